@@ -0,0 +1,28 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/*
+ * each benchmark is a subcommand of predcfb_bench and gets the arguments
+ * that follow its name. it returns 0 on success
+ */
+struct benchmark {
+	const char *name;
+	const char *usage;
+	int (*run)(int argc, char **argv);
+};
+
+extern const char *progname;
+
+/* monotonic time in seconds */
+extern double bench_now(void);
+
+/* print one result line: name, iterations and time per iteration */
+extern void bench_report(const char *name, int iterations, double seconds);
+
+extern const struct benchmark bench_reload;
+extern const struct benchmark bench_csvcopy;
+extern const struct benchmark bench_numparse;
+extern const struct benchmark bench_oidhash;
+extern const struct benchmark bench_stream;
+
+#endif
@@ -0,0 +1,212 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sys/types.h>
+
+#include <predcfb/csvparse.h>
+#include <predcfb/zipfile.h>
+
+#include "bench.h"
+
+/*
+ * csvcopy: tokenize every csv member of an archive with libcsv, which
+ * copies each field twice, and with the in-place tokenizer, which only
+ * copies quoted fields. the members are inflated once up front and the
+ * line handler does nothing, so only the tokenizing is timed. the
+ * in-place tokenizer is run with every scanner the cpu supports
+ */
+
+#define CSVCOPY_ITERATIONS 20
+#define CSVCOPY_BUF_SIZE (64 * 1024)
+
+static const char *members[] = {
+	"conference.csv",
+	"team.csv",
+	"game.csv",
+	"team-game-statistics.csv",
+	NULL
+};
+
+struct member {
+	char *data;
+	size_t size;
+};
+
+static int count_line(struct csvline *line, void *data)
+{
+	size_t *fields = data;
+
+	*fields += line->num_fields;
+
+	return 0;
+}
+
+static int inflate(zf_readctx *zf, const char *file, struct member *m)
+{
+	size_t max = 0;
+	ssize_t bytes;
+	char *data;
+
+	if (zipfile_open_file(zf, file) != ZIPFILE_OK)
+		return -1;
+
+	for (;;) {
+		if (m->size == max) {
+			max = max ? max * 2 : CSVCOPY_BUF_SIZE;
+			if ((data = realloc(m->data, max)) == NULL)
+				break;
+			m->data = data;
+		}
+
+		bytes = zipfile_read_file(zf, m->data + m->size, max - m->size);
+		if (bytes <= 0) {
+			zipfile_close_file(zf);
+			return bytes == 0 ? 0 : -1;
+		}
+
+		m->size += bytes;
+	}
+
+	zipfile_close_file(zf);
+
+	return -1;
+}
+
+/* parse every member once, work is scratch space as big as the largest */
+static int parse_all(struct member *m, char *work, bool inplace,
+                     enum csvscan_isa isa, size_t *copied)
+{
+	struct csvparse csvp;
+	size_t fields = 0;
+	int err;
+
+	for (; m->data; m++) {
+		memcpy(work, m->data, m->size);
+
+		if (csvp_init(&csvp, count_line, &fields) != CSVP_OK ||
+		    csvp_set_isa(&csvp, isa) != CSVP_OK)
+			return -1;
+
+		if (inplace)
+			err = csvp_parse_inplace(&csvp, work, m->size);
+		else
+			err = csvp_parse(&csvp, work, m->size);
+
+		*copied += csvp.bytes_copied;
+
+		if (csvp_destroy(&csvp) != CSVP_OK || err != CSVP_OK) {
+			fprintf(stderr, "%s: %s\n", progname, csvp_strerror(&csvp));
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static int time_parse(const char *name, struct member *m, char *work,
+                      bool inplace, enum csvscan_isa isa, int n,
+                      size_t total)
+{
+	size_t copied = 0;
+	double start, secs;
+	int i;
+
+	start = bench_now();
+
+	for (i = 0; i < n; i++) {
+		copied = 0;
+		if (parse_all(m, work, inplace, isa, &copied) != 0)
+			return -1;
+	}
+
+	secs = bench_now() - start;
+
+	bench_report(name, n, secs);
+	printf("%-32s %12lu bytes copied/run %8.1f MB/s\n", "",
+	       (unsigned long) copied, total * n / secs / 1e6);
+
+	return 0;
+}
+
+static int time_scanners(struct member *m, char *work, int n, size_t total)
+{
+	enum csvscan_isa isa;
+	char name[64];
+	int err = 0;
+
+	for (isa = CSVSCAN_SCALAR; isa <= CSVSCAN_AVX2 && !err; isa++) {
+		if (!csvscan_isa_supported(isa))
+			continue;
+
+		snprintf(name, sizeof(name), "csvp_parse_inplace (%s)",
+		         csvscan_isa_name(isa));
+		err = time_parse(name, m, work, true, isa, n, total);
+	}
+
+	return err;
+}
+
+static int run_csvcopy(int argc, char **argv)
+{
+	struct member m[sizeof(members) / sizeof(members[0])];
+	size_t max = 0, total = 0;
+	char *work = NULL;
+	zf_readctx *zf;
+	int n = CSVCOPY_ITERATIONS;
+	int err = -1;
+	int i;
+
+	if (argc < 1)
+		return -1;
+
+	if (argc > 1 && (n = atoi(argv[1])) < 1)
+		return -1;
+
+	zf = zipfile_open_archive(argv[0]);
+	if (!zf || zipfile_get_error(zf) != ZIPFILE_ENONE) {
+		fprintf(stderr, "%s: could not open %s\n", progname, argv[0]);
+		free(zf);
+		return -1;
+	}
+
+	memset(m, 0, sizeof(m));
+
+	for (i = 0; members[i]; i++) {
+		if (inflate(zf, members[i], &m[i]) != 0) {
+			fprintf(stderr, "%s: %s: %s\n", progname, members[i],
+			        zipfile_strerr(zf));
+			goto out;
+		}
+
+		if (m[i].size > max)
+			max = m[i].size;
+		total += m[i].size;
+	}
+
+	if ((work = malloc(max)) == NULL)
+		goto out;
+
+	printf("%-32s %12lu bytes inflated\n", argv[0], (unsigned long) total);
+
+	if (time_parse("csvp_parse", m, work, false, csvscan_get_isa(), n,
+	               total) != 0 ||
+	    time_scanners(m, work, n, total) != 0)
+		goto out;
+
+	err = 0;
+out:
+	for (i = 0; members[i]; i++)
+		free(m[i].data);
+	free(work);
+	zipfile_close_archive(zf);
+
+	return err;
+}
+
+const struct benchmark bench_csvcopy = {
+	"csvcopy",
+	"<zip file> [iterations]",
+	run_csvcopy
+};
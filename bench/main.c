@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+
+static const struct benchmark *benchmarks[] = {
+	&bench_reload,
+	&bench_csvcopy,
+	&bench_numparse,
+	&bench_oidhash,
+	&bench_stream,
+	NULL
+};
+
+double bench_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void bench_report(const char *name, int iterations, double seconds)
+{
+	printf("%-32s %6d runs %12.3f ms/run\n",
+	       name, iterations, seconds * 1000.0 / iterations);
+}
+
+static void print_usage(void)
+{
+	int i;
+
+	fprintf(stderr, "usage: %s <benchmark> [args]\n", progname);
+
+	for (i = 0; benchmarks[i]; i++)
+		fprintf(stderr, "\t%s %s\n", benchmarks[i]->name,
+		        benchmarks[i]->usage);
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+
+	progname = argv[0];
+
+	if (argc < 2) {
+		print_usage();
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; benchmarks[i]; i++) {
+		if (strcmp(argv[1], benchmarks[i]->name) == 0) {
+			if (benchmarks[i]->run(argc - 2, argv + 2) != 0)
+				return EXIT_FAILURE;
+
+			return EXIT_SUCCESS;
+		}
+	}
+
+	print_usage();
+
+	return EXIT_FAILURE;
+}
@@ -0,0 +1,111 @@
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <predcfb/csvparse.h>
+
+#include "bench.h"
+
+/*
+ * numparse: converting the numeric fields of a team-game-statistics.csv
+ * sized line, with strtol as csvline used to and with csvline_short_at
+ */
+
+#define NUMPARSE_ROWS 200000
+#define NUMPARSE_FIELDS 64
+
+static volatile long sink;
+
+/* the conversion csvline_short_at used to do */
+static int strtol_short(const char *str, short *out)
+{
+	char *endptr;
+	long li;
+
+	li = strtol(str, &endptr, 10);
+	if (*endptr != '\0' || li < SHRT_MIN || li > SHRT_MAX)
+		return -1;
+
+	*out = (short) li;
+
+	return 0;
+}
+
+static int fill_line(struct csvline *line)
+{
+	char buf[16];
+	int i;
+
+	csvline_clear(line);
+	srand(1);
+
+	/* mostly small counts, some yardages, the odd negative */
+	for (i = 0; i < NUMPARSE_FIELDS; i++) {
+		int v = rand() % 10 ? rand() % 40 : rand() % 700 - 50;
+
+		snprintf(buf, sizeof(buf), "%d", v);
+		if (csvline_add(line, buf, strlen(buf)) != CSVP_OK)
+			return -1;
+	}
+
+	return 0;
+}
+
+static int run_numparse(int argc, char **argv)
+{
+	struct csvline line;
+	double start, secs;
+	short val;
+	long sum;
+	int n = NUMPARSE_ROWS;
+	int i, j;
+
+	if (argc > 0 && (n = atoi(argv[0])) < 1)
+		return -1;
+
+	if (fill_line(&line) != 0)
+		return -1;
+
+	start = bench_now();
+	for (i = 0, sum = 0; i < n; i++) {
+		for (j = 0; j < line.num_fields; j++) {
+			if (strtol_short(line.fields[j], &val) != 0)
+				return -1;
+			sum += val;
+		}
+	}
+	secs = bench_now() - start;
+	sink = sum;
+
+	bench_report("strtol", n, secs);
+	printf("%-32s %12.1f ns/field\n", "",
+	       secs * 1e9 / ((double) n * line.num_fields));
+
+	start = bench_now();
+	for (i = 0, sum = 0; i < n; i++) {
+		for (j = 0; j < line.num_fields; j++) {
+			if (csvline_short_at(&line, j, &val) != CSVP_OK)
+				return -1;
+			sum += val;
+		}
+	}
+	secs = bench_now() - start;
+
+	if (sum != sink) {
+		fprintf(stderr, "%s: results differ\n", progname);
+		return -1;
+	}
+
+	bench_report("csvline_short_at", n, secs);
+	printf("%-32s %12.1f ns/field\n", "",
+	       secs * 1e9 / ((double) n * line.num_fields));
+
+	return 0;
+}
+
+const struct benchmark bench_numparse = {
+	"numparse",
+	"[rows]",
+	run_numparse
+};
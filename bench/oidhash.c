@@ -0,0 +1,175 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <predcfb/predcfb.h>
+#include <predcfb/objectid.h>
+
+#include "../src/objectdb/hash_impl.h"
+#include "bench.h"
+
+/*
+ * oidhash: objectids per second for a season's worth of teams and games,
+ * with every sha1 implementation the cpu supports and with fast ids, then
+ * for the games alone hashed as one batch with each batch implementation
+ */
+
+#define OIDHASH_ITERATIONS 200
+#define OIDHASH_TEAMS 240
+#define OIDHASH_GAMES 1600
+
+static volatile unsigned char sink;
+
+/* the names aren't interned, so team ids are hashed every time */
+struct season {
+	char names[OIDHASH_TEAMS][TEAM_NAME_MAX];
+	struct team teams[OIDHASH_TEAMS];
+	struct game games[OIDHASH_GAMES];
+};
+
+static void fill_season(struct season *s)
+{
+	static const char *mascots[] = {
+		"State", "Tech", "A&M", "University", "College"
+	};
+	int i;
+
+	memset(s, 0, sizeof(*s));
+	srand(1);
+
+	/* names about as long as the real ones */
+	for (i = 0; i < OIDHASH_TEAMS; i++) {
+		snprintf(s->names[i], TEAM_NAME_MAX, "Team %d %s", i * 37,
+		         mascots[i % 5]);
+		s->teams[i].name.str = s->names[i];
+	}
+
+	for (i = 0; i < OIDHASH_GAMES; i++) {
+		struct game *g = &s->games[i];
+
+		g->home = &s->teams[rand() % OIDHASH_TEAMS];
+		g->away = &s->teams[rand() % OIDHASH_TEAMS];
+		snprintf(g->date_str, DATE_STR_SIZE, "2012-%02d-%02d",
+		         9 + i / 400, 1 + i % 28);
+	}
+}
+
+static void time_ids(const char *name, const struct season *s, bool fast,
+                     int n)
+{
+	struct objectid id;
+	double start, secs;
+	unsigned char x = 0;
+	int i, j;
+
+	start = bench_now();
+
+	for (i = 0; i < n; i++) {
+		for (j = 0; j < OIDHASH_TEAMS; j++) {
+			if (fast)
+				objectid_fast_from_team(&s->teams[j], &id);
+			else
+				objectid_from_team(&s->teams[j], &id);
+			x ^= id.md[0];
+		}
+
+		for (j = 0; j < OIDHASH_GAMES; j++) {
+			if (fast)
+				objectid_fast_from_game(&s->games[j], &id);
+			else
+				objectid_from_game(&s->games[j], &id);
+			x ^= id.md[0];
+		}
+	}
+
+	secs = bench_now() - start;
+	sink = x;
+
+	bench_report(name, n, secs);
+	printf("%-32s %12.2f M ids/s\n", "",
+	       (double) n * (OIDHASH_TEAMS + OIDHASH_GAMES) / secs / 1e6);
+}
+
+static void time_batch(const char *name, const struct season *s, int n)
+{
+	const struct game *games[OIDHASH_GAMES];
+	struct objectid *ids;
+	double start, secs;
+	unsigned char x = 0;
+	int i, j;
+
+	if ((ids = malloc(sizeof(*ids) * OIDHASH_GAMES)) == NULL)
+		return;
+
+	for (i = 0; i < OIDHASH_GAMES; i++)
+		games[i] = &s->games[i];
+
+	start = bench_now();
+
+	for (i = 0; i < n; i++) {
+		objectid_from_games(games, OIDHASH_GAMES, ids);
+		for (j = 0; j < OIDHASH_GAMES; j++)
+			x ^= ids[j].md[0];
+	}
+
+	secs = bench_now() - start;
+	sink = x;
+	free(ids);
+
+	bench_report(name, n, secs);
+	printf("%-32s %12.2f M ids/s\n", "",
+	       (double) n * OIDHASH_GAMES / secs / 1e6);
+}
+
+static int run_oidhash(int argc, char **argv)
+{
+	enum objectid_sha1_impl impl, best = objectid_get_sha1_impl();
+	enum objectid_batch_impl batch, best_batch = objectid_get_batch_impl();
+	struct season *s;
+	char name[64];
+	int n = OIDHASH_ITERATIONS;
+
+	if (argc > 0 && (n = atoi(argv[0])) < 1)
+		return -1;
+
+	if ((s = malloc(sizeof(*s))) == NULL)
+		return -1;
+
+	fill_season(s);
+
+	for (impl = OBJECTID_SHA1_POLARSSL; impl <= OBJECTID_SHA1_SHANI; impl++) {
+		if (!objectid_set_sha1_impl(impl))
+			continue;
+
+		snprintf(name, sizeof(name), "sha1 (%s)",
+		         objectid_sha1_impl_name(impl));
+		time_ids(name, s, false, n);
+	}
+
+	objectid_set_sha1_impl(best);
+
+	time_ids("fast", s, true, n);
+
+	for (batch = OBJECTID_BATCH_SERIAL; batch <= OBJECTID_BATCH_MB_AVX2;
+	     batch++) {
+		if (!objectid_set_batch_impl(batch))
+			continue;
+
+		snprintf(name, sizeof(name), "games batch (%s)",
+		         objectid_batch_impl_name(batch));
+		time_batch(name, s, n);
+	}
+
+	objectid_set_batch_impl(best_batch);
+
+	free(s);
+
+	return 0;
+}
+
+const struct benchmark bench_oidhash = {
+	"oidhash",
+	"[iterations]",
+	run_oidhash
+};
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unistd.h>
+
+#include <predcfb/cfbstats.h>
+#include <predcfb/objectdb.h>
+#include <predcfb/snapshot.h>
+
+#include "bench.h"
+
+/*
+ * reload: how long it takes to get back to a loaded database from the
+ * archive itself, from a --save yaml file and from a --snapshot file
+ */
+
+#define RELOAD_ITERATIONS 20
+
+static int time_archive(objectdb_ctx *db, const char *archive, int n)
+{
+	cfbstats_ctx *cfbstats;
+	double start;
+	int i;
+
+	if ((cfbstats = cfbstats_new(db)) == NULL)
+		return -1;
+
+	start = bench_now();
+
+	for (i = 0; i < n; i++) {
+		objectdb_clear(db);
+
+		if (cfbstats_read_zipfile(cfbstats, archive) != CFBSTATS_OK) {
+			fprintf(stderr, "%s: %s: %s\n", progname, archive,
+			        cfbstats_strerror(cfbstats));
+			cfbstats_free(cfbstats);
+			return -1;
+		}
+	}
+
+	bench_report("cfbstats_read_zipfile", n, bench_now() - start);
+	cfbstats_free(cfbstats);
+
+	return 0;
+}
+
+static int time_yaml(objectdb_ctx *db, const char *path, int n)
+{
+	double start;
+	int i;
+
+	start = bench_now();
+
+	for (i = 0; i < n; i++) {
+		objectdb_clear(db);
+
+		if (objectdb_read(db, path) != OBJECTDB_OK)
+			return -1;
+	}
+
+	bench_report("objectdb_read (yaml)", n, bench_now() - start);
+
+	return 0;
+}
+
+static int time_snapshot(objectdb_ctx *db, const char *path, int n)
+{
+	snapshot_ctx *snap;
+	double start;
+	int err = -1;
+	int i;
+
+	if ((snap = snapshot_new()) == NULL)
+		return -1;
+
+	/* just mapping and checking it is what a read-only user pays */
+	start = bench_now();
+
+	for (i = 0; i < n; i++) {
+		if (snapshot_open(snap, path) != SNAPSHOT_OK)
+			goto out;
+	}
+
+	bench_report("snapshot_open", n, bench_now() - start);
+
+	start = bench_now();
+
+	for (i = 0; i < n; i++) {
+		objectdb_clear(db);
+
+		if (snapshot_open(snap, path) != SNAPSHOT_OK ||
+		    snapshot_load(snap, db) != SNAPSHOT_OK)
+			goto out;
+	}
+
+	bench_report("snapshot_open + snapshot_load", n, bench_now() - start);
+	err = 0;
+out:
+	if (err != 0) {
+		fprintf(stderr, "%s: %s: %s\n", progname, path,
+		        snapshot_strerror(snap));
+	}
+
+	snapshot_free(snap);
+
+	return err;
+}
+
+static int run_reload(int argc, char **argv)
+{
+	char yaml_path[] = "/tmp/predcfb_benchXXXXXX";
+	char snap_path[] = "/tmp/predcfb_benchXXXXXX";
+	objectdb_ctx *db;
+	int n = RELOAD_ITERATIONS;
+	int err = -1;
+	int fd;
+
+	if (argc < 1)
+		return -1;
+
+	if (argc > 1 && (n = atoi(argv[1])) < 1)
+		return -1;
+
+	if ((db = objectdb_new()) == NULL)
+		return -1;
+
+	if ((fd = mkstemp(yaml_path)) >= 0)
+		close(fd);
+
+	if ((fd = mkstemp(snap_path)) >= 0)
+		close(fd);
+
+	if (time_archive(db, argv[0], n) != 0)
+		goto out;
+
+	/* the database is still loaded from the last run */
+	if (objectdb_write(db, yaml_path, OBJECTDB_FORMAT_YAML) != OBJECTDB_OK ||
+	    objectdb_write(db, snap_path, OBJECTDB_FORMAT_SNAPSHOT) != OBJECTDB_OK)
+		goto out;
+
+	if (time_yaml(db, yaml_path, n) != 0)
+		goto out;
+
+	if (time_snapshot(db, snap_path, n) != 0)
+		goto out;
+
+	err = 0;
+out:
+	unlink(yaml_path);
+	unlink(snap_path);
+	objectdb_free(db);
+
+	return err;
+}
+
+const struct benchmark bench_reload = {
+	"reload",
+	"<zip file> [iterations]",
+	run_reload
+};
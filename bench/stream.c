@@ -0,0 +1,106 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <predcfb/cfbstats.h>
+#include <predcfb/objectdb.h>
+
+#include "bench.h"
+
+/*
+ * stream: reading an archive pipelined, then streamed through read
+ * buffers of a few sizes, with the time spent inflating, parsing and
+ * waiting on inflated data for each
+ */
+
+#define STREAM_ITERATIONS 20
+
+static const size_t buffer_sizes[] = {
+	4 * 1024,
+	64 * 1024,
+	CFBSTATS_READ_BUFFER_SIZE,
+	0
+};
+
+static int time_read(objectdb_ctx *db, const char *archive, bool pipeline,
+                     size_t buffer_size, int n)
+{
+	struct cfbstats_timing t;
+	cfbstats_ctx *cfbstats;
+	char name[64];
+	double start;
+	int i;
+
+	if ((cfbstats = cfbstats_new(db)) == NULL)
+		return -1;
+
+	cfbstats_set_pipeline(cfbstats, pipeline);
+	cfbstats_set_read_buffer(cfbstats, buffer_size);
+
+	start = bench_now();
+
+	for (i = 0; i < n; i++) {
+		objectdb_clear(db);
+
+		if (cfbstats_read_zipfile(cfbstats, archive) != CFBSTATS_OK) {
+			fprintf(stderr, "%s: %s: %s\n", progname, archive,
+			        cfbstats_strerror(cfbstats));
+			cfbstats_free(cfbstats);
+			return -1;
+		}
+	}
+
+	if (pipeline)
+		snprintf(name, sizeof(name), "pipelined");
+	else
+		snprintf(name, sizeof(name), "streamed (%zu k buffers)",
+		         buffer_size / 1024);
+
+	bench_report(name, n, bench_now() - start);
+
+	cfbstats_get_timing(cfbstats, &t);
+	printf("%-32s %12.3f ms inflate %9.3f ms parse %9.3f ms wait\n", "",
+	       t.inflate * 1000.0 / n, t.parse * 1000.0 / n,
+	       t.wait * 1000.0 / n);
+
+	cfbstats_free(cfbstats);
+
+	return 0;
+}
+
+static int run_stream(int argc, char **argv)
+{
+	objectdb_ctx *db;
+	int n = STREAM_ITERATIONS;
+	int err = -1;
+	int i;
+
+	if (argc < 1)
+		return -1;
+
+	if (argc > 1 && (n = atoi(argv[1])) < 1)
+		return -1;
+
+	if ((db = objectdb_new()) == NULL)
+		return -1;
+
+	if (time_read(db, argv[0], true, 0, n) != 0)
+		goto out;
+
+	for (i = 0; buffer_sizes[i]; i++) {
+		if (time_read(db, argv[0], false, buffer_sizes[i], n) != 0)
+			goto out;
+	}
+
+	err = 0;
+out:
+	objectdb_free(db);
+
+	return err;
+}
+
+const struct benchmark bench_stream = {
+	"stream",
+	"<zip file> [iterations]",
+	run_stream
+};
@@ -21,3 +21,45 @@ ENDIF(NOT HAS_YAML_H OR NOT HAS_YAML)
 CHECK_SYMBOL_EXISTS(strlcpy "string.h" HAVE_STRLCPY)
 CHECK_SYMBOL_EXISTS(strlcat "string.h" HAVE_STRLCAT)
 
+
+# check for x86 simd intrinsics that can be enabled per function, so the
+# csv scanner can pick sse4.2 or avx2 at runtime
+INCLUDE(CheckCSourceCompiles)
+CHECK_C_SOURCE_COMPILES("
+#include <immintrin.h>
+__attribute__((target(\"avx2\"))) static int f(const char *p)
+{
+	__m256i v = _mm256_loadu_si256((const __m256i *) p);
+	return _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, v));
+}
+__attribute__((target(\"sse4.2\"))) static int g(const char *p)
+{
+	__m128i v = _mm_loadu_si128((const __m128i *) p);
+	return _mm_cvtsi128_si32(_mm_cmpestrm(v, 4, v, 16, _SIDD_CMP_EQUAL_ANY));
+}
+int main(void)
+{
+	char buf[32] = {0};
+	__builtin_cpu_init();
+	return __builtin_cpu_supports(\"avx2\") ? f(buf) : g(buf);
+}" HAVE_X86_SIMD)
+
+# check for the sha extensions, so objectids can be hashed with sha-ni
+# when the cpu has it
+CHECK_C_SOURCE_COMPILES("
+#include <cpuid.h>
+#include <immintrin.h>
+__attribute__((target(\"sha,sse4.1\"))) static int f(const char *p)
+{
+	__m128i v = _mm_loadu_si128((const __m128i *) p);
+	v = _mm_sha1rnds4_epu32(v, _mm_sha1nexte_epu32(v, v), 0);
+	return _mm_extract_epi32(_mm_sha1msg2_epu32(_mm_sha1msg1_epu32(v, v), v), 3);
+}
+int main(void)
+{
+	unsigned int a, b, c, d;
+	char buf[16] = {0};
+	if (!__get_cpuid_count(7, 0, &a, &b, &c, &d))
+		return 0;
+	return (b & bit_SHA) ? f(buf) : 0;
+}" HAVE_X86_SHA)
@@ -1,6 +1,12 @@
 #ifndef CFBSTATS_H
 #define CFBSTATS_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include <predcfb/objectdb.h>
+
 #define CFBSTATS_OK       0
 #define CFBSTATS_ERROR  (-1)
 
@@ -11,12 +17,101 @@ enum cfbstats_err {
 	CFBSTATS_EINVALIDFILE,
 	CFBSTATS_ETOOMANY,
 	CFBSTATS_EIDLOOKUP,
-	CFBSTATS_EOIDLOOKUP
+	CFBSTATS_EOIDLOOKUP,
+	CFBSTATS_EMERGE,
+	CFBSTATS_EMANIFEST
+};
+
+/*
+ * a cfbstats_ctx holds all of the parsing state for reading archives into
+ * one objectdb. contexts share nothing, so different contexts (with
+ * different databases) can be used from different threads at once
+ */
+typedef struct cfbstats_context cfbstats_ctx;
+
+/* allocate a context that reads into db, NULL if out of memory */
+extern cfbstats_ctx *cfbstats_new(objectdb_ctx *db);
+extern void cfbstats_free(cfbstats_ctx *ctx);
+
+extern enum cfbstats_err cfbstats_get_error(const cfbstats_ctx *ctx);
+extern const char *cfbstats_strerror(const cfbstats_ctx *ctx);
+
+/*
+ * in pipelined mode (the default) each file in an archive is inflated on
+ * its own thread while the files before it are parsed, at the cost of
+ * holding the inflated files in memory. disabled, the files are read one
+ * after another, each streamed through a pair of buffers
+ */
+extern void cfbstats_set_pipeline(cfbstats_ctx *ctx, bool enable);
+
+/*
+ * with the pipeline disabled, each file is streamed through two buffers
+ * of this size: one is parsed while a helper thread inflates the next
+ * part of the file into the other. a size of 0 restores the default
+ */
+#define CFBSTATS_READ_BUFFER_SIZE (1024 * 1024)
+
+extern void cfbstats_set_read_buffer(cfbstats_ctx *ctx, size_t size);
+
+/*
+ * seconds spent reading archives since the context was created or its
+ * timing was reset. inflate time is summed over every thread that
+ * inflated, wait is how long the parser sat waiting for inflated data
+ */
+struct cfbstats_timing {
+	double inflate;
+	double parse;
+	double wait;
 };
 
-extern enum cfbstats_err cfbstats_errno;
-extern const char *cfbstats_strerror(void);
+extern void cfbstats_get_timing(const cfbstats_ctx *ctx,
+                                struct cfbstats_timing *timing);
+extern void cfbstats_reset_timing(cfbstats_ctx *ctx);
+
+/*
+ * with a manifest, the context remembers the size and crc of every file
+ * it reads from an archive, as given by the archive's central directory.
+ * when an archive the manifest has a record of is read again, the files
+ * that haven't changed since are skipped, for as long as none of the
+ * files before them have changed either. the rest are read on top of
+ * what is already in the database: rows it already has change nothing,
+ * so only new games and changed statistics are applied. the manifest is
+ * only good for the database it was written alongside
+ */
+extern int cfbstats_manifest_new(cfbstats_ctx *ctx);
+extern int cfbstats_manifest_read(cfbstats_ctx *ctx, const char *path);
+extern int cfbstats_manifest_write(cfbstats_ctx *ctx, const char *path);
+
+/* how many files were skipped as unchanged since the context was made */
+extern int cfbstats_files_skipped(const cfbstats_ctx *ctx);
+
+extern int cfbstats_read_zipfile(cfbstats_ctx *ctx, const char *archive);
+
+/*
+ * apply the rows of a game.csv or team-game-statistics.csv, header and
+ * all, read from inf (name is only used in messages), without reading
+ * the rest of the archive they come from. games the database doesn't
+ * have are added, with both of their teams marked dirty (see
+ * objectdb_get_dirty_teams), and stats rows replace the game's stats
+ * for that team and its totals. the cfbstats codes in the rows are
+ * looked up in the ids of archive (a path or file name), as recorded in
+ * the manifest, or if archive is NULL, in the ids of the archive last
+ * read with cfbstats_read_zipfile
+ */
+extern int cfbstats_append_csv(cfbstats_ctx *ctx,
+                               const char *archive,
+                               FILE *inf,
+                               const char *name);
 
-extern int cfbstats_read_zipfile(const char *archive);
+/*
+ * parse each archive into its own database on a pool of num_workers
+ * threads, then merge the results into the context's database in the
+ * order given. if num_workers is <= 0, one worker per online cpu is used.
+ * if the database isn't empty, the archives are read into it one by one
+ */
+extern int cfbstats_read_zipfiles(cfbstats_ctx *ctx,
+                                  const char **archives,
+                                  int num_archives,
+                                  int num_workers);
 
 #endif
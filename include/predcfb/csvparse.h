@@ -1,7 +1,9 @@
 #ifndef CSVPARSE_H
 #define CSVPARSE_H
 
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <libcsv/csv.h>
 
 #define CSVP_OK		  0
@@ -29,6 +31,7 @@ enum csvline_error {
 
 struct csvline {
 	const char *fields[CSVLINE_MAX_FIELDS];
+	size_t lens[CSVLINE_MAX_FIELDS];
 	int num_fields;
 	int line;
 	struct strbuf strbuf;
@@ -39,14 +42,58 @@ extern const char *strbuf_add(struct strbuf *s, const char *str, size_t len);
 extern void strbuf_clear(struct strbuf *s);
 
 extern int csvline_add(struct csvline *c, const char *str, size_t len);
+
+/*
+ * add a field without copying it; str must stay valid for as long as the
+ * line is in use and must already be null terminated at str[len]
+ */
+extern int csvline_add_slice(struct csvline *c, const char *str, size_t len);
 extern void csvline_clear(struct csvline *c);
 
+/* count a column that wasn't materialized; reading it is an error */
+extern int csvline_skip(struct csvline *c);
+
 extern int csvline_str_at(struct csvline *c, int at, const char **out);
+extern int csvline_slice_at(struct csvline *c, int at,
+		const char **out, size_t *len);
 extern int csvline_int_at(struct csvline *c, int at, int *out);
 extern int csvline_short_at(struct csvline *c, int at, short *out);
 
 extern const char *csvline_strerror(const struct csvline *c);
 
+/* csvscan interface */
+
+/*
+ * the scanner finds the bytes the in-place tokenizer has to stop at:
+ * commas, quotes, carriage returns and newlines. it looks at
+ * CSVSCAN_BLOCK bytes at a time and records the offset of each one it
+ * finds, so the tokenizer never walks the bytes in between
+ */
+#define CSVSCAN_BLOCK 32
+#define CSVSCAN_CHUNK 4096
+
+enum csvscan_isa {
+	CSVSCAN_SCALAR,
+	CSVSCAN_SSE42,
+	CSVSCAN_AVX2
+};
+
+/*
+ * store the offset into buf of every special byte in offsets, which must
+ * have room for len entries, and return how many were found. csvscan
+ * uses the best implementation the cpu supports (csvscan_get_isa), the
+ * other takes one the cpu must support
+ */
+extern size_t csvscan(const char *buf, size_t len, uint32_t *offsets);
+extern size_t csvscan_with_isa(enum csvscan_isa isa,
+                               const char *buf,
+                               size_t len,
+                               uint32_t *offsets);
+
+extern enum csvscan_isa csvscan_get_isa(void);
+extern bool csvscan_isa_supported(enum csvscan_isa isa);
+extern const char *csvscan_isa_name(enum csvscan_isa isa);
+
 /* csvparse interface */
 
 enum csvparse_error {
@@ -61,16 +108,45 @@ struct csvparse {
 	struct csv_parser parser;
 	int lines;
 	struct csvline csvline;
-	int (*handler)(struct csvline*);
+	int (*handler)(struct csvline*, void*);
+	void *handler_data;
+	size_t bytes_copied;
+	bool projected;
+	bool columns[CSVLINE_MAX_FIELDS];
+	enum csvscan_isa isa;
 	enum csvparse_error error;
 };
 
 extern int csvp_init(
 		struct csvparse *c,
-		int (*handler)(struct csvline*));
+		int (*handler)(struct csvline*, void*),
+		void *handler_data);
 extern int csvp_destroy(struct csvparse *c);
+
+/*
+ * only materialize the given column indices in each line; the others are
+ * still counted in num_fields but cost no more than finding their end
+ */
+extern int csvp_set_projection(
+		struct csvparse *c,
+		const int *columns,
+		int num_columns);
 extern int csvp_parse(struct csvparse *c, char *buf, size_t len);
 
+/*
+ * the scanner implementation csvp_parse_inplace uses, csvscan_get_isa
+ * unless set. fails if the cpu doesn't support isa
+ */
+extern int csvp_set_isa(struct csvparse *c, enum csvscan_isa isa);
+
+/*
+ * tokenize a complete buffer in place. unquoted fields are handed to the
+ * handler as slices pointing into buf, which is modified to terminate
+ * them, so buf must outlive the parse; quoted fields are unescaped and
+ * copied into the line as usual
+ */
+extern int csvp_parse_inplace(struct csvparse *c, char *buf, size_t len);
+
 extern enum csvparse_error csvp_error(const struct csvparse *c);
 extern const char *csvp_strerror(const struct csvparse *c);
 
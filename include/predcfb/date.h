@@ -0,0 +1,30 @@
+#ifndef DATE_H
+#define DATE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+/* YYYY-MM-DD\0, the form dates are saved and hashed in */
+#define DATE_STR_SIZE 11
+
+/*
+ * game dates are days, kept as a time_t at midnight UTC. these do the
+ * calendar arithmetic directly, so there are no libc time calls and the
+ * local timezone doesn't matter
+ */
+
+/* days since 1970-01-01 in the proleptic gregorian calendar */
+extern long date_days_from_civil(int year, int month, int day);
+extern void date_civil_from_days(long days, int *year, int *month, int *day);
+
+/* parse M/D/YYYY (one or two digit month and day), false if invalid */
+extern bool date_parse_mdy(const char *str, size_t len, time_t *out);
+
+/* parse YYYY-MM-DD, false if invalid */
+extern bool date_parse_ymd(const char *str, time_t *out);
+
+/* write the YYYY-MM-DD form of the day containing t */
+extern void date_string(time_t t, char buf[DATE_STR_SIZE]);
+
+#endif
@@ -1,6 +1,9 @@
 #ifndef OBJECTDB_H
 #define OBJECTDB_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include <predcfb/objectid.h>
 #include <predcfb/predcfb.h>
 
@@ -9,34 +12,219 @@
 
 enum objectdb_err {
 	OBJECTDB_ENONE,
-	OBJECTDB_EMAXOBJECTS,
-	OBJECTDB_EMAXCONFS,
-	OBJECTDB_EMAXTEAMS,
-	OBJECTDB_EMAXGAMES,
+	OBJECTDB_ENOMEM,
 	OBJECTDB_ENOTFOUND,
 	OBJECTDB_EWRONGTYPE,
-	OBJECTDB_EDUPLICATE
+	OBJECTDB_EDUPLICATE,
+	OBJECTDB_EREAD,
+	OBJECTDB_EPARSE,
+	OBJECTDB_EMISMATCH,
+	OBJECTDB_EIDS,
+	OBJECTDB_ETOOLONG
 };
 
-extern enum objectdb_err objectdb_errno;
+/*
+ * every object database is independent of the others, so separate
+ * databases can be built and queried from separate threads without
+ * locking. a single database must not be used by two threads at once
+ */
+typedef struct objectdb_context objectdb_ctx;
+
+/* allocate an empty object database, NULL if out of memory */
+extern objectdb_ctx *objectdb_new(void);
+
+/*
+ * the same, choosing how objectids are made. a database of OBJECTID_FAST
+ * ids can't be written, read into or merged with a sha1 one
+ */
+extern objectdb_ctx *objectdb_new_ids(enum objectid_kind ids);
+extern enum objectid_kind objectdb_get_ids(const objectdb_ctx *db);
+extern void objectdb_free(objectdb_ctx *db);
+
+extern enum objectdb_err objectdb_get_error(const objectdb_ctx *db);
+extern const char *objectdb_strerror(const objectdb_ctx *db);
+
+/*
+ * make room for num_objects more objects up front, so that loading a
+ * known number of records doesn't have to regrow the index along the way
+ */
+extern int objectdb_reserve(objectdb_ctx *db, int num_objects);
+
+/*
+ * point n at db's copy of the first len bytes of str, adding one if this
+ * is a new name. every conference and team name in a database should be
+ * interned: each name is then stored once however many seasons use it,
+ * and its objectids are hashed once, here, instead of for every object.
+ * fails with OBJECTDB_ETOOLONG unless len < TEAM_NAME_MAX
+ */
+extern int objectdb_intern(objectdb_ctx *db,
+                           const char *str,
+                           size_t len,
+                           struct name *n);
+
+/* the interned name with handle ref, NULL if there isn't one */
+extern const char *objectdb_name(objectdb_ctx *db, uint32_t ref);
+extern int objectdb_num_names(const objectdb_ctx *db);
 
-extern struct conference *objectdb_create_conference(void);
-extern int objectdb_add_conference(struct conference *c, struct objectid *id);
-extern struct conference *objectdb_get_conference(const struct objectid *id);
+extern struct conference *objectdb_create_conference(objectdb_ctx *db);
+extern int objectdb_add_conference(objectdb_ctx *db,
+                                   struct conference *c,
+                                   struct objectid *id);
+extern struct conference *objectdb_get_conference(objectdb_ctx *db,
+                                                  const struct objectid *id);
 
-extern struct team *objectdb_create_team(void);
-extern int objectdb_add_team(struct team *c, struct objectid *id);
-extern struct team *objectdb_get_team(const struct objectid *id);
+extern struct team *objectdb_create_team(objectdb_ctx *db);
+extern int objectdb_add_team(objectdb_ctx *db,
+                             struct team *t,
+                             struct objectid *id);
+extern struct team *objectdb_get_team(objectdb_ctx *db,
+                                      const struct objectid *id);
 
-extern struct game *objectdb_create_game(void);
-extern int objectdb_add_game(struct game *g, struct objectid *id);
-extern struct game *objectdb_get_game(const struct objectid *id);
+extern struct game *objectdb_create_game(objectdb_ctx *db);
+extern int objectdb_add_game(objectdb_ctx *db,
+                             struct game *g,
+                             struct objectid *id);
+extern struct game *objectdb_get_game(objectdb_ctx *db,
+                                      const struct objectid *id);
 
-/* return the list of games and set num_games */
-extern struct game *objectdb_get_games(int *num_games);
+/*
+ * add num games at once, ids[i] is set to the objectid of games[i]. the
+ * ids are hashed as one batch, see objectid_from_games. if a game can't
+ * be added, the games before it stay added
+ */
+extern int objectdb_add_games(objectdb_ctx *db,
+                              struct game * const *games,
+                              int num,
+                              struct objectid *ids);
+
+/*
+ * the same, except that a game whose objectid is already in the database
+ * isn't an error: games[i] is pointed at the game already there instead,
+ * and the new one is left unused
+ */
+extern int objectdb_add_or_get_games(objectdb_ctx *db,
+                                     struct game **games,
+                                     int num,
+                                     struct objectid *ids);
+
+/*
+ * every conference, team and game is also given a dense index (its idx
+ * member) when it is added: the nth team added has idx n - 1. these are
+ * only stable within one database, objectids are the permanent identity
+ */
+extern struct conference *objectdb_get_conference_at(objectdb_ctx *db,
+                                                     uint32_t idx);
+extern struct team *objectdb_get_team_at(objectdb_ctx *db, uint32_t idx);
+extern struct game *objectdb_get_game_at(objectdb_ctx *db, uint32_t idx);
+
+extern int objectdb_num_conferences(const objectdb_ctx *db);
+extern int objectdb_num_teams(const objectdb_ctx *db);
+extern int objectdb_num_games(const objectdb_ctx *db);
+
+/*
+ * return the list of games, in the order they were added, and set
+ * num_games. the list is only valid until the next game is added
+ */
+extern struct game **objectdb_get_games(objectdb_ctx *db, int *num_games);
+
+/*
+ * game stats are also kept column by column: one aligned array of shorts
+ * per stat, with the home and away rows of every game next to each other
+ * (see OBJECTDB_STATS_ROW). columns are padded with zeroed rows to a
+ * multiple of 16, so they can be summed a whole vector at a time
+ */
+enum stats_column {
+	STATS_RUSH_ATT,
+	STATS_RUSH_YDS,
+	STATS_RUSH_TDS,
+	STATS_PASS_ATT,
+	STATS_PASS_COMP,
+	STATS_PASS_YDS,
+	STATS_PASS_TDS,
+	STATS_PASS_INT,
+	STATS_FUMBLES,
+	STATS_FUMBLES_LOST,
+	STATS_POINTS,
+	STATS_NUM_COLUMNS
+};
 
-extern void objectdb_clear(void);
+enum game_side {
+	GAME_HOME,
+	GAME_AWAY
+};
+
+#define OBJECTDB_STATS_ROW(game_idx, side) (((int) (game_idx) * 2) + (side))
+
+/* read or write the field of struct stats that backs a column */
+extern short objectdb_stats_get(const struct stats *s, enum stats_column col);
+extern void objectdb_stats_set(struct stats *s,
+                               enum stats_column col,
+                               short val);
+
+/* the same for the field of struct team_stats */
+extern int32_t objectdb_team_stats_get(const struct team_stats *s,
+                                       enum stats_column col);
+extern void objectdb_team_stats_set(struct team_stats *s,
+                                    enum stats_column col,
+                                    int32_t val);
+
+/* set one side's stats for a game, in both the game and the columns */
+extern void objectdb_set_game_stats(objectdb_ctx *db,
+                                    struct game *g,
+                                    enum game_side side,
+                                    const struct stats *s);
+
+/*
+ * return a stats column and set num_rows to the rows in use. the column
+ * is only valid until the next game is added
+ */
+extern const short *objectdb_get_stats_column(const objectdb_ctx *db,
+                                              enum stats_column col,
+                                              int *num_rows);
+
+/*
+ * dirty teams are the ones whose results have changed since the dirty
+ * list was last cleared: both teams of every game added since, or whose
+ * stats were set, and teams whose stats were merged into. whatever is
+ * worked out from a team's games only needs working out again for these.
+ * a database starts out with every team it loads dirty, so a caller
+ * that only wants what changed clears the list once the database is
+ * loaded. the list is in the order the teams were marked, and is only
+ * valid until the next team is added
+ */
+extern struct team **objectdb_get_dirty_teams(objectdb_ctx *db,
+                                              int *num_teams);
+extern bool objectdb_team_is_dirty(const objectdb_ctx *db,
+                                   const struct team *t);
+extern void objectdb_clear_dirty(objectdb_ctx *db);
+
+/*
+ * copy every object in src into dst. conferences and teams that already
+ * exist in dst are reused (team stats are accumulated), games must be new
+ */
+extern int objectdb_merge(objectdb_ctx *dst, objectdb_ctx *src);
+
+/* remove every object, all pointers into the database become invalid */
+extern void objectdb_clear(objectdb_ctx *db);
+
+/*
+ * add every object saved in the yaml file at path to db. references are
+ * relinked through the saved sha1s, and every objectid is recomputed and
+ * must match the saved one
+ */
+extern int objectdb_read(objectdb_ctx *db, const char *path);
+
+enum objectdb_format {
+	OBJECTDB_FORMAT_YAML,
+	OBJECTDB_FORMAT_SNAPSHOT
+};
 
-extern int objectdb_write(void);
+/*
+ * save the database to path, either as yaml or as a binary snapshot
+ * that can be mapped back in with snapshot_open (see snapshot.h)
+ */
+extern int objectdb_write(objectdb_ctx *db,
+                          const char *path,
+                          enum objectdb_format format);
 
 #endif
@@ -24,6 +24,9 @@ extern void objectid_print(const struct objectid *id);
 extern void objectid_string(const struct objectid *id,
                             char buf[OBJECTID_MD_STR_SIZE]);
 
+/* parse the hex form of an objectid, false if str isn't one */
+extern bool objectid_from_string(const char *str, struct objectid *id);
+
 /* need this to avoid circular dependencies */
 struct conference;
 struct team;
@@ -39,4 +42,31 @@ extern void objectid_from_team(const struct team *t, struct objectid *id);
 /* create an objectid from a game */
 extern void objectid_from_game(const struct game *g, struct objectid *id);
 
+/*
+ * objectids are normally sha1s of the object, which is what gets saved.
+ * a database that is only ever used in memory can use a fast 128 bit
+ * non-cryptographic hash instead (see objectdb_new_ids). those ids are
+ * only comparable with other fast ids, so they can't be saved or loaded
+ */
+enum objectid_kind {
+	OBJECTID_SHA1,
+	OBJECTID_FAST
+};
+
+extern void objectid_fast_from_conference(const struct conference *c,
+                                          struct objectid *id);
+extern void objectid_fast_from_team(const struct team *t,
+                                    struct objectid *id);
+extern void objectid_fast_from_game(const struct game *g,
+                                    struct objectid *id);
+
+/*
+ * sha1 objectids for num games at once, ids[i] for games[i]. the games
+ * are hashed eight at a time by a multi-buffer kernel, one message per
+ * vector lane, or one after another with sha-ni when the cpu has it
+ */
+extern void objectid_from_games(const struct game * const *games,
+                                int num,
+                                struct objectid *ids);
+
 #endif
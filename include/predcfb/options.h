@@ -8,9 +8,18 @@ extern const char *progname;
 extern bool opt_help;
 extern bool opt_version;
 extern bool opt_save;
+extern bool opt_snapshot;
+extern bool opt_fast_ids;
 
-extern const char *opt_archive;
+extern const char **opt_archives;
+extern int opt_num_archives;
 extern const char *opt_save_file;
+extern const char *opt_snapshot_file;
+extern const char *opt_load_file;
+extern const char **opt_append_files;
+extern int opt_num_append_files;
+extern const char *opt_season;
+extern int opt_jobs;
 
 int options_parse(int argc, char **argv);
 
@@ -2,12 +2,25 @@
 #define PREDCFB_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <time.h>
 
+#include <predcfb/date.h>
 #include <predcfb/objectid.h>
 
+/*
+ * conference and team names are interned in the objectdb that holds
+ * them (see objectdb_intern): str points at the database's only copy of
+ * the name, and ref is the name's handle there, or 0 if str was never
+ * interned. names are kept to at most CONFERENCE_NAME_MAX - 1 or
+ * TEAM_NAME_MAX - 1 bytes
+ */
+struct name {
+	const char *str;
+	uint32_t ref;
+};
+
 #define CONFERENCE_NAME_MAX 64
-#define CONFERENCE_NUM_MAX  32
 
 enum conference_division {
 	CONFERENCE_FBS,
@@ -15,8 +28,9 @@ enum conference_division {
 };
 
 struct conference {
-	char name[CONFERENCE_NAME_MAX];
+	struct name name;
 	enum conference_division subdivision;
+	uint32_t idx;
 };
 
 struct stats {
@@ -45,18 +59,37 @@ struct stats {
 #endif
 };
 
+/*
+ * a team's totals over every game read into the database, which can be
+ * several seasons' worth: well past what a single game's shorts hold
+ */
+struct team_stats {
+	int32_t rush_att;
+	int32_t rush_yds;
+	int32_t rush_tds;
+
+	int32_t pass_att;
+	int32_t pass_comp;
+	int32_t pass_yds;
+	int32_t pass_tds;
+	int32_t pass_int;
+
+	int32_t fumbles;
+	int32_t fumbles_lost;
+
+	int32_t points;
+};
+
 #define TEAM_NAME_MAX   64
-#define TEAM_NUM_MAX   256
 
 struct team {
-	char name[TEAM_NAME_MAX];
+	struct name name;
 	struct objectid conf_oid;
 	struct conference *conf;
-	struct stats stats;
+	struct team_stats stats;
+	uint32_t idx;
 };
 
-#define GAME_NUM_MAX 2048
-
 struct game {
 	struct objectid home_oid;
 	struct team *home;
@@ -64,8 +97,11 @@ struct game {
 	struct team *away;
 	bool neutral;
 	time_t date;
+	/* YYYY-MM-DD form of date, if whoever set date also filled it in */
+	char date_str[DATE_STR_SIZE];
 	struct stats home_stats;
 	struct stats away_stats;
+	uint32_t idx;
 };
 
 #endif
@@ -0,0 +1,118 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+
+#include <predcfb/objectid.h>
+#include <predcfb/objectdb.h>
+
+#define SNAPSHOT_OK       0
+#define SNAPSHOT_ERROR  (-1)
+
+#define SNAPSHOT_MAGIC      "PREDCFB"
+#define SNAPSHOT_VERSION    2
+
+/* written in native byte order, so a snapshot from another arch is refused */
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+
+enum snapshot_err {
+	SNAPSHOT_ENONE,
+	SNAPSHOT_ENOMEM,
+	SNAPSHOT_EOPEN,
+	SNAPSHOT_EFORMAT,
+	SNAPSHOT_EVERSION,
+	SNAPSHOT_ECORRUPT,
+	SNAPSHOT_EOBJECTDB
+};
+
+/*
+ * binary snapshot layout
+ *
+ * a header followed by three tables of fixed size records and a string
+ * table, each starting on a SNAPSHOT_ALIGN boundary. records refer to
+ * each other by their index in the referenced table and to names by
+ * their offset into the string table, so the file can be used straight
+ * out of an mmap without any fixups. stats are stored as int16_t in
+ * enum stats_column order
+ */
+#define SNAPSHOT_ALIGN 64
+
+struct snapshot_header {
+	char magic[8];
+	uint32_t version;
+	uint32_t byte_order;
+
+	/* sizeof each record type, checked on open */
+	uint32_t conference_size;
+	uint32_t team_size;
+	uint32_t game_size;
+
+	uint32_t num_conferences;
+	uint32_t num_teams;
+	uint32_t num_games;
+
+	uint64_t conferences_offset;
+	uint64_t teams_offset;
+	uint64_t games_offset;
+	uint64_t strings_offset;
+	uint64_t strings_size;
+};
+
+struct snapshot_conference {
+	struct objectid id;
+	uint32_t name;
+	uint32_t subdivision;
+};
+
+struct snapshot_team {
+	struct objectid id;
+	uint32_t name;
+	uint32_t conf;
+	int32_t stats[STATS_NUM_COLUMNS];
+};
+
+struct snapshot_game {
+	struct objectid id;
+	uint32_t home;
+	uint32_t away;
+	uint32_t neutral;
+	int64_t date;
+	int16_t home_stats[STATS_NUM_COLUMNS];
+	int16_t away_stats[STATS_NUM_COLUMNS];
+};
+
+typedef struct snapshot_context snapshot_ctx;
+
+extern snapshot_ctx *snapshot_new(void);
+extern void snapshot_free(snapshot_ctx *snap);
+
+extern enum snapshot_err snapshot_get_error(const snapshot_ctx *snap);
+extern const char *snapshot_strerror(const snapshot_ctx *snap);
+
+/*
+ * map the snapshot at path and check that every offset and reference in
+ * it is in range; nothing is copied. the tables below stay valid until
+ * snapshot_close or snapshot_free
+ */
+extern int snapshot_open(snapshot_ctx *snap, const char *path);
+extern void snapshot_close(snapshot_ctx *snap);
+
+extern const struct snapshot_conference *snapshot_get_conferences(
+		const snapshot_ctx *snap, int *num_conferences);
+extern const struct snapshot_team *snapshot_get_teams(
+		const snapshot_ctx *snap, int *num_teams);
+extern const struct snapshot_game *snapshot_get_games(
+		const snapshot_ctx *snap, int *num_games);
+
+/* return the name stored at offset in the string table */
+extern const char *snapshot_string(const snapshot_ctx *snap, uint32_t offset);
+
+/*
+ * copy every object of the open snapshot into db, which must use sha1
+ * objectids. the objects are indexed under their stored objectids, which
+ * are trusted rather than hashed again; an objectid that is taken twice
+ * fails the load
+ */
+extern int snapshot_load(snapshot_ctx *snap, objectdb_ctx *db);
+
+#endif
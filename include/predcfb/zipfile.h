@@ -1,6 +1,9 @@
 #ifndef ZIPFILE_H
 #define ZIPFILE_H
 
+#include <stdint.h>
+#include <sys/types.h>
+
 #define ZIPFILE_OK	0
 #define ZIPFILE_ERROR	(-1)
 
@@ -18,14 +21,51 @@ enum zipfile_err {
 	ZIPFILE_EUNKNOWN
 };
 
+/*
+ * the default backend maps the archive and inflates each file whole, or
+ * hands out stored files straight from the mapping. archives it can't
+ * read (zip64, encrypted) are left to minizip, which streams
+ */
+enum zipfile_backend {
+	ZIPFILE_BACKEND_MMAP,
+	ZIPFILE_BACKEND_MINIZIP
+};
+
 typedef struct zipfile_read_context zf_readctx;
 
+/* a file in the archive, as the archive's central directory describes it */
+struct zipfile_stat {
+	const char *name;
+	uint64_t size;
+	uint64_t compressed_size;
+	uint32_t crc;
+};
+
 extern int zipfile_check_format(const char *path);
 extern zf_readctx *zipfile_open_archive(const char *path);
+extern zf_readctx *zipfile_open_archive_backend(const char *path,
+                                                enum zipfile_backend backend);
 extern int zipfile_close_archive(zf_readctx *z);
+extern enum zipfile_backend zipfile_get_backend(const zf_readctx *z);
+
+/*
+ * the archive's directory is read once, when it is opened. zipfile_list
+ * points stats at every file in the archive, in directory order, and
+ * returns how many there are. the stats and names stay valid until the
+ * archive is closed
+ */
+extern int zipfile_list(zf_readctx *z, const struct zipfile_stat **stats);
+extern int zipfile_stat(zf_readctx *z, const char *file,
+                        struct zipfile_stat *st);
 extern int zipfile_open_file(zf_readctx *z, const char *file);
 extern int zipfile_close_file(zf_readctx *z);
 extern ssize_t zipfile_read_file(zf_readctx *z, char *buf, size_t count);
+
+/*
+ * the whole of the open file. the data stays valid until the file is
+ * closed and may be modified in place, but is not nul terminated
+ */
+extern int zipfile_file_data(zf_readctx *z, char **data, size_t *size);
 extern const char *zipfile_strerr(const zf_readctx *z);
 extern enum zipfile_err zipfile_get_error(zf_readctx *z);
 
@@ -0,0 +1,165 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <predcfb/cfbstats.h>
+#include <predcfb/csvparse.h>
+#include <predcfb/objectdb.h>
+
+#include "cfbstats_internal.h"
+
+extern const char *progname;
+
+/*
+ * appending rows
+ *
+ * results come out a few games at a time during the season, and reading
+ * the whole archive again for each of them is a waste. the rows of a
+ * game.csv or team-game-statistics.csv (recognised by the header, which
+ * has to come first) are applied straight to the database instead, the
+ * same way they would be if they were read from the archive: games the
+ * database doesn't have are added, and stats rows replace whatever the
+ * game had for that team, with the team's totals adjusted to match.
+ * nothing else in the database is touched, and the teams whose results
+ * changed end up on the database's dirty list
+ *
+ * the rows use the cfbstats codes of one season, so they are looked up
+ * in the id map of that season's archive
+ */
+struct append_state {
+	cfbstats_ctx *ctx;
+	int (*parse)(struct csvline *, void *);
+};
+
+/* the header tells the two files apart, they don't have as many fields */
+static int parse_append_csv(struct csvline *c, void *data)
+{
+	struct append_state *st = data;
+
+	if (c->line == 1) {
+		if (c->num_fields == total_fields_game) {
+			st->parse = parse_game_csv;
+		} else if (c->num_fields == total_fields_stats) {
+			st->parse = parse_stats_csv;
+		} else {
+			st->ctx->error = CFBSTATS_EINVALIDFILE;
+			return CFBSTATS_ERROR;
+		}
+	}
+
+	return st->parse(c, st->ctx);
+}
+
+static void handle_csvparse_error(const cfbstats_ctx *ctx,
+                                  const struct csvparse *csvp,
+                                  const char *name)
+{
+	if (csvp_error(csvp) == CSVP_EPARSE) {
+		fprintf(stderr, "%s: %s in %s\n",
+		        progname, cfbstats_errstr(ctx->error), name);
+	}
+
+	fprintf(stderr, "%s: %s in %s\n", progname, csvp_strerror(csvp), name);
+}
+
+/* put the ids of archive's season back in the id map */
+static int restore_ids(cfbstats_ctx *ctx, const char *archive)
+{
+	const struct manifest_archive *a;
+
+	cfbstats_init(ctx, ctx->db);
+
+	if (!ctx->manifest || (a = manifest_find(ctx->manifest, archive)) == NULL) {
+		fprintf(stderr, "%s: no record of %s in the manifest\n",
+		        progname, archive);
+		ctx->error = CFBSTATS_EMANIFEST;
+		return CFBSTATS_ERROR;
+	}
+
+	if (manifest_restore(ctx, a) != CFBSTATS_OK) {
+		fprintf(stderr, "%s: the database doesn't match the "
+		        "manifest's record of %s\n", progname, archive);
+		return CFBSTATS_ERROR;
+	}
+
+	return cfbstats_set_archive(ctx, archive);
+}
+
+static int append_rows(cfbstats_ctx *ctx,
+                       struct csvparse *csvp,
+                       FILE *inf,
+                       const char *name)
+{
+	char *buf;
+	size_t len;
+	int err = CFBSTATS_OK;
+
+	if ((buf = malloc(ctx->read_buffer)) == NULL) {
+		ctx->error = CFBSTATS_ENOMEM;
+		return CFBSTATS_ERROR;
+	}
+
+	while ((len = fread(buf, 1, ctx->read_buffer, inf)) > 0) {
+		if (csvp_parse(csvp, buf, len) != CSVP_OK) {
+			handle_csvparse_error(ctx, csvp, name);
+			err = CFBSTATS_ERROR;
+			break;
+		}
+	}
+
+	if (err == CFBSTATS_OK && ferror(inf)) {
+		fprintf(stderr, "%s: could not read %s\n", progname, name);
+		ctx->error = CFBSTATS_EINVALIDFILE;
+		err = CFBSTATS_ERROR;
+	}
+
+	free(buf);
+
+	return err;
+}
+
+int cfbstats_append_csv(cfbstats_ctx *ctx,
+                        const char *archive,
+                        FILE *inf,
+                        const char *name)
+{
+	struct append_state st;
+	struct csvparse csvp;
+	int err;
+
+	if (archive && restore_ids(ctx, archive) != CFBSTATS_OK)
+		return CFBSTATS_ERROR;
+
+	st.ctx = ctx;
+	st.parse = NULL;
+
+	if (csvp_init(&csvp, parse_append_csv, &st) != CSVP_OK) {
+		handle_csvparse_error(ctx, &csvp, name);
+		return CFBSTATS_ERROR;
+	}
+
+	if (append_rows(ctx, &csvp, inf, name) != CFBSTATS_OK) {
+		csvp_destroy(&csvp);
+		return CFBSTATS_ERROR;
+	}
+
+	/* destroying the parser hands over a last line without a newline */
+	if (csvp_destroy(&csvp) != CSVP_OK) {
+		handle_csvparse_error(ctx, &csvp, name);
+		return CFBSTATS_ERROR;
+	}
+
+	/* games are only added a batch at a time */
+	if (st.parse == parse_game_csv && flush_game_csv(ctx) != CFBSTATS_OK) {
+		fprintf(stderr, "%s: %s in %s\n",
+		        progname, cfbstats_errstr(ctx->error), name);
+		return CFBSTATS_ERROR;
+	}
+
+	/* new games' ids go in the season's record, for later stats rows */
+	err = CFBSTATS_OK;
+	if (ctx->manifest && ctx->archive)
+		err = manifest_record(ctx, ctx->archive, NULL, 0);
+
+	return err;
+}
@@ -0,0 +1,269 @@
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include <predcfb/cfbstats.h>
+#include <predcfb/objectdb.h>
+
+#include "cfbstats_internal.h"
+
+extern const char *progname;
+
+/*
+ * one job per archive. each job is parsed into its own objectdb by
+ * whichever worker picks it up, and the per-archive databases are merged
+ * into the caller's database once every worker has finished. if the
+ * caller keeps a manifest, each job records its archive in one of its
+ * own, and the records are moved over as the job is merged
+ */
+struct batch_job {
+	const char *archive;
+	enum objectid_kind ids;
+	size_t read_buffer;
+	bool track;
+	objectdb_ctx *db;
+	struct manifest *manifest;
+	struct cfbstats_timing timing;
+	enum cfbstats_err error;
+	int status;
+};
+
+struct batch {
+	struct batch_job *jobs;
+	int num_jobs;
+	int next_job;
+	pthread_mutex_t lock;
+};
+
+static struct batch_job *batch_next_job(struct batch *b)
+{
+	struct batch_job *job = NULL;
+
+	pthread_mutex_lock(&b->lock);
+
+	if (b->next_job < b->num_jobs) {
+		job = &b->jobs[b->next_job];
+		b->next_job++;
+	}
+
+	pthread_mutex_unlock(&b->lock);
+
+	return job;
+}
+
+static void run_job(struct batch_job *job)
+{
+	cfbstats_ctx *ctx = NULL;
+
+	job->status = CFBSTATS_ERROR;
+
+	/* the same kind of ids as the database it will be merged into */
+	job->db = objectdb_new_ids(job->ids);
+	if (job->db)
+		ctx = cfbstats_new(job->db);
+
+	if (!ctx) {
+		job->error = CFBSTATS_ENOMEM;
+		return;
+	}
+
+	/* the archives are already spread over the workers */
+	cfbstats_set_pipeline(ctx, false);
+	cfbstats_set_read_buffer(ctx, job->read_buffer);
+
+	if (job->track && cfbstats_manifest_new(ctx) != CFBSTATS_OK) {
+		job->error = ctx->error;
+		cfbstats_free(ctx);
+		return;
+	}
+
+	job->status = cfbstats_parse_archive(ctx, job->archive);
+	job->error = ctx->error;
+	cfbstats_get_timing(ctx, &job->timing);
+
+	job->manifest = ctx->manifest;
+	ctx->manifest = NULL;
+
+	cfbstats_free(ctx);
+}
+
+static void *batch_worker(void *data)
+{
+	struct batch *b = data;
+	struct batch_job *job;
+
+	while ((job = batch_next_job(b)) != NULL)
+		run_job(job);
+
+	return NULL;
+}
+
+static int default_num_workers(void)
+{
+	long cpus;
+
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cpus < 1)
+		return 1;
+
+	return (int) cpus;
+}
+
+static int run_workers(struct batch *b, int num_workers)
+{
+	pthread_t *threads;
+	int started;
+	int i;
+
+	threads = malloc(sizeof(*threads) * num_workers);
+	if (!threads)
+		return CFBSTATS_ERROR;
+
+	for (started = 0; started < num_workers; started++) {
+		if (pthread_create(&threads[started], NULL, batch_worker, b))
+			break;
+	}
+
+	/*
+	 * if no threads could be started, do all of the work here. if
+	 * only some of them started, they will pick up the remaining jobs
+	 */
+	if (started == 0)
+		batch_worker(b);
+
+	for (i = 0; i < started; i++)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+
+	return CFBSTATS_OK;
+}
+
+static int merge_jobs(cfbstats_ctx *ctx, struct batch *b)
+{
+	struct batch_job *job;
+	int i;
+
+	for (i = 0; i < b->num_jobs; i++) {
+		job = &b->jobs[i];
+
+		ctx->timing.inflate += job->timing.inflate;
+		ctx->timing.parse += job->timing.parse;
+		ctx->timing.wait += job->timing.wait;
+
+		if (job->status != CFBSTATS_OK) {
+			ctx->error = job->error;
+			fprintf(stderr, "%s: failed to read %s: %s\n",
+			        progname, job->archive,
+			        cfbstats_errstr(job->error));
+			return CFBSTATS_ERROR;
+		}
+
+		if (objectdb_merge(ctx->db, job->db) != OBJECTDB_OK) {
+			ctx->error = CFBSTATS_EMERGE;
+			fprintf(stderr, "%s: failed to merge %s: %s\n",
+			        progname, job->archive,
+			        objectdb_strerror(ctx->db));
+			return CFBSTATS_ERROR;
+		}
+
+		if (ctx->manifest && job->manifest &&
+		    manifest_append(ctx->manifest, job->manifest) != CFBSTATS_OK) {
+			ctx->error = CFBSTATS_ENOMEM;
+			return CFBSTATS_ERROR;
+		}
+	}
+
+	return CFBSTATS_OK;
+}
+
+/*
+ * a database that already has objects in it is read into one archive
+ * at a time, so that the archives can reuse what it has and skip the
+ * files in its manifest that haven't changed. each archive is still
+ * pipelined if the context is
+ */
+static int read_serial(cfbstats_ctx *ctx,
+                       const char **archives,
+                       int num_archives)
+{
+	int i;
+
+	for (i = 0; i < num_archives; i++) {
+		if (cfbstats_read_zipfile(ctx, archives[i]) != CFBSTATS_OK) {
+			fprintf(stderr, "%s: failed to read %s: %s\n",
+			        progname, archives[i],
+			        cfbstats_errstr(ctx->error));
+			return CFBSTATS_ERROR;
+		}
+	}
+
+	return CFBSTATS_OK;
+}
+
+/* global functions */
+
+int cfbstats_read_zipfiles(cfbstats_ctx *ctx,
+                           const char **archives,
+                           int num_archives,
+                           int num_workers)
+{
+	struct batch b;
+	int err = CFBSTATS_ERROR;
+	int i;
+
+	if (num_archives <= 0)
+		return CFBSTATS_OK;
+
+	if (objectdb_num_conferences(ctx->db) > 0 ||
+	    objectdb_num_teams(ctx->db) > 0 ||
+	    objectdb_num_games(ctx->db) > 0)
+		return read_serial(ctx, archives, num_archives);
+
+	if (num_workers <= 0)
+		num_workers = default_num_workers();
+
+	if (num_workers > num_archives)
+		num_workers = num_archives;
+
+	b.jobs = calloc(num_archives, sizeof(*b.jobs));
+	if (!b.jobs) {
+		ctx->error = CFBSTATS_ENOMEM;
+		return CFBSTATS_ERROR;
+	}
+
+	b.num_jobs = num_archives;
+	b.next_job = 0;
+	pthread_mutex_init(&b.lock, NULL);
+
+	for (i = 0; i < num_archives; i++) {
+		b.jobs[i].archive = archives[i];
+		b.jobs[i].ids = objectdb_get_ids(ctx->db);
+		b.jobs[i].read_buffer = ctx->read_buffer;
+		b.jobs[i].track = ctx->manifest != NULL;
+	}
+
+	if (run_workers(&b, num_workers) != CFBSTATS_OK) {
+		ctx->error = CFBSTATS_ENOMEM;
+		goto cleanup;
+	}
+
+	err = merge_jobs(ctx, &b);
+
+cleanup:
+	for (i = 0; i < num_archives; i++) {
+		if (b.jobs[i].db)
+			objectdb_free(b.jobs[i].db);
+
+		manifest_free(b.jobs[i].manifest);
+	}
+
+	pthread_mutex_destroy(&b.lock);
+	free(b.jobs);
+
+	return err;
+}
@@ -1,25 +1,201 @@
 #ifndef CFBSTATS_INTERNAL_H
 #define CFBSTATS_INTERNAL_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <config.h>
 #include <predcfb/predcfb.h>
+#include <predcfb/date.h>
 #include <predcfb/objectid.h>
+#include <predcfb/objectdb.h>
 #include <predcfb/csvparse.h>
+#include <predcfb/cfbstats.h>
+
+/*
+ * id_map, translates cfbstats ids into objectids and the dense objectdb
+ * index of the object, so references can be resolved without hashing.
+ * each kind of id has its own map, see id_map.c
+ */
+#define CFBSTATS_ID_ARRAY_SIZE 256
+#define CFBSTATS_ID_ARRAY_MAX  (1 << 20)
+
+enum id_kind {
+	ID_CONFERENCE,
+	ID_TEAM,
+	ID_GAME
+};
+
+/*
+ * games are mapped by a key packed from their game code (see
+ * pack_game_code). 64 bit keys keep the whole code, so every game of
+ * every season has its own key and one map can hold several seasons.
+ * 32 bit keys only tell games apart within a season, and only for team
+ * codes under 2048, but halve the key; PREDCFB_GAME_KEY_BITS picks one
+ */
+#if PREDCFB_GAME_KEY_BITS == 32
+typedef uint32_t game_key;
+#else
+typedef uint64_t game_key;
+#endif
+
+struct id_map_entry {
+	bool used;
+	struct objectid oid;
+	uint32_t idx;
+};
+
+/* conference and team codes, entries[code] */
+struct id_array {
+	struct id_map_entry *entries;
+	size_t size;
+};
+
+struct id_table_slot {
+	game_key key;
+	struct id_map_entry entry;
+};
+
+/* game keys */
+struct id_table {
+	struct id_table_slot *slots;
+	size_t size;
+	size_t count;
+};
+
+struct id_map {
+	struct id_array conferences;
+	struct id_array teams;
+	struct id_table games;
+};
+
+extern void cfbstats_init(cfbstats_ctx *ctx, objectdb_ctx *db);
+
+/* remember archive as the one whose ids are in the id map */
+extern int cfbstats_set_archive(cfbstats_ctx *ctx, const char *archive);
+extern const char *cfbstats_errstr(enum cfbstats_err err);
+
+/* read every file from an archive into ctx->db */
+extern int cfbstats_parse_archive(cfbstats_ctx *ctx, const char *archive);
+
+/*
+ * date_cache, the parsed time and canonical YYYY-MM-DD string for each
+ * M/D/YYYY date string seen in the archive's game.csv
+ */
+#define CFBSTATS_DATE_CACHE_SIZE 256
+
+struct date_cache_entry {
+	char raw[DATE_STR_SIZE];
+	size_t len;
+	time_t date;
+	char str[DATE_STR_SIZE];
+};
+
+struct date_cache {
+	struct date_cache_entry entries[CFBSTATS_DATE_CACHE_SIZE];
+};
+
+/*
+ * id_map functions. conference and team codes must be in
+ * [0, CFBSTATS_ID_ARRAY_MAX), insert returns CFBSTATS_ENONE,
+ * CFBSTATS_ETOOMANY for a code out of that range or CFBSTATS_ENOMEM
+ */
+extern void id_map_init(struct id_map *map);
+extern void id_map_destroy(struct id_map *map);
+extern void id_map_clear(struct id_map *map);
+extern enum cfbstats_err id_map_insert(struct id_map *map,
+                                       enum id_kind kind,
+                                       int id,
+                                       const struct objectid *oid,
+                                       uint32_t idx);
+extern const struct id_map_entry *id_map_lookup(const struct id_map *map,
+                                                enum id_kind kind,
+                                                int id);
+extern enum cfbstats_err id_map_insert_game(struct id_map *map,
+                                            game_key key,
+                                            const struct objectid *oid,
+                                            uint32_t idx);
+extern const struct id_map_entry *id_map_lookup_game(const struct id_map *map,
+                                                     game_key key);
 
-#define CFBSTATS_ID_MAP_SIZE 4096
+/*
+ * call fn for every id in the map: conference and team codes in order,
+ * then game keys in no particular order. kind is ID_GAME for the games.
+ * the walk stops at the first call that doesn't return CFBSTATS_OK
+ */
+typedef int (*id_map_walk_func)(enum id_kind kind,
+                                uint64_t code,
+                                const struct id_map_entry *entry,
+                                void *data);
 
-extern void cfbstats_init(void);
+extern int id_map_walk(const struct id_map *map,
+                       id_map_walk_func fn,
+                       void *data);
 
-/* id_map functions */
-extern void id_map_clear(void);
-extern int id_map_insert(int id, const struct objectid *oid);
-extern const struct objectid *id_map_lookup(int id);
-extern int pack_game_code(const char *str);
+/* the key for a 16 digit game code, false if str isn't one */
+extern bool pack_game_code(const char *str, game_key *key);
 
-/* prototypes for handling a line from each file */
-extern int parse_conference_csv(struct csvline *);
-extern int parse_team_csv(struct csvline *);
-extern int parse_game_csv(struct csvline *);
-extern int parse_stats_csv(struct csvline *);
+/* date_cache functions, lookup returns NULL if str isn't a valid date */
+extern void date_cache_clear(struct date_cache *cache);
+extern const struct date_cache_entry *date_cache_lookup(
+		struct date_cache *cache,
+		const char *str,
+		size_t len);
+
+/*
+ * prototypes for handling a line from each file, the data pointer
+ * is the cfbstats_ctx for the archive being read
+ */
+extern int parse_conference_csv(struct csvline *, void *);
+extern int parse_team_csv(struct csvline *, void *);
+extern int parse_game_csv(struct csvline *, void *);
+extern int parse_stats_csv(struct csvline *, void *);
+
+/*
+ * games are parsed into pending_games and only added to the objectdb
+ * (and the id map) a batch at a time, so their objectids can be hashed
+ * together. flush_game_csv adds whatever is pending, it is called after
+ * every chunk of game.csv and at the end of the file
+ */
+#define CFBSTATS_GAME_BATCH 64
+
+struct pending_games {
+	struct game *games[CFBSTATS_GAME_BATCH];
+	game_key keys[CFBSTATS_GAME_BATCH];
+	int num_games;
+};
+
+extern int flush_game_csv(cfbstats_ctx *ctx);
+
+/*
+ * manifest, what each archive read into the database was read from, see
+ * manifest.c. manifest_find takes the archive's path and returns NULL if
+ * it has no record. manifest_unchanged is true if the record has a file
+ * by the name in st, with the same size and crc. manifest_restore puts
+ * the ids in a record back in the id map, failing with
+ * CFBSTATS_EOIDLOOKUP if the database no longer has one of the objects.
+ * manifest_record replaces the archive's record with stats (or with the
+ * files it had, if stats is NULL) and the contents of the id map, and
+ * manifest_append moves src's records to dst
+ */
+struct manifest;
+struct manifest_archive;
+struct zipfile_stat;
+
+extern struct manifest *manifest_new(void);
+extern void manifest_free(struct manifest *m);
+extern struct manifest_archive *manifest_find(const struct manifest *m,
+                                              const char *path);
+extern bool manifest_unchanged(const struct manifest_archive *a,
+                               const struct zipfile_stat *st);
+extern int manifest_restore(cfbstats_ctx *ctx,
+                            const struct manifest_archive *a);
+extern int manifest_record(cfbstats_ctx *ctx,
+                           const char *path,
+                           const struct zipfile_stat *stats,
+                           int num_stats);
+extern int manifest_append(struct manifest *dst, struct manifest *src);
 
 /* field description structure */
 enum field_type {
@@ -37,12 +213,20 @@ enum field_type {
 	FIELD_TYPE_SITE_BOOL
 };
 
+/*
+ * for the CONFID, TEAMID and GAMEID types, offset is where the objectid
+ * goes and ptr_offset is where the pointer to the object goes. for the
+ * DATE type, offset is the time_t and ptr_offset the YYYY-MM-DD string.
+ * the STR type interns the field into the struct name at offset, keeping
+ * at most len - 1 bytes of it
+ */
 struct fielddesc {
 	int index;
 	const char *name;
 	enum field_type type;
 	size_t len;
 	size_t offset;
+	size_t ptr_offset;
 };
 
 /* per-file field description lists */
@@ -64,13 +248,78 @@ extern const int total_fields_stats;
 
 /* linehandler */
 struct linehandler {
-	const struct fielddesc *descriptions;
-	const struct fielddesc *current;
+	cfbstats_ctx *ctx;
 	struct csvline *csvline;
 	void *obj;
+	int *id;
+	game_key *key;
+};
+
+/*
+ * a field plan is a descriptor list compiled once the header has been
+ * checked: one step per described field, sorted by column, holding the
+ * function for the field's type. rows are parsed by calling down the
+ * steps, with no switch on the type or walk of the descriptor table
+ */
+#define FIELD_PLAN_MAX_STEPS 32
+
+typedef int (*field_func)(struct linehandler *, const struct fielddesc *);
+
+struct field_step {
+	field_func parse;
+	const struct fielddesc *desc;
+};
+
+struct field_plan {
+	struct field_step steps[FIELD_PLAN_MAX_STEPS];
+	int num_steps;
+};
+
+/* a plan per file, compiled from each file's header */
+enum field_plan_file {
+	FIELD_PLAN_CONFERENCE,
+	FIELD_PLAN_TEAM,
+	FIELD_PLAN_GAME,
+	FIELD_PLAN_STATS,
+	NUM_FIELD_PLANS
 };
 
-extern int linehandler_parse(struct linehandler *lh, int *id);
+extern int field_plan_compile(struct field_plan *plan,
+                              const struct fielddesc *desc_list);
+
+/* parse the line with the plan for file, compiled from its header */
+extern int linehandler_run(struct linehandler *lh, enum field_plan_file file);
+
+/*
+ * everything needed to parse one archive into one objectdb; cfbstats ids
+ * are only unique within an archive, so each archive gets its own context
+ */
+struct cfbstats_context {
+	objectdb_ctx *db;
+	struct id_map id_map;
+	struct date_cache dates;
+	struct pending_games pending;
+	struct field_plan plans[NUM_FIELD_PLANS];
+	bool pipeline;
+	size_t read_buffer;
+	struct cfbstats_timing timing;
+	struct manifest *manifest;
+	int files_skipped;
+	/*
+	 * how many of each object the db held when this archive's read
+	 * began. a row naming one of those objects reuses it, a row naming
+	 * an object added by this archive is a duplicate
+	 */
+	uint32_t known_conferences;
+	uint32_t known_teams;
+	uint32_t known_games;
+	/* a row's object that went unused, for the next row to parse into */
+	struct conference *spare_conf;
+	struct team *spare_team;
+	/* the archive the id map is for, NULL if it isn't for one */
+	char *archive;
+	enum cfbstats_err error;
+};
 
 /*
  * struct that will contain the stats, team, and game ids
@@ -79,6 +328,8 @@ extern int linehandler_parse(struct linehandler *lh, int *id);
 struct stats_wrapper {
 	struct objectid team_oid;
 	struct objectid game_oid;
+	struct team *team;
+	struct game *game;
 	struct stats stats;
 };
 
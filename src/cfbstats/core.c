@@ -1,12 +1,12 @@
 
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <predcfb/cfbstats.h>
 
 #include "cfbstats_internal.h"
 
-enum cfbstats_err cfbstats_errno = CFBSTATS_ENONE;
-
 static const char *cfbstats_errors[] = {
 	"No error",
 	"Error parsing zip file",
@@ -14,22 +14,87 @@ static const char *cfbstats_errors[] = {
 	"File does not match expected format",
 	"Too many records",
 	"Failed cfbstats id lookup",
-	"Failed objectid lookup"
+	"Failed objectid lookup",
+	"Failed to merge archives",
+	"Invalid manifest"
 };
 
-const char *cfbstats_strerror(void)
+const char *cfbstats_errstr(enum cfbstats_err err)
+{
+	return cfbstats_errors[err];
+}
+
+const char *cfbstats_strerror(const cfbstats_ctx *ctx)
 {
-	return cfbstats_errors[cfbstats_errno];
+	return cfbstats_errstr(ctx->error);
 }
 
-void cfbstats_init(void)
+enum cfbstats_err cfbstats_get_error(const cfbstats_ctx *ctx)
 {
-	/* make sure that the id map size is a power of 2 */
-	assert(!(CFBSTATS_ID_MAP_SIZE & (CFBSTATS_ID_MAP_SIZE - 1)));
+	return ctx->error;
+}
 
+void cfbstats_init(cfbstats_ctx *ctx, objectdb_ctx *db)
+{
 	assert(num_fdesc_conference <= total_fields_conference);
 	assert(num_fdesc_team <= total_fields_team);
 	assert(num_fdesc_game <= total_fields_game);
+	assert(num_fdesc_stats <= FIELD_PLAN_MAX_STEPS);
+
+	ctx->db = db;
+	ctx->error = CFBSTATS_ENONE;
+	id_map_clear(&ctx->id_map);
+	free(ctx->archive);
+	ctx->archive = NULL;
+	date_cache_clear(&ctx->dates);
+	ctx->pending.num_games = 0;
+	ctx->known_conferences = objectdb_num_conferences(db);
+	ctx->known_teams = objectdb_num_teams(db);
+	ctx->known_games = objectdb_num_games(db);
+	ctx->spare_conf = NULL;
+	ctx->spare_team = NULL;
+	memset(ctx->plans, 0, sizeof(ctx->plans));
+}
+
+int cfbstats_set_archive(cfbstats_ctx *ctx, const char *archive)
+{
+	char *copy;
+
+	if ((copy = strdup(archive)) == NULL) {
+		ctx->error = CFBSTATS_ENOMEM;
+		return CFBSTATS_ERROR;
+	}
 
-	id_map_clear();
+	free(ctx->archive);
+	ctx->archive = copy;
+
+	return CFBSTATS_OK;
+}
+
+cfbstats_ctx *cfbstats_new(objectdb_ctx *db)
+{
+	cfbstats_ctx *ctx;
+
+	ctx = malloc(sizeof(*ctx));
+	if (!ctx)
+		return NULL;
+
+	id_map_init(&ctx->id_map);
+	ctx->archive = NULL;
+	cfbstats_init(ctx, db);
+	ctx->pipeline = true;
+	ctx->read_buffer = CFBSTATS_READ_BUFFER_SIZE;
+	ctx->manifest = NULL;
+	ctx->files_skipped = 0;
+	cfbstats_reset_timing(ctx);
+
+	return ctx;
+}
+
+void cfbstats_free(cfbstats_ctx *ctx)
+{
+	id_map_destroy(&ctx->id_map);
+	manifest_free(ctx->manifest);
+	free(ctx->archive);
+	free(ctx);
 }
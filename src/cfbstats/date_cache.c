@@ -0,0 +1,57 @@
+#include <string.h>
+#include <time.h>
+
+#include <predcfb/cfbstats.h>
+#include <predcfb/date.h>
+
+#include "cfbstats_internal.h"
+
+void date_cache_clear(struct date_cache *cache)
+{
+	memset(cache->entries, 0, sizeof(cache->entries));
+}
+
+static unsigned int hash_date(const char *str, size_t len)
+{
+	unsigned int h = 0;
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		h = h * 31 + (unsigned char) str[i];
+
+	return h & (CFBSTATS_DATE_CACHE_SIZE - 1);
+}
+
+/*
+ * a season only has a hundred or so game dates, so most lookups hit.
+ * the cache is direct mapped; a miss parses the date and replaces
+ * whatever was in its slot
+ */
+const struct date_cache_entry *date_cache_lookup(struct date_cache *cache,
+                                                 const char *str,
+                                                 size_t len)
+{
+	struct date_cache_entry *entry;
+	time_t date;
+
+	/*
+	 * longer than any M/D/YYYY date, or empty. an empty string would
+	 * match any slot that hasn't been filled yet, which have len 0
+	 */
+	if (len == 0 || len >= DATE_STR_SIZE)
+		return NULL;
+
+	entry = &cache->entries[hash_date(str, len)];
+	if (entry->len == len && memcmp(entry->raw, str, len) == 0)
+		return entry;
+
+	if (!date_parse_mdy(str, len, &date))
+		return NULL;
+
+	memcpy(entry->raw, str, len);
+	entry->len = len;
+	entry->date = date;
+	date_string(date, entry->str);
+
+	return entry;
+}
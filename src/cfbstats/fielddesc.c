@@ -59,7 +59,8 @@ const struct fielddesc fdesc_team[] = {
 		.name = "Conference Code",
 		.type = FIELD_TYPE_CONFID,
 		.len = 0,
-		.offset = offsetof(struct team, conf_oid)
+		.offset = offsetof(struct team, conf_oid),
+		.ptr_offset = offsetof(struct team, conf)
 	},
 	{
 		.index = INT_MIN,
@@ -84,21 +85,24 @@ const struct fielddesc fdesc_game[] = {
 		.name = "Date",
 		.type = FIELD_TYPE_DATE,
 		.len = 0,
-		.offset = offsetof(struct game, date)
+		.offset = offsetof(struct game, date),
+		.ptr_offset = offsetof(struct game, date_str)
 	},
 	{
 		.index = 2,
 		.name = "Visit Team Code",
 		.type = FIELD_TYPE_TEAMID,
 		.len = 0,
-		.offset = offsetof(struct game, away_oid)
+		.offset = offsetof(struct game, away_oid),
+		.ptr_offset = offsetof(struct game, away)
 	},
 	{
 		.index = 3,
 		.name = "Home Team Code",
 		.type = FIELD_TYPE_TEAMID,
 		.len = 0,
-		.offset = offsetof(struct game, home_oid)
+		.offset = offsetof(struct game, home_oid),
+		.ptr_offset = offsetof(struct game, home)
 	},
 	{
 		.index = 5,
@@ -127,6 +131,7 @@ const struct fielddesc fdesc_stats[] = {
 		.type = FIELD_TYPE_TEAMID,
 		.len = 0,
 		.offset = WRAPPER_OFFSET(team_oid),
+		.ptr_offset = WRAPPER_OFFSET(team),
 	},
 	{
 		.index = 1,
@@ -134,6 +139,7 @@ const struct fielddesc fdesc_stats[] = {
 		.type = FIELD_TYPE_GAMEID,
 		.len = 0,
 		.offset = WRAPPER_OFFSET(game_oid),
+		.ptr_offset = WRAPPER_OFFSET(game),
 	},
 	{
 		.index = 2,
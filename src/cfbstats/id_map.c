@@ -1,4 +1,6 @@
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -7,100 +9,359 @@
 
 #include "cfbstats_internal.h"
 
-struct map_entry {
-	int id;
-	struct objectid oid;
-};
+/*
+ * id_map
+ *
+ * conference and team codes are small numbers, so each kind has its own
+ * array indexed by the code, grown to the next power of 2 above the
+ * largest code seen. game keys (see pack_game_code) are far too sparse
+ * for that, so games go in a hash table with linear probing that is
+ * grown before it is half full. either way a lookup that misses stops
+ * after one slot, or at the first empty slot, however full the map is
+ */
 
-static struct map_entry id_map[CFBSTATS_ID_MAP_SIZE];
+#define ID_TABLE_SIZE 1024
 
-void id_map_clear(void)
+/* grow the game table once it is more than half full */
+#define ID_TABLE_LOAD_NUM 1
+#define ID_TABLE_LOAD_DEN 2
+
+static void array_init(struct id_array *a)
 {
-	memset(id_map, 0, sizeof(id_map));
+	a->entries = NULL;
+	a->size = 0;
 }
 
-int id_map_insert(int id, const struct objectid *oid)
+static void table_init(struct id_table *t)
 {
-	static const int mask = CFBSTATS_ID_MAP_SIZE - 1;
-	struct map_entry *entry;
-	int i;
-	int count = 0;
+	t->slots = NULL;
+	t->size = 0;
+	t->count = 0;
+}
 
-	i = id & mask;
+void id_map_init(struct id_map *map)
+{
+	array_init(&map->conferences);
+	array_init(&map->teams);
+	table_init(&map->games);
+}
 
-	while (count < CFBSTATS_ID_MAP_SIZE) {
-		entry = &id_map[i];
-		if (entry->id == 0) {
-			entry->id = id;
-			entry->oid = *oid;
-			break;
-		}
+void id_map_destroy(struct id_map *map)
+{
+	free(map->conferences.entries);
+	free(map->teams.entries);
+	free(map->games.slots);
+	id_map_init(map);
+}
 
-		i = (i + 1) & mask;
-		count++;
-	}
+static void array_clear(struct id_array *a)
+{
+	if (a->entries)
+		memset(a->entries, 0, a->size * sizeof(*a->entries));
+}
+
+static void table_clear(struct id_table *t)
+{
+	if (t->slots)
+		memset(t->slots, 0, t->size * sizeof(*t->slots));
 
-	if (count == CFBSTATS_ID_MAP_SIZE)
+	t->count = 0;
+}
+
+/* the memory is kept for the next archive */
+void id_map_clear(struct id_map *map)
+{
+	array_clear(&map->conferences);
+	array_clear(&map->teams);
+	table_clear(&map->games);
+}
+
+/* direct-indexed arrays */
+
+static int array_grow(struct id_array *a, int id)
+{
+	struct id_map_entry *entries;
+	size_t size = a->size ? a->size : CFBSTATS_ID_ARRAY_SIZE;
+
+	while (size <= (size_t) id)
+		size *= 2;
+
+	entries = realloc(a->entries, size * sizeof(*entries));
+	if (!entries)
 		return CFBSTATS_ERROR;
 
+	memset(entries + a->size, 0, (size - a->size) * sizeof(*entries));
+
+	a->entries = entries;
+	a->size = size;
+
 	return CFBSTATS_OK;
 }
 
-const struct objectid *id_map_lookup(int id)
+static struct id_map_entry *array_lookup(const struct id_array *a, int id)
 {
-	const int mask = CFBSTATS_ID_MAP_SIZE - 1;
-	struct map_entry *entry;
-	int i;
-	int count = 0;
+	if (id < 0 || (size_t) id >= a->size || !a->entries[id].used)
+		return NULL;
+
+	return &a->entries[id];
+}
+
+static enum cfbstats_err array_insert(struct id_array *a,
+                                      int id,
+                                      const struct id_map_entry *e)
+{
+	if (id < 0 || id >= CFBSTATS_ID_ARRAY_MAX)
+		return CFBSTATS_ETOOMANY;
+
+	if ((size_t) id >= a->size && array_grow(a, id) != CFBSTATS_OK)
+		return CFBSTATS_ENOMEM;
+
+	/* the first object with a code keeps it */
+	if (!a->entries[id].used)
+		a->entries[id] = *e;
+
+	return CFBSTATS_ENONE;
+}
+
+/* game hash table */
+
+static size_t table_home(const struct id_table *t, game_key key)
+{
+	uint64_t h = key;
+
+	/* most of a key's bits are the same from game to game, mix them */
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+
+	return h & (t->size - 1);
+}
+
+static bool over_load_factor(size_t count, size_t size)
+{
+	return (count * ID_TABLE_LOAD_DEN) > (size * ID_TABLE_LOAD_NUM);
+}
+
+/* place s without checking for duplicates, there must be a free slot */
+static void table_place(struct id_table *t, const struct id_table_slot *s)
+{
+	size_t i;
+
+	for (i = table_home(t, s->key); t->slots[i].entry.used;
+	     i = (i + 1) & (t->size - 1))
+		;
+
+	t->slots[i] = *s;
+}
+
+static int table_resize(struct id_table *t, size_t new_size)
+{
+	struct id_table_slot *old_slots = t->slots;
+	size_t old_size = t->size;
+	size_t i;
+
+	t->slots = calloc(new_size, sizeof(*t->slots));
+	if (!t->slots) {
+		t->slots = old_slots;
+		return CFBSTATS_ERROR;
+	}
+
+	t->size = new_size;
+
+	for (i = 0; i < old_size; i++) {
+		if (old_slots[i].entry.used)
+			table_place(t, &old_slots[i]);
+	}
+
+	free(old_slots);
+
+	return CFBSTATS_OK;
+}
 
-	i = id & mask;
+static struct id_map_entry *table_lookup(const struct id_table *t,
+                                         game_key key)
+{
+	struct id_table_slot *slot;
+	size_t i;
+
+	if (t->count == 0)
+		return NULL;
+
+	for (i = table_home(t, key); ; i = (i + 1) & (t->size - 1)) {
+		slot = &t->slots[i];
+
+		if (!slot->entry.used)
+			return NULL;
+
+		if (slot->key == key)
+			return &slot->entry;
+	}
+}
+
+static enum cfbstats_err table_insert(struct id_table *t,
+                                      const struct id_table_slot *s)
+{
+	size_t size;
+
+	/* the first game with a key keeps it, as with the arrays */
+	if (table_lookup(t, s->key) != NULL)
+		return CFBSTATS_ENONE;
+
+	if (t->size == 0 || over_load_factor(t->count + 1, t->size)) {
+		size = t->size ? t->size * 2 : ID_TABLE_SIZE;
+		if (table_resize(t, size) != CFBSTATS_OK)
+			return CFBSTATS_ENOMEM;
+	}
+
+	table_place(t, s);
+	t->count++;
+
+	return CFBSTATS_ENONE;
+}
+
+static void fill_entry(struct id_map_entry *e,
+                       const struct objectid *oid,
+                       uint32_t idx)
+{
+	e->used = true;
+	e->oid = *oid;
+	e->idx = idx;
+}
+
+enum cfbstats_err id_map_insert(struct id_map *map,
+                                enum id_kind kind,
+                                int id,
+                                const struct objectid *oid,
+                                uint32_t idx)
+{
+	struct id_map_entry e;
+
+	fill_entry(&e, oid, idx);
+
+	if (kind == ID_CONFERENCE)
+		return array_insert(&map->conferences, id, &e);
+
+	return array_insert(&map->teams, id, &e);
+}
+
+const struct id_map_entry *id_map_lookup(const struct id_map *map,
+                                         enum id_kind kind,
+                                         int id)
+{
+	if (kind == ID_CONFERENCE)
+		return array_lookup(&map->conferences, id);
+
+	return array_lookup(&map->teams, id);
+}
+
+enum cfbstats_err id_map_insert_game(struct id_map *map,
+                                     game_key key,
+                                     const struct objectid *oid,
+                                     uint32_t idx)
+{
+	struct id_table_slot s;
+
+	s.key = key;
+	fill_entry(&s.entry, oid, idx);
+
+	return table_insert(&map->games, &s);
+}
 
-	while (count < CFBSTATS_ID_MAP_SIZE) {
-		entry = &id_map[i];
-		if (entry->id == id)
-			return &entry->oid;
+const struct id_map_entry *id_map_lookup_game(const struct id_map *map,
+                                              game_key key)
+{
+	return table_lookup(&map->games, key);
+}
+
+static int array_walk(const struct id_array *a,
+                      enum id_kind kind,
+                      id_map_walk_func fn,
+                      void *data)
+{
+	size_t i;
 
-		i = (i + 1) & mask;
-		count++;
+	for (i = 0; i < a->size; i++) {
+		if (a->entries[i].used &&
+		    fn(kind, i, &a->entries[i], data) != CFBSTATS_OK)
+			return CFBSTATS_ERROR;
 	}
 
-	return NULL;
+	return CFBSTATS_OK;
 }
 
-int pack_game_code(const char *str)
+int id_map_walk(const struct id_map *map, id_map_walk_func fn, void *data)
 {
-	int id;
-	const char *team1, *team2, *date, *mmdd;
-	const size_t team_str_len = 4;
-	const size_t date_str_len = 8;
-	const size_t mmdd_str_len = 4;
-	const size_t buf_size = date_str_len + 1;
-	char buf[buf_size];
-	int code;
+	const struct id_table_slot *slot;
+	size_t i;
 
-	team1 = str;
-	team2 = (str + team_str_len);
-	date = (str + (team_str_len * 2));
-	mmdd = date + 4;
+	if (array_walk(&map->conferences, ID_CONFERENCE, fn, data) != CFBSTATS_OK ||
+	    array_walk(&map->teams, ID_TEAM, fn, data) != CFBSTATS_OK)
+		return CFBSTATS_ERROR;
 
-	/* team1 shifted into bits 16-31 */
-	memcpy(buf, team1, team_str_len);
-	buf[team_str_len] = '\0';
-	code = atoi(buf);
-	id = (code << 16) & 0xffff0000;
+	for (i = 0; i < map->games.size; i++) {
+		slot = &map->games.slots[i];
 
-	/* team2 xor'd into bits 16-31 */
-	memcpy(buf, team2, team_str_len);
-	buf[team_str_len] = '\0';
-	code = atoi(buf);
-	id ^= (code << 16) & 0xffff0000;
+		if (slot->entry.used &&
+		    fn(ID_GAME, slot->key, &slot->entry, data) != CFBSTATS_OK)
+			return CFBSTATS_ERROR;
+	}
 
-	/* month and day (mmdd) put into bits 0-15 */
-	memcpy(buf, mmdd, mmdd_str_len);
-	buf[mmdd_str_len] = '\0';
-	code = atoi(buf);
-	id |= code & 0x0000ffff;
+	return CFBSTATS_OK;
+}
+
+/* game codes */
 
-	return id;
+/* the value of the n digits at str, false if they aren't all digits */
+static bool parse_digits(const char *str, int n, uint32_t *out)
+{
+	uint32_t val = 0;
+	int i;
+
+	for (i = 0; i < n; i++) {
+		if (str[i] < '0' || str[i] > '9')
+			return false;
+
+		val = val * 10 + (uint32_t) (str[i] - '0');
+	}
+
+	*out = val;
+
+	return true;
 }
 
+/*
+ * a game code is 16 digits: the visiting team's code and the home team's
+ * code, 4 digits each, then the date as YYYYMMDD. it is read in place.
+ * the month and day are checked so they can't spill into the fields
+ * packed above them, whatever the key width
+ */
+bool pack_game_code(const char *str, game_key *key)
+{
+	uint32_t team1, team2, date, month, day;
+
+	if (!parse_digits(str, 4, &team1) ||
+	    !parse_digits(str + 4, 4, &team2) ||
+	    !parse_digits(str + 8, 8, &date) ||
+	    str[16] != '\0')
+		return false;
+
+	month = date / 100 % 100;
+	day = date % 100;
+
+	if (month < 1 || month > 12 || day < 1 || day > 31)
+		return false;
+
+#if PREDCFB_GAME_KEY_BITS == 32
+	/* team codes in bits 21-31 and 10-20, then year parity, month, day */
+	if (team1 >= (1u << 11) || team2 >= (1u << 11))
+		return false;
+
+	*key = (team1 << 21) | (team2 << 10) |
+	       ((date / 10000) & 1) << 9 | month << 5 | day;
+#else
+	/* team codes in bits 48-63 and 32-47, YYYYMMDD in the low 32 */
+	*key = ((uint64_t) team1 << 48) | ((uint64_t) team2 << 32) | date;
+#endif
+
+	return true;
+}
@@ -5,22 +5,21 @@
 #include <string.h>
 #include <assert.h>
 
-#include <openbsd/string.h>
-
 #include <predcfb/cfbstats.h>
 #include <predcfb/predcfb.h>
 #include <predcfb/csvparse.h>
 #include <predcfb/objectid.h>
+#include <predcfb/objectdb.h>
 
 #include "cfbstats_internal.h"
 
 extern const char *progname;
 
-static int get_ownid(struct linehandler *lh, int *id)
+static int get_ownid(struct linehandler *lh, const struct fielddesc *cur)
 {
 	int err;
 
-	err = csvline_int_at(lh->csvline, lh->current->index, id);
+	err = csvline_int_at(lh->csvline, cur->index, lh->id);
 	if (err != CSVP_OK) {
 		/* FIXME */
 		return CFBSTATS_ERROR;
@@ -29,41 +28,49 @@ static int get_ownid(struct linehandler *lh, int *id)
 	return CFBSTATS_OK;
 }
 
-static int get_owngameid(struct linehandler *lh, int *id)
+static int get_owngameid(struct linehandler *lh, const struct fielddesc *cur)
 {
 	int err;
 	const char *str;
 
-	err = csvline_str_at(lh->csvline, lh->current->index, &str);
+	err = csvline_str_at(lh->csvline, cur->index, &str);
 	if (err != CSVP_OK) {
 		/* FIXME */
 		return CFBSTATS_ERROR;
 	}
 
-	*id = pack_game_code(str);
+	if (!pack_game_code(str, lh->key)) {
+		fprintf(stderr, "%s: invalid game code (line %d)\n", progname, lh->csvline->line);
+		lh->ctx->error = CFBSTATS_EINVALIDFILE;
+		return CFBSTATS_ERROR;
+	}
 
 	return CFBSTATS_OK;
 }
 
-static int get_str(struct linehandler *lh)
+static int get_str(struct linehandler *lh, const struct fielddesc *cur)
 {
 	const char *str;
-	const struct fielddesc *cur = lh->current;
-	char *outbuf = (char*) (((intptr_t) lh->obj) + cur->offset);
+	intptr_t pname = ((intptr_t) lh->obj) + cur->offset;
+	struct name *outname = (struct name*) pname;
 
 	if (csvline_str_at(lh->csvline, cur->index, &str) != CSVP_OK) {
 		/* FIXME */
 		return CFBSTATS_ERROR;
 	}
 
-	strlcpy(outbuf, str, cur->len);
+	/* cut to len - 1 bytes, as copying into a name buffer used to */
+	if (objectdb_intern(lh->ctx->db, str, strnlen(str, cur->len - 1),
+	                    outname) != OBJECTDB_OK) {
+		lh->ctx->error = CFBSTATS_ENOMEM;
+		return CFBSTATS_ERROR;
+	}
 
 	return CFBSTATS_OK;
 }
 
-static int get_short(struct linehandler *lh)
+static int get_short(struct linehandler *lh, const struct fielddesc *cur)
 {
-	const struct fielddesc *cur = lh->current;
 	short *sout = (short*) (((intptr_t) lh->obj) + cur->offset);
 
 	if (csvline_short_at(lh->csvline, cur->index, sout) != CSVP_OK) {
@@ -79,10 +86,9 @@ static int get_short(struct linehandler *lh)
 	return CFBSTATS_OK;
 }
 
-static int get_conf_enum(struct linehandler *lh)
+static int get_conf_enum(struct linehandler *lh, const struct fielddesc *cur)
 {
 	const char *str;
-	const struct fielddesc *cur = lh->current;
 	intptr_t pval = ((intptr_t) lh->obj) + cur->offset;
 	enum conference_division *outdiv = (enum conference_division*) pval;
 
@@ -103,10 +109,9 @@ static int get_conf_enum(struct linehandler *lh)
 	return CFBSTATS_OK;
 }
 
-static int get_site_bool(struct linehandler *lh)
+static int get_site_bool(struct linehandler *lh, const struct fielddesc *cur)
 {
 	const char *str;
-	const struct fielddesc *cur = lh->current;
 	intptr_t pbool = ((intptr_t) lh->obj) + cur->offset;
 	bool *outbool = (bool*) pbool;
 
@@ -120,7 +125,7 @@ static int get_site_bool(struct linehandler *lh)
 	} else if (strcmp(str, "NEUTRAL") == 0) {
 		*outbool = true;
 	} else {
-		cfbstats_errno = CFBSTATS_EINVALIDFILE;
+		lh->ctx->error = CFBSTATS_EINVALIDFILE;
 		fprintf(stderr, "%s: invalid value for game site (line %d)\n", progname, lh->csvline->line);
 		return CFBSTATS_ERROR;
 	}
@@ -128,60 +133,67 @@ static int get_site_bool(struct linehandler *lh)
 	return CFBSTATS_OK;
 }
 
-static int get_confid(struct linehandler *lh)
+static int get_confid(struct linehandler *lh, const struct fielddesc *cur)
 {
-	const struct fielddesc *cur = lh->current;
 	int id;
-	const struct objectid *oid;
+	const struct id_map_entry *entry;
 	intptr_t poid = ((intptr_t) lh->obj) + cur->offset;
+	intptr_t pconf = ((intptr_t) lh->obj) + cur->ptr_offset;
 	struct objectid *outoid = (struct objectid*) poid;
+	struct conference **outconf = (struct conference**) pconf;
 
 	if (csvline_int_at(lh->csvline, cur->index, &id) != CSVP_OK) {
 		/* FIXME */
 		return CFBSTATS_ERROR;
 	}
 
-	if ((oid = id_map_lookup(id)) == NULL) {
+	if ((entry = id_map_lookup(&lh->ctx->id_map, ID_CONFERENCE, id)) == NULL) {
 		fprintf(stderr, "%s: conference id does not exist (line %d)\n", progname, lh->csvline->line);
+		lh->ctx->error = CFBSTATS_EIDLOOKUP;
 		return CFBSTATS_ERROR;
 	}
 
-	*outoid = *oid;
+	*outoid = entry->oid;
+	*outconf = objectdb_get_conference_at(lh->ctx->db, entry->idx);
 
 	return CFBSTATS_OK;
 }
 
-static int get_teamid(struct linehandler *lh)
+static int get_teamid(struct linehandler *lh, const struct fielddesc *cur)
 {
-	const struct fielddesc *cur = lh->current;
 	int id;
-	const struct objectid *oid;
+	const struct id_map_entry *entry;
 	intptr_t poid = ((intptr_t) lh->obj) + cur->offset;
+	intptr_t pteam = ((intptr_t) lh->obj) + cur->ptr_offset;
 	struct objectid *outoid = (struct objectid*) poid;
+	struct team **outteam = (struct team**) pteam;
 
 	if (csvline_int_at(lh->csvline, cur->index, &id) != CSVP_OK) {
 		/* FIXME */
 		return CFBSTATS_ERROR;
 	}
 
-	if ((oid = id_map_lookup(id)) == NULL) {
+	if ((entry = id_map_lookup(&lh->ctx->id_map, ID_TEAM, id)) == NULL) {
 		fprintf(stderr, "%s: team id does not exist (line %d)\n", progname, lh->csvline->line);
+		lh->ctx->error = CFBSTATS_EIDLOOKUP;
 		return CFBSTATS_ERROR;
 	}
 
-	*outoid = *oid;
+	*outoid = entry->oid;
+	*outteam = objectdb_get_team_at(lh->ctx->db, entry->idx);
 
 	return CFBSTATS_OK;
 }
 
-static int get_gameid(struct linehandler *lh)
+static int get_gameid(struct linehandler *lh, const struct fielddesc *cur)
 {
-	const struct fielddesc *cur = lh->current;
 	const char *str;
-	int id;
-	const struct objectid *oid;
+	game_key key;
+	const struct id_map_entry *entry;
 	intptr_t poid = ((intptr_t) lh->obj) + cur->offset;
+	intptr_t pgame = ((intptr_t) lh->obj) + cur->ptr_offset;
 	struct objectid *outoid = (struct objectid*) poid;
+	struct game **outgame = (struct game**) pgame;
 
 	if (csvline_str_at(lh->csvline, cur->index, &str) != CSVP_OK) {
 		const char *err = csvline_strerror(lh->csvline);
@@ -193,113 +205,110 @@ static int get_gameid(struct linehandler *lh)
 		return CFBSTATS_ERROR;
 	}
 
-	id = pack_game_code(str);
+	if (!pack_game_code(str, &key)) {
+		fprintf(stderr, "%s: invalid game code (line %d)\n", progname, lh->csvline->line);
+		lh->ctx->error = CFBSTATS_EINVALIDFILE;
+		return CFBSTATS_ERROR;
+	}
 
-	if ((oid = id_map_lookup(id)) == NULL) {
+	if ((entry = id_map_lookup_game(&lh->ctx->id_map, key)) == NULL) {
 		fprintf(stderr, "%s: game id does not exist (line %d)\n", progname, lh->csvline->line);
+		lh->ctx->error = CFBSTATS_EIDLOOKUP;
 		return CFBSTATS_ERROR;
 	}
 
-	*outoid = *oid;
+	*outoid = entry->oid;
+	*outgame = objectdb_get_game_at(lh->ctx->db, entry->idx);
 
 	return CFBSTATS_OK;
 }
 
-static int get_date(struct linehandler *lh)
+static int get_date(struct linehandler *lh, const struct fielddesc *cur)
 {
-	/* dates are MM/DD/YYYY HH:MM:SS -ZZZZ */
-	static const int DATE_BUF_SIZE = 26;
+	/* dates are MM/DD/YYYY */
 	const char *str;
-	const struct fielddesc *cur = lh->current;
+	size_t len;
 	intptr_t ptime = ((intptr_t) lh->obj) + cur->offset;
+	intptr_t pstr = ((intptr_t) lh->obj) + cur->ptr_offset;
 	time_t *outtime = (time_t*) ptime;
-	char date_buf[DATE_BUF_SIZE];
-	struct tm tm;
-	const char *lastchar;
+	char *outstr = (char*) pstr;
+	const struct date_cache_entry *entry;
 
-	if (csvline_str_at(lh->csvline, cur->index, &str) != CSVP_OK) {
+	if (csvline_slice_at(lh->csvline, cur->index, &str, &len) != CSVP_OK) {
 		/* FIXME */
 		return CFBSTATS_ERROR;
 	}
 
-	snprintf(date_buf, DATE_BUF_SIZE, "%s 00:00:00 +0000", str);
-	lastchar = strptime(date_buf, "%m/%d/%Y %H:%M:%S %z", &tm);
-	if (!lastchar || *lastchar != '\0') {
-		cfbstats_errno = CFBSTATS_EINVALIDFILE;
+	entry = date_cache_lookup(&lh->ctx->dates, str, len);
+	if (!entry) {
+		lh->ctx->error = CFBSTATS_EINVALIDFILE;
 		return CFBSTATS_ERROR;
 	}
 
-	*outtime = mktime(&tm);
+	*outtime = entry->date;
+	memcpy(outstr, entry->str, DATE_STR_SIZE);
 
 	return CFBSTATS_OK;
 }
 
-int linehandler_parse(struct linehandler *lh, int *id)
+/* the function for each field type, looked up once per plan */
+static const field_func field_funcs[] = {
+	[FIELD_TYPE_END] = NULL,
+	[FIELD_TYPE_OWNID] = get_ownid,
+	[FIELD_TYPE_OWNGAMEID] = get_owngameid,
+	[FIELD_TYPE_CONFID] = get_confid,
+	[FIELD_TYPE_TEAMID] = get_teamid,
+	[FIELD_TYPE_GAMEID] = get_gameid,
+	[FIELD_TYPE_STR] = get_str,
+	[FIELD_TYPE_SHORT] = get_short,
+	[FIELD_TYPE_DATE] = get_date,
+	[FIELD_TYPE_CONFERENCE_ENUM] = get_conf_enum,
+	[FIELD_TYPE_SITE_BOOL] = get_site_bool
+};
+
+int field_plan_compile(struct field_plan *plan, const struct fielddesc *desc_list)
 {
-	assert(lh->descriptions != NULL);
-
-	lh->current = lh->descriptions;
-
-	while (lh->current->type != FIELD_TYPE_END) {
-		switch (lh->current->type) {
-		case FIELD_TYPE_OWNID:
-			if (get_ownid(lh, id) != CFBSTATS_OK)
-				return CFBSTATS_ERROR;
-			break;
-
-		case FIELD_TYPE_OWNGAMEID:
-			if (get_owngameid(lh, id) != CFBSTATS_OK)
-				return CFBSTATS_ERROR;
-			break;
-		
-		case FIELD_TYPE_STR:
-			if (get_str(lh) != CFBSTATS_OK)
-				return CFBSTATS_ERROR;
-			break;
-
-		case FIELD_TYPE_SHORT:
-			if (get_short(lh) != CFBSTATS_OK)
-				return CFBSTATS_ERROR;
-			break;
-
-		case FIELD_TYPE_DATE:
-			if (get_date(lh) != CFBSTATS_OK)
-				return CFBSTATS_ERROR;
-			break;
-
-		case FIELD_TYPE_CONFERENCE_ENUM:
-			if (get_conf_enum(lh) != CFBSTATS_OK)
-				return CFBSTATS_ERROR;
-			break;
-
-		case FIELD_TYPE_CONFID:
-			if (get_confid(lh) != CFBSTATS_OK)
-				return CFBSTATS_ERROR;
-			break;
-
-		case FIELD_TYPE_TEAMID:
-			if (get_teamid(lh) != CFBSTATS_OK)
-				return CFBSTATS_ERROR;
-			break;
-
-		case FIELD_TYPE_GAMEID:
-			if (get_gameid(lh) != CFBSTATS_OK)
-				return CFBSTATS_ERROR;
-			break;
-
-		case FIELD_TYPE_SITE_BOOL:
-			if (get_site_bool(lh) != CFBSTATS_OK)
-				return CFBSTATS_ERROR;
-			break;
-
-		case FIELD_TYPE_END:
-			/* this should never happen... */
-			break;
+	const struct fielddesc *desc;
+	struct field_step step;
+	int i;
+
+	plan->num_steps = 0;
+
+	for (desc = desc_list; desc->type != FIELD_TYPE_END; desc++) {
+		if (plan->num_steps == FIELD_PLAN_MAX_STEPS)
+			return CFBSTATS_ERROR;
+
+		step.parse = field_funcs[desc->type];
+		step.desc = desc;
+
+		/* insert sorted by column, so a row is read left to right */
+		for (i = plan->num_steps; i > 0; i--) {
+			if (plan->steps[i - 1].desc->index <= desc->index)
+				break;
+			plan->steps[i] = plan->steps[i - 1];
 		}
 
-		lh->current++;
+		plan->steps[i] = step;
+		plan->num_steps++;
 	}
 
 	return CFBSTATS_OK;
 }
 
+int linehandler_run(struct linehandler *lh, enum field_plan_file file)
+{
+	const struct field_plan *plan = &lh->ctx->plans[file];
+	const struct field_step *step = plan->steps;
+	const struct field_step *end = step + plan->num_steps;
+
+	/* no plan means the header hasn't been checked */
+	if (step == end)
+		return CFBSTATS_ERROR;
+
+	for (; step < end; step++) {
+		if (step->parse(lh, step->desc) != CFBSTATS_OK)
+			return CFBSTATS_ERROR;
+	}
+
+	return CFBSTATS_OK;
+}
@@ -0,0 +1,561 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <openbsd/string.h>
+
+#include <predcfb/cfbstats.h>
+#include <predcfb/objectdb.h>
+#include <predcfb/objectid.h>
+#include <predcfb/zipfile.h>
+
+#include "cfbstats_internal.h"
+
+extern const char *progname;
+
+/*
+ * manifest
+ *
+ * for every archive read into a database, the size and crc of each file
+ * it was read from (straight out of the zip central directory) and the
+ * objectid every cfbstats id in it came to. saved next to the database
+ * as text:
+ *
+ *   predcfb-manifest 1 <game key bits>
+ *   archive <name>
+ *   member <file> <size> <crc>
+ *   conference <code> <sha1>
+ *   team <code> <sha1>
+ *   game <key> <sha1>
+ *   end
+ *
+ * archives are known by their file name alone, so a directory of
+ * archives can be moved and the weekly download of a season replaces
+ * the last one. the ids are what let a changed file be read on its own:
+ * the files before it are skipped, and the ids they would have put in
+ * the id map are looked up from the database instead
+ */
+#define MANIFEST_MAGIC "predcfb-manifest"
+#define MANIFEST_VERSION 1
+#define MANIFEST_LINE_MAX 4096
+#define MANIFEST_LIST_SIZE 16
+#define MANIFEST_MAX_MEMBERS 8
+#define MANIFEST_NAME_MAX 64
+
+struct manifest_member {
+	char name[MANIFEST_NAME_MAX];
+	uint64_t size;
+	uint32_t crc;
+};
+
+struct manifest_id {
+	enum id_kind kind;
+	uint64_t code;
+	struct objectid oid;
+};
+
+struct manifest_archive {
+	char *name;
+	struct manifest_member members[MANIFEST_MAX_MEMBERS];
+	int num_members;
+	struct manifest_id *ids;
+	int num_ids;
+	int max_ids;
+};
+
+struct manifest {
+	struct manifest_archive *archives;
+	int num_archives;
+	int max_archives;
+};
+
+static const char *id_kind_names[] = {
+	"conference",
+	"team",
+	"game"
+};
+
+static const char *archive_name(const char *path)
+{
+	const char *slash = strrchr(path, '/');
+
+	return slash ? slash + 1 : path;
+}
+
+static void archive_destroy(struct manifest_archive *a)
+{
+	free(a->name);
+	free(a->ids);
+}
+
+static int add_id(struct manifest_archive *a,
+                  enum id_kind kind,
+                  uint64_t code,
+                  const struct objectid *oid)
+{
+	struct manifest_id *ids;
+	int max;
+
+	if (a->num_ids == a->max_ids) {
+		max = a->max_ids ? a->max_ids * 2 : MANIFEST_LIST_SIZE;
+		if ((ids = realloc(a->ids, sizeof(*ids) * max)) == NULL)
+			return CFBSTATS_ERROR;
+
+		a->ids = ids;
+		a->max_ids = max;
+	}
+
+	a->ids[a->num_ids].kind = kind;
+	a->ids[a->num_ids].code = code;
+	a->ids[a->num_ids].oid = *oid;
+	a->num_ids++;
+
+	return CFBSTATS_OK;
+}
+
+/* the record for name, replacing any there is, or NULL */
+static struct manifest_archive *new_archive(struct manifest *m,
+                                            const char *name)
+{
+	struct manifest_archive *a;
+	char *copy;
+	int max;
+
+	if ((copy = strdup(name)) == NULL)
+		return NULL;
+
+	if ((a = manifest_find(m, name)) != NULL) {
+		archive_destroy(a);
+	} else {
+		if (m->num_archives == m->max_archives) {
+			max = m->max_archives ? m->max_archives * 2 :
+			                        MANIFEST_LIST_SIZE;
+			a = realloc(m->archives, sizeof(*a) * max);
+			if (!a) {
+				free(copy);
+				return NULL;
+			}
+
+			m->archives = a;
+			m->max_archives = max;
+		}
+
+		a = &m->archives[m->num_archives++];
+	}
+
+	memset(a, 0, sizeof(*a));
+	a->name = copy;
+
+	return a;
+}
+
+struct manifest *manifest_new(void)
+{
+	return calloc(1, sizeof(struct manifest));
+}
+
+void manifest_free(struct manifest *m)
+{
+	int i;
+
+	if (!m)
+		return;
+
+	for (i = 0; i < m->num_archives; i++)
+		archive_destroy(&m->archives[i]);
+
+	free(m->archives);
+	free(m);
+}
+
+struct manifest_archive *manifest_find(const struct manifest *m,
+                                       const char *path)
+{
+	const char *name = archive_name(path);
+	int i;
+
+	for (i = 0; i < m->num_archives; i++) {
+		if (strcmp(m->archives[i].name, name) == 0)
+			return &m->archives[i];
+	}
+
+	return NULL;
+}
+
+bool manifest_unchanged(const struct manifest_archive *a,
+                        const struct zipfile_stat *st)
+{
+	int i;
+
+	for (i = 0; i < a->num_members; i++) {
+		if (strcmp(a->members[i].name, st->name) == 0)
+			return a->members[i].size == st->size &&
+			       a->members[i].crc == st->crc;
+	}
+
+	return false;
+}
+
+int manifest_restore(cfbstats_ctx *ctx, const struct manifest_archive *a)
+{
+	const struct manifest_id *id;
+	const struct conference *conf;
+	const struct team *team;
+	const struct game *game;
+	enum cfbstats_err err;
+	int i;
+
+	for (i = 0; i < a->num_ids; i++) {
+		id = &a->ids[i];
+		err = CFBSTATS_EOIDLOOKUP;
+
+		/* the object has to still be in the database */
+		switch (id->kind) {
+		case ID_CONFERENCE:
+			conf = objectdb_get_conference(ctx->db, &id->oid);
+			if (conf)
+				err = id_map_insert(&ctx->id_map, ID_CONFERENCE,
+				                    (int) id->code, &id->oid,
+				                    conf->idx);
+			break;
+
+		case ID_TEAM:
+			team = objectdb_get_team(ctx->db, &id->oid);
+			if (team)
+				err = id_map_insert(&ctx->id_map, ID_TEAM,
+				                    (int) id->code, &id->oid,
+				                    team->idx);
+			break;
+
+		case ID_GAME:
+			game = objectdb_get_game(ctx->db, &id->oid);
+			if (game)
+				err = id_map_insert_game(&ctx->id_map,
+				                         (game_key) id->code,
+				                         &id->oid, game->idx);
+			break;
+		}
+
+		if (err != CFBSTATS_ENONE) {
+			ctx->error = err;
+			return CFBSTATS_ERROR;
+		}
+	}
+
+	return CFBSTATS_OK;
+}
+
+static int record_id(enum id_kind kind,
+                     uint64_t code,
+                     const struct id_map_entry *entry,
+                     void *data)
+{
+	return add_id(data, kind, code, &entry->oid);
+}
+
+int manifest_record(cfbstats_ctx *ctx,
+                    const char *path,
+                    const struct zipfile_stat *stats,
+                    int num_stats)
+{
+	struct manifest_member members[MANIFEST_MAX_MEMBERS];
+	struct manifest_archive *a;
+	int num_members = 0;
+	int i;
+
+	/* the files the archive was last read from */
+	if (!stats && (a = manifest_find(ctx->manifest, path)) != NULL) {
+		memcpy(members, a->members, sizeof(members));
+		num_members = a->num_members;
+	}
+
+	if ((a = new_archive(ctx->manifest, archive_name(path))) == NULL)
+		goto nomem;
+
+	if (!stats) {
+		memcpy(a->members, members, sizeof(members));
+		a->num_members = num_members;
+	}
+
+	for (i = 0; stats && i < num_stats && i < MANIFEST_MAX_MEMBERS; i++) {
+		strlcpy(a->members[i].name, stats[i].name, MANIFEST_NAME_MAX);
+		a->members[i].size = stats[i].size;
+		a->members[i].crc = stats[i].crc;
+	}
+
+	if (stats)
+		a->num_members = i;
+
+	if (id_map_walk(&ctx->id_map, record_id, a) != CFBSTATS_OK)
+		goto nomem;
+
+	return CFBSTATS_OK;
+
+nomem:
+	ctx->error = CFBSTATS_ENOMEM;
+	return CFBSTATS_ERROR;
+}
+
+int manifest_append(struct manifest *dst, struct manifest *src)
+{
+	struct manifest_archive *a, *from;
+	int i;
+
+	for (i = 0; i < src->num_archives; i++) {
+		from = &src->archives[i];
+
+		if ((a = new_archive(dst, from->name)) == NULL)
+			return CFBSTATS_ERROR;
+
+		/* the ids are handed over rather than copied */
+		memcpy(a->members, from->members, sizeof(a->members));
+		a->num_members = from->num_members;
+		a->ids = from->ids;
+		a->num_ids = from->num_ids;
+		a->max_ids = from->max_ids;
+
+		from->ids = NULL;
+		from->num_ids = 0;
+		from->max_ids = 0;
+	}
+
+	return CFBSTATS_OK;
+}
+
+/* reading and writing */
+
+static int bad_line(const char *path, int line)
+{
+	fprintf(stderr, "%s: %s: invalid manifest (line %d)\n",
+	        progname, path, line);
+
+	return CFBSTATS_ERROR;
+}
+
+static bool id_kind_from_name(const char *name, enum id_kind *kind)
+{
+	int i;
+
+	for (i = 0; i < (int) (sizeof(id_kind_names) /
+	                       sizeof(id_kind_names[0])); i++) {
+		if (strcmp(id_kind_names[i], name) == 0) {
+			*kind = (enum id_kind) i;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static int read_header(const char *buf)
+{
+	char magic[MANIFEST_NAME_MAX];
+	int version, key_bits;
+
+	if (sscanf(buf, "%63s %d %d", magic, &version, &key_bits) != 3 ||
+	    strcmp(magic, MANIFEST_MAGIC) != 0 ||
+	    version != MANIFEST_VERSION)
+		return CFBSTATS_ERROR;
+
+	/* game keys from a build with other keys mean nothing here */
+	if (key_bits != PREDCFB_GAME_KEY_BITS)
+		return CFBSTATS_ERROR;
+
+	return CFBSTATS_OK;
+}
+
+/* one line inside an archive's record, a is NULL outside of one */
+static int read_line(struct manifest *m,
+                     struct manifest_archive **a,
+                     char *buf)
+{
+	struct manifest_member *mm;
+	char kind_name[MANIFEST_NAME_MAX];
+	char sha1[OBJECTID_MD_STR_SIZE];
+	struct objectid oid;
+	enum id_kind kind;
+	uint64_t code;
+
+	if (!*a) {
+		if (strncmp(buf, "archive ", 8) != 0 || buf[8] == '\0')
+			return CFBSTATS_ERROR;
+
+		*a = new_archive(m, buf + 8);
+
+		return *a ? CFBSTATS_OK : CFBSTATS_ERROR;
+	}
+
+	if (strcmp(buf, "end") == 0) {
+		*a = NULL;
+		return CFBSTATS_OK;
+	}
+
+	if (strncmp(buf, "member ", 7) == 0) {
+		if ((*a)->num_members == MANIFEST_MAX_MEMBERS)
+			return CFBSTATS_ERROR;
+
+		mm = &(*a)->members[(*a)->num_members];
+		if (sscanf(buf, "member %63s %" SCNu64 " %" SCNx32,
+		           mm->name, &mm->size, &mm->crc) != 3)
+			return CFBSTATS_ERROR;
+
+		(*a)->num_members++;
+
+		return CFBSTATS_OK;
+	}
+
+	if (sscanf(buf, "%63s %" SCNu64 " %40s", kind_name, &code, sha1) != 3 ||
+	    !id_kind_from_name(kind_name, &kind) ||
+	    !objectid_from_string(sha1, &oid))
+		return CFBSTATS_ERROR;
+
+	return add_id(*a, kind, code, &oid);
+}
+
+static int read_manifest(struct manifest *m, FILE *inf, const char *path)
+{
+	struct manifest_archive *a = NULL;
+	char buf[MANIFEST_LINE_MAX];
+	size_t len;
+	int line;
+
+	for (line = 1; fgets(buf, sizeof(buf), inf) != NULL; line++) {
+		len = strlen(buf);
+		if (len == 0 || buf[len - 1] != '\n')
+			return bad_line(path, line);
+
+		buf[len - 1] = '\0';
+
+		if (line == 1) {
+			if (read_header(buf) != CFBSTATS_OK)
+				return bad_line(path, line);
+		} else if (read_line(m, &a, buf) != CFBSTATS_OK) {
+			return bad_line(path, line);
+		}
+	}
+
+	/* a record cut off part of the way through */
+	if (ferror(inf) || line == 1 || a != NULL)
+		return bad_line(path, line);
+
+	return CFBSTATS_OK;
+}
+
+static int write_manifest(const struct manifest *m, FILE *outf)
+{
+	const struct manifest_archive *a;
+	const struct manifest_member *mm;
+	const struct manifest_id *id;
+	char sha1[OBJECTID_MD_STR_SIZE];
+	int i, j;
+
+	fprintf(outf, "%s %d %d\n", MANIFEST_MAGIC, MANIFEST_VERSION,
+	        PREDCFB_GAME_KEY_BITS);
+
+	for (i = 0; i < m->num_archives; i++) {
+		a = &m->archives[i];
+
+		fprintf(outf, "archive %s\n", a->name);
+
+		for (j = 0; j < a->num_members; j++) {
+			mm = &a->members[j];
+			fprintf(outf, "member %s %" PRIu64 " %08" PRIx32 "\n",
+			        mm->name, mm->size, mm->crc);
+		}
+
+		for (j = 0; j < a->num_ids; j++) {
+			id = &a->ids[j];
+			objectid_string(&id->oid, sha1);
+			fprintf(outf, "%s %" PRIu64 " %s\n",
+			        id_kind_names[id->kind], id->code, sha1);
+		}
+
+		fputs("end\n", outf);
+	}
+
+	return ferror(outf) ? CFBSTATS_ERROR : CFBSTATS_OK;
+}
+
+/* global functions */
+
+int cfbstats_manifest_new(cfbstats_ctx *ctx)
+{
+	struct manifest *m;
+
+	if ((m = manifest_new()) == NULL) {
+		ctx->error = CFBSTATS_ENOMEM;
+		return CFBSTATS_ERROR;
+	}
+
+	manifest_free(ctx->manifest);
+	ctx->manifest = m;
+
+	return CFBSTATS_OK;
+}
+
+int cfbstats_manifest_read(cfbstats_ctx *ctx, const char *path)
+{
+	struct manifest *m;
+	FILE *inf;
+
+	if ((inf = fopen(path, "r")) == NULL) {
+		fprintf(stderr, "%s: could not open '%s' for reading\n",
+		        progname, path);
+		ctx->error = CFBSTATS_EMANIFEST;
+		return CFBSTATS_ERROR;
+	}
+
+	if ((m = manifest_new()) == NULL) {
+		fclose(inf);
+		ctx->error = CFBSTATS_ENOMEM;
+		return CFBSTATS_ERROR;
+	}
+
+	if (read_manifest(m, inf, path) != CFBSTATS_OK) {
+		manifest_free(m);
+		fclose(inf);
+		ctx->error = CFBSTATS_EMANIFEST;
+		return CFBSTATS_ERROR;
+	}
+
+	fclose(inf);
+
+	manifest_free(ctx->manifest);
+	ctx->manifest = m;
+
+	return CFBSTATS_OK;
+}
+
+int cfbstats_manifest_write(cfbstats_ctx *ctx, const char *path)
+{
+	FILE *outf;
+	int err;
+
+	if (!ctx->manifest)
+		return CFBSTATS_OK;
+
+	if ((outf = fopen(path, "w")) == NULL) {
+		fprintf(stderr, "%s: could not open '%s' for writing\n",
+		        progname, path);
+		ctx->error = CFBSTATS_EMANIFEST;
+		return CFBSTATS_ERROR;
+	}
+
+	err = write_manifest(ctx->manifest, outf);
+
+	if (fclose(outf) != 0)
+		err = CFBSTATS_ERROR;
+
+	if (err != CFBSTATS_OK) {
+		fprintf(stderr, "%s: could not write '%s'\n", progname, path);
+		ctx->error = CFBSTATS_EMANIFEST;
+	}
+
+	return err;
+}
+
+int cfbstats_files_skipped(const cfbstats_ctx *ctx)
+{
+	return ctx->files_skipped;
+}
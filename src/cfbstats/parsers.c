@@ -1,4 +1,5 @@
 
+#include <stdbool.h>
 #include <string.h>
 
 #include <predcfb/cfbstats.h>
@@ -6,11 +7,16 @@
 
 #include "cfbstats_internal.h"
 
-/* csv header verification */
+/*
+ * csv header verification; once the header is known to match, the
+ * descriptions are compiled into the plan used for the rest of the file
+ */
 
 static int check_csv_header(
+		cfbstats_ctx *ctx,
 		struct csvline *c,
-		const struct fielddesc *desc_list)
+		const struct fielddesc *desc_list,
+		enum field_plan_file file)
 {
 	const char *field;
 	const struct fielddesc *desc = desc_list;
@@ -20,35 +26,95 @@ static int check_csv_header(
 			return CFBSTATS_ERROR;
 
 		if (strcmp(field, desc->name) != 0) {
-			cfbstats_errno = CFBSTATS_EINVALIDFILE;
+			ctx->error = CFBSTATS_EINVALIDFILE;
 			return CFBSTATS_ERROR;
 		}
 
 		desc++;
 	}
 
+	if (field_plan_compile(&ctx->plans[file], desc_list) != CFBSTATS_OK) {
+		ctx->error = CFBSTATS_EINVALIDFILE;
+		return CFBSTATS_ERROR;
+	}
+
 	return CFBSTATS_OK;
 }
 
+/*
+ * reading an archive into a db that already has its season reuses the
+ * objects there; only those the db had before this archive can be, a
+ * name repeated within one archive is still a duplicate
+ */
+
+static struct conference *existing_conference(cfbstats_ctx *ctx,
+                                              struct conference *conf,
+                                              const struct objectid *oid)
+{
+	struct conference *old;
+
+	if (objectdb_get_error(ctx->db) != OBJECTDB_EDUPLICATE)
+		return NULL;
+
+	old = objectdb_get_conference(ctx->db, oid);
+	if (old == NULL || old->idx >= ctx->known_conferences) {
+		ctx->error = CFBSTATS_EINVALIDFILE;
+		return NULL;
+	}
+
+	memset(conf, 0, sizeof(*conf));
+	ctx->spare_conf = conf;
+
+	return old;
+}
+
+static struct team *existing_team(cfbstats_ctx *ctx,
+                                  struct team *team,
+                                  const struct objectid *oid)
+{
+	struct team *old;
+
+	if (objectdb_get_error(ctx->db) != OBJECTDB_EDUPLICATE)
+		return NULL;
+
+	old = objectdb_get_team(ctx->db, oid);
+	if (old == NULL || old->idx >= ctx->known_teams) {
+		ctx->error = CFBSTATS_EINVALIDFILE;
+		return NULL;
+	}
+
+	memset(team, 0, sizeof(*team));
+	ctx->spare_team = team;
+
+	return old;
+}
+
 /* parse conference.csv */
 
-int parse_conference_csv(struct csvline *c)
+int parse_conference_csv(struct csvline *c, void *data)
 {
+	cfbstats_ctx *ctx = data;
 	struct linehandler handler;
 	struct conference *conf;
 	struct objectid oid;
+	enum cfbstats_err err;
 	int id;
 
 	if (c->num_fields != total_fields_conference) {
-		cfbstats_errno = CFBSTATS_EINVALIDFILE;
+		ctx->error = CFBSTATS_EINVALIDFILE;
 		return CFBSTATS_ERROR;
 	}
 
 	if (c->line == 1) {
-		return check_csv_header(c, fdesc_conference);
+		return check_csv_header(ctx, c, fdesc_conference,
+		                        FIELD_PLAN_CONFERENCE);
 	}
 
-	conf = objectdb_create_conference();
+	if ((conf = ctx->spare_conf) != NULL)
+		ctx->spare_conf = NULL;
+	else
+		conf = objectdb_create_conference(ctx->db);
+
 	if (!conf) {
 		/* too many conferences!
 		 * TODO: print error string
@@ -56,188 +122,275 @@ int parse_conference_csv(struct csvline *c)
 		return CFBSTATS_ERROR;
 	}
 
-	handler.descriptions = fdesc_conference;
+	handler.ctx = ctx;
 	handler.csvline = c;
 	handler.obj = conf;
+	handler.id = &id;
+	handler.key = NULL;
 
 	/* parse the fields */
-	if (linehandler_parse(&handler, &id) != CFBSTATS_OK)
+	if (linehandler_run(&handler, FIELD_PLAN_CONFERENCE) != CFBSTATS_OK)
 		return CFBSTATS_ERROR;
 
-	/* add the conference to the objectdb */
-	if (objectdb_add_conference(conf, &oid) != OBJECTDB_OK)
-		return CFBSTATS_ERROR;
+	/* add the conference to the objectdb, or use the one already there */
+	if (objectdb_add_conference(ctx->db, conf, &oid) != OBJECTDB_OK) {
+		if ((conf = existing_conference(ctx, conf, &oid)) == NULL)
+			return CFBSTATS_ERROR;
+	}
 
 	/* add the conference to the id map */
-	if (id_map_insert(id, &oid) != CFBSTATS_OK)
+	err = id_map_insert(&ctx->id_map, ID_CONFERENCE, id, &oid, conf->idx);
+	if (err != CFBSTATS_ENONE) {
+		ctx->error = err;
 		return CFBSTATS_ERROR;
+	}
 
 	return CFBSTATS_OK;
 }
 
 /* parse team.csv */
 
-int parse_team_csv(struct csvline *c)
+int parse_team_csv(struct csvline *c, void *data)
 {
+	cfbstats_ctx *ctx = data;
 	struct linehandler handler;
 	struct objectid oid;
+	enum cfbstats_err err;
 	int id;
 	struct team *team;
 
 	if (c->num_fields != total_fields_team) {
-		cfbstats_errno = CFBSTATS_EINVALIDFILE;
+		ctx->error = CFBSTATS_EINVALIDFILE;
 		return CFBSTATS_ERROR;
 	}
 
 	if (c->line == 1) {
-		return check_csv_header(c, fdesc_team);
+		return check_csv_header(ctx, c, fdesc_team,
+		                        FIELD_PLAN_TEAM);
 	}
 
-	if ((team = objectdb_create_team()) == NULL) {
-		cfbstats_errno = CFBSTATS_ETOOMANY;
+	if ((team = ctx->spare_team) != NULL)
+		ctx->spare_team = NULL;
+	else
+		team = objectdb_create_team(ctx->db);
+
+	if (team == NULL) {
+		ctx->error = CFBSTATS_ETOOMANY;
 		return CFBSTATS_ERROR;
 	}
 
-	handler.descriptions = fdesc_team;
+	handler.ctx = ctx;
 	handler.csvline = c;
 	handler.obj = team;
+	handler.id = &id;
+	handler.key = NULL;
 
 	/* parse the fields */
-	if (linehandler_parse(&handler, &id) != CFBSTATS_OK)
+	if (linehandler_run(&handler, FIELD_PLAN_TEAM) != CFBSTATS_OK)
 		return CFBSTATS_ERROR;
 
-	/* set the conference pointer from the oid */
-	if ((team->conf = objectdb_get_conference(&team->conf_oid)) == NULL) {
-		cfbstats_errno = CFBSTATS_EOIDLOOKUP;
+	/* the conference pointer is resolved through the id map */
+	if (team->conf == NULL) {
+		ctx->error = CFBSTATS_EOIDLOOKUP;
 		return CFBSTATS_ERROR;
 	}
 
-	/* add the team to the object db */
-	if (objectdb_add_team(team, &oid) != OBJECTDB_OK)
-		return CFBSTATS_ERROR;
+	/* add the team to the object db, or use the one already there */
+	if (objectdb_add_team(ctx->db, team, &oid) != OBJECTDB_OK) {
+		if ((team = existing_team(ctx, team, &oid)) == NULL)
+			return CFBSTATS_ERROR;
+	}
 
 	/* add the team to the id map */
-	if (id_map_insert(id, &oid) != CFBSTATS_OK)
+	err = id_map_insert(&ctx->id_map, ID_TEAM, id, &oid, team->idx);
+	if (err != CFBSTATS_ENONE) {
+		ctx->error = err;
 		return CFBSTATS_ERROR;
+	}
 
 	return CFBSTATS_OK;
 }
 
 /* parse game.csv */
 
-int parse_game_csv(struct csvline *c)
+int flush_game_csv(cfbstats_ctx *ctx)
+{
+	struct pending_games *p = &ctx->pending;
+	struct objectid oids[CFBSTATS_GAME_BATCH];
+	struct game *rows[CFBSTATS_GAME_BATCH];
+	enum cfbstats_err err;
+	int num = p->num_games;
+	int i;
+
+	if (num == 0)
+		return CFBSTATS_OK;
+
+	p->num_games = 0;
+	memcpy(rows, p->games, num * sizeof(*rows));
+
+	/*
+	 * add the games to the db, hashing their ids together. a game the
+	 * db already had before this archive (from a saved database, or an
+	 * earlier read of the same archive) is used as it is
+	 */
+	if (objectdb_add_or_get_games(ctx->db, p->games, num, oids)
+	    != OBJECTDB_OK) {
+		if (objectdb_get_error(ctx->db) == OBJECTDB_ENOMEM)
+			ctx->error = CFBSTATS_ENOMEM;
+		else
+			ctx->error = CFBSTATS_EINVALIDFILE;
+		return CFBSTATS_ERROR;
+	}
+
+	for (i = 0; i < num; i++) {
+		if (p->games[i] != rows[i] &&
+		    p->games[i]->idx >= ctx->known_games) {
+			ctx->error = CFBSTATS_EINVALIDFILE;
+			return CFBSTATS_ERROR;
+		}
+	}
+
+	/* finally, add the ids to the id map */
+	for (i = 0; i < num; i++) {
+		err = id_map_insert_game(&ctx->id_map, p->keys[i], &oids[i],
+		                         p->games[i]->idx);
+		if (err != CFBSTATS_ENONE) {
+			ctx->error = err;
+			return CFBSTATS_ERROR;
+		}
+	}
+
+	return CFBSTATS_OK;
+}
+
+int parse_game_csv(struct csvline *c, void *data)
 {
+	cfbstats_ctx *ctx = data;
+	struct pending_games *p = &ctx->pending;
 	struct linehandler handler;
-	struct objectid oid;
-	int id;
+	game_key key;
 	struct game *game;
 
 	if (c->num_fields != total_fields_game) {
-		cfbstats_errno = CFBSTATS_EINVALIDFILE;
+		ctx->error = CFBSTATS_EINVALIDFILE;
 		return CFBSTATS_ERROR;
 	}
 
 	if (c->line == 1) {
-		return check_csv_header(c, fdesc_game);
+		return check_csv_header(ctx, c, fdesc_game,
+		                        FIELD_PLAN_GAME);
 	}
 
-	if ((game = objectdb_create_game()) == NULL) {
-		cfbstats_errno = CFBSTATS_ETOOMANY;
+	if ((game = objectdb_create_game(ctx->db)) == NULL) {
+		ctx->error = CFBSTATS_ETOOMANY;
 		return CFBSTATS_ERROR;
 	}
 
-	handler.descriptions = fdesc_game;
+	handler.ctx = ctx;
 	handler.csvline = c;
 	handler.obj = game;
+	handler.id = NULL;
+	handler.key = &key;
 
 	/* parse the fields */
-	if (linehandler_parse(&handler, &id) != CFBSTATS_OK)
+	if (linehandler_run(&handler, FIELD_PLAN_GAME) != CFBSTATS_OK)
 		return CFBSTATS_ERROR;
 
-	/* set home and away team pointers */
-	if ((game->home = objectdb_get_team(&game->home_oid)) == NULL) {
-		cfbstats_errno = CFBSTATS_EOIDLOOKUP;
+	/* home and away team pointers are resolved through the id map */
+	if (game->home == NULL || game->away == NULL) {
+		ctx->error = CFBSTATS_EOIDLOOKUP;
 		return CFBSTATS_ERROR;
 	}
 
-	if ((game->away = objectdb_get_team(&game->away_oid)) == NULL) {
-		cfbstats_errno = CFBSTATS_EOIDLOOKUP;
-		return CFBSTATS_ERROR;
-	}
-
-	/* add the game to the db */
-	if (objectdb_add_game(game, &oid) != OBJECTDB_OK)
-		return CFBSTATS_ERROR;
+	/* the game is added with the rest of its batch */
+	p->games[p->num_games] = game;
+	p->keys[p->num_games] = key;
+	p->num_games++;
 
-	/* finally, add the id to the id map */
-	if (id_map_insert(id, &oid) != CFBSTATS_OK)
-		return CFBSTATS_ERROR;
+	if (p->num_games == CFBSTATS_GAME_BATCH)
+		return flush_game_csv(ctx);
 
 	return CFBSTATS_OK;
 }
 
 /* parse team-game-statistics.csv */
 
-static void update_team_stats(struct team *team, struct stats *stats)
+/* take the game's old stats out of the team's totals and add the new */
+static void update_team_stats(struct team *team,
+                              const struct stats *old,
+                              const struct stats *stats)
 {
-	team->stats.rush_att += stats->rush_att;
-	team->stats.rush_yds += stats->rush_yds;
-	team->stats.rush_tds += stats->rush_tds;
+	int i;
 
-	team->stats.pass_att += stats->pass_att;
-	team->stats.pass_comp += stats->pass_comp;
-	team->stats.pass_yds += stats->pass_yds;
-	team->stats.pass_tds += stats->pass_tds;
-	team->stats.pass_int += stats->pass_int;
+	for (i = 0; i < STATS_NUM_COLUMNS; i++) {
+		objectdb_team_stats_set(&team->stats, i,
+		                        objectdb_team_stats_get(&team->stats, i) -
+		                        objectdb_stats_get(old, i) +
+		                        objectdb_stats_get(stats, i));
+	}
+}
 
-	team->stats.fumbles += stats->fumbles;
-	team->stats.fumbles_lost += stats->fumbles_lost;
+static bool stats_equal(const struct stats *a, const struct stats *b)
+{
+	int i;
 
-	team->stats.points += stats->points;
+	for (i = 0; i < STATS_NUM_COLUMNS; i++) {
+		if (objectdb_stats_get(a, i) != objectdb_stats_get(b, i))
+			return false;
+	}
+
+	return true;
 }
 
-int parse_stats_csv(struct csvline *c)
+int parse_stats_csv(struct csvline *c, void *data)
 {
+	cfbstats_ctx *ctx = data;
 	struct stats_wrapper sw;
 	struct linehandler handler;
+	enum game_side side;
+	struct stats old;
 	int id; // ignore this
-	struct team *team;
-	struct game *game;
 
 	if (c->num_fields != total_fields_stats) {
-		cfbstats_errno = CFBSTATS_EINVALIDFILE;
+		ctx->error = CFBSTATS_EINVALIDFILE;
 		return CFBSTATS_ERROR;
 	}
 
 	if (c->line == 1) {
-		return check_csv_header(c, fdesc_stats);
+		return check_csv_header(ctx, c, fdesc_stats,
+		                        FIELD_PLAN_STATS);
 	}
 
-	handler.descriptions = fdesc_stats;
+	handler.ctx = ctx;
 	handler.csvline = c;
 	handler.obj = &sw;
+	handler.id = &id;
+	handler.key = NULL;
 
 	/* parse the fields */
-	if (linehandler_parse(&handler, &id) != CFBSTATS_OK)
+	if (linehandler_run(&handler, FIELD_PLAN_STATS) != CFBSTATS_OK)
 		return CFBSTATS_ERROR;
 
-	if ((game = objectdb_get_game(&sw.game_oid)) == NULL) {
-		cfbstats_errno = CFBSTATS_EOIDLOOKUP;
+	/* the team and game come straight from the id map, no hashing */
+	if (sw.game == NULL || sw.team == NULL) {
+		ctx->error = CFBSTATS_EOIDLOOKUP;
 		return CFBSTATS_ERROR;
 	}
 
-	if (objectid_compare(&game->home_oid, &sw.team_oid)) {
-		game->home_stats = sw.stats;
-	} else {
-		game->away_stats = sw.stats;
-	}
+	side = (sw.game->home == sw.team) ? GAME_HOME : GAME_AWAY;
+	old = (side == GAME_HOME) ? sw.game->home_stats : sw.game->away_stats;
 
-	if ((team = objectdb_get_team(&sw.team_oid)) == NULL) {
-		cfbstats_errno = CFBSTATS_EOIDLOOKUP;
-		return CFBSTATS_ERROR;
-	}
+	/*
+	 * a game's stats start out zeroed, so this is usually a new row. a
+	 * row the game already has changes nothing, which is what makes
+	 * reading an archive into a database that has it idempotent, and a
+	 * corrected row replaces the old one in the team's totals
+	 */
+	if (stats_equal(&old, &sw.stats))
+		return CFBSTATS_OK;
 
-	update_team_stats(team, &sw.stats);
+	objectdb_set_game_stats(ctx->db, sw.game, side, &sw.stats);
+	update_team_stats(sw.team, &old, &sw.stats);
 
 	return CFBSTATS_OK;
 }
@@ -1,5 +1,11 @@
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include <pthread.h>
 
 #include <predcfb/cfbstats.h>
 #include <predcfb/zipfile.h>
@@ -18,28 +24,38 @@ enum file_type {
 struct file_handler {
 	const char *file;
 	enum file_type type;
-	int (*parsing_func)(struct csvline *);
+	int (*parsing_func)(struct csvline *, void *);
+	const struct fielddesc *fields;
+	/* finishes off lines the parsing function holds back, or NULL */
+	int (*flush_func)(cfbstats_ctx *);
 };
 
 static const struct file_handler file_handlers[] = {
-	{ "conference.csv", CFBSTATS_FILE_CSV, parse_conference_csv },
-	{ "team.csv", CFBSTATS_FILE_CSV, parse_team_csv },
-	{ "game.csv", CFBSTATS_FILE_CSV, parse_game_csv },
-	{ "team-game-statistics.csv", CFBSTATS_FILE_CSV, parse_stats_csv },
-	{ NULL, CFBSTATS_FILE_NONE, NULL }
+	{ "conference.csv", CFBSTATS_FILE_CSV, parse_conference_csv,
+	  fdesc_conference, NULL },
+	{ "team.csv", CFBSTATS_FILE_CSV, parse_team_csv, fdesc_team, NULL },
+	{ "game.csv", CFBSTATS_FILE_CSV, parse_game_csv, fdesc_game,
+	  flush_game_csv },
+	{ "team-game-statistics.csv", CFBSTATS_FILE_CSV, parse_stats_csv,
+	  fdesc_stats, NULL },
+	{ NULL, CFBSTATS_FILE_NONE, NULL, NULL, NULL }
 };
 
-static void handle_zipfile_error(const zf_readctx *zf)
+#define NUM_FILE_HANDLERS \
+	((int) (sizeof(file_handlers) / sizeof(file_handlers[0])) - 1)
+
+static void handle_zipfile_error(cfbstats_ctx *ctx, const zf_readctx *zf)
 {
 	const char *err;
 
 	err = zipfile_strerr(zf);
 	fprintf(stderr, "%s: %s\n", progname, err);
 
-	cfbstats_errno = CFBSTATS_EZIPFILE;
+	ctx->error = CFBSTATS_EZIPFILE;
 }
 
 static void handle_csvparse_error(
+		const cfbstats_ctx *ctx,
 		const struct csvparse *csvp,
 		const struct file_handler *handler)
 {
@@ -51,7 +67,7 @@ static void handle_csvparse_error(
 		 * own error code since the error originated
 		 * here
 		 */
-		err = cfbstats_strerror();
+		err = cfbstats_errstr(ctx->error);
 		fprintf(stderr, "%s: %s in %s\n",
 			progname, err, handler->file);
 	}
@@ -61,57 +77,454 @@ static void handle_csvparse_error(
 		progname, err, handler->file);
 }
 
-static int read_csv_file(zf_readctx *zf, const struct file_handler *handler)
+static int flush_lines(cfbstats_ctx *ctx, const struct file_handler *handler)
+{
+	if (!handler->flush_func || handler->flush_func(ctx) == CFBSTATS_OK)
+		return CFBSTATS_OK;
+
+	fprintf(stderr, "%s: %s in %s\n",
+	        progname, cfbstats_errstr(ctx->error), handler->file);
+
+	return CFBSTATS_ERROR;
+}
+
+/* only the described columns of a file are materialized */
+static int set_projection(struct csvparse *csvp,
+                          const struct file_handler *handler)
+{
+	const struct fielddesc *desc;
+	int columns[FIELD_PLAN_MAX_STEPS];
+	int num_columns = 0;
+
+	for (desc = handler->fields; desc->type != FIELD_TYPE_END; desc++) {
+		if (num_columns == FIELD_PLAN_MAX_STEPS)
+			return CSVP_ERROR;
+
+		columns[num_columns++] = desc->index;
+	}
+
+	return csvp_set_projection(csvp, columns, num_columns);
+}
+
+/* streamed reading */
+
+static double now(void)
 {
-	static const int CSV_BUF_SIZE = 4096;
-	char buf[CSV_BUF_SIZE];
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/*
+ * a file is streamed through two buffers: while the parser works
+ * through one, a helper thread inflates the next piece of the file into
+ * the other. only the helper touches the archive handle between starting
+ * and being joined. records that straddle two buffers are put back
+ * together by the parser, which copies what it needs across calls
+ */
+struct stream {
+	zf_readctx *zf;
+	char *bufs[2];
+	ssize_t filled[2];
+	size_t size;
+	int next;
+
+	pthread_t thread;
+	bool started;
+	double inflate_time;
+};
+
+static void fill_buffer(struct stream *s)
+{
+	double start = now();
+	char *buf = s->bufs[s->next];
 	ssize_t bytes;
-	struct csvparse csvp;
+	size_t used = 0;
+
+	/* minizip hands out a little at a time, so fill the whole buffer */
+	while (used < s->size) {
+		bytes = zipfile_read_file(s->zf, buf + used, s->size - used);
+		if (bytes == ZIPFILE_ERROR) {
+			s->filled[s->next] = ZIPFILE_ERROR;
+			s->inflate_time += now() - start;
+			return;
+		}
 
-	if (zipfile_open_file(zf, handler->file) != ZIPFILE_OK) {
-		handle_zipfile_error(zf);
-		return CFBSTATS_ERROR;
+		if (bytes == 0) /* eof */
+			break;
+
+		used += bytes;
 	}
 
-	if (csvp_init(&csvp, handler->parsing_func) != CSVP_OK) {
-		handle_csvparse_error(&csvp, handler);
+	s->filled[s->next] = used;
+	s->inflate_time += now() - start;
+}
+
+static void *fill_thread(void *data)
+{
+	fill_buffer(data);
+
+	return NULL;
+}
+
+/* start filling the next buffer, here if no thread could be started */
+static void start_fill(struct stream *s)
+{
+	s->started = pthread_create(&s->thread, NULL, fill_thread, s) == 0;
+	if (!s->started)
+		fill_buffer(s);
+}
+
+/* wait for the next buffer, and make it the one to parse */
+static int finish_fill(struct stream *s, cfbstats_ctx *ctx)
+{
+	double start = now();
+	int cur = s->next;
+
+	if (s->started)
+		pthread_join(s->thread, NULL);
+
+	s->started = false;
+	s->next = !cur;
+	ctx->timing.wait += now() - start;
+
+	return cur;
+}
+
+static int stream_init(struct stream *s, zf_readctx *zf, size_t size)
+{
+	s->zf = zf;
+	s->size = size;
+	s->next = 0;
+	s->started = false;
+	s->inflate_time = 0;
+
+	s->bufs[0] = malloc(size);
+	s->bufs[1] = malloc(size);
+	if (!s->bufs[0] || !s->bufs[1]) {
+		free(s->bufs[0]);
+		free(s->bufs[1]);
 		return CFBSTATS_ERROR;
 	}
 
-	while ((bytes = zipfile_read_file(zf, buf, CSV_BUF_SIZE))) {
-		if (bytes == ZIPFILE_ERROR)
+	return CFBSTATS_OK;
+}
+
+static void stream_destroy(struct stream *s, cfbstats_ctx *ctx)
+{
+	free(s->bufs[0]);
+	free(s->bufs[1]);
+
+	ctx->timing.inflate += s->inflate_time;
+}
+
+static int parse_stream(cfbstats_ctx *ctx,
+                        struct stream *s,
+                        struct csvparse *csvp,
+                        const struct file_handler *handler)
+{
+	double start;
+	int cur;
+	int err;
+
+	start_fill(s);
+
+	for (;;) {
+		cur = finish_fill(s, ctx);
+
+		if (s->filled[cur] == ZIPFILE_ERROR) {
+			ctx->error = CFBSTATS_EZIPFILE;
+			fprintf(stderr, "%s: %s\n", progname, zipfile_strerr(s->zf));
 			return CFBSTATS_ERROR;
+		}
 
-		if (bytes == 0) /* eof */
-			break;
+		if (s->filled[cur] == 0) /* eof */
+			return CFBSTATS_OK;
+
+		/* a short buffer is the end of the file */
+		if ((size_t) s->filled[cur] == s->size)
+			start_fill(s);
+		else
+			s->filled[s->next] = 0;
+
+		start = now();
+		if (csvp_parse(csvp, s->bufs[cur], s->filled[cur]) != CSVP_OK) {
+			handle_csvparse_error(ctx, csvp, handler);
+			err = CFBSTATS_ERROR;
+		} else {
+			err = flush_lines(ctx, handler);
+		}
+		ctx->timing.parse += now() - start;
 
-		if (csvp_parse(&csvp, buf, bytes) != CSVP_OK) {
-			handle_csvparse_error(&csvp, handler);
+		if (err != CFBSTATS_OK) {
+			/* the helper can't be left running on the handle */
+			if (s->started)
+				finish_fill(s, ctx);
 			return CFBSTATS_ERROR;
 		}
 	}
+}
 
-	if (csvp_destroy(&csvp) != CSVP_OK) {
-		handle_csvparse_error(&csvp, handler);
+static int read_csv_file(
+		cfbstats_ctx *ctx,
+		zf_readctx *zf,
+		const struct file_handler *handler)
+{
+	struct zipfile_stat st;
+	struct csvparse csvp;
+	struct stream s;
+	size_t size;
+	double start;
+	int err;
+
+	/* a file smaller than the buffers is read in one go */
+	size = ctx->read_buffer;
+	if (zipfile_stat(zf, handler->file, &st) == ZIPFILE_OK &&
+	    st.size < size)
+		size = st.size + 1;
+
+	start = now();
+	err = zipfile_open_file(zf, handler->file);
+	ctx->timing.inflate += now() - start;
+
+	if (err != ZIPFILE_OK) {
+		handle_zipfile_error(ctx, zf);
+		return CFBSTATS_ERROR;
+	}
+
+	if (stream_init(&s, zf, size) != CFBSTATS_OK) {
+		ctx->error = CFBSTATS_ENOMEM;
+		return CFBSTATS_ERROR;
+	}
+
+	if (csvp_init(&csvp, handler->parsing_func, ctx) != CSVP_OK ||
+	    set_projection(&csvp, handler) != CSVP_OK) {
+		handle_csvparse_error(ctx, &csvp, handler);
+		stream_destroy(&s, ctx);
+		return CFBSTATS_ERROR;
+	}
+
+	err = parse_stream(ctx, &s, &csvp, handler);
+	stream_destroy(&s, ctx);
+
+	if (err != CFBSTATS_OK) {
+		csvp_destroy(&csvp);
 		return CFBSTATS_ERROR;
 	}
 
+	/* destroying the parser hands over a last line without a newline */
+	start = now();
+	err = csvp_destroy(&csvp);
+	ctx->timing.parse += now() - start;
+
+	if (err != CSVP_OK) {
+		handle_csvparse_error(ctx, &csvp, handler);
+		return CFBSTATS_ERROR;
+	}
+
+	if (flush_lines(ctx, handler) != CFBSTATS_OK)
+		return CFBSTATS_ERROR;
+
 	if (zipfile_close_file(zf) != ZIPFILE_OK) {
-		handle_zipfile_error(zf);
+		handle_zipfile_error(ctx, zf);
+		return CFBSTATS_ERROR;
+	}
+
+	return CFBSTATS_OK;
+}
+
+/* pipelined reading */
+
+/*
+ * in pipelined mode every member is inflated into memory by its own
+ * thread, through its own archive handle, while the members before it
+ * are being parsed. the members are still parsed one at a time in the
+ * order of file_handlers, so the ids each file refers to are always in
+ * the id map before it is parsed. the data belongs to the member's open
+ * file, so the handle stays open until the member has been parsed
+ */
+struct inflate_job {
+	const char *archive;
+	const struct file_handler *handler;
+	pthread_t thread;
+	bool started;
+
+	zf_readctx *zf;
+	char *data;
+	size_t size;
+	double inflate_time;
+
+	enum cfbstats_err error;
+	int status;
+};
+
+static int inflate_member(struct inflate_job *job)
+{
+	zf_readctx *zf;
+
+	job->error = CFBSTATS_EZIPFILE;
+
+	zf = zipfile_open_archive(job->archive);
+	if (!zf) {
+		job->error = CFBSTATS_ENOMEM;
+		return CFBSTATS_ERROR;
+	} else if (zipfile_get_error(zf) != ZIPFILE_ENONE) {
+		free(zf);
+		return CFBSTATS_ERROR;
+	}
+
+	if (zipfile_open_file(zf, job->handler->file) != ZIPFILE_OK) {
+		zipfile_close_archive(zf);
 		return CFBSTATS_ERROR;
 	}
 
+	job->zf = zf;
+
+	if (zipfile_file_data(zf, &job->data, &job->size) != ZIPFILE_OK)
+		return CFBSTATS_ERROR;
+
+	job->error = CFBSTATS_ENONE;
+
 	return CFBSTATS_OK;
 }
 
-static int read_files_from_zipfile(zf_readctx *zf)
+static int release_member(struct inflate_job *job)
+{
+	int err = CFBSTATS_OK;
+
+	if (!job->zf)
+		return CFBSTATS_OK;
+
+	if (zipfile_close_file(job->zf) != ZIPFILE_OK)
+		err = CFBSTATS_ERROR;
+
+	zipfile_close_archive(job->zf);
+
+	job->zf = NULL;
+	job->data = NULL;
+
+	return err;
+}
+
+static void run_inflate(struct inflate_job *job)
 {
-	const struct file_handler *handler = file_handlers;
+	double start = now();
+
+	job->status = inflate_member(job);
+	job->inflate_time = now() - start;
+}
+
+static void *inflate_thread(void *data)
+{
+	run_inflate(data);
+
+	return NULL;
+}
+
+/* the whole member is in memory, so unquoted fields are never copied */
+static int parse_csv_buffer(cfbstats_ctx *ctx, struct inflate_job *job)
+{
+	struct csvparse csvp;
+
+	if (csvp_init(&csvp, job->handler->parsing_func, ctx) != CSVP_OK ||
+	    set_projection(&csvp, job->handler) != CSVP_OK) {
+		handle_csvparse_error(ctx, &csvp, job->handler);
+		return CFBSTATS_ERROR;
+	}
+
+	if (csvp_parse_inplace(&csvp, job->data, job->size) != CSVP_OK) {
+		handle_csvparse_error(ctx, &csvp, job->handler);
+		csvp_destroy(&csvp);
+		return CFBSTATS_ERROR;
+	}
+
+	if (csvp_destroy(&csvp) != CSVP_OK) {
+		handle_csvparse_error(ctx, &csvp, job->handler);
+		return CFBSTATS_ERROR;
+	}
+
+	return flush_lines(ctx, job->handler);
+}
+
+/* wait for a member to finish inflating, or inflate it here */
+static int join_member(cfbstats_ctx *ctx, struct inflate_job *job)
+{
+	double start = now();
+
+	if (job->started)
+		pthread_join(job->thread, NULL);
+	else
+		run_inflate(job);
+
+	ctx->timing.wait += now() - start;
+	ctx->timing.inflate += job->inflate_time;
+
+	return job->status;
+}
+
+static int read_files_pipelined(cfbstats_ctx *ctx,
+                                const char *path,
+                                int first)
+{
+	struct inflate_job jobs[NUM_FILE_HANDLERS];
+	double start;
+	int err = CFBSTATS_OK;
+	int i;
+
+	for (i = first; i < NUM_FILE_HANDLERS; i++) {
+		jobs[i].archive = path;
+		jobs[i].handler = &file_handlers[i];
+		jobs[i].zf = NULL;
+		jobs[i].data = NULL;
+		jobs[i].size = 0;
+		jobs[i].inflate_time = 0;
+		jobs[i].error = CFBSTATS_ENONE;
+		jobs[i].status = CFBSTATS_ERROR;
+
+		/* a member whose thread didn't start is inflated when needed */
+		jobs[i].started = pthread_create(&jobs[i].thread, NULL,
+		                                 inflate_thread, &jobs[i]) == 0;
+	}
+
+	/* every thread has to be joined, even after an error */
+	for (i = first; i < NUM_FILE_HANDLERS; i++) {
+		if (err != CFBSTATS_OK) {
+			if (jobs[i].started)
+				pthread_join(jobs[i].thread, NULL);
+		} else if (join_member(ctx, &jobs[i]) != CFBSTATS_OK) {
+			ctx->error = jobs[i].error;
+			fprintf(stderr, "%s: could not inflate %s: %s\n",
+			        progname, jobs[i].handler->file,
+			        cfbstats_errstr(ctx->error));
+			err = CFBSTATS_ERROR;
+		} else {
+			start = now();
+			err = parse_csv_buffer(ctx, &jobs[i]);
+			ctx->timing.parse += now() - start;
+		}
+
+		if (release_member(&jobs[i]) != CFBSTATS_OK &&
+		    err == CFBSTATS_OK) {
+			ctx->error = CFBSTATS_EZIPFILE;
+			err = CFBSTATS_ERROR;
+		}
+	}
+
+	return err;
+}
+
+static int read_files_from_zipfile(cfbstats_ctx *ctx,
+                                   zf_readctx *zf,
+                                   int first)
+{
+	const struct file_handler *handler = &file_handlers[first];
 
 	while (handler->type != CFBSTATS_FILE_NONE) {
 		switch (handler->type) {
 		case CFBSTATS_FILE_CSV:
-			if (read_csv_file(zf, handler) != CFBSTATS_OK)
+			if (read_csv_file(ctx, zf, handler) != CFBSTATS_OK)
 				return CFBSTATS_ERROR;
 			break;
 
@@ -127,30 +540,143 @@ static int read_files_from_zipfile(zf_readctx *zf)
 	return CFBSTATS_OK;
 }
 
-/* global functions */
+/* skipping unchanged files */
+
+/*
+ * the size and crc of every file, then how many of the files at the
+ * start of the list can be skipped. a file is only skipped if it and
+ * every file before it are the same as when the archive was recorded:
+ * each file refers to the ids of the files before it, so a changed file
+ * has to be read along with everything after it. the skipped files' ids
+ * are restored from the manifest. if the database doesn't have all of
+ * them, it isn't the one the manifest was written with, and the whole
+ * archive is read
+ */
+static int plan_skip(cfbstats_ctx *ctx,
+                     zf_readctx *zf,
+                     const char *path,
+                     struct zipfile_stat *stats)
+{
+	const struct manifest_archive *a;
+	int first = 0;
+	int i;
+
+	for (i = 0; i < NUM_FILE_HANDLERS; i++) {
+		/* a missing file is reported when it is read */
+		if (zipfile_stat(zf, file_handlers[i].file, &stats[i])
+		    != ZIPFILE_OK)
+			memset(&stats[i], 0, sizeof(stats[i]));
+
+		/* the archive's own copy of the name goes with it */
+		stats[i].name = file_handlers[i].file;
+	}
+
+	if (!ctx->manifest || (a = manifest_find(ctx->manifest, path)) == NULL)
+		return 0;
+
+	while (first < NUM_FILE_HANDLERS &&
+	       manifest_unchanged(a, &stats[first]))
+		first++;
 
-int cfbstats_read_zipfile(const char *path)
+	/* rows appended later need the ids even if nothing is read */
+	if (first > 0 && manifest_restore(ctx, a) != CFBSTATS_OK) {
+		id_map_clear(&ctx->id_map);
+		ctx->error = CFBSTATS_ENONE;
+		first = 0;
+	}
+
+	ctx->files_skipped += first;
+
+	return first;
+}
+
+static int read_files(cfbstats_ctx *ctx, zf_readctx *zf, const char *path)
 {
-	zf_readctx *zf;
+	struct zipfile_stat stats[NUM_FILE_HANDLERS];
+	int first;
+
+	first = plan_skip(ctx, zf, path, stats);
+
+	if (ctx->pipeline) {
+		/* the inflating threads open the archive themselves */
+		if (zipfile_close_archive(zf) != ZIPFILE_OK) {
+			handle_zipfile_error(ctx, zf);
+			return CFBSTATS_ERROR;
+		}
+
+		if (read_files_pipelined(ctx, path, first) != CFBSTATS_OK)
+			return CFBSTATS_ERROR;
+	} else {
+		if (read_files_from_zipfile(ctx, zf, first) != CFBSTATS_OK)
+			return CFBSTATS_ERROR;
+
+		if (zipfile_close_archive(zf) != ZIPFILE_OK) {
+			handle_zipfile_error(ctx, zf);
+			return CFBSTATS_ERROR;
+		}
+	}
+
+	/* an archive that was skipped whole keeps the record it has */
+	if (ctx->manifest && first < NUM_FILE_HANDLERS)
+		return manifest_record(ctx, path, stats, NUM_FILE_HANDLERS);
 
-	cfbstats_init();
+	return CFBSTATS_OK;
+}
 
-	zf = zipfile_open_archive(path);
+int cfbstats_parse_archive(cfbstats_ctx *ctx, const char *path)
+{
+	zf_readctx *zf;
+
+	/*
+	 * the mapped backend inflates each file whole when it is opened,
+	 * which is what the pipeline wants. streaming is only worth it if
+	 * the file comes out a buffer at a time, which minizip does
+	 */
+	zf = zipfile_open_archive_backend(path, ctx->pipeline ?
+	                                  ZIPFILE_BACKEND_MMAP :
+	                                  ZIPFILE_BACKEND_MINIZIP);
 	if (!zf) {
-		cfbstats_errno = CFBSTATS_ENOMEM;
+		ctx->error = CFBSTATS_ENOMEM;
 		return CFBSTATS_ERROR;
 	} else if (zipfile_get_error(zf) != ZIPFILE_ENONE) {
-		handle_zipfile_error(zf);
+		handle_zipfile_error(ctx, zf);
 		return CFBSTATS_ERROR;
 	}
 
-	if (read_files_from_zipfile(zf) != ZIPFILE_OK)
-		return CFBSTATS_ERROR;
+	return read_files(ctx, zf, path);
+}
 
-	if (zipfile_close_archive(zf) != ZIPFILE_OK) {
-		handle_zipfile_error(zf);
+/* global functions */
+
+void cfbstats_set_pipeline(cfbstats_ctx *ctx, bool enable)
+{
+	ctx->pipeline = enable;
+}
+
+void cfbstats_set_read_buffer(cfbstats_ctx *ctx, size_t size)
+{
+	ctx->read_buffer = size ? size : CFBSTATS_READ_BUFFER_SIZE;
+}
+
+void cfbstats_get_timing(const cfbstats_ctx *ctx,
+                         struct cfbstats_timing *timing)
+{
+	*timing = ctx->timing;
+}
+
+void cfbstats_reset_timing(cfbstats_ctx *ctx)
+{
+	memset(&ctx->timing, 0, sizeof(ctx->timing));
+}
+
+int cfbstats_read_zipfile(cfbstats_ctx *ctx, const char *path)
+{
+	/* cfbstats ids are only meaningful within a single archive */
+	cfbstats_init(ctx, ctx->db);
+
+	if (cfbstats_parse_archive(ctx, path) != CFBSTATS_OK)
 		return CFBSTATS_ERROR;
-	}
 
-	return CFBSTATS_OK;
+	/* the id map is left as it is, for cfbstats_append_csv */
+	return cfbstats_set_archive(ctx, path);
 }
@@ -7,6 +7,7 @@
  * A longer description would go here.
  */
 
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 #include <limits.h>
@@ -61,6 +62,40 @@ int csvline_add(struct csvline *c, const char *str, size_t len)
 	}
 
 	c->fields[c->num_fields] = strbuf_str;
+	c->lens[c->num_fields] = len;
+	c->num_fields++;
+
+	return CSVP_OK;
+}
+
+int csvline_add_slice(struct csvline *c, const char *str, size_t len)
+{
+	if (!str) {
+		c->error = CSVLINE_ENULLSTR;
+		return CSVP_ERROR;
+	}
+
+	if (c->num_fields >= CSVLINE_MAX_FIELDS) {
+		c->error = CSVLINE_EMAXFIELDS;
+		return CSVP_ERROR;
+	}
+
+	c->fields[c->num_fields] = str;
+	c->lens[c->num_fields] = len;
+	c->num_fields++;
+
+	return CSVP_OK;
+}
+
+int csvline_skip(struct csvline *c)
+{
+	if (c->num_fields >= CSVLINE_MAX_FIELDS) {
+		c->error = CSVLINE_EMAXFIELDS;
+		return CSVP_ERROR;
+	}
+
+	c->fields[c->num_fields] = NULL;
+	c->lens[c->num_fields] = 0;
 	c->num_fields++;
 
 	return CSVP_OK;
@@ -81,14 +116,79 @@ int csvline_str_at(struct csvline *c, int at, const char **out)
 		return CSVP_ERROR;
 	}
 	
+	if (!c->fields[at]) {
+		/* not in the projection */
+		c->error = CSVLINE_ENULLSTR;
+		return CSVP_ERROR;
+	}
+
 	*out = c->fields[at];
 
 	return CSVP_OK;
 }
 
-int csvline_int_at(struct csvline *c, int at, int *out)
+int csvline_slice_at(struct csvline *c, int at, const char **out, size_t *len)
+{
+	if (at < 0 || at >= c->num_fields) {
+		c->error = CSVLINE_EINDEX;
+		return CSVP_ERROR;
+	}
+
+	if (!c->fields[at]) {
+		c->error = CSVLINE_ENULLSTR;
+		return CSVP_ERROR;
+	}
+
+	*out = c->fields[at];
+	*len = c->lens[at];
+
+	return CSVP_OK;
+}
+
+/*
+ * the common numeric field, an optional minus sign and a few digits, is
+ * converted here without strtol, which has to handle locales, bases and
+ * errno. anything else (blanks, a plus sign, long numbers, junk) returns
+ * false and goes through strtol, so the results and errors don't change.
+ * 9 digits always fit in a long
+ */
+#define FAST_MAX_DIGITS 9
+
+static bool parse_fixed(const char *str, size_t len, long *out)
+{
+	bool negative = false;
+	unsigned long v = 0;
+	unsigned int d;
+	size_t i;
+
+	if (len > 0 && str[0] == '-') {
+		negative = true;
+		str++;
+		len--;
+
+		/* strtol rejects a lone minus sign */
+		if (len == 0)
+			return false;
+	}
+
+	if (len > FAST_MAX_DIGITS)
+		return false;
+
+	for (i = 0; i < len; i++) {
+		d = (unsigned char) str[i] - '0';
+		if (d > 9)
+			return false;
+
+		v = v * 10 + d;
+	}
+
+	*out = negative ? -(long) v : (long) v;
+
+	return true;
+}
+
+static int parse_long(struct csvline *c, int at, long *out)
 {
-	long int li;
 	char *endptr;
 	const char *str;
 
@@ -97,8 +197,15 @@ int csvline_int_at(struct csvline *c, int at, int *out)
 		return CSVP_ERROR;
 	}
 
-	str = c->fields[at];
-	li = strtol(str, &endptr, 10);
+	if ((str = c->fields[at]) == NULL) {
+		c->error = CSVLINE_ENULLSTR;
+		return CSVP_ERROR;
+	}
+
+	if (parse_fixed(str, c->lens[at], out))
+		return CSVP_OK;
+
+	*out = strtol(str, &endptr, 10);
 
 	if (*endptr != '\0') {
 		/*
@@ -110,6 +217,16 @@ int csvline_int_at(struct csvline *c, int at, int *out)
 		return CSVP_ERROR;
 	}
 
+	return CSVP_OK;
+}
+
+int csvline_int_at(struct csvline *c, int at, int *out)
+{
+	long int li;
+
+	if (parse_long(c, at, &li) != CSVP_OK)
+		return CSVP_ERROR;
+
 	if (li < INT_MIN || li > INT_MAX) {
 		c->error = CSVLINE_ERANGE;
 		return CSVP_ERROR;
@@ -123,26 +240,9 @@ int csvline_int_at(struct csvline *c, int at, int *out)
 int csvline_short_at(struct csvline *c, int at, short *out)
 {
 	long int li;
-	char *endptr;
-	const char *str;
-
-	if (at < 0 || at >= c->num_fields) {
-		c->error = CSVLINE_EINDEX;
-		return CSVP_ERROR;
-	}
-
-	str = c->fields[at];
-	li = strtol(str, &endptr, 10);
 
-	if (*endptr != '\0') {
-		/*
-		 * endptr points at the first bad character, so if it
-		 * points at anything other than the null byte, there
-		 * was an error trying to parse the string
-		 */
-		c->error = CSVLINE_EWRONGTYPE;
+	if (parse_long(c, at, &li) != CSVP_OK)
 		return CSVP_ERROR;
-	}
 
 	if (li < SHRT_MIN || li > SHRT_MAX) {
 		c->error = CSVLINE_ERANGE;
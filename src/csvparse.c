@@ -1,31 +1,67 @@
 
+#include <stdbool.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <libcsv/csv.h>
 #include <predcfb/csvparse.h>
 
+static void set_csvline_error(struct csvparse *c)
+{
+	switch (c->csvline.error) {
+
+	case CSVLINE_EMAXFIELDS:
+		c->error = CSVP_ETOOMANY;
+		break;
+
+	case CSVLINE_ESTRBUFSPACE:
+		c->error = CSVP_ENOBUFS;
+		break;
+
+	default:
+	case CSVLINE_ENONE:
+		/* what? */
+		break;
+	}
+}
+
+/* whether the next field of the line is in the projection */
+static bool wanted(const struct csvparse *c)
+{
+	int column = c->csvline.num_fields;
+
+	if (!c->projected)
+		return true;
+
+	return column < CSVLINE_MAX_FIELDS && c->columns[column];
+}
+
+static int skip_field(struct csvparse *c)
+{
+	if (csvline_skip(&c->csvline) != CSVP_OK) {
+		set_csvline_error(c);
+		return CSVP_ERROR;
+	}
+
+	return CSVP_OK;
+}
+
 static void add_to_csvline(void *str, size_t len, void *mydata)
 {
 	struct csvparse *c = mydata;
 
-	if (csvline_add(&c->csvline, str, len) != CSVP_OK) {
-		switch (c->csvline.error) {
+	/* libcsv has already copied the field into its own entry buffer */
+	c->bytes_copied += len;
 
-		case CSVLINE_EMAXFIELDS:
-			c->error = CSVP_ETOOMANY;
-			break;
+	if (!wanted(c)) {
+		skip_field(c);
+		return;
+	}
 
-		case CSVLINE_ESTRBUFSPACE:
-			c->error = CSVP_ENOBUFS;
-			break;
+	c->bytes_copied += len;
 
-		default:
-		case CSVLINE_ENONE:
-			/* what? */
-			break;
-		}
-	}
+	if (csvline_add(&c->csvline, str, len) != CSVP_OK)
+		set_csvline_error(c);
 }
 
 static void send_csvline_to_parse(int ch, void *mydata)
@@ -37,14 +73,17 @@ static void send_csvline_to_parse(int ch, void *mydata)
 		c->lines++;
 		c->csvline.line = c->lines;
 
-		if (c->handler(&c->csvline) != 0)
+		if (c->handler(&c->csvline, c->handler_data) != 0)
 			c->error = CSVP_EPARSE;
 	}
 
 	csvline_clear(&c->csvline);
 }
 
-int csvp_init(struct csvparse *c, int (*handler)(struct csvline*))
+int csvp_init(
+		struct csvparse *c,
+		int (*handler)(struct csvline*, void*),
+		void *handler_data)
 {
 	memset(c, 0, sizeof(*c));
 
@@ -54,6 +93,43 @@ int csvp_init(struct csvparse *c, int (*handler)(struct csvline*))
 	}
 
 	c->handler = handler;
+	c->handler_data = handler_data;
+	c->isa = csvscan_get_isa();
+
+	return CSVP_OK;
+}
+
+int csvp_set_projection(
+		struct csvparse *c,
+		const int *columns,
+		int num_columns)
+{
+	int i;
+
+	memset(c->columns, 0, sizeof(c->columns));
+
+	for (i = 0; i < num_columns; i++) {
+		if (columns[i] < 0 || columns[i] >= CSVLINE_MAX_FIELDS) {
+			c->error = CSVP_ETOOMANY;
+			return CSVP_ERROR;
+		}
+
+		c->columns[columns[i]] = true;
+	}
+
+	c->projected = true;
+
+	return CSVP_OK;
+}
+
+int csvp_set_isa(struct csvparse *c, enum csvscan_isa isa)
+{
+	if (!csvscan_isa_supported(isa)) {
+		c->error = CSVP_EINTERNAL;
+		return CSVP_ERROR;
+	}
+
+	c->isa = isa;
 
 	return CSVP_OK;
 }
@@ -112,6 +188,258 @@ int csvp_parse(struct csvparse *c, char *buf, size_t len)
 	return CSVP_OK;
 }
 
+/* in-place tokenizer */
+
+static bool is_blank(char ch)
+{
+	return ch == ' ' || ch == '\t';
+}
+
+static bool is_term(char ch)
+{
+	return ch == '\r' || ch == '\n';
+}
+
+static int copy_field(struct csvparse *c, const char *str, size_t len)
+{
+	c->bytes_copied += len;
+
+	if (csvline_add(&c->csvline, str, len) != CSVP_OK) {
+		set_csvline_error(c);
+		return CSVP_ERROR;
+	}
+
+	return CSVP_OK;
+}
+
+/*
+ * walks the scanner's offsets for the buffer, scanning the next chunk
+ * when they run out. the tokenizer only writes behind the last special
+ * byte it asked for, so a chunk is always scanned before it is modified
+ */
+struct scan_cursor {
+	char *chunk;
+	char *scanned;
+	char *end;
+	uint32_t offsets[CSVSCAN_CHUNK];
+	size_t num;
+	size_t next;
+	enum csvscan_isa isa;
+};
+
+static void cursor_init(struct scan_cursor *s, enum csvscan_isa isa,
+                        char *buf, size_t len)
+{
+	s->isa = isa;
+	s->chunk = buf;
+	s->scanned = buf;
+	s->end = buf + len;
+	s->num = 0;
+	s->next = 0;
+}
+
+/* the first special byte at or after p, or the end of the buffer */
+static char *next_special(struct scan_cursor *s, char *p)
+{
+	size_t len;
+	char *q;
+
+	for (;;) {
+		while (s->next < s->num) {
+			q = s->chunk + s->offsets[s->next];
+			if (q >= p)
+				return q;
+			s->next++;
+		}
+
+		if (s->scanned == s->end)
+			return s->end;
+
+		s->chunk = p > s->scanned ? p : s->scanned;
+		len = s->end - s->chunk;
+		if (len > CSVSCAN_CHUNK)
+			len = CSVSCAN_CHUNK;
+
+		s->num = csvscan_with_isa(s->isa, s->chunk, len, s->offsets);
+		s->next = 0;
+		s->scanned = s->chunk + len;
+	}
+}
+
+static char *next_quote(struct scan_cursor *s, char *p)
+{
+	char *q = next_special(s, p);
+
+	while (q < s->end && *q != '"')
+		q = next_special(s, q + 1);
+
+	return q;
+}
+
+/*
+ * the read functions leave *pos past the delimiter that ended the field
+ * and return that delimiter in *delim, or '\0' at the end of the buffer,
+ * since it may be overwritten by the field's terminating null
+ */
+
+/*
+ * *pos points at the opening quote. the field is unescaped in place and
+ * then copied, since it is no longer a plain slice of the input. a field
+ * outside the projection is only scanned to its closing quote
+ */
+static int read_quoted(struct csvparse *c, struct scan_cursor *s,
+                       char **pos, char *delim, bool keep)
+{
+	char *end = s->end;
+	char *p = *pos + 1;
+	char *start = p;
+	char *dst = p;
+	char *q;
+
+	for (;;) {
+		if ((q = next_quote(s, p)) == end) {
+			/* no closing quote */
+			c->error = CSVP_EPARSE;
+			return CSVP_ERROR;
+		}
+
+		if (keep) {
+			memmove(dst, p, q - p);
+			dst += q - p;
+		}
+
+		p = q + 1;
+
+		if (p == end || *p != '"')
+			break;
+
+		/* an escaped quote */
+		if (keep)
+			*dst++ = '"';
+		p++;
+	}
+
+	while (p < end && is_blank(*p))
+		p++;
+
+	if (p == end) {
+		*delim = '\0';
+	} else if (*p == ',' || is_term(*p)) {
+		*delim = *p++;
+	} else {
+		/* only a delimiter may follow the closing quote */
+		c->error = CSVP_EPARSE;
+		return CSVP_ERROR;
+	}
+
+	*pos = p;
+
+	if (!keep)
+		return skip_field(c);
+
+	return copy_field(c, start, dst - start);
+}
+
+/*
+ * *pos points at the first non-blank character of the field. the field
+ * is terminated where it ends in buf, unless it runs up to the very end
+ * of buf, in which case there is no room for the null and it is copied.
+ * a field outside the projection is left alone
+ */
+static int read_unquoted(struct csvparse *c, struct scan_cursor *s,
+                         char **pos, char *delim, bool keep)
+{
+	char *start = *pos;
+	char *p;
+	char *last;
+
+	p = next_special(s, start);
+	if (p < s->end && *p == '"') {
+		/* quote inside an unquoted field */
+		c->error = CSVP_EPARSE;
+		return CSVP_ERROR;
+	}
+
+	if (!keep) {
+		*delim = p == s->end ? '\0' : *p;
+		*pos = p == s->end ? p : p + 1;
+		return skip_field(c);
+	}
+
+	last = p;
+	while (last > start && is_blank(last[-1]))
+		last--;
+
+	if (p == s->end) {
+		*delim = '\0';
+		*pos = p;
+		return copy_field(c, start, last - start);
+	}
+
+	*delim = *p;
+	*pos = p + 1;
+	*last = '\0';
+
+	if (csvline_add_slice(&c->csvline, start, last - start) != CSVP_OK) {
+		set_csvline_error(c);
+		return CSVP_ERROR;
+	}
+
+	return CSVP_OK;
+}
+
+/* follows libcsv in CSV_STRICT mode, including skipping empty lines */
+int csvp_parse_inplace(struct csvparse *c, char *buf, size_t len)
+{
+	struct scan_cursor s;
+	char *p = buf;
+	char *end = buf + len;
+	char delim;
+	int err;
+
+	cursor_init(&s, c->isa, buf, len);
+
+	for (;;) {
+		while (p < end && (is_blank(*p) || is_term(*p)))
+			p++;
+
+		if (p == end)
+			break;
+
+		do {
+			while (p < end && is_blank(*p))
+				p++;
+
+			if (p < end && *p == '"')
+				err = read_quoted(c, &s, &p, &delim, wanted(c));
+			else
+				err = read_unquoted(c, &s, &p, &delim, wanted(c));
+
+			if (err != CSVP_OK)
+				return CSVP_ERROR;
+
+			/* a trailing delimiter still ends an empty field */
+			if (delim == ',' && p == end) {
+				if (wanted(c))
+					err = copy_field(c, "", 0);
+				else
+					err = skip_field(c);
+
+				if (err != CSVP_OK)
+					return CSVP_ERROR;
+				delim = '\0';
+			}
+		} while (delim == ',');
+
+		send_csvline_to_parse(delim, c);
+
+		if (c->error != CSVP_ENONE)
+			return CSVP_ERROR;
+	}
+
+	return CSVP_OK;
+}
+
 const char *csvp_strerror(const struct csvparse *c)
 {
 	const char *err;
@@ -0,0 +1,226 @@
+/**
+ * @file csvscan.c
+ * @brief Block scanner for the bytes the csv tokenizer stops at
+ *
+ * Finds every comma, quote, carriage return and newline in a chunk of
+ * input CSVSCAN_BLOCK bytes at a time, using avx2 or sse4.2 when the cpu
+ * has them and a plain loop otherwise. The best implementation is picked
+ * the first time the scanner is used and never changes after; a parser
+ * that wants another one passes it to csvscan_with_isa.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include <pthread.h>
+
+#include <config.h>
+#include <predcfb/csvparse.h>
+
+#ifdef HAVE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+typedef size_t (*scan_func)(const char *buf, size_t len, uint32_t *offsets);
+
+static scan_func scan;
+static enum csvscan_isa scan_isa;
+static pthread_once_t scan_once = PTHREAD_ONCE_INIT;
+
+static const char *isa_names[] = {
+	"scalar",
+	"sse4.2",
+	"avx2"
+};
+
+static size_t scan_scalar(const char *buf, size_t len, uint32_t *offsets)
+{
+	size_t num = 0;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		switch (buf[i]) {
+		case ',':
+		case '"':
+		case '\r':
+		case '\n':
+			offsets[num++] = i;
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	return num;
+}
+
+#ifdef HAVE_X86_SIMD
+
+/* turn a block's match mask into offsets */
+static size_t add_mask(uint32_t mask, uint32_t at, uint32_t *offsets)
+{
+	size_t num = 0;
+
+	while (mask) {
+		offsets[num++] = at + __builtin_ctz(mask);
+		mask &= mask - 1;
+	}
+
+	return num;
+}
+
+/* the tail that doesn't fill a block */
+static size_t scan_tail(const char *buf, size_t len, size_t at,
+                        uint32_t *offsets)
+{
+	size_t num;
+	size_t i;
+
+	num = scan_scalar(buf + at, len - at, offsets);
+	for (i = 0; i < num; i++)
+		offsets[i] += at;
+
+	return num;
+}
+
+/*
+ * pcmpestrm compares each byte against the whole set at once; the
+ * explicit lengths keep the nulls the tokenizer writes from ending it
+ */
+#define SSE42_MODE (_SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY | _SIDD_BIT_MASK)
+
+__attribute__((target("sse4.2")))
+static size_t scan_sse42(const char *buf, size_t len, uint32_t *offsets)
+{
+	const __m128i set = _mm_setr_epi8(',', '"', '\r', '\n',
+	                                  0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+	size_t num = 0;
+	size_t at;
+
+	for (at = 0; at + CSVSCAN_BLOCK <= len; at += CSVSCAN_BLOCK) {
+		__m128i lo = _mm_loadu_si128((const __m128i *) (buf + at));
+		__m128i hi = _mm_loadu_si128((const __m128i *) (buf + at + 16));
+		uint32_t mask;
+
+		mask = (uint32_t) _mm_cvtsi128_si32(
+				_mm_cmpestrm(set, 4, lo, 16, SSE42_MODE)) & 0xffff;
+		mask |= (uint32_t) _mm_cvtsi128_si32(
+				_mm_cmpestrm(set, 4, hi, 16, SSE42_MODE)) << 16;
+
+		num += add_mask(mask, at, offsets + num);
+	}
+
+	return num + scan_tail(buf, len, at, offsets + num);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_avx2(const char *buf, size_t len, uint32_t *offsets)
+{
+	const __m256i comma = _mm256_set1_epi8(',');
+	const __m256i quote = _mm256_set1_epi8('"');
+	const __m256i cr = _mm256_set1_epi8('\r');
+	const __m256i lf = _mm256_set1_epi8('\n');
+	size_t num = 0;
+	size_t at;
+
+	for (at = 0; at + CSVSCAN_BLOCK <= len; at += CSVSCAN_BLOCK) {
+		__m256i v = _mm256_loadu_si256((const __m256i *) (buf + at));
+		__m256i m;
+
+		m = _mm256_or_si256(
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, comma),
+			                _mm256_cmpeq_epi8(v, quote)),
+			_mm256_or_si256(_mm256_cmpeq_epi8(v, cr),
+			                _mm256_cmpeq_epi8(v, lf)));
+
+		num += add_mask((uint32_t) _mm256_movemask_epi8(m), at,
+		                offsets + num);
+	}
+
+	return num + scan_tail(buf, len, at, offsets + num);
+}
+
+#endif
+
+bool csvscan_isa_supported(enum csvscan_isa isa)
+{
+	switch (isa) {
+	case CSVSCAN_SCALAR:
+		return true;
+
+#ifdef HAVE_X86_SIMD
+	case CSVSCAN_SSE42:
+		return __builtin_cpu_supports("sse4.2");
+
+	case CSVSCAN_AVX2:
+		return __builtin_cpu_supports("avx2");
+#endif
+
+	default:
+		return false;
+	}
+}
+
+static scan_func isa_func(enum csvscan_isa isa)
+{
+	switch (isa) {
+#ifdef HAVE_X86_SIMD
+	case CSVSCAN_AVX2:
+		return scan_avx2;
+
+	case CSVSCAN_SSE42:
+		return scan_sse42;
+#endif
+
+	default:
+		return scan_scalar;
+	}
+}
+
+static void pick_isa(void)
+{
+#ifdef HAVE_X86_SIMD
+	__builtin_cpu_init();
+#endif
+
+	if (csvscan_isa_supported(CSVSCAN_AVX2))
+		scan_isa = CSVSCAN_AVX2;
+	else if (csvscan_isa_supported(CSVSCAN_SSE42))
+		scan_isa = CSVSCAN_SSE42;
+	else
+		scan_isa = CSVSCAN_SCALAR;
+
+	scan = isa_func(scan_isa);
+}
+
+size_t csvscan(const char *buf, size_t len, uint32_t *offsets)
+{
+	pthread_once(&scan_once, pick_isa);
+
+	return scan(buf, len, offsets);
+}
+
+size_t csvscan_with_isa(enum csvscan_isa isa,
+                        const char *buf,
+                        size_t len,
+                        uint32_t *offsets)
+{
+	return isa_func(isa)(buf, len, offsets);
+}
+
+enum csvscan_isa csvscan_get_isa(void)
+{
+	pthread_once(&scan_once, pick_isa);
+
+	return scan_isa;
+}
+
+const char *csvscan_isa_name(enum csvscan_isa isa)
+{
+	if (isa < CSVSCAN_SCALAR || isa > CSVSCAN_AVX2)
+		return "unknown";
+
+	return isa_names[isa];
+}
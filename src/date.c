@@ -0,0 +1,161 @@
+/**
+ * @file date.c
+ * @brief Calendar arithmetic for game dates
+ *
+ * Game dates only have a day, stored as a time_t at midnight UTC. The
+ * conversions here are the days from civil and civil from days
+ * algorithms for the proleptic gregorian calendar, so parsing and
+ * formatting a date needs no libc time calls and doesn't depend on TZ.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#include <predcfb/date.h>
+
+#define SECONDS_PER_DAY (24 * 60 * 60)
+
+long date_days_from_civil(int year, int month, int day)
+{
+	long y = year - (month <= 2);
+	long era = (y >= 0 ? y : y - 399) / 400;
+	long yoe = y - era * 400;
+	long doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+	long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+	return era * 146097 + doe - 719468;
+}
+
+void date_civil_from_days(long days, int *year, int *month, int *day)
+{
+	long z = days + 719468;
+	long era = (z >= 0 ? z : z - 146096) / 146097;
+	long doe = z - era * 146097;
+	long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+	long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+	long mp = (5 * doy + 2) / 153;
+
+	*day = (int) (doy - (153 * mp + 2) / 5 + 1);
+	*month = (int) (mp < 10 ? mp + 3 : mp - 9);
+	*year = (int) (yoe + era * 400 + (*month <= 2));
+}
+
+static bool is_leap(int year)
+{
+	return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+static bool valid_date(int year, int month, int day)
+{
+	static const int days_in_month[] = {
+		31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31
+	};
+	int max;
+
+	if (month < 1 || month > 12 || day < 1)
+		return false;
+
+	max = days_in_month[month - 1];
+	if (month == 2 && is_leap(year))
+		max++;
+
+	return day <= max;
+}
+
+/* read 1 to max digits from str, stopping at end */
+static const char *read_number(const char *str, const char *end,
+                               int max, int *out)
+{
+	int n = 0;
+	int v = 0;
+
+	while (str < end && n < max && *str >= '0' && *str <= '9') {
+		v = v * 10 + (*str++ - '0');
+		n++;
+	}
+
+	if (n == 0)
+		return NULL;
+
+	*out = v;
+
+	return str;
+}
+
+static time_t to_time(int year, int month, int day)
+{
+	return (time_t) date_days_from_civil(year, month, day) * SECONDS_PER_DAY;
+}
+
+bool date_parse_mdy(const char *str, size_t len, time_t *out)
+{
+	const char *end = str + len;
+	int year, month, day;
+
+	if ((str = read_number(str, end, 2, &month)) == NULL ||
+	    str == end || *str++ != '/')
+		return false;
+
+	if ((str = read_number(str, end, 2, &day)) == NULL ||
+	    str == end || *str++ != '/')
+		return false;
+
+	if (end - str != 4 || read_number(str, end, 4, &year) != end)
+		return false;
+
+	if (!valid_date(year, month, day))
+		return false;
+
+	*out = to_time(year, month, day);
+
+	return true;
+}
+
+bool date_parse_ymd(const char *str, time_t *out)
+{
+	const char *end = str;
+	int year, month, day;
+
+	while (*end)
+		end++;
+
+	if (end - str != DATE_STR_SIZE - 1 || str[4] != '-' || str[7] != '-')
+		return false;
+
+	if (read_number(str, str + 4, 4, &year) != str + 4 ||
+	    read_number(str + 5, str + 7, 2, &month) != str + 7 ||
+	    read_number(str + 8, end, 2, &day) != end)
+		return false;
+
+	if (!valid_date(year, month, day))
+		return false;
+
+	*out = to_time(year, month, day);
+
+	return true;
+}
+
+void date_string(time_t t, char buf[DATE_STR_SIZE])
+{
+	long days = (long) (t / SECONDS_PER_DAY);
+	int year, month, day;
+
+	/* round toward the start of the day for times before 1970 */
+	if (t % SECONDS_PER_DAY < 0)
+		days--;
+
+	date_civil_from_days(days, &year, &month, &day);
+
+	buf[0] = '0' + (year / 1000) % 10;
+	buf[1] = '0' + (year / 100) % 10;
+	buf[2] = '0' + (year / 10) % 10;
+	buf[3] = '0' + year % 10;
+	buf[4] = '-';
+	buf[5] = '0' + month / 10;
+	buf[6] = '0' + month % 10;
+	buf[7] = '-';
+	buf[8] = '0' + day / 10;
+	buf[9] = '0' + day % 10;
+	buf[10] = '\0';
+}
@@ -1,18 +1,37 @@
-
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+
+#include <dirent.h>
+#include <sys/stat.h>
 
 #include <config.h>
 #include <predcfb/options.h>
 #include <predcfb/cfbstats.h>
 #include <predcfb/objectdb.h>
+#include <predcfb/snapshot.h>
 #include <predcfb/zipfile.h>
 
 static void print_help(void)
 {
 	static const char *usage =
-		"usage: predcfb [--help] [--version] <zip file>\n"
-		"\tthe zip file containing parsable data can be found at www.cfbstats.com";
+		"usage: predcfb [--help] [--version] [--save[=<file>]] "
+		"[--snapshot[=<file>]] [--load=<file>] [--jobs=<n>] "
+		"[--fast-ids] [--append=<csv file|->] [--season=<zip file>] "
+		"<zip file|directory>...\n"
+		"\tthe zip file containing parsable data can be found at www.cfbstats.com\n"
+		"\twhen given more than one archive (or a directory of them), the\n"
+		"\tarchives are parsed on <n> threads and merged into one database\n"
+		"\t--load starts from a database saved with --save or --snapshot,\n"
+		"\tin place of (or in addition to) the archives\n"
+		"\t--snapshot also writes <file>.manifest, which lets --load skip\n"
+		"\tthe files of each archive that haven't changed since\n"
+		"\t--append adds the rows of a game.csv or team-game-statistics.csv\n"
+		"\t(- for stdin) to the database, looking up their codes in the\n"
+		"\tmanifest's record of the --season archive, or in the one archive\n"
+		"\tread; it can be given more than once\n"
+		"\t--fast-ids hashes objectids with a non-cryptographic hash, for\n"
+		"\truns that don't save or load a database";
 
 	puts(usage);
 	exit(EXIT_SUCCESS);
@@ -28,8 +47,227 @@ static void print_version(void)
 	exit(EXIT_SUCCESS);
 }
 
+/* archive list functions */
+
+struct archive_list {
+	char **paths;
+	int num_paths;
+	int max_paths;
+};
+
+static int archive_list_add(struct archive_list *l, const char *path)
+{
+	char **paths;
+	int max;
+
+	if (l->num_paths == l->max_paths) {
+		max = l->max_paths ? l->max_paths * 2 : 16;
+		paths = realloc(l->paths, sizeof(*paths) * max);
+		if (!paths)
+			return -1;
+
+		l->paths = paths;
+		l->max_paths = max;
+	}
+
+	if ((l->paths[l->num_paths] = strdup(path)) == NULL)
+		return -1;
+
+	l->num_paths++;
+
+	return 0;
+}
+
+static int is_zip_name(const struct dirent *d)
+{
+	size_t len = strlen(d->d_name);
+
+	return (len > 4 && strcmp(d->d_name + len - 4, ".zip") == 0);
+}
+
+static int archive_list_add_dir(struct archive_list *l, const char *dir)
+{
+	struct dirent **entries;
+	char path[4096];
+	int num_entries;
+	int err = 0;
+	int i;
+
+	num_entries = scandir(dir, &entries, is_zip_name, alphasort);
+	if (num_entries < 0) {
+		fprintf(stderr, "%s: could not read directory '%s'\n",
+		        progname, dir);
+		return -1;
+	}
+
+	for (i = 0; i < num_entries; i++) {
+		snprintf(path, sizeof(path), "%s/%s", dir, entries[i]->d_name);
+
+		if (err == 0 && zipfile_check_format(path) == ZIPFILE_OK)
+			err = archive_list_add(l, path);
+
+		free(entries[i]);
+	}
+
+	free(entries);
+
+	return err;
+}
+
+/* expand directories given on the command line into their archives */
+static int collect_archives(struct archive_list *l)
+{
+	struct stat st;
+	int i;
+
+	for (i = 0; i < opt_num_archives; i++) {
+		if (stat(opt_archives[i], &st) == 0 && S_ISDIR(st.st_mode)) {
+			if (archive_list_add_dir(l, opt_archives[i]) != 0)
+				return -1;
+		} else if (zipfile_check_format(opt_archives[i]) == ZIPFILE_OK) {
+			if (archive_list_add(l, opt_archives[i]) != 0)
+				return -1;
+		} else {
+			fprintf(stderr, "%s: expected zip file\n", progname);
+			return -1;
+		}
+	}
+
+	if (l->num_paths == 0 && !opt_load_file) {
+		fprintf(stderr, "%s: no zip files found\n", progname);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* start from a saved database, either a binary snapshot or yaml */
+static int load_saved(objectdb_ctx *db, const char *path)
+{
+	snapshot_ctx *snap;
+	int err = 0;
+
+	if ((snap = snapshot_new()) == NULL) {
+		fprintf(stderr, "%s: out of memory\n", progname);
+		return -1;
+	}
+
+	if (snapshot_open(snap, path) != SNAPSHOT_OK) {
+		if (snapshot_get_error(snap) == SNAPSHOT_EFORMAT) {
+			if (objectdb_read(db, path) != OBJECTDB_OK) {
+				fprintf(stderr, "%s: could not load '%s': %s\n",
+				        progname, path, objectdb_strerror(db));
+				err = -1;
+			}
+		} else {
+			fprintf(stderr, "%s: could not load '%s': %s\n",
+			        progname, path, snapshot_strerror(snap));
+			err = -1;
+		}
+	} else if (snapshot_load(snap, db) != SNAPSHOT_OK) {
+		fprintf(stderr, "%s: could not load '%s': %s\n",
+		        progname, path, snapshot_strerror(snap));
+		err = -1;
+	}
+
+	snapshot_free(snap);
+
+	return err;
+}
+
+/*
+ * a snapshot keeps its manifest in <file>.manifest. a yaml database
+ * doesn't keep game statistics, so it never has one
+ */
+#define MANIFEST_SUFFIX ".manifest"
+
+static void manifest_path(char *buf, size_t size, const char *file)
+{
+	snprintf(buf, size, "%s" MANIFEST_SUFFIX, file);
+}
+
+static int start_manifest(cfbstats_ctx *cfbstats)
+{
+	struct stat st;
+	char path[4096];
+
+	if (opt_load_file) {
+		manifest_path(path, sizeof(path), opt_load_file);
+
+		if (stat(path, &st) == 0) {
+			if (cfbstats_manifest_read(cfbstats, path) == CFBSTATS_OK)
+				return 0;
+
+			fprintf(stderr, "%s: ignoring manifest '%s'\n",
+			        progname, path);
+		}
+	}
+
+	if (!opt_snapshot)
+		return 0;
+
+	return cfbstats_manifest_new(cfbstats) == CFBSTATS_OK ? 0 : -1;
+}
+
+/* apply the rows of each --append file, and say how many teams changed */
+static int append_files(cfbstats_ctx *cfbstats,
+                        objectdb_ctx *db,
+                        int num_archives)
+{
+	const char *season = opt_season;
+	const char *name;
+	FILE *inf;
+	int num_dirty;
+	int err;
+	int i;
+
+	/* without --season, the rows are from the one archive read */
+	if (!season && num_archives != 1) {
+		fprintf(stderr, "%s: --append needs --season unless exactly "
+		        "one archive is read\n", progname);
+		return -1;
+	}
+
+	/* only the teams the rows change are of interest */
+	objectdb_clear_dirty(db);
+
+	for (i = 0; i < opt_num_append_files; i++) {
+		name = opt_append_files[i];
+
+		if (strcmp(name, "-") == 0) {
+			inf = stdin;
+			name = "stdin";
+		} else if ((inf = fopen(name, "r")) == NULL) {
+			fprintf(stderr, "%s: could not open '%s' for reading\n",
+			        progname, name);
+			return -1;
+		}
+
+		/* the season's ids only have to be found once */
+		err = cfbstats_append_csv(cfbstats, i == 0 ? season : NULL,
+		                          inf, name);
+
+		if (inf != stdin)
+			fclose(inf);
+
+		if (err != CFBSTATS_OK)
+			return -1;
+	}
+
+	objectdb_get_dirty_teams(db, &num_dirty);
+	printf("%s: %d teams changed\n", progname, num_dirty);
+
+	return 0;
+}
+
 int main(int argc, char **argv)
 {
+	struct archive_list archives = { NULL, 0, 0 };
+	char path[4096];
+	objectdb_ctx *db;
+	cfbstats_ctx *cfbstats;
+	int err;
+
 	progname = argv[0];
 
 	if (options_parse(argc, argv) != 0)
@@ -41,16 +279,59 @@ int main(int argc, char **argv)
 	if (opt_version)
 		print_version();
 
-	if (zipfile_check_format(opt_archive) == ZIPFILE_OK) {
-		if (cfbstats_read_zipfile(opt_archive) != CFBSTATS_OK)
-			exit(EXIT_FAILURE);
-	} else {
-		fprintf(stderr, "%s: expected zip file\n", progname);
+	if (collect_archives(&archives) != 0)
+		exit(EXIT_FAILURE);
+
+	db = objectdb_new_ids(opt_fast_ids ? OBJECTID_FAST : OBJECTID_SHA1);
+	cfbstats = db ? cfbstats_new(db) : NULL;
+	if (!cfbstats) {
+		fprintf(stderr, "%s: out of memory\n", progname);
 		exit(EXIT_FAILURE);
 	}
 
-	if (opt_save && (objectdb_write() != OBJECTDB_OK))
+	if (opt_load_file && load_saved(db, opt_load_file) != 0)
+		exit(EXIT_FAILURE);
+
+	if (start_manifest(cfbstats) != 0) {
+		fprintf(stderr, "%s: out of memory\n", progname);
 		exit(EXIT_FAILURE);
+	}
+
+	if (archives.num_paths == 0) {
+		err = CFBSTATS_OK;
+	} else if (archives.num_paths == 1) {
+		err = cfbstats_read_zipfile(cfbstats, archives.paths[0]);
+	} else {
+		err = cfbstats_read_zipfiles(cfbstats,
+		                             (const char **) archives.paths,
+		                             archives.num_paths,
+		                             opt_jobs);
+	}
+
+	if (err != CFBSTATS_OK)
+		exit(EXIT_FAILURE);
+
+	if (cfbstats_files_skipped(cfbstats) > 0)
+		printf("%s: skipped %d unchanged files\n",
+		       progname, cfbstats_files_skipped(cfbstats));
+
+	if (opt_num_append_files > 0 &&
+	    append_files(cfbstats, db, archives.num_paths) != 0)
+		exit(EXIT_FAILURE);
+
+	if (opt_save && (objectdb_write(db, opt_save_file,
+	                                OBJECTDB_FORMAT_YAML) != OBJECTDB_OK))
+		exit(EXIT_FAILURE);
+
+	if (opt_snapshot) {
+		if (objectdb_write(db, opt_snapshot_file,
+		                   OBJECTDB_FORMAT_SNAPSHOT) != OBJECTDB_OK)
+			exit(EXIT_FAILURE);
+
+		manifest_path(path, sizeof(path), opt_snapshot_file);
+		if (cfbstats_manifest_write(cfbstats, path) != CFBSTATS_OK)
+			exit(EXIT_FAILURE);
+	}
 
 	exit(EXIT_SUCCESS);
 }
@@ -0,0 +1,127 @@
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <predcfb/predcfb.h>
+#include <predcfb/objectid.h>
+#include <predcfb/objectdb.h>
+
+#include "objectdb_internal.h"
+
+/*
+ * every allocation is rounded up to this, which is enough for any of
+ * the structures kept in the objectdb
+ */
+#define ARENA_ALIGN (sizeof(union arena_align))
+
+union arena_align {
+	long double ld;
+	long long ll;
+	void *p;
+};
+
+struct arena_page {
+	struct arena_page *next;
+	size_t size;
+	size_t used;
+	union arena_align data[];
+};
+
+static size_t align_size(size_t size)
+{
+	return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+static struct arena_page *new_page(size_t size)
+{
+	struct arena_page *page;
+
+	page = malloc(sizeof(*page) + size);
+	if (!page)
+		return NULL;
+
+	page->next = NULL;
+	page->size = size;
+	page->used = 0;
+
+	return page;
+}
+
+void arena_init(struct arena *a, size_t page_size)
+{
+	a->first = NULL;
+	a->current = NULL;
+	a->page_size = align_size(page_size);
+}
+
+/* move on to the next page that has room for size bytes */
+static struct arena_page *next_page(struct arena *a, size_t size)
+{
+	struct arena_page *page;
+	struct arena_page **link;
+
+	/* pages kept around by arena_reset are reused first */
+	link = a->current ? &a->current->next : &a->first;
+
+	while ((page = *link) != NULL) {
+		page->used = 0;
+		if (page->size >= size)
+			return page;
+
+		link = &page->next;
+	}
+
+	page = new_page(size > a->page_size ? size : a->page_size);
+	if (!page)
+		return NULL;
+
+	*link = page;
+
+	return page;
+}
+
+void *arena_alloc(struct arena *a, size_t size)
+{
+	struct arena_page *page = a->current;
+	void *mem;
+
+	size = align_size(size);
+
+	if (!page || page->size - page->used < size) {
+		if ((page = next_page(a, size)) == NULL)
+			return NULL;
+
+		a->current = page;
+	}
+
+	mem = (char*) page->data + page->used;
+	page->used += size;
+
+	/* objects are expected to start out zeroed */
+	memset(mem, 0, size);
+
+	return mem;
+}
+
+void arena_reset(struct arena *a)
+{
+	/*
+	 * the pages are kept for reuse; next_page resets each one as it
+	 * is reached again, so this doesn't depend on the number of objects
+	 */
+	a->current = NULL;
+}
+
+void arena_destroy(struct arena *a)
+{
+	struct arena_page *page, *next;
+
+	for (page = a->first; page; page = next) {
+		next = page->next;
+		free(page);
+	}
+
+	a->first = NULL;
+	a->current = NULL;
+}
@@ -0,0 +1,183 @@
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <predcfb/predcfb.h>
+#include <predcfb/objectid.h>
+#include <predcfb/objectdb.h>
+
+#include "objectdb_internal.h"
+
+/*
+ * columnar game stats
+ *
+ * every stat gets its own array of shorts with two rows per game (home
+ * then away), so a kernel that only wants points can stream through the
+ * points column instead of striding over whole games. the arrays are
+ * aligned to OBJECTDB_COLUMN_ALIGN and always sized to a multiple of
+ * OBJECTDB_COLUMN_ROWS, with unused rows kept at zero, so vector loops
+ * never need a scalar tail.
+ */
+
+/* where each column lives in struct stats */
+static const size_t column_offsets[STATS_NUM_COLUMNS] = {
+	offsetof(struct stats, rush_att),
+	offsetof(struct stats, rush_yds),
+	offsetof(struct stats, rush_tds),
+	offsetof(struct stats, pass_att),
+	offsetof(struct stats, pass_comp),
+	offsetof(struct stats, pass_yds),
+	offsetof(struct stats, pass_tds),
+	offsetof(struct stats, pass_int),
+	offsetof(struct stats, fumbles),
+	offsetof(struct stats, fumbles_lost),
+	offsetof(struct stats, points)
+};
+
+static const size_t team_column_offsets[STATS_NUM_COLUMNS] = {
+	offsetof(struct team_stats, rush_att),
+	offsetof(struct team_stats, rush_yds),
+	offsetof(struct team_stats, rush_tds),
+	offsetof(struct team_stats, pass_att),
+	offsetof(struct team_stats, pass_comp),
+	offsetof(struct team_stats, pass_yds),
+	offsetof(struct team_stats, pass_tds),
+	offsetof(struct team_stats, pass_int),
+	offsetof(struct team_stats, fumbles),
+	offsetof(struct team_stats, fumbles_lost),
+	offsetof(struct team_stats, points)
+};
+
+short objectdb_stats_get(const struct stats *s, enum stats_column col)
+{
+	short val;
+
+	memcpy(&val, (const char *) s + column_offsets[col], sizeof(val));
+
+	return val;
+}
+
+void objectdb_stats_set(struct stats *s, enum stats_column col, short val)
+{
+	memcpy((char *) s + column_offsets[col], &val, sizeof(val));
+}
+
+int32_t objectdb_team_stats_get(const struct team_stats *s,
+                                enum stats_column col)
+{
+	int32_t val;
+
+	memcpy(&val, (const char *) s + team_column_offsets[col], sizeof(val));
+
+	return val;
+}
+
+void objectdb_team_stats_set(struct team_stats *s,
+                             enum stats_column col,
+                             int32_t val)
+{
+	memcpy((char *) s + team_column_offsets[col], &val, sizeof(val));
+}
+
+static int round_rows(int rows)
+{
+	return (rows + OBJECTDB_COLUMN_ROWS - 1) & ~(OBJECTDB_COLUMN_ROWS - 1);
+}
+
+static int grow_columns(struct stats_columns *sc, int min_rows)
+{
+	short *cols[STATS_NUM_COLUMNS];
+	size_t size;
+	int max;
+	int i;
+
+	max = sc->max_rows ? sc->max_rows : OBJECTDB_LIST_SIZE * 2;
+	while (max < min_rows)
+		max *= 2;
+
+	max = round_rows(max);
+	size = max * sizeof(short);
+
+	for (i = 0; i < STATS_NUM_COLUMNS; i++) {
+		if (posix_memalign((void **) &cols[i], OBJECTDB_COLUMN_ALIGN,
+		                   size) != 0) {
+			while (i-- > 0)
+				free(cols[i]);
+			return OBJECTDB_ERROR;
+		}
+
+		/* keep the rows past num_rows zeroed */
+		memset(cols[i], 0, size);
+	}
+
+	for (i = 0; i < STATS_NUM_COLUMNS; i++) {
+		if (sc->cols[i]) {
+			memcpy(cols[i], sc->cols[i], sc->num_rows * sizeof(short));
+			free(sc->cols[i]);
+		}
+
+		sc->cols[i] = cols[i];
+	}
+
+	sc->max_rows = max;
+
+	return OBJECTDB_OK;
+}
+
+void columns_init(struct stats_columns *sc)
+{
+	memset(sc, 0, sizeof(*sc));
+}
+
+void columns_destroy(struct stats_columns *sc)
+{
+	int i;
+
+	for (i = 0; i < STATS_NUM_COLUMNS; i++)
+		free(sc->cols[i]);
+
+	columns_init(sc);
+}
+
+void columns_clear(struct stats_columns *sc)
+{
+	int i;
+
+	if (sc->num_rows == 0)
+		return;
+
+	for (i = 0; i < STATS_NUM_COLUMNS; i++)
+		memset(sc->cols[i], 0, sc->num_rows * sizeof(short));
+
+	sc->num_rows = 0;
+}
+
+void columns_set_row(struct stats_columns *sc, int row, const struct stats *s)
+{
+	const char *base = (const char *) s;
+	int i;
+
+	for (i = 0; i < STATS_NUM_COLUMNS; i++)
+		memcpy(&sc->cols[i][row], base + column_offsets[i], sizeof(short));
+}
+
+int columns_reserve(struct stats_columns *sc, int num_games)
+{
+	int rows = OBJECTDB_STATS_ROW(num_games, GAME_HOME);
+
+	if (rows > sc->max_rows)
+		return grow_columns(sc, rows);
+
+	return OBJECTDB_OK;
+}
+
+void columns_add_game(struct stats_columns *sc, const struct game *g)
+{
+	columns_set_row(sc, OBJECTDB_STATS_ROW(g->idx, GAME_HOME),
+	                &g->home_stats);
+	columns_set_row(sc, OBJECTDB_STATS_ROW(g->idx, GAME_AWAY),
+	                &g->away_stats);
+
+	sc->num_rows = OBJECTDB_STATS_ROW(g->idx, GAME_AWAY) + 1;
+}
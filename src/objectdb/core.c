@@ -1,5 +1,5 @@
-
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdint.h>
@@ -11,298 +11,859 @@
 
 #include "objectdb_internal.h"
 
-#define OBJECTDB_MAX_OBJECTS   4096
-#define OBJECTDB_MAP_SIZE      2048
-
-static struct object object_table[OBJECTDB_MAX_OBJECTS];
-static int num_objects = 0;
+/* object list functions */
 
-static struct conference conferences[CONFERENCE_NUM_MAX];
-static int num_conferences = 0;
+/* double the size of a pointer list, returns NULL if out of memory */
+static void *grow_list(void *list, int *max_items, size_t item_size)
+{
+	void *new_list;
+	int max;
 
-static struct team teams[TEAM_NUM_MAX];
-static int num_teams = 0;
+	max = *max_items ? *max_items * 2 : OBJECTDB_LIST_SIZE;
 
-static struct game games[GAME_NUM_MAX];
-static int num_games = 0;
+	new_list = realloc(list, max * item_size);
+	if (!new_list)
+		return NULL;
 
-static struct object *object_map[OBJECTDB_MAP_SIZE];
+	*max_items = max;
 
-enum objectdb_err objectdb_errno = OBJECTDB_ENONE;
+	return new_list;
+}
 
-/* object table functions */
+/* object index functions */
 
-static struct object *table_new_object(void)
+static struct object *map_lookup(objectdb_ctx *db, const struct objectid *id)
 {
-	struct object *o;
+	struct object *obj;
 
-	if (num_objects >= OBJECTDB_MAX_OBJECTS) {
-		objectdb_errno = OBJECTDB_EMAXOBJECTS;
+	if ((obj = index_lookup(&db->index, id)) == NULL) {
+		db->error = OBJECTDB_ENOTFOUND;
 		return NULL;
 	}
 
-	o = &object_table[num_objects];
-	num_objects++;
+	return obj;
+}
+
+static int map_insert(objectdb_ctx *db, struct object *obj)
+{
+	int err;
+
+	if ((err = index_insert(&db->index, obj)) != OBJECTDB_ENONE) {
+		db->error = err;
+		return OBJECTDB_ERROR;
+	}
 
-	return o;
+	return OBJECTDB_OK;
 }
 
-/* object map functions */
+/* objectdb allocation functions */
 
-static struct object **map_get_bin(const struct objectid *id)
+objectdb_ctx *objectdb_new(void)
 {
-	static const int32_t mask = OBJECTDB_MAP_SIZE - 1;
-	int32_t *bits = (int32_t*) &id->md[16];
-	int32_t bin;
+	return objectdb_new_ids(OBJECTID_SHA1);
+}
 
-	/* assert that map size is a power of two */
-	assert(!(OBJECTDB_MAP_SIZE & (OBJECTDB_MAP_SIZE - 1)));
+objectdb_ctx *objectdb_new_ids(enum objectid_kind ids)
+{
+	objectdb_ctx *db;
+
+	/* calloc leaves the database in the same state as objectdb_clear */
+	db = calloc(1, sizeof(*db));
+	if (!db)
+		return NULL;
 
-	bin = *bits & mask;
+	arena_init(&db->arena, OBJECTDB_PAGE_SIZE);
+	index_init(&db->index);
+	columns_init(&db->columns);
+	strings_init(&db->strings);
+	db->ids = ids;
+	db->error = OBJECTDB_ENONE;
 
-	return (object_map + bin);
+	return db;
 }
 
-static struct object *map_lookup(const struct objectid *id)
+void objectdb_free(objectdb_ctx *db)
 {
-	struct object **bin;
-	struct object *obj;
+	arena_destroy(&db->arena);
+	index_destroy(&db->index);
+	columns_destroy(&db->columns);
+	strings_destroy(&db->strings);
+
+	free(db->objects);
+	free(db->conferences);
+	free(db->teams);
+	free(db->team_dirty);
+	free(db->dirty_teams);
+	free(db->games);
+
+	free(db);
+}
 
-	bin = map_get_bin(id);
+enum objectid_kind objectdb_get_ids(const objectdb_ctx *db)
+{
+	return db->ids;
+}
 
-	if (*bin == NULL) {
-		objectdb_errno = OBJECTDB_ENOTFOUND;
-		return NULL;
-	}
+enum objectdb_err objectdb_get_error(const objectdb_ctx *db)
+{
+	return db->error;
+}
 
-	obj = *bin;
+const char *objectdb_strerror(const objectdb_ctx *db)
+{
+	static const char *objectdb_errors[] = {
+		"No error",
+		"Out of memory",
+		"Object not found",
+		"Object has the wrong type",
+		"Duplicate object",
+		"Could not read file",
+		"Invalid file",
+		"Saved object does not match",
+		"Database does not have sha1 objectids",
+		"Name is too long"
+	};
+
+	return objectdb_errors[db->error];
+}
 
-	while (obj) {
-		if (objectid_compare(id, &obj->id) == true)
-			return obj;
+int objectdb_reserve(objectdb_ctx *db, int num_objects)
+{
+	struct object **objects;
+	int total = db->num_objects + num_objects;
 
-		obj = obj->next;
+	if (index_reserve(&db->index, total) != OBJECTDB_OK) {
+		db->error = OBJECTDB_ENOMEM;
+		return OBJECTDB_ERROR;
 	}
 
-	objectdb_errno = OBJECTDB_ENOTFOUND;
+	if (total > db->max_objects) {
+		objects = realloc(db->objects, total * sizeof(*objects));
+		if (!objects) {
+			db->error = OBJECTDB_ENOMEM;
+			return OBJECTDB_ERROR;
+		}
+
+		db->objects = objects;
+		db->max_objects = total;
+	}
 
-	return NULL;
+	return OBJECTDB_OK;
 }
 
-static int map_insert(struct object *obj)
+/* objectdb name functions */
+
+int objectdb_intern(objectdb_ctx *db,
+                    const char *str,
+                    size_t len,
+                    struct name *n)
 {
-	struct object **bin;
-	struct object *cur;
-	struct object *prev;
+	return objectdb_intern_sha1(db, str, len, NULL, n);
+}
 
-	bin = map_get_bin(&obj->id);
+int objectdb_intern_sha1(objectdb_ctx *db,
+                         const char *str,
+                         size_t len,
+                         const struct objectid *sha1,
+                         struct name *n)
+{
+	int err;
 
-	if (*bin == NULL) {
-		/* insert this object at the top of the bin */
-		*bin = obj;
-	} else {
-		/* otherwise, insert at the end of the list */
-		cur = *bin;
-		prev = NULL;
-		while (cur) {
-			if (objectid_compare(&obj->id, &cur->id) == true) {
-				objectdb_errno = OBJECTDB_EDUPLICATE;
-				return OBJECTDB_ERROR;
-			}
+	err = strings_intern(&db->strings, &db->arena, str, len, sha1, n);
+	if (err != OBJECTDB_ENONE) {
+		db->error = err;
+		return OBJECTDB_ERROR;
+	}
 
-			prev = cur;
-			cur = cur->next;
-		}
+	return OBJECTDB_OK;
+}
 
-		assert(prev != NULL);
-		prev->next = obj;
+const char *objectdb_name(objectdb_ctx *db, uint32_t ref)
+{
+	const struct pooled_name *pn;
+
+	if ((pn = strings_lookup(&db->strings, ref)) == NULL) {
+		db->error = OBJECTDB_ENOTFOUND;
+		return NULL;
 	}
 
-	obj->next = NULL;
+	return pn->str;
+}
+
+int objectdb_num_names(const objectdb_ctx *db)
+{
+	return db->strings.num_names;
+}
 
-	return OBJECTDB_OK;
+/* a copy of an object from another database needs its own name */
+static int reintern(objectdb_ctx *db, struct name *n)
+{
+	size_t len = n->ref ? strings_pooled(n)->len : strlen(n->str);
+
+	return objectdb_intern(db, n->str, len, n);
 }
 
 /* objectdb create functions */
 
-struct conference *objectdb_create_conference(void)
+struct conference *objectdb_create_conference(objectdb_ctx *db)
 {
 	struct conference *conf;
 
-	if (num_conferences >= CONFERENCE_NUM_MAX) {
-		objectdb_errno = OBJECTDB_EMAXCONFS;
+	if ((conf = arena_alloc(&db->arena, sizeof(*conf))) == NULL) {
+		db->error = OBJECTDB_ENOMEM;
 		return NULL;
 	}
 
-	conf = &conferences[num_conferences];
-	num_conferences++;
-
 	return conf;
 }
 
-struct team *objectdb_create_team(void)
+struct team *objectdb_create_team(objectdb_ctx *db)
 {
 	struct team *team;
 
-	if (num_teams >= TEAM_NUM_MAX) {
-		objectdb_errno = OBJECTDB_EMAXTEAMS;
+	if ((team = arena_alloc(&db->arena, sizeof(*team))) == NULL) {
+		db->error = OBJECTDB_ENOMEM;
 		return NULL;
 	}
 
-	team = &teams[num_teams];
-	num_teams++;
-
 	return team;
 }
 
-struct game *objectdb_create_game(void)
+struct game *objectdb_create_game(objectdb_ctx *db)
 {
 	struct game *game;
 
-	if (num_games >= GAME_NUM_MAX) {
-		objectdb_errno = OBJECTDB_EMAXGAMES;
+	if ((game = arena_alloc(&db->arena, sizeof(*game))) == NULL) {
+		db->error = OBJECTDB_ENOMEM;
 		return NULL;
 	}
 
-	game = &games[num_games];
-	num_games++;
-
 	return game;
 }
 
 /* objectdb add functions */
 
-int objectdb_add_conference(struct conference *c, struct objectid *id)
+static void conference_id(const objectdb_ctx *db,
+                          const struct conference *c,
+                          struct objectid *id)
 {
+	if (db->ids == OBJECTID_FAST)
+		objectid_fast_from_conference(c, id);
+	else
+		objectid_from_conference(c, id);
+}
+
+static void team_id(const objectdb_ctx *db,
+                    const struct team *t,
+                    struct objectid *id)
+{
+	if (db->ids == OBJECTID_FAST)
+		objectid_fast_from_team(t, id);
+	else
+		objectid_from_team(t, id);
+}
+
+static void game_id(const objectdb_ctx *db,
+                    const struct game *g,
+                    struct objectid *id)
+{
+	if (db->ids == OBJECTID_FAST)
+		objectid_fast_from_game(g, id);
+	else
+		objectid_from_game(g, id);
+}
+
+/*
+ * index a new object and append it to the object list, nothing is
+ * appended if the objectid is already taken
+ */
+static struct object *insert_object(objectdb_ctx *db,
+                                    const struct objectid *id,
+                                    enum object_type type)
+{
+	struct object **objects;
 	struct object *obj;
 
-	if ((obj = table_new_object()) == NULL)
-		return OBJECTDB_ERROR;
+	if (db->num_objects >= db->max_objects) {
+		objects = grow_list(db->objects, &db->max_objects,
+		                    sizeof(*objects));
+		if (!objects) {
+			db->error = OBJECTDB_ENOMEM;
+			return NULL;
+		}
 
-	objectid_from_conference(c, id);
+		db->objects = objects;
+	}
+
+	if ((obj = arena_alloc(&db->arena, sizeof(*obj))) == NULL) {
+		db->error = OBJECTDB_ENOMEM;
+		return NULL;
+	}
 
 	obj->id = *id;
-	obj->type = OBJECTDB_CONF;
+	obj->type = type;
+
+	if (map_insert(db, obj) != OBJECTDB_OK)
+		return NULL;
+
+	db->objects[db->num_objects] = obj;
+	db->num_objects++;
+
+	return obj;
+}
+
+int objectdb_add_conference(objectdb_ctx *db,
+                            struct conference *c,
+                            struct objectid *id)
+{
+	conference_id(db, c, id);
+
+	return objectdb_insert_conference(db, c, id);
+}
+
+int objectdb_insert_conference(objectdb_ctx *db,
+                               struct conference *c,
+                               const struct objectid *id)
+{
+	struct conference **conferences;
+	struct object *obj;
+
+	if (db->num_conferences >= db->max_conferences) {
+		conferences = grow_list(db->conferences, &db->max_conferences,
+		                        sizeof(*conferences));
+		if (!conferences) {
+			db->error = OBJECTDB_ENOMEM;
+			return OBJECTDB_ERROR;
+		}
+
+		db->conferences = conferences;
+	}
+
+	if ((obj = insert_object(db, id, OBJECTDB_CONF)) == NULL)
+		return OBJECTDB_ERROR;
+
 	obj->data.conf = c;
 
-	if (map_insert(obj) != OBJECTDB_OK)
+	c->idx = db->num_conferences;
+	db->conferences[db->num_conferences] = c;
+	db->num_conferences++;
+
+	return OBJECTDB_OK;
+}
+
+/*
+ * the dirty flags and list are sized with the team list, so that marking
+ * a team never has to allocate
+ */
+static int grow_dirty(objectdb_ctx *db, int max_teams)
+{
+	unsigned char *flags;
+	struct team **teams;
+
+	if ((flags = realloc(db->team_dirty, max_teams)) == NULL)
+		return OBJECTDB_ERROR;
+
+	db->team_dirty = flags;
+
+	teams = realloc(db->dirty_teams, max_teams * sizeof(*teams));
+	if (!teams)
 		return OBJECTDB_ERROR;
 
+	db->dirty_teams = teams;
+
 	return OBJECTDB_OK;
 }
 
-int objectdb_add_team(struct team *t, struct objectid *id)
+static void mark_dirty(objectdb_ctx *db, struct team *t)
+{
+	/* only teams in this database are tracked */
+	if (!t || t->idx >= (uint32_t) db->num_teams || db->teams[t->idx] != t)
+		return;
+
+	if (db->team_dirty[t->idx])
+		return;
+
+	db->team_dirty[t->idx] = 1;
+	db->dirty_teams[db->num_dirty++] = t;
+}
+
+int objectdb_add_team(objectdb_ctx *db, struct team *t, struct objectid *id)
 {
+	team_id(db, t, id);
+
+	return objectdb_insert_team(db, t, id);
+}
+
+int objectdb_insert_team(objectdb_ctx *db,
+                         struct team *t,
+                         const struct objectid *id)
+{
+	struct team **teams;
 	struct object *obj;
+	int max;
+
+	if (db->num_teams >= db->max_teams) {
+		max = db->max_teams;
+		teams = grow_list(db->teams, &max, sizeof(*teams));
+		if (!teams) {
+			db->error = OBJECTDB_ENOMEM;
+			return OBJECTDB_ERROR;
+		}
 
-	if ((obj = table_new_object()) == NULL)
-		return OBJECTDB_ERROR;
+		db->teams = teams;
 
-	objectid_from_team(t, id);
+		if (grow_dirty(db, max) != OBJECTDB_OK) {
+			db->error = OBJECTDB_ENOMEM;
+			return OBJECTDB_ERROR;
+		}
 
-	obj->id = *id;
-	obj->type = OBJECTDB_TEAM;
-	obj->data.team = t;
+		db->max_teams = max;
+	}
 
-	if (map_insert(obj) != OBJECTDB_OK)
+	if ((obj = insert_object(db, id, OBJECTDB_TEAM)) == NULL)
 		return OBJECTDB_ERROR;
 
+	obj->data.team = t;
+
+	t->idx = db->num_teams;
+	db->teams[db->num_teams] = t;
+	db->team_dirty[db->num_teams] = 0;
+	db->num_teams++;
+
 	return OBJECTDB_OK;
 }
 
-int objectdb_add_game(struct game *g, struct objectid *id)
+int objectdb_insert_game(objectdb_ctx *db,
+                         struct game *g,
+                         const struct objectid *id)
 {
+	struct game **games;
 	struct object *obj;
 
-	if ((obj = table_new_object()) == NULL)
+	if (db->num_games >= db->max_games) {
+		games = grow_list(db->games, &db->max_games, sizeof(*games));
+		if (!games) {
+			db->error = OBJECTDB_ENOMEM;
+			return OBJECTDB_ERROR;
+		}
+
+		db->games = games;
+	}
+
+	if (columns_reserve(&db->columns, db->num_games + 1) != OBJECTDB_OK) {
+		db->error = OBJECTDB_ENOMEM;
 		return OBJECTDB_ERROR;
+	}
 
-	objectid_from_game(g, id);
+	if ((obj = insert_object(db, id, OBJECTDB_GAME)) == NULL)
+		return OBJECTDB_ERROR;
 
-	obj->id = *id;
-	obj->type = OBJECTDB_GAME;
 	obj->data.game = g;
 
-	if (map_insert(obj) != OBJECTDB_OK)
-		return OBJECTDB_ERROR;
+	g->idx = db->num_games;
+	columns_add_game(&db->columns, g);
+
+	db->games[db->num_games] = g;
+	db->num_games++;
+
+	mark_dirty(db, g->home);
+	mark_dirty(db, g->away);
+
+	return OBJECTDB_OK;
+}
+
+int objectdb_add_game(objectdb_ctx *db, struct game *g, struct objectid *id)
+{
+	game_id(db, g, id);
+
+	return objectdb_insert_game(db, g, id);
+}
+
+static void games_ids(const objectdb_ctx *db,
+                      struct game * const *games,
+                      int num,
+                      struct objectid *ids)
+{
+	int i;
+
+	if (db->ids == OBJECTID_SHA1) {
+		objectid_from_games((const struct game * const *) games,
+		                    num, ids);
+	} else {
+		for (i = 0; i < num; i++)
+			game_id(db, games[i], &ids[i]);
+	}
+}
+
+int objectdb_add_games(objectdb_ctx *db,
+                       struct game * const *games,
+                       int num,
+                       struct objectid *ids)
+{
+	int i;
+
+	games_ids(db, games, num, ids);
+
+	for (i = 0; i < num; i++) {
+		if (objectdb_insert_game(db, games[i], &ids[i]) != OBJECTDB_OK)
+			return OBJECTDB_ERROR;
+	}
+
+	return OBJECTDB_OK;
+}
+
+int objectdb_add_or_get_games(objectdb_ctx *db,
+                              struct game **games,
+                              int num,
+                              struct objectid *ids)
+{
+	struct object *obj;
+	int i;
+
+	games_ids(db, games, num, ids);
+
+	for (i = 0; i < num; i++) {
+		if ((obj = index_lookup(&db->index, &ids[i])) != NULL) {
+			if (obj->type != OBJECTDB_GAME) {
+				db->error = OBJECTDB_EWRONGTYPE;
+				return OBJECTDB_ERROR;
+			}
+
+			games[i] = obj->data.game;
+			continue;
+		}
+
+		if (objectdb_insert_game(db, games[i], &ids[i]) != OBJECTDB_OK)
+			return OBJECTDB_ERROR;
+	}
 
 	return OBJECTDB_OK;
 }
 
 /* objectdb get functions */
 
-struct conference *objectdb_get_conference(const struct objectid *id)
+struct conference *objectdb_get_conference(objectdb_ctx *db,
+                                           const struct objectid *id)
 {
 	struct object *obj;
 
-	if ((obj = map_lookup(id)) == NULL)
+	if ((obj = map_lookup(db, id)) == NULL)
 		return NULL;
 
 	if (obj->type != OBJECTDB_CONF) {
-		objectdb_errno = OBJECTDB_EWRONGTYPE;
+		db->error = OBJECTDB_EWRONGTYPE;
 		return NULL;
 	}
 
 	return obj->data.conf;
 }
 
-struct team *objectdb_get_team(const struct objectid *id)
+struct team *objectdb_get_team(objectdb_ctx *db, const struct objectid *id)
 {
 	struct object *obj;
 
-	if ((obj = map_lookup(id)) == NULL)
+	if ((obj = map_lookup(db, id)) == NULL)
 		return NULL;
 
 	if (obj->type != OBJECTDB_TEAM) {
-		objectdb_errno = OBJECTDB_EWRONGTYPE;
+		db->error = OBJECTDB_EWRONGTYPE;
 		return NULL;
 	}
 
 	return obj->data.team;
 }
 
-struct game *objectdb_get_game(const struct objectid *id)
+struct game *objectdb_get_game(objectdb_ctx *db, const struct objectid *id)
 {
 	struct object *obj;
 
-	if ((obj = map_lookup(id)) == NULL)
+	if ((obj = map_lookup(db, id)) == NULL)
 		return NULL;
 
 	if (obj->type != OBJECTDB_GAME) {
-		objectdb_errno = OBJECTDB_EWRONGTYPE;
+		db->error = OBJECTDB_EWRONGTYPE;
 		return NULL;
 	}
 
 	return obj->data.game;
 }
 
+/* objectdb get by index functions */
+
+struct conference *objectdb_get_conference_at(objectdb_ctx *db, uint32_t idx)
+{
+	if (idx >= (uint32_t) db->num_conferences) {
+		db->error = OBJECTDB_ENOTFOUND;
+		return NULL;
+	}
+
+	return db->conferences[idx];
+}
+
+struct team *objectdb_get_team_at(objectdb_ctx *db, uint32_t idx)
+{
+	if (idx >= (uint32_t) db->num_teams) {
+		db->error = OBJECTDB_ENOTFOUND;
+		return NULL;
+	}
+
+	return db->teams[idx];
+}
+
+struct game *objectdb_get_game_at(objectdb_ctx *db, uint32_t idx)
+{
+	if (idx >= (uint32_t) db->num_games) {
+		db->error = OBJECTDB_ENOTFOUND;
+		return NULL;
+	}
+
+	return db->games[idx];
+}
+
+int objectdb_num_conferences(const objectdb_ctx *db)
+{
+	return db->num_conferences;
+}
+
+int objectdb_num_teams(const objectdb_ctx *db)
+{
+	return db->num_teams;
+}
+
+int objectdb_num_games(const objectdb_ctx *db)
+{
+	return db->num_games;
+}
+
+/* objectdb stats column functions */
+
+void objectdb_set_game_stats(objectdb_ctx *db,
+                             struct game *g,
+                             enum game_side side,
+                             const struct stats *s)
+{
+	if (side == GAME_HOME)
+		g->home_stats = *s;
+	else
+		g->away_stats = *s;
+
+	columns_set_row(&db->columns, OBJECTDB_STATS_ROW(g->idx, side), s);
+
+	mark_dirty(db, g->home);
+	mark_dirty(db, g->away);
+}
+
+const short *objectdb_get_stats_column(const objectdb_ctx *db,
+                                       enum stats_column col,
+                                       int *num_rows)
+{
+	*num_rows = db->columns.num_rows;
+	return db->columns.cols[col];
+}
+
+/* objectdb dirty team functions */
+
+struct team **objectdb_get_dirty_teams(objectdb_ctx *db, int *num_teams)
+{
+	*num_teams = db->num_dirty;
+	return db->dirty_teams;
+}
+
+bool objectdb_team_is_dirty(const objectdb_ctx *db, const struct team *t)
+{
+	if (t->idx >= (uint32_t) db->num_teams || db->teams[t->idx] != t)
+		return false;
+
+	return db->team_dirty[t->idx] != 0;
+}
+
+void objectdb_clear_dirty(objectdb_ctx *db)
+{
+	int i;
+
+	for (i = 0; i < db->num_dirty; i++)
+		db->team_dirty[db->dirty_teams[i]->idx] = 0;
+
+	db->num_dirty = 0;
+}
+
 /* objectdb get list */
-struct game *objectdb_get_games(int *_num_games)
+struct game **objectdb_get_games(objectdb_ctx *db, int *num_games)
 {
-	*_num_games = num_games;
-	return games;
+	*num_games = db->num_games;
+	return db->games;
 }
 
-/* objectdb misc functions */
+/* objectdb merge functions */
+
+static void merge_stats(struct team_stats *total, const struct team_stats *s)
+{
+	total->rush_att += s->rush_att;
+	total->rush_yds += s->rush_yds;
+	total->rush_tds += s->rush_tds;
+
+	total->pass_att += s->pass_att;
+	total->pass_comp += s->pass_comp;
+	total->pass_yds += s->pass_yds;
+	total->pass_tds += s->pass_tds;
+	total->pass_int += s->pass_int;
+
+	total->fumbles += s->fumbles;
+	total->fumbles_lost += s->fumbles_lost;
+
+	total->points += s->points;
+}
+
+static int merge_conference(objectdb_ctx *dst, const struct object *o)
+{
+	struct conference *conf;
+	struct objectid id;
+
+	/* the same conference shows up in every season */
+	if (map_lookup(dst, &o->id) != NULL)
+		return OBJECTDB_OK;
+
+	if ((conf = objectdb_create_conference(dst)) == NULL)
+		return OBJECTDB_ERROR;
+
+	*conf = *o->data.conf;
+
+	if (reintern(dst, &conf->name) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
+
+	return objectdb_add_conference(dst, conf, &id);
+}
+
+static int merge_team(objectdb_ctx *dst, const struct object *o)
+{
+	struct team *team;
+	struct objectid id;
+
+	if ((team = objectdb_get_team(dst, &o->id)) != NULL) {
+		merge_stats(&team->stats, &o->data.team->stats);
+		mark_dirty(dst, team);
+		return OBJECTDB_OK;
+	}
+
+	if ((team = objectdb_create_team(dst)) == NULL)
+		return OBJECTDB_ERROR;
+
+	*team = *o->data.team;
+
+	if (reintern(dst, &team->name) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
+
+	/* conferences are merged first, so this has to succeed */
+	team->conf = objectdb_get_conference(dst, &team->conf_oid);
+	if (!team->conf)
+		return OBJECTDB_ERROR;
+
+	return objectdb_add_team(dst, team, &id);
+}
 
-void objectdb_clear(void)
+static int merge_game(objectdb_ctx *dst, const struct object *o)
 {
-	memset(object_table, 0, sizeof(object_table));
-	num_objects = 0;
+	struct game *game;
+	struct objectid id;
+
+	if ((game = objectdb_create_game(dst)) == NULL)
+		return OBJECTDB_ERROR;
+
+	*game = *o->data.game;
+
+	game->home = objectdb_get_team(dst, &game->home_oid);
+	game->away = objectdb_get_team(dst, &game->away_oid);
+	if (!game->home || !game->away)
+		return OBJECTDB_ERROR;
+
+	return objectdb_add_game(dst, game, &id);
+}
+
+int objectdb_merge(objectdb_ctx *dst, objectdb_ctx *src)
+{
+	const struct object *o;
+	int err = OBJECTDB_OK;
+	int i;
+
+	/* src's ids are looked up in dst as they are */
+	if (src->ids != dst->ids) {
+		dst->error = OBJECTDB_EIDS;
+		return OBJECTDB_ERROR;
+	}
+
+	if (objectdb_reserve(dst, src->num_objects) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
 
-	memset(conferences, 0, sizeof(conferences));
-	num_conferences = 0;
+	/*
+	 * objects are stored in the order they were added, so every
+	 * conference is merged before the teams that point at it, and
+	 * every team before the games that point at it
+	 */
+	for (i = 0; i < src->num_objects; i++) {
+		o = src->objects[i];
+
+		switch (o->type) {
+		case OBJECTDB_CONF:
+			err = merge_conference(dst, o);
+			break;
+
+		case OBJECTDB_TEAM:
+			err = merge_team(dst, o);
+			break;
+
+		case OBJECTDB_GAME:
+			err = merge_game(dst, o);
+			break;
+
+		case OBJECTDB_BLOB:
+			/* do nothing for now */
+			break;
+		}
 
-	memset(teams, 0, sizeof(teams));
-	num_teams = 0;
+		if (err != OBJECTDB_OK)
+			return OBJECTDB_ERROR;
+	}
 
-	memset(games, 0, sizeof(games));
-	num_games = 0;
+	return OBJECTDB_OK;
+}
+
+/* objectdb misc functions */
+
+void objectdb_clear(objectdb_ctx *db)
+{
+	/* the lists keep their memory, only the objects are released */
+	arena_reset(&db->arena);
 
-	memset(object_map, 0, sizeof(object_map));
+	db->num_objects = 0;
+	db->num_conferences = 0;
+	db->num_teams = 0;
+	db->num_games = 0;
+	db->num_dirty = 0;
+
+	index_clear(&db->index);
+	columns_clear(&db->columns);
+	strings_clear(&db->strings);
+
+	db->error = OBJECTDB_ENONE;
 }
 
-int objectdb_write(void)
+int objectdb_write(objectdb_ctx *db,
+                   const char *path,
+                   enum objectdb_format format)
 {
-	return objectdb_write_yaml(object_table, num_objects);
+	/* only sha1 ids mean anything outside of this process */
+	if (db->ids != OBJECTID_SHA1) {
+		db->error = OBJECTDB_EIDS;
+		return OBJECTDB_ERROR;
+	}
+
+	switch (format) {
+	case OBJECTDB_FORMAT_SNAPSHOT:
+		return objectdb_write_snapshot(db, path);
+
+	case OBJECTDB_FORMAT_YAML:
+		break;
+	}
+
+	return objectdb_write_yaml(db->objects, db->num_objects, path);
 }
@@ -0,0 +1,723 @@
+/**
+ * @file hash.c
+ * @brief The hashes behind objectids
+ *
+ * sha1 is done by polarssl or, when the cpu has the sha extensions, by
+ * sha-ni; the implementation is picked the first time an id is hashed.
+ * a hash loads the implementation once, when it starts, so one that is
+ * selected while other threads are hashing only affects later hashes.
+ * without sha-ni, batches of ids are hashed eight messages at a time,
+ * one per vector lane. the fast ids use murmurhash3 (x64, 128 bit),
+ * which is several times quicker than either but only fit for ids that
+ * never leave memory.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <pthread.h>
+
+#include <config.h>
+#include <polarssl/sha1.h>
+#include <predcfb/objectdb.h>
+#include <predcfb/objectid.h>
+
+#include "objectdb_internal.h"
+#include "hash_impl.h"
+
+#ifdef HAVE_X86_SHA
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+/* messages hashed at once by hash_sha1_batch */
+#define MB_LANES 8
+
+typedef void (*mb_func)(uint32_t state[5][MB_LANES],
+                        const uint32_t words[16][MB_LANES]);
+
+struct sha1_impl {
+	void (*update)(sha1_context *ctx, const unsigned char *input,
+	               size_t len);
+	void (*finish)(sha1_context *ctx, unsigned char md[20]);
+};
+
+/* only accessed with load_impl and store_impl */
+static const struct sha1_impl *impl_in_use;
+static enum objectid_sha1_impl sha1_impl;
+static mb_func batch_process;
+static enum objectid_batch_impl batch_impl;
+static pthread_once_t sha1_once = PTHREAD_ONCE_INIT;
+
+#define load_impl(var) __atomic_load_n(&(var), __ATOMIC_ACQUIRE)
+#define store_impl(var, val) __atomic_store_n(&(var), (val), __ATOMIC_RELEASE)
+
+static const char *impl_names[] = {
+	"polarssl",
+	"sha-ni"
+};
+
+static const char *batch_names[] = {
+	"serial",
+	"multi-buffer",
+	"multi-buffer avx2"
+};
+
+static void mb_process_default(uint32_t state[5][MB_LANES],
+                               const uint32_t words[16][MB_LANES]);
+#ifdef HAVE_X86_SIMD
+static void mb_process_avx2(uint32_t state[5][MB_LANES],
+                            const uint32_t words[16][MB_LANES]);
+#endif
+
+static const struct sha1_impl polarssl_impl = {
+	sha1_update,
+	sha1_finish
+};
+
+static void put_be32(unsigned char *out, uint32_t v)
+{
+	out[0] = (unsigned char) (v >> 24);
+	out[1] = (unsigned char) (v >> 16);
+	out[2] = (unsigned char) (v >> 8);
+	out[3] = (unsigned char) v;
+}
+
+#ifdef HAVE_X86_SHA
+
+/* the message words are big endian */
+#define SHANI_BSWAP _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL)
+
+/*
+ * every four rounds after the first sixteen look the same, only which
+ * message and e registers they use rotates
+ */
+#define SHANI_ROUNDS(i) do { \
+	e[(i) & 1] = _mm_sha1nexte_epu32(e[(i) & 1], msg[(i) & 3]); \
+	e[~(i) & 1] = abcd; \
+	msg[((i) + 1) & 3] = _mm_sha1msg2_epu32(msg[((i) + 1) & 3], \
+	                                        msg[(i) & 3]); \
+	abcd = _mm_sha1rnds4_epu32(abcd, e[(i) & 1], (i) / 5); \
+	msg[((i) + 3) & 3] = _mm_sha1msg1_epu32(msg[((i) + 3) & 3], \
+	                                        msg[(i) & 3]); \
+	msg[((i) + 2) & 3] = _mm_xor_si128(msg[((i) + 2) & 3], \
+	                                   msg[(i) & 3]); \
+} while (0)
+
+__attribute__((target("sha,sse4.1")))
+static void shani_process(uint32_t state[5], const unsigned char *data,
+                          size_t blocks)
+{
+	__m128i abcd, abcd_save, e_save;
+	__m128i e[2], msg[4];
+
+	abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *) state), 0x1b);
+	e[0] = _mm_set_epi32((int) state[4], 0, 0, 0);
+
+	for (; blocks > 0; blocks--, data += 64) {
+		abcd_save = abcd;
+		e_save = e[0];
+
+		msg[0] = _mm_shuffle_epi8(
+				_mm_loadu_si128((const __m128i *) data), SHANI_BSWAP);
+		e[0] = _mm_add_epi32(e[0], msg[0]);
+		e[1] = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e[0], 0);
+
+		msg[1] = _mm_shuffle_epi8(
+				_mm_loadu_si128((const __m128i *) (data + 16)),
+				SHANI_BSWAP);
+		e[1] = _mm_sha1nexte_epu32(e[1], msg[1]);
+		e[0] = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e[1], 0);
+		msg[0] = _mm_sha1msg1_epu32(msg[0], msg[1]);
+
+		msg[2] = _mm_shuffle_epi8(
+				_mm_loadu_si128((const __m128i *) (data + 32)),
+				SHANI_BSWAP);
+		e[0] = _mm_sha1nexte_epu32(e[0], msg[2]);
+		e[1] = abcd;
+		abcd = _mm_sha1rnds4_epu32(abcd, e[0], 0);
+		msg[1] = _mm_sha1msg1_epu32(msg[1], msg[2]);
+		msg[0] = _mm_xor_si128(msg[0], msg[2]);
+
+		msg[3] = _mm_shuffle_epi8(
+				_mm_loadu_si128((const __m128i *) (data + 48)),
+				SHANI_BSWAP);
+
+		SHANI_ROUNDS(3);
+		SHANI_ROUNDS(4);
+		SHANI_ROUNDS(5);
+		SHANI_ROUNDS(6);
+		SHANI_ROUNDS(7);
+		SHANI_ROUNDS(8);
+		SHANI_ROUNDS(9);
+		SHANI_ROUNDS(10);
+		SHANI_ROUNDS(11);
+		SHANI_ROUNDS(12);
+		SHANI_ROUNDS(13);
+		SHANI_ROUNDS(14);
+		SHANI_ROUNDS(15);
+		SHANI_ROUNDS(16);
+		SHANI_ROUNDS(17);
+		SHANI_ROUNDS(18);
+		SHANI_ROUNDS(19);
+
+		e[0] = _mm_sha1nexte_epu32(e[0], e_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+	}
+
+	_mm_storeu_si128((__m128i *) state, _mm_shuffle_epi32(abcd, 0x1b));
+	state[4] = (uint32_t) _mm_extract_epi32(e[0], 3);
+}
+
+/* the same buffering as polarssl, over the same context */
+static void shani_update(sha1_context *ctx, const unsigned char *input,
+                         size_t len)
+{
+	size_t left, fill;
+
+	if (len == 0)
+		return;
+
+	left = ctx->total[0] & 0x3f;
+	fill = 64 - left;
+
+	ctx->total[0] += (uint32_t) len;
+	if (ctx->total[0] < (uint32_t) len)
+		ctx->total[1]++;
+
+	if (left && len >= fill) {
+		memcpy(ctx->buffer + left, input, fill);
+		shani_process(ctx->state, ctx->buffer, 1);
+		input += fill;
+		len -= fill;
+		left = 0;
+	}
+
+	if (len >= 64) {
+		shani_process(ctx->state, input, len / 64);
+		input += len & ~(size_t) 0x3f;
+		len &= 0x3f;
+	}
+
+	if (len > 0)
+		memcpy(ctx->buffer + left, input, len);
+}
+
+static void shani_finish(sha1_context *ctx, unsigned char md[20])
+{
+	static const unsigned char padding[64] = { 0x80 };
+	unsigned char bits[8];
+	uint32_t last;
+	int i;
+
+	put_be32(bits, (ctx->total[0] >> 29) | (ctx->total[1] << 3));
+	put_be32(bits + 4, ctx->total[0] << 3);
+
+	last = ctx->total[0] & 0x3f;
+	shani_update(ctx, padding, last < 56 ? 56 - last : 120 - last);
+	shani_update(ctx, bits, sizeof(bits));
+
+	for (i = 0; i < 5; i++)
+		put_be32(md + i * 4, ctx->state[i]);
+}
+
+static const struct sha1_impl shani_impl = {
+	shani_update,
+	shani_finish
+};
+
+static bool cpu_has_sha(void)
+{
+	unsigned int a, b, c, d;
+
+	if (!__get_cpuid_count(7, 0, &a, &b, &c, &d))
+		return false;
+
+	return (b & bit_SHA) != 0;
+}
+
+#endif
+
+static bool impl_supported(enum objectid_sha1_impl impl)
+{
+	switch (impl) {
+	case OBJECTID_SHA1_POLARSSL:
+		return true;
+
+#ifdef HAVE_X86_SHA
+	case OBJECTID_SHA1_SHANI:
+		return cpu_has_sha();
+#endif
+
+	default:
+		return false;
+	}
+}
+
+static void use_impl(enum objectid_sha1_impl impl)
+{
+	switch (impl) {
+#ifdef HAVE_X86_SHA
+	case OBJECTID_SHA1_SHANI:
+		store_impl(impl_in_use, &shani_impl);
+		break;
+#endif
+
+	default:
+		impl = OBJECTID_SHA1_POLARSSL;
+		store_impl(impl_in_use, &polarssl_impl);
+		break;
+	}
+
+	store_impl(sha1_impl, impl);
+}
+
+static bool batch_supported(enum objectid_batch_impl impl)
+{
+	switch (impl) {
+	case OBJECTID_BATCH_SERIAL:
+	case OBJECTID_BATCH_MB:
+		return true;
+
+#ifdef HAVE_X86_SIMD
+	case OBJECTID_BATCH_MB_AVX2:
+		return __builtin_cpu_supports("avx2");
+#endif
+
+	default:
+		return false;
+	}
+}
+
+static void use_batch(enum objectid_batch_impl impl)
+{
+	switch (impl) {
+#ifdef HAVE_X86_SIMD
+	case OBJECTID_BATCH_MB_AVX2:
+		store_impl(batch_process, mb_process_avx2);
+		break;
+#endif
+
+	case OBJECTID_BATCH_MB:
+		store_impl(batch_process, mb_process_default);
+		break;
+
+	default:
+		impl = OBJECTID_BATCH_SERIAL;
+		store_impl(batch_process, NULL);
+		break;
+	}
+
+	store_impl(batch_impl, impl);
+}
+
+static void pick_impl(void)
+{
+#ifdef HAVE_X86_SIMD
+	__builtin_cpu_init();
+#endif
+
+	/* sha-ni one message at a time keeps up with eight avx2 lanes */
+	if (impl_supported(OBJECTID_SHA1_SHANI)) {
+		use_impl(OBJECTID_SHA1_SHANI);
+		use_batch(OBJECTID_BATCH_SERIAL);
+		return;
+	}
+
+	use_impl(OBJECTID_SHA1_POLARSSL);
+
+	if (batch_supported(OBJECTID_BATCH_MB_AVX2))
+		use_batch(OBJECTID_BATCH_MB_AVX2);
+	else
+		use_batch(OBJECTID_BATCH_MB);
+}
+
+void hash_sha1_starts(struct hash_sha1 *ctx)
+{
+	pthread_once(&sha1_once, pick_impl);
+
+	ctx->impl = load_impl(impl_in_use);
+
+	/* both implementations start from the same state */
+	sha1_starts(&ctx->sha1);
+}
+
+void hash_sha1_update(struct hash_sha1 *ctx, const void *input, size_t len)
+{
+	ctx->impl->update(&ctx->sha1, input, len);
+}
+
+void hash_sha1_finish(struct hash_sha1 *ctx, unsigned char md[20])
+{
+	ctx->impl->finish(&ctx->sha1, md);
+}
+
+enum objectid_sha1_impl objectid_get_sha1_impl(void)
+{
+	pthread_once(&sha1_once, pick_impl);
+
+	return load_impl(sha1_impl);
+}
+
+bool objectid_set_sha1_impl(enum objectid_sha1_impl impl)
+{
+	pthread_once(&sha1_once, pick_impl);
+
+	if (!impl_supported(impl))
+		return false;
+
+	use_impl(impl);
+
+	return true;
+}
+
+const char *objectid_sha1_impl_name(enum objectid_sha1_impl impl)
+{
+	if (impl < OBJECTID_SHA1_POLARSSL || impl > OBJECTID_SHA1_SHANI)
+		return "unknown";
+
+	return impl_names[impl];
+}
+
+enum objectid_batch_impl objectid_get_batch_impl(void)
+{
+	pthread_once(&sha1_once, pick_impl);
+
+	return load_impl(batch_impl);
+}
+
+bool objectid_set_batch_impl(enum objectid_batch_impl impl)
+{
+	pthread_once(&sha1_once, pick_impl);
+
+	if (!batch_supported(impl))
+		return false;
+
+	use_batch(impl);
+
+	return true;
+}
+
+const char *objectid_batch_impl_name(enum objectid_batch_impl impl)
+{
+	if (impl < OBJECTID_BATCH_SERIAL || impl > OBJECTID_BATCH_MB_AVX2)
+		return "unknown";
+
+	return batch_names[impl];
+}
+
+/* multi-buffer sha1 */
+
+/*
+ * MB_LANES messages are hashed side by side, one per 32 bit lane of a
+ * vector, with the plain sha1 rounds. the same code is built for avx2,
+ * where a vector is one register, and for the baseline, where gcc splits
+ * it into two sse2 halves of four lanes
+ */
+typedef uint32_t mb_vec __attribute__((vector_size(MB_LANES * 4)));
+
+#define MB_ROL(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+
+#define MB_ROUND(i, f, k) do { \
+	if ((i) >= 16) { \
+		w[(i) & 15] = MB_ROL(w[((i) + 13) & 15] ^ w[((i) + 8) & 15] ^ \
+		                     w[((i) + 2) & 15] ^ w[(i) & 15], 1); \
+	} \
+	t = MB_ROL(a, 5) + (f) + e + (k) + w[(i) & 15]; \
+	e = d; \
+	d = c; \
+	c = MB_ROL(b, 30); \
+	b = a; \
+	a = t; \
+} while (0)
+
+/* one block for every lane, words[i][lane] is word i of lane's block */
+static inline __attribute__((always_inline))
+void mb_process(uint32_t state[5][MB_LANES],
+                const uint32_t words[16][MB_LANES])
+{
+	mb_vec a, b, c, d, e, t;
+	mb_vec w[16];
+	int i;
+
+	memcpy(&a, state[0], sizeof(a));
+	memcpy(&b, state[1], sizeof(b));
+	memcpy(&c, state[2], sizeof(c));
+	memcpy(&d, state[3], sizeof(d));
+	memcpy(&e, state[4], sizeof(e));
+	memcpy(w, words, sizeof(w));
+
+	for (i = 0; i < 20; i++)
+		MB_ROUND(i, (b & c) | (~b & d), 0x5a827999U);
+	for (; i < 40; i++)
+		MB_ROUND(i, b ^ c ^ d, 0x6ed9eba1U);
+	for (; i < 60; i++)
+		MB_ROUND(i, (b & c) | (b & d) | (c & d), 0x8f1bbcdcU);
+	for (; i < 80; i++)
+		MB_ROUND(i, b ^ c ^ d, 0xca62c1d6U);
+
+	memcpy(&t, state[0], sizeof(t));
+	a += t;
+	memcpy(state[0], &a, sizeof(a));
+	memcpy(&t, state[1], sizeof(t));
+	b += t;
+	memcpy(state[1], &b, sizeof(b));
+	memcpy(&t, state[2], sizeof(t));
+	c += t;
+	memcpy(state[2], &c, sizeof(c));
+	memcpy(&t, state[3], sizeof(t));
+	d += t;
+	memcpy(state[3], &d, sizeof(d));
+	memcpy(&t, state[4], sizeof(t));
+	e += t;
+	memcpy(state[4], &e, sizeof(e));
+}
+
+static void mb_process_default(uint32_t state[5][MB_LANES],
+                               const uint32_t words[16][MB_LANES])
+{
+	mb_process(state, words);
+}
+
+#ifdef HAVE_X86_SIMD
+__attribute__((target("avx2")))
+static void mb_process_avx2(uint32_t state[5][MB_LANES],
+                            const uint32_t words[16][MB_LANES])
+{
+	mb_process(state, words);
+}
+#endif
+
+static uint32_t get_be32(const unsigned char *in)
+{
+	return ((uint32_t) in[0] << 24) | ((uint32_t) in[1] << 16) |
+	       ((uint32_t) in[2] << 8) | (uint32_t) in[3];
+}
+
+static const uint32_t sha1_init[5] = {
+	0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0
+};
+
+/*
+ * up to MB_LANES messages. each lane's padding goes in its own tail
+ * buffer; a lane with fewer blocks than the longest keeps its state by
+ * having it put back after the blocks it doesn't have
+ */
+static void mb_lanes(mb_func process, const unsigned char *const *msgs,
+                     const size_t *lens, int num, struct objectid *ids)
+{
+	uint32_t state[5][MB_LANES];
+	uint32_t saved[5][MB_LANES];
+	uint32_t words[16][MB_LANES];
+	unsigned char tails[MB_LANES][128];
+	size_t full[MB_LANES], blocks[MB_LANES];
+	size_t max_blocks = 0, min_blocks = SIZE_MAX;
+	size_t b;
+	int lane, i;
+
+	for (lane = 0; lane < MB_LANES; lane++) {
+		size_t len = lane < num ? lens[lane] : 0;
+		size_t rem = len & 0x3f;
+
+		for (i = 0; i < 5; i++)
+			state[i][lane] = sha1_init[i];
+
+		full[lane] = len / 64;
+		blocks[lane] = 0;
+		if (lane >= num)
+			continue;
+
+		memset(tails[lane], 0, sizeof(tails[lane]));
+		memcpy(tails[lane], msgs[lane] + len - rem, rem);
+		tails[lane][rem] = 0x80;
+
+		blocks[lane] = full[lane] + (rem < 56 ? 1 : 2);
+		put_be32(tails[lane] + (blocks[lane] - full[lane]) * 64 - 8,
+		         (uint32_t) (len >> 29));
+		put_be32(tails[lane] + (blocks[lane] - full[lane]) * 64 - 4,
+		         (uint32_t) (len << 3));
+
+		if (blocks[lane] > max_blocks)
+			max_blocks = blocks[lane];
+		if (blocks[lane] < min_blocks)
+			min_blocks = blocks[lane];
+	}
+
+	for (b = 0; b < max_blocks; b++) {
+		for (lane = 0; lane < MB_LANES; lane++) {
+			const unsigned char *p;
+
+			if (b >= blocks[lane])
+				p = tails[0];
+			else if (b < full[lane])
+				p = msgs[lane] + b * 64;
+			else
+				p = tails[lane] + (b - full[lane]) * 64;
+
+			for (i = 0; i < 16; i++)
+				words[i][lane] = get_be32(p + i * 4);
+		}
+
+		/* only needed once a lane has run out of blocks */
+		if (b >= min_blocks)
+			memcpy(saved, state, sizeof(saved));
+
+		process(state, (const uint32_t (*)[MB_LANES]) words);
+
+		for (lane = 0; lane < num && b >= min_blocks; lane++) {
+			if (b < blocks[lane])
+				continue;
+
+			for (i = 0; i < 5; i++)
+				state[i][lane] = saved[i][lane];
+		}
+	}
+
+	for (lane = 0; lane < num; lane++) {
+		for (i = 0; i < 5; i++)
+			put_be32(ids[lane].md + i * 4, state[i][lane]);
+	}
+}
+
+/* the implementations are loaded once, the whole batch is hashed with them */
+void hash_sha1_batch(const unsigned char *const *msgs, const size_t *lens,
+                     int num, struct objectid *ids)
+{
+	const struct sha1_impl *impl;
+	sha1_context ctx;
+	mb_func process;
+	int i;
+
+	pthread_once(&sha1_once, pick_impl);
+
+	process = load_impl(batch_process);
+	impl = load_impl(impl_in_use);
+
+	if (process == NULL) {
+		for (i = 0; i < num; i++) {
+			sha1_starts(&ctx);
+			impl->update(&ctx, msgs[i], lens[i]);
+			impl->finish(&ctx, ids[i].md);
+		}
+
+		return;
+	}
+
+	for (i = 0; i < num; i += MB_LANES) {
+		mb_lanes(process, msgs + i, lens + i,
+		         num - i < MB_LANES ? num - i : MB_LANES, ids + i);
+	}
+}
+
+/* murmurhash3 x64 128 */
+
+static uint64_t rotl64(uint64_t x, int r)
+{
+	return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t fmix64(uint64_t k)
+{
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	k *= 0xc4ceb9fe1a85ec53ULL;
+	k ^= k >> 33;
+
+	return k;
+}
+
+#define MURMUR_C1 0x87c37b91114253d5ULL
+#define MURMUR_C2 0x4cf5ad432745937fULL
+
+/*
+ * the words are loaded in host order, which is fine as the ids are never
+ * saved. the tail is zero padded to a whole block: mixing in a zero word
+ * changes nothing, so that is the same as the reference's tail switch
+ */
+void hash_fast128(const void *input, size_t len, unsigned char out[16])
+{
+	const unsigned char *data = input;
+	unsigned char tail[16];
+	uint64_t h1 = 0, h2 = 0;
+	uint64_t k1, k2;
+	size_t i;
+
+	for (i = 0; i + 16 <= len; i += 16) {
+		memcpy(&k1, data + i, sizeof(k1));
+		memcpy(&k2, data + i + 8, sizeof(k2));
+
+		k1 *= MURMUR_C1;
+		k1 = rotl64(k1, 31);
+		k1 *= MURMUR_C2;
+		h1 ^= k1;
+
+		h1 = rotl64(h1, 27);
+		h1 += h2;
+		h1 = h1 * 5 + 0x52dce729;
+
+		k2 *= MURMUR_C2;
+		k2 = rotl64(k2, 33);
+		k2 *= MURMUR_C1;
+		h2 ^= k2;
+
+		h2 = rotl64(h2, 31);
+		h2 += h1;
+		h2 = h2 * 5 + 0x38495ab5;
+	}
+
+	memset(tail, 0, sizeof(tail));
+	memcpy(tail, data + i, len - i);
+	memcpy(&k1, tail, sizeof(k1));
+	memcpy(&k2, tail + 8, sizeof(k2));
+
+	k2 *= MURMUR_C2;
+	k2 = rotl64(k2, 33);
+	k2 *= MURMUR_C1;
+	h2 ^= k2;
+
+	k1 *= MURMUR_C1;
+	k1 = rotl64(k1, 31);
+	k1 *= MURMUR_C2;
+	h1 ^= k1;
+
+	h1 ^= (uint64_t) len;
+	h2 ^= (uint64_t) len;
+
+	h1 += h2;
+	h2 += h1;
+
+	h1 = fmix64(h1);
+	h2 = fmix64(h2);
+
+	h1 += h2;
+	h2 += h1;
+
+	memcpy(out, &h1, sizeof(h1));
+	memcpy(out + 8, &h2, sizeof(h2));
+}
+
+/* objectids of a message */
+
+void hash_sha1_id(const void *data, size_t len, struct objectid *id)
+{
+	struct hash_sha1 ctx;
+
+	hash_sha1_starts(&ctx);
+	hash_sha1_update(&ctx, data, len);
+	hash_sha1_finish(&ctx, id->md);
+}
+
+/*
+ * the 128 bit hash fills the first 16 bytes, the last 4 repeat the
+ * first 4 so the index fingerprint (the tail of the id) is hash too
+ */
+void hash_fast_id(const void *data, size_t len, struct objectid *id)
+{
+	hash_fast128(data, len, id->md);
+	memcpy(id->md + 16, id->md, OBJECTID_MD_SIZE - 16);
+}
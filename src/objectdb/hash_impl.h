@@ -0,0 +1,38 @@
+#ifndef HASH_IMPL_H
+#define HASH_IMPL_H
+
+#include <stdbool.h>
+
+/*
+ * the sha1 and batch implementations behind objectids, see hash.c. the
+ * best the cpu supports is picked the first time an id is hashed; the
+ * setters are only for tests and benchmarks comparing them. a hash that
+ * is under way when one is called finishes on the implementation it
+ * started with. every implementation gives the same ids
+ */
+enum objectid_sha1_impl {
+	OBJECTID_SHA1_POLARSSL,
+	OBJECTID_SHA1_SHANI
+};
+
+extern enum objectid_sha1_impl objectid_get_sha1_impl(void);
+
+/* use impl from now on, false if the cpu can't run it */
+extern bool objectid_set_sha1_impl(enum objectid_sha1_impl impl);
+
+extern const char *objectid_sha1_impl_name(enum objectid_sha1_impl impl);
+
+enum objectid_batch_impl {
+	OBJECTID_BATCH_SERIAL,
+	OBJECTID_BATCH_MB,
+	OBJECTID_BATCH_MB_AVX2
+};
+
+extern enum objectid_batch_impl objectid_get_batch_impl(void);
+
+/* use impl for batches from now on, false if the cpu can't run it */
+extern bool objectid_set_batch_impl(enum objectid_batch_impl impl);
+
+extern const char *objectid_batch_impl_name(enum objectid_batch_impl impl);
+
+#endif
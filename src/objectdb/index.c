@@ -0,0 +1,190 @@
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <predcfb/predcfb.h>
+#include <predcfb/objectid.h>
+#include <predcfb/objectdb.h>
+
+#include "objectdb_internal.h"
+
+/*
+ * objectid index
+ *
+ * open addressing with robin hood insertion: an entry that is further
+ * from its home slot than the one being probed takes that slot over, so
+ * probe lengths stay short and a lookup can stop as soon as it reaches
+ * an entry that is closer to home than the key would be. every slot keeps
+ * a 32 bit fingerprint of the objectid next to the object pointer, so
+ * the full 20 byte compare only happens on a fingerprint match.
+ */
+
+/* grow once the table is more than 4/5 full */
+#define INDEX_LOAD_NUM 4
+#define INDEX_LOAD_DEN 5
+
+static uint32_t fingerprint(const struct objectid *id)
+{
+	uint32_t hash;
+
+	/* the objectid is already a good hash, just take some of it */
+	memcpy(&hash, &id->md[OBJECTID_MD_SIZE - sizeof(hash)], sizeof(hash));
+
+	return hash;
+}
+
+static size_t probe_distance(const struct object_index *idx,
+                             size_t slot, uint32_t hash)
+{
+	return (slot - (hash & (idx->size - 1))) & (idx->size - 1);
+}
+
+static bool over_load_factor(size_t count, size_t size)
+{
+	return (count * INDEX_LOAD_DEN) > (size * INDEX_LOAD_NUM);
+}
+
+/* place obj without checking for duplicates, there must be a free slot */
+static void place(struct object_index *idx, struct object *obj, uint32_t hash)
+{
+	const size_t mask = idx->size - 1;
+	struct index_slot *slot;
+	struct index_slot tmp;
+	size_t dist = 0;
+	size_t i;
+
+	i = hash & mask;
+
+	for (;;) {
+		slot = &idx->slots[i];
+
+		if (slot->obj == NULL) {
+			slot->hash = hash;
+			slot->obj = obj;
+			return;
+		}
+
+		/* take from the rich: evict entries closer to their home */
+		if (probe_distance(idx, i, slot->hash) < dist) {
+			tmp = *slot;
+			slot->hash = hash;
+			slot->obj = obj;
+
+			hash = tmp.hash;
+			obj = tmp.obj;
+			dist = probe_distance(idx, i, hash);
+		}
+
+		i = (i + 1) & mask;
+		dist++;
+	}
+}
+
+static int resize(struct object_index *idx, size_t new_size)
+{
+	struct index_slot *old_slots = idx->slots;
+	size_t old_size = idx->size;
+	size_t i;
+
+	idx->slots = calloc(new_size, sizeof(*idx->slots));
+	if (!idx->slots) {
+		idx->slots = old_slots;
+		return OBJECTDB_ERROR;
+	}
+
+	idx->size = new_size;
+
+	for (i = 0; i < old_size; i++) {
+		if (old_slots[i].obj)
+			place(idx, old_slots[i].obj, old_slots[i].hash);
+	}
+
+	free(old_slots);
+
+	return OBJECTDB_OK;
+}
+
+void index_init(struct object_index *idx)
+{
+	idx->slots = NULL;
+	idx->size = 0;
+	idx->count = 0;
+}
+
+void index_destroy(struct object_index *idx)
+{
+	free(idx->slots);
+	index_init(idx);
+}
+
+void index_clear(struct object_index *idx)
+{
+	if (idx->slots)
+		memset(idx->slots, 0, idx->size * sizeof(*idx->slots));
+
+	idx->count = 0;
+}
+
+int index_reserve(struct object_index *idx, size_t count)
+{
+	size_t size = idx->size ? idx->size : OBJECTDB_INDEX_SIZE;
+
+	while (over_load_factor(count, size))
+		size *= 2;
+
+	if (size == idx->size)
+		return OBJECTDB_OK;
+
+	return resize(idx, size);
+}
+
+struct object *index_lookup(const struct object_index *idx,
+                            const struct objectid *id)
+{
+	const struct index_slot *slot;
+	uint32_t hash;
+	size_t mask;
+	size_t dist;
+	size_t i;
+
+	if (idx->count == 0)
+		return NULL;
+
+	hash = fingerprint(id);
+	mask = idx->size - 1;
+	i = hash & mask;
+
+	for (dist = 0; ; dist++) {
+		slot = &idx->slots[i];
+
+		/*
+		 * an empty slot, or an entry that is closer to its home than
+		 * we are to ours, means the key would have been placed already
+		 */
+		if (slot->obj == NULL || probe_distance(idx, i, slot->hash) < dist)
+			return NULL;
+
+		if (slot->hash == hash && objectid_compare(id, &slot->obj->id))
+			return slot->obj;
+
+		i = (i + 1) & mask;
+	}
+}
+
+int index_insert(struct object_index *idx, struct object *obj)
+{
+	if (index_lookup(idx, &obj->id) != NULL)
+		return OBJECTDB_EDUPLICATE;
+
+	if (idx->size == 0 || over_load_factor(idx->count + 1, idx->size)) {
+		if (index_reserve(idx, idx->count + 1) != OBJECTDB_OK)
+			return OBJECTDB_ENOMEM;
+	}
+
+	place(idx, obj, fingerprint(&obj->id));
+	idx->count++;
+
+	return OBJECTDB_ENONE;
+}
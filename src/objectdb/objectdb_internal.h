@@ -1,6 +1,17 @@
 #ifndef OBJECTDB_INTERNAL_H
 #define OBJECTDB_INTERNAL_H
 
+#include <stddef.h>
+#include <stdint.h>
+
+#include <polarssl/sha1.h>
+
+#define OBJECTDB_INDEX_SIZE    1024
+#define OBJECTDB_PAGE_SIZE     (256 * 1024)
+#define OBJECTDB_LIST_SIZE     64
+#define OBJECTDB_COLUMN_ALIGN  32
+#define OBJECTDB_COLUMN_ROWS   16
+
 enum object_type {
 	OBJECTDB_CONF,
 	OBJECTDB_TEAM,
@@ -18,9 +29,207 @@ struct object {
 	struct objectid id;
 	enum object_type type;
 	union object_data data;
-	struct object *next;
 };
 
-extern int objectdb_write_yaml(const struct object *objects, int num_objects);
+/* objectid -> object hash index, see index.c */
+struct index_slot {
+	uint32_t hash;
+	struct object *obj;
+};
+
+struct object_index {
+	struct index_slot *slots;
+	size_t size;
+	size_t count;
+};
+
+extern void index_init(struct object_index *idx);
+extern void index_destroy(struct object_index *idx);
+extern void index_clear(struct object_index *idx);
+
+/* make room for count objects in total without further resizing */
+extern int index_reserve(struct object_index *idx, size_t count);
+
+extern struct object *index_lookup(const struct object_index *idx,
+                                   const struct objectid *id);
+
+/* returns OBJECTDB_ENONE, OBJECTDB_EDUPLICATE or OBJECTDB_ENOMEM */
+extern int index_insert(struct object_index *idx, struct object *obj);
+
+/*
+ * objectid hashing, see hash.c. a sha1 runs on the implementation that
+ * was in use when it was started, whatever is selected in the meantime
+ */
+struct sha1_impl;
+
+struct hash_sha1 {
+	sha1_context sha1;
+	const struct sha1_impl *impl;
+};
+
+extern void hash_sha1_starts(struct hash_sha1 *ctx);
+extern void hash_sha1_update(struct hash_sha1 *ctx,
+                             const void *input,
+                             size_t len);
+extern void hash_sha1_finish(struct hash_sha1 *ctx, unsigned char md[20]);
+
+/* the sha1 of each message at once, with the batch implementation in use */
+extern void hash_sha1_batch(const unsigned char * const *msgs,
+                            const size_t *lens,
+                            int num,
+                            struct objectid *ids);
+
+extern void hash_fast128(const void *input, size_t len, unsigned char out[16]);
+
+/* the sha1 and the fast objectid of len bytes of data */
+extern void hash_sha1_id(const void *data, size_t len, struct objectid *id);
+extern void hash_fast_id(const void *data, size_t len, struct objectid *id);
+
+/*
+ * arena allocator: memory is handed out from large pages that are never
+ * moved, so pointers between objects stay valid as the database grows.
+ * nothing is freed individually, arena_reset recycles every page at once
+ */
+struct arena_page;
+
+struct arena {
+	struct arena_page *first;
+	struct arena_page *current;
+	size_t page_size;
+};
+
+extern void arena_init(struct arena *a, size_t page_size);
+extern void *arena_alloc(struct arena *a, size_t size);
+extern void arena_reset(struct arena *a);
+extern void arena_destroy(struct arena *a);
+
+/*
+ * interned names, see strings.c. every name is stored once, in the
+ * arena, along with the objectids a conference or team of that name
+ * gets; those are hashed when the name is first interned. a name's ref
+ * is its position in names plus one, the table maps a name back to it
+ */
+struct pooled_name {
+	struct objectid sha1;
+	struct objectid fast;
+	uint32_t hash;
+	uint32_t len;
+	char str[];
+};
+
+struct string_pool {
+	struct pooled_name **names;
+	int num_names;
+	int max_names;
+
+	uint32_t *slots;
+	size_t size;
+};
+
+extern void strings_init(struct string_pool *sp);
+extern void strings_destroy(struct string_pool *sp);
+
+/* forget every name, their memory goes with the arena's */
+extern void strings_clear(struct string_pool *sp);
+
+/*
+ * returns OBJECTDB_ENONE, OBJECTDB_ENOMEM, or OBJECTDB_ETOOLONG if len
+ * isn't less than TEAM_NAME_MAX. a new name's sha1 is hashed unless one
+ * is passed in
+ */
+extern int strings_intern(struct string_pool *sp,
+                          struct arena *a,
+                          const char *str,
+                          size_t len,
+                          const struct objectid *sha1,
+                          struct name *n);
+
+extern const struct pooled_name *strings_lookup(const struct string_pool *sp,
+                                                uint32_t ref);
+
+/* the pool entry behind an interned name (n->ref must not be 0) */
+extern const struct pooled_name *strings_pooled(const struct name *n);
+
+/* per-game stats stored one column per stat, see columns.c */
+struct stats_columns {
+	short *cols[STATS_NUM_COLUMNS];
+	int num_rows;
+	int max_rows;
+};
+
+extern void columns_init(struct stats_columns *sc);
+extern void columns_destroy(struct stats_columns *sc);
+extern void columns_clear(struct stats_columns *sc);
+
+/* make room for the rows of num_games games */
+extern int columns_reserve(struct stats_columns *sc, int num_games);
+
+/* append the two rows for g, which must be the newest game */
+extern void columns_add_game(struct stats_columns *sc, const struct game *g);
+extern void columns_set_row(struct stats_columns *sc,
+                            int row,
+                            const struct stats *s);
+
+/*
+ * all of the state for one object database; nothing in here is shared,
+ * so separate databases can be used from separate threads. the objects
+ * themselves live in the arena, the lists only hold pointers to them in
+ * the order they were added
+ */
+struct objectdb_context {
+	struct arena arena;
+	enum objectid_kind ids;
+
+	struct object **objects;
+	int num_objects;
+	int max_objects;
+
+	struct conference **conferences;
+	int num_conferences;
+	int max_conferences;
+
+	struct team **teams;
+	int num_teams;
+	int max_teams;
+
+	/* a flag per team, and the dirty teams in the order they were marked */
+	unsigned char *team_dirty;
+	struct team **dirty_teams;
+	int num_dirty;
+
+	struct game **games;
+	int num_games;
+	int max_games;
+
+	struct object_index index;
+	struct stats_columns columns;
+	struct string_pool strings;
+
+	enum objectdb_err error;
+};
+
+/*
+ * add objects and intern names whose objectids are already known, for a
+ * snapshot that saved them; nothing is rehashed
+ */
+extern int objectdb_intern_sha1(objectdb_ctx *db,
+                                const char *str,
+                                size_t len,
+                                const struct objectid *sha1,
+                                struct name *n);
+extern int objectdb_insert_conference(objectdb_ctx *db,
+                                      struct conference *c,
+                                      const struct objectid *id);
+extern int objectdb_insert_team(objectdb_ctx *db,
+                                struct team *t,
+                                const struct objectid *id);
+extern int objectdb_insert_game(objectdb_ctx *db,
+                                struct game *g,
+                                const struct objectid *id);
+
+extern int objectdb_write_yaml(struct object * const *objects,
+                               int num_objects,
+                               const char *path);
+extern int objectdb_write_snapshot(objectdb_ctx *db, const char *path);
 
 #endif
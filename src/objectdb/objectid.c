@@ -5,9 +5,13 @@
 #include <assert.h>
 
 #include <polarssl/sha1.h>
+#include <predcfb/date.h>
+#include <predcfb/objectdb.h>
 #include <predcfb/objectid.h>
 #include <predcfb/predcfb.h>
 
+#include "objectdb_internal.h"
+
 /* objectid display functions */
 
 void objectid_print(const struct objectid *id)
@@ -40,6 +44,40 @@ void objectid_string(const struct objectid *id, char buf[OBJECTID_MD_STR_SIZE])
 	buf[OBJECTID_MD_STR_SIZE - 1] = '\0';
 }
 
+static int hex_value(char c)
+{
+	if (c >= '0' && c <= '9')
+		return c - '0';
+
+	if (c >= 'a' && c <= 'f')
+		return c - 'a' + 10;
+
+	if (c >= 'A' && c <= 'F')
+		return c - 'A' + 10;
+
+	return -1;
+}
+
+bool objectid_from_string(const char *str, struct objectid *id)
+{
+	int i;
+	int high, low;
+
+	for (i = 0; i < OBJECTID_MD_SIZE; i++) {
+		high = hex_value(str[i * 2]);
+		if (high < 0)
+			return false;
+
+		low = hex_value(str[i * 2 + 1]);
+		if (low < 0)
+			return false;
+
+		id->md[i] = (unsigned char) ((high << 4) | low);
+	}
+
+	return str[OBJECTID_MD_STR_SIZE - 1] == '\0';
+}
+
 /* objectid comparison functions */
 
 bool objectid_compare(const struct objectid *a, const struct objectid *b)
@@ -53,53 +91,165 @@ bool objectid_compare(const struct objectid *a, const struct objectid *b)
 
 /* objectid hashing functions */
 
-void objectid_from_conference(const struct conference *c, struct objectid *id)
+/* interned names had their objectids worked out when they were pooled */
+static void name_sha1(const struct name *n, struct objectid *id)
 {
-	size_t len;
+	if (n->ref)
+		*id = strings_pooled(n)->sha1;
+	else
+		hash_sha1_id(n->str, strlen(n->str), id);
+}
+
+static void name_fast(const struct name *n, struct objectid *id)
+{
+	if (n->ref)
+		*id = strings_pooled(n)->fast;
+	else
+		hash_fast_id(n->str, strlen(n->str), id);
+}
+
+static size_t name_len(const struct name *n)
+{
+	return n->ref ? strings_pooled(n)->len : strlen(n->str);
+}
 
+void objectid_from_conference(const struct conference *c, struct objectid *id)
+{
 	/* just hash name */
-	len = strlen(c->name);
-	sha1((unsigned char*) c->name, len, id->md);
+	name_sha1(&c->name, id);
 }
 
 void objectid_from_team(const struct team *t, struct objectid *id)
 {
-	size_t len;
-
 	/* just hash name */
-	len = strlen(t->name);
-	sha1((unsigned char*) t->name, len, id->md);
+	name_sha1(&t->name, id);
+}
+
+/* the parser keeps the date string, otherwise create it */
+static const char *game_date(const struct game *g, char buf[DATE_STR_SIZE])
+{
+	if (g->date_str[0] != '\0')
+		return g->date_str;
+
+	date_string(g->date, buf);
+
+	return buf;
 }
 
 void objectid_from_game(const struct game *g, struct objectid *id)
 {
-	/* date format is YYYY-MM-DD\0 */
-	static const int DATE_BUF_SIZE = 11;
-	char date_buf[DATE_BUF_SIZE];
-	struct tm tm;
-	size_t num_bytes;
-	sha1_context ctx;
-	size_t len;
+	char date_buf[DATE_STR_SIZE];
+	struct hash_sha1 ctx;
 
 	assert(g->home != NULL);
 	assert(g->away != NULL);
 
-	/* create date string */
-	gmtime_r(&g->date, &tm);
-	num_bytes = strftime(date_buf, DATE_BUF_SIZE, "%Y-%m-%d", &tm);
-	assert(num_bytes == DATE_BUF_SIZE - 1);
-
-	sha1_starts(&ctx);
+	hash_sha1_starts(&ctx);
 
 	/* hash home team name */
-	len = strlen(g->home->name);
-	sha1_update(&ctx, (unsigned char*)g->home->name, len);
-	/* hash away team oid */
-	len = strlen(g->away->name);
-	sha1_update(&ctx, (unsigned char*)g->away->name, len);
-	/* hash time_t */
-	sha1_update(&ctx, (unsigned char*)date_buf, DATE_BUF_SIZE - 1);
+	hash_sha1_update(&ctx, g->home->name.str, name_len(&g->home->name));
+	/* hash away team name */
+	hash_sha1_update(&ctx, g->away->name.str, name_len(&g->away->name));
+	/* hash the day */
+	hash_sha1_update(&ctx, game_date(g, date_buf), DATE_STR_SIZE - 1);
+
+	hash_sha1_finish(&ctx, id->md);
+}
+
+/*
+ * a game's home name, away name and day, as one message. interned names
+ * always fit, a name that was never interned might not: game_message
+ * returns 0 then and the caller hashes the game with objectid_from_game
+ */
+#define GAME_MESSAGE_MAX (TEAM_NAME_MAX * 2 + DATE_STR_SIZE)
+
+static size_t game_message(const struct game *g, char buf[GAME_MESSAGE_MAX])
+{
+	char date_buf[DATE_STR_SIZE];
+	size_t home, away;
 
-	sha1_finish(&ctx, id->md);
+	assert(g->home != NULL);
+	assert(g->away != NULL);
+
+	home = name_len(&g->home->name);
+	away = name_len(&g->away->name);
+
+	if (home >= TEAM_NAME_MAX || away >= TEAM_NAME_MAX)
+		return 0;
+
+	memcpy(buf, g->home->name.str, home);
+	memcpy(buf + home, g->away->name.str, away);
+	memcpy(buf + home + away, game_date(g, date_buf), DATE_STR_SIZE - 1);
+
+	return home + away + DATE_STR_SIZE - 1;
 }
 
+/* fast objectid functions */
+
+void objectid_fast_from_conference(const struct conference *c,
+                                   struct objectid *id)
+{
+	name_fast(&c->name, id);
+}
+
+void objectid_fast_from_team(const struct team *t, struct objectid *id)
+{
+	name_fast(&t->name, id);
+}
+
+/*
+ * the same bytes objectid_from_game hashes, in one piece. the fast hash
+ * can't be fed in pieces, so a game whose message doesn't fit gets its
+ * sha1 id instead
+ */
+void objectid_fast_from_game(const struct game *g, struct objectid *id)
+{
+	char buf[GAME_MESSAGE_MAX];
+	size_t len;
+
+	if ((len = game_message(g, buf)) == 0)
+		objectid_from_game(g, id);
+	else
+		hash_fast_id(buf, len, id);
+}
+
+/* batch objectid functions */
+
+#define GAME_BATCH 64
+
+void objectid_from_games(const struct game * const *games,
+                         int num,
+                         struct objectid *ids)
+{
+	char bufs[GAME_BATCH][GAME_MESSAGE_MAX];
+	const unsigned char *msgs[GAME_BATCH];
+	size_t lens[GAME_BATCH];
+	int slots[GAME_BATCH];
+	struct objectid out[GAME_BATCH];
+	int done, n, m, i;
+
+	for (done = 0; done < num; done += n) {
+		n = num - done < GAME_BATCH ? num - done : GAME_BATCH;
+
+		/* games that don't fit a buffer are hashed on their own */
+		for (i = 0, m = 0; i < n; i++) {
+			lens[m] = game_message(games[done + i], bufs[m]);
+			if (lens[m] == 0) {
+				objectid_from_game(games[done + i], &ids[done + i]);
+				continue;
+			}
+			msgs[m] = (const unsigned char *) bufs[m];
+			slots[m++] = done + i;
+		}
+
+		if (m == n) {
+			hash_sha1_batch(msgs, lens, n, ids + done);
+			continue;
+		}
+
+		hash_sha1_batch(msgs, lens, m, out);
+
+		for (i = 0; i < m; i++)
+			ids[slots[i]] = out[i];
+	}
+}
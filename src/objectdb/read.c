@@ -0,0 +1,406 @@
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <yaml.h>
+
+#include <openbsd/string.h>
+
+#include <predcfb/predcfb.h>
+#include <predcfb/date.h>
+#include <predcfb/objectdb.h>
+#include <predcfb/objectid.h>
+
+#include "objectdb_internal.h"
+
+extern const char *progname;
+
+/*
+ * every object in a yaml file written by objectdb_write_yaml looks like
+ *
+ *   - type: TEAM
+ *     sha1: <objectid>
+ *     team:
+ *       name: ...
+ *       conf_sha1: <objectid>
+ *
+ * the fields are collected into a record, then the object is rebuilt,
+ * relinked to the objects it refers to and its objectid is checked
+ * against the saved one. referenced objects always come first in the file
+ */
+#define RECORD_STR_MAX 64
+
+struct load_record {
+	char type[RECORD_STR_MAX];
+	char sha1[RECORD_STR_MAX];
+	char name[RECORD_STR_MAX];
+	char subdivision[RECORD_STR_MAX];
+	char conf_sha1[RECORD_STR_MAX];
+	char date[RECORD_STR_MAX];
+	char home_sha1[RECORD_STR_MAX];
+	char away_sha1[RECORD_STR_MAX];
+};
+
+struct record_field {
+	const char *name;
+	size_t offset;
+};
+
+#define RECORD_FIELD(f) { #f, offsetof(struct load_record, f) }
+
+/* fields directly under an object */
+static const struct record_field object_fields[] = {
+	RECORD_FIELD(type),
+	RECORD_FIELD(sha1),
+	{ NULL, 0 }
+};
+
+/* fields under the conference, team or game mapping */
+static const struct record_field data_fields[] = {
+	RECORD_FIELD(name),
+	RECORD_FIELD(subdivision),
+	RECORD_FIELD(conf_sha1),
+	RECORD_FIELD(date),
+	RECORD_FIELD(home_sha1),
+	RECORD_FIELD(away_sha1),
+	{ NULL, 0 }
+};
+
+struct load_context {
+	const char *path;
+	FILE *inf;
+	yaml_parser_t parser;
+	yaml_event_t event;
+	bool have_event;
+
+	objectdb_ctx *db;
+	struct load_record rec;
+};
+
+/* event helpers */
+
+static int next_event(struct load_context *ctx)
+{
+	if (ctx->have_event)
+		yaml_event_delete(&ctx->event);
+
+	ctx->have_event = false;
+
+	if (!yaml_parser_parse(&ctx->parser, &ctx->event)) {
+		fprintf(stderr, "%s: %s: %s (line %lu)\n",
+		        progname, ctx->path, ctx->parser.problem,
+		        (unsigned long) ctx->parser.problem_mark.line + 1);
+		ctx->db->error = OBJECTDB_EPARSE;
+		return OBJECTDB_ERROR;
+	}
+
+	ctx->have_event = true;
+
+	return OBJECTDB_OK;
+}
+
+static int parse_error(struct load_context *ctx, const char *what)
+{
+	fprintf(stderr, "%s: %s: %s (line %lu)\n",
+	        progname, ctx->path, what,
+	        (unsigned long) ctx->event.start_mark.line + 1);
+	ctx->db->error = OBJECTDB_EPARSE;
+
+	return OBJECTDB_ERROR;
+}
+
+static int expect_event(struct load_context *ctx, yaml_event_type_t type)
+{
+	if (next_event(ctx) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
+
+	if (ctx->event.type != type)
+		return parse_error(ctx, "unexpected structure");
+
+	return OBJECTDB_OK;
+}
+
+static const char *scalar_value(struct load_context *ctx)
+{
+	return (const char *) ctx->event.data.scalar.value;
+}
+
+/* record parsing */
+
+static char *find_field(struct load_context *ctx,
+                        const struct record_field *fields,
+                        const char *key)
+{
+	for (; fields->name; fields++) {
+		if (strcmp(fields->name, key) == 0)
+			return (char *) &ctx->rec + fields->offset;
+	}
+
+	return NULL;
+}
+
+static bool is_data_key(const char *key)
+{
+	return strcmp(key, "conference") == 0 ||
+	       strcmp(key, "team") == 0 ||
+	       strcmp(key, "game") == 0;
+}
+
+/* read key/value pairs up to the end of the current mapping */
+static int read_fields(struct load_context *ctx,
+                       const struct record_field *fields,
+                       bool allow_data)
+{
+	char *dest;
+
+	for (;;) {
+		if (next_event(ctx) != OBJECTDB_OK)
+			return OBJECTDB_ERROR;
+
+		if (ctx->event.type == YAML_MAPPING_END_EVENT)
+			return OBJECTDB_OK;
+
+		if (ctx->event.type != YAML_SCALAR_EVENT)
+			return parse_error(ctx, "expected a key");
+
+		dest = find_field(ctx, fields, scalar_value(ctx));
+		if (!dest && allow_data && is_data_key(scalar_value(ctx))) {
+			/* the conference, team or game mapping */
+			if (expect_event(ctx, YAML_MAPPING_START_EVENT) != OBJECTDB_OK)
+				return OBJECTDB_ERROR;
+
+			if (read_fields(ctx, data_fields, false) != OBJECTDB_OK)
+				return OBJECTDB_ERROR;
+
+			continue;
+		}
+
+		if (!dest)
+			return parse_error(ctx, "unknown key");
+
+		if (expect_event(ctx, YAML_SCALAR_EVENT) != OBJECTDB_OK)
+			return OBJECTDB_ERROR;
+
+		if (strlcpy(dest, scalar_value(ctx), RECORD_STR_MAX) >= RECORD_STR_MAX)
+			return parse_error(ctx, "value is too long");
+	}
+}
+
+/* object rebuilding */
+
+static int mismatch(struct load_context *ctx, const char *what)
+{
+	fprintf(stderr, "%s: %s: %s for object %s\n",
+	        progname, ctx->path, what, ctx->rec.sha1);
+	ctx->db->error = OBJECTDB_EMISMATCH;
+
+	return OBJECTDB_ERROR;
+}
+
+static int read_oid(struct load_context *ctx,
+                    const char *str,
+                    struct objectid *id)
+{
+	if (!objectid_from_string(str, id))
+		return parse_error(ctx, "invalid sha1");
+
+	return OBJECTDB_OK;
+}
+
+/* the yaml only has the day, which is all that goes into the objectid */
+static int read_date(struct load_context *ctx, struct game *g)
+{
+	if (!date_parse_ymd(ctx->rec.date, &g->date))
+		return parse_error(ctx, "invalid date");
+
+	strlcpy(g->date_str, ctx->rec.date, DATE_STR_SIZE);
+
+	return OBJECTDB_OK;
+}
+
+static int check_oid(struct load_context *ctx, const struct objectid *id)
+{
+	struct objectid saved;
+
+	if (read_oid(ctx, ctx->rec.sha1, &saved) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
+
+	if (!objectid_compare(&saved, id))
+		return mismatch(ctx, "sha1 does not match");
+
+	return OBJECTDB_OK;
+}
+
+static int load_conference(struct load_context *ctx)
+{
+	struct conference *c;
+	struct objectid id;
+
+	if ((c = objectdb_create_conference(ctx->db)) == NULL)
+		return OBJECTDB_ERROR;
+
+	if (objectdb_intern(ctx->db, ctx->rec.name,
+	                    strnlen(ctx->rec.name, CONFERENCE_NAME_MAX - 1),
+	                    &c->name) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
+
+	if (strcmp(ctx->rec.subdivision, "FBS") == 0)
+		c->subdivision = CONFERENCE_FBS;
+	else if (strcmp(ctx->rec.subdivision, "FCS") == 0)
+		c->subdivision = CONFERENCE_FCS;
+	else
+		return parse_error(ctx, "invalid subdivision");
+
+	if (objectdb_add_conference(ctx->db, c, &id) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
+
+	return check_oid(ctx, &id);
+}
+
+static int load_team(struct load_context *ctx)
+{
+	struct team *t;
+	struct objectid id;
+
+	if ((t = objectdb_create_team(ctx->db)) == NULL)
+		return OBJECTDB_ERROR;
+
+	if (objectdb_intern(ctx->db, ctx->rec.name,
+	                    strnlen(ctx->rec.name, TEAM_NAME_MAX - 1),
+	                    &t->name) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
+
+	if (read_oid(ctx, ctx->rec.conf_sha1, &t->conf_oid) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
+
+	if ((t->conf = objectdb_get_conference(ctx->db, &t->conf_oid)) == NULL)
+		return mismatch(ctx, "unknown conference");
+
+	if (objectdb_add_team(ctx->db, t, &id) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
+
+	return check_oid(ctx, &id);
+}
+
+static int load_game(struct load_context *ctx)
+{
+	struct game *g;
+	struct objectid id;
+
+	if ((g = objectdb_create_game(ctx->db)) == NULL)
+		return OBJECTDB_ERROR;
+
+	if (read_date(ctx, g) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
+
+	if (read_oid(ctx, ctx->rec.home_sha1, &g->home_oid) != OBJECTDB_OK ||
+	    read_oid(ctx, ctx->rec.away_sha1, &g->away_oid) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
+
+	g->home = objectdb_get_team(ctx->db, &g->home_oid);
+	g->away = objectdb_get_team(ctx->db, &g->away_oid);
+	if (!g->home || !g->away)
+		return mismatch(ctx, "unknown team");
+
+	if (objectdb_add_game(ctx->db, g, &id) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
+
+	return check_oid(ctx, &id);
+}
+
+static int load_object(struct load_context *ctx)
+{
+	memset(&ctx->rec, 0, sizeof(ctx->rec));
+
+	if (read_fields(ctx, object_fields, true) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
+
+	if (strcmp(ctx->rec.type, "CONF") == 0)
+		return load_conference(ctx);
+
+	if (strcmp(ctx->rec.type, "TEAM") == 0)
+		return load_team(ctx);
+
+	if (strcmp(ctx->rec.type, "GAME") == 0)
+		return load_game(ctx);
+
+	/* blobs aren't saved yet, so anything else is an error */
+	return parse_error(ctx, "unknown object type");
+}
+
+static int load_objects(struct load_context *ctx)
+{
+	if (expect_event(ctx, YAML_STREAM_START_EVENT) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
+
+	if (expect_event(ctx, YAML_DOCUMENT_START_EVENT) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
+
+	if (expect_event(ctx, YAML_SEQUENCE_START_EVENT) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
+
+	for (;;) {
+		if (next_event(ctx) != OBJECTDB_OK)
+			return OBJECTDB_ERROR;
+
+		if (ctx->event.type == YAML_SEQUENCE_END_EVENT)
+			break;
+
+		if (ctx->event.type != YAML_MAPPING_START_EVENT)
+			return parse_error(ctx, "expected an object");
+
+		if (load_object(ctx) != OBJECTDB_OK)
+			return OBJECTDB_ERROR;
+	}
+
+	if (expect_event(ctx, YAML_DOCUMENT_END_EVENT) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
+
+	return OBJECTDB_OK;
+}
+
+int objectdb_read(objectdb_ctx *db, const char *path)
+{
+	struct load_context ctx;
+	int err;
+
+	memset(&ctx, 0, sizeof(ctx));
+
+	ctx.path = path;
+	ctx.db = db;
+
+	/* the saved sha1s are what everything is relinked through */
+	if (db->ids != OBJECTID_SHA1) {
+		db->error = OBJECTDB_EIDS;
+		return OBJECTDB_ERROR;
+	}
+
+	ctx.inf = fopen(path, "r");
+	if (!ctx.inf) {
+		fprintf(stderr, "%s: could not open '%s' for reading\n",
+		        progname, path);
+		db->error = OBJECTDB_EREAD;
+		return OBJECTDB_ERROR;
+	}
+
+	if (!yaml_parser_initialize(&ctx.parser)) {
+		fclose(ctx.inf);
+		db->error = OBJECTDB_ENOMEM;
+		return OBJECTDB_ERROR;
+	}
+
+	yaml_parser_set_input_file(&ctx.parser, ctx.inf);
+
+	err = load_objects(&ctx);
+
+	if (ctx.have_event)
+		yaml_event_delete(&ctx.event);
+
+	yaml_parser_delete(&ctx.parser);
+	fclose(ctx.inf);
+
+	return err;
+}
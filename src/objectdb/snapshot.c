@@ -0,0 +1,629 @@
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <predcfb/predcfb.h>
+#include <predcfb/objectid.h>
+#include <predcfb/objectdb.h>
+#include <predcfb/snapshot.h>
+
+#include "objectdb_internal.h"
+
+extern const char *progname;
+
+struct snapshot_context {
+	const unsigned char *map;
+	size_t map_size;
+
+	const struct snapshot_header *header;
+	const struct snapshot_conference *conferences;
+	const struct snapshot_team *teams;
+	const struct snapshot_game *games;
+	const char *strings;
+
+	enum snapshot_err error;
+};
+
+static uint64_t align_offset(uint64_t offset)
+{
+	return (offset + SNAPSHOT_ALIGN - 1) & ~((uint64_t) SNAPSHOT_ALIGN - 1);
+}
+
+/* snapshot writing */
+
+struct snapshot_writer {
+	FILE *outf;
+	uint64_t pos;
+	uint32_t next_string;
+};
+
+static int write_bytes(struct snapshot_writer *w, const void *buf, size_t len)
+{
+	if (fwrite(buf, 1, len, w->outf) != len)
+		return OBJECTDB_ERROR;
+
+	w->pos += len;
+
+	return OBJECTDB_OK;
+}
+
+/* pad the file out to the given offset */
+static int write_padding(struct snapshot_writer *w, uint64_t offset)
+{
+	static const char zeros[SNAPSHOT_ALIGN];
+
+	while (w->pos < offset) {
+		if (write_bytes(w, zeros, offset - w->pos) != OBJECTDB_OK)
+			return OBJECTDB_ERROR;
+	}
+
+	return OBJECTDB_OK;
+}
+
+/* names are written to the string table in the same order they're taken */
+static uint32_t take_string(struct snapshot_writer *w, const char *str)
+{
+	uint32_t offset = w->next_string;
+
+	w->next_string += strlen(str) + 1;
+
+	return offset;
+}
+
+static void columns_from_stats(int16_t *cols, const struct stats *s)
+{
+	int i;
+
+	for (i = 0; i < STATS_NUM_COLUMNS; i++)
+		cols[i] = objectdb_stats_get(s, i);
+}
+
+static void columns_from_team_stats(int32_t *cols, const struct team_stats *s)
+{
+	int i;
+
+	for (i = 0; i < STATS_NUM_COLUMNS; i++)
+		cols[i] = objectdb_team_stats_get(s, i);
+}
+
+static void fill_header(objectdb_ctx *db, struct snapshot_header *h)
+{
+	uint64_t strings_size = 0;
+	int i;
+
+	memset(h, 0, sizeof(*h));
+
+	memcpy(h->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+	h->version = SNAPSHOT_VERSION;
+	h->byte_order = SNAPSHOT_BYTE_ORDER;
+
+	h->conference_size = sizeof(struct snapshot_conference);
+	h->team_size = sizeof(struct snapshot_team);
+	h->game_size = sizeof(struct snapshot_game);
+
+	h->num_conferences = db->num_conferences;
+	h->num_teams = db->num_teams;
+	h->num_games = db->num_games;
+
+	for (i = 0; i < db->num_conferences; i++)
+		strings_size += strlen(db->conferences[i]->name.str) + 1;
+
+	for (i = 0; i < db->num_teams; i++)
+		strings_size += strlen(db->teams[i]->name.str) + 1;
+
+	h->conferences_offset = align_offset(sizeof(*h));
+	h->teams_offset = align_offset(h->conferences_offset +
+			(uint64_t) h->num_conferences * h->conference_size);
+	h->games_offset = align_offset(h->teams_offset +
+			(uint64_t) h->num_teams * h->team_size);
+	h->strings_offset = align_offset(h->games_offset +
+			(uint64_t) h->num_games * h->game_size);
+	h->strings_size = strings_size;
+}
+
+static int write_records(struct snapshot_writer *w,
+                         objectdb_ctx *db,
+                         const struct snapshot_header *h)
+{
+	struct snapshot_conference sc;
+	struct snapshot_team st;
+	struct snapshot_game sg;
+	struct objectid id;
+	int i;
+
+	if (write_padding(w, h->conferences_offset) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
+
+	for (i = 0; i < db->num_conferences; i++) {
+		const struct conference *c = db->conferences[i];
+
+		/* zeroed so the padding in the record is reproducible */
+		memset(&sc, 0, sizeof(sc));
+		objectid_from_conference(c, &id);
+		sc.id = id;
+		sc.name = take_string(w, c->name.str);
+		sc.subdivision = c->subdivision;
+
+		if (write_bytes(w, &sc, sizeof(sc)) != OBJECTDB_OK)
+			return OBJECTDB_ERROR;
+	}
+
+	if (write_padding(w, h->teams_offset) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
+
+	for (i = 0; i < db->num_teams; i++) {
+		const struct team *t = db->teams[i];
+
+		memset(&st, 0, sizeof(st));
+		objectid_from_team(t, &id);
+		st.id = id;
+		st.name = take_string(w, t->name.str);
+		st.conf = t->conf->idx;
+		columns_from_team_stats(st.stats, &t->stats);
+
+		if (write_bytes(w, &st, sizeof(st)) != OBJECTDB_OK)
+			return OBJECTDB_ERROR;
+	}
+
+	if (write_padding(w, h->games_offset) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
+
+	for (i = 0; i < db->num_games; i++) {
+		const struct game *g = db->games[i];
+
+		memset(&sg, 0, sizeof(sg));
+		objectid_from_game(g, &id);
+		sg.id = id;
+		sg.home = g->home->idx;
+		sg.away = g->away->idx;
+		sg.neutral = g->neutral;
+		sg.date = g->date;
+		columns_from_stats(sg.home_stats, &g->home_stats);
+		columns_from_stats(sg.away_stats, &g->away_stats);
+
+		if (write_bytes(w, &sg, sizeof(sg)) != OBJECTDB_OK)
+			return OBJECTDB_ERROR;
+	}
+
+	return OBJECTDB_OK;
+}
+
+static int write_strings(struct snapshot_writer *w,
+                         objectdb_ctx *db,
+                         const struct snapshot_header *h)
+{
+	const char *name;
+	int i;
+
+	if (write_padding(w, h->strings_offset) != OBJECTDB_OK)
+		return OBJECTDB_ERROR;
+
+	for (i = 0; i < db->num_conferences; i++) {
+		name = db->conferences[i]->name.str;
+		if (write_bytes(w, name, strlen(name) + 1) != OBJECTDB_OK)
+			return OBJECTDB_ERROR;
+	}
+
+	for (i = 0; i < db->num_teams; i++) {
+		name = db->teams[i]->name.str;
+		if (write_bytes(w, name, strlen(name) + 1) != OBJECTDB_OK)
+			return OBJECTDB_ERROR;
+	}
+
+	return OBJECTDB_OK;
+}
+
+int objectdb_write_snapshot(objectdb_ctx *db, const char *path)
+{
+	struct snapshot_writer w;
+	struct snapshot_header h;
+	int err = OBJECTDB_ERROR;
+
+	memset(&w, 0, sizeof(w));
+
+	w.outf = fopen(path, "wb");
+	if (!w.outf) {
+		fprintf(stderr, "%s: could not open '%s' for writing\n",
+		        progname, path);
+		return OBJECTDB_ERROR;
+	}
+
+	fill_header(db, &h);
+
+	if (write_bytes(&w, &h, sizeof(h)) != OBJECTDB_OK)
+		goto cleanup;
+
+	if (write_records(&w, db, &h) != OBJECTDB_OK)
+		goto cleanup;
+
+	if (write_strings(&w, db, &h) != OBJECTDB_OK)
+		goto cleanup;
+
+	err = OBJECTDB_OK;
+	printf("%s: wrote %d objects to %s\n", progname, db->num_objects, path);
+cleanup:
+	if (fclose(w.outf) != 0)
+		err = OBJECTDB_ERROR;
+
+	if (err != OBJECTDB_OK)
+		fprintf(stderr, "%s: error writing '%s'\n", progname, path);
+
+	return err;
+}
+
+/* snapshot reading */
+
+snapshot_ctx *snapshot_new(void)
+{
+	return calloc(1, sizeof(snapshot_ctx));
+}
+
+void snapshot_free(snapshot_ctx *snap)
+{
+	snapshot_close(snap);
+	free(snap);
+}
+
+enum snapshot_err snapshot_get_error(const snapshot_ctx *snap)
+{
+	return snap->error;
+}
+
+const char *snapshot_strerror(const snapshot_ctx *snap)
+{
+	static const char *snapshot_errors[] = {
+		"No error",
+		"Out of memory",
+		"Could not open snapshot",
+		"Not a snapshot file",
+		"Unsupported snapshot version",
+		"Snapshot is corrupt",
+		"Could not add object to the database"
+	};
+
+	return snapshot_errors[snap->error];
+}
+
+static bool table_in_range(size_t map_size, uint64_t offset,
+                           uint32_t count, uint64_t size)
+{
+	if (offset % SNAPSHOT_ALIGN != 0 || offset > map_size)
+		return false;
+
+	return count * size <= map_size - offset;
+}
+
+static int check_header(snapshot_ctx *snap)
+{
+	const struct snapshot_header *h = snap->header;
+
+	if (memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 ||
+	    h->byte_order != SNAPSHOT_BYTE_ORDER) {
+		snap->error = SNAPSHOT_EFORMAT;
+		return SNAPSHOT_ERROR;
+	}
+
+	if (h->version != SNAPSHOT_VERSION ||
+	    h->conference_size != sizeof(struct snapshot_conference) ||
+	    h->team_size != sizeof(struct snapshot_team) ||
+	    h->game_size != sizeof(struct snapshot_game)) {
+		snap->error = SNAPSHOT_EVERSION;
+		return SNAPSHOT_ERROR;
+	}
+
+	if (!table_in_range(snap->map_size, h->conferences_offset,
+	                    h->num_conferences, h->conference_size) ||
+	    !table_in_range(snap->map_size, h->teams_offset,
+	                    h->num_teams, h->team_size) ||
+	    !table_in_range(snap->map_size, h->games_offset,
+	                    h->num_games, h->game_size) ||
+	    !table_in_range(snap->map_size, h->strings_offset,
+	                    1, h->strings_size)) {
+		snap->error = SNAPSHOT_ECORRUPT;
+		return SNAPSHOT_ERROR;
+	}
+
+	return SNAPSHOT_OK;
+}
+
+/* every name and reference has to land inside its table */
+static int check_records(snapshot_ctx *snap)
+{
+	const struct snapshot_header *h = snap->header;
+	uint32_t i;
+
+	if (h->strings_size == 0 && h->num_conferences + h->num_teams > 0)
+		goto corrupt;
+
+	if (h->strings_size > 0 && snap->strings[h->strings_size - 1] != '\0')
+		goto corrupt;
+
+	for (i = 0; i < h->num_conferences; i++) {
+		if (snap->conferences[i].name >= h->strings_size)
+			goto corrupt;
+	}
+
+	for (i = 0; i < h->num_teams; i++) {
+		if (snap->teams[i].name >= h->strings_size ||
+		    snap->teams[i].conf >= h->num_conferences)
+			goto corrupt;
+	}
+
+	for (i = 0; i < h->num_games; i++) {
+		if (snap->games[i].home >= h->num_teams ||
+		    snap->games[i].away >= h->num_teams)
+			goto corrupt;
+	}
+
+	return SNAPSHOT_OK;
+
+corrupt:
+	snap->error = SNAPSHOT_ECORRUPT;
+	return SNAPSHOT_ERROR;
+}
+
+int snapshot_open(snapshot_ctx *snap, const char *path)
+{
+	const struct snapshot_header *h;
+	struct stat st;
+	void *map;
+	int fd;
+
+	snapshot_close(snap);
+
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		snap->error = SNAPSHOT_EOPEN;
+		return SNAPSHOT_ERROR;
+	}
+
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		snap->error = SNAPSHOT_EOPEN;
+		return SNAPSHOT_ERROR;
+	}
+
+	if ((size_t) st.st_size < sizeof(*h)) {
+		close(fd);
+		snap->error = SNAPSHOT_EFORMAT;
+		return SNAPSHOT_ERROR;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED) {
+		snap->error = SNAPSHOT_EOPEN;
+		return SNAPSHOT_ERROR;
+	}
+
+	snap->map = map;
+	snap->map_size = st.st_size;
+	snap->header = h = map;
+
+	if (check_header(snap) != SNAPSHOT_OK)
+		goto error;
+
+	snap->conferences = (const void *) (snap->map + h->conferences_offset);
+	snap->teams = (const void *) (snap->map + h->teams_offset);
+	snap->games = (const void *) (snap->map + h->games_offset);
+	snap->strings = (const char *) (snap->map + h->strings_offset);
+
+	if (check_records(snap) != SNAPSHOT_OK)
+		goto error;
+
+	snap->error = SNAPSHOT_ENONE;
+
+	return SNAPSHOT_OK;
+
+error:
+	/* keep the error from the checks */
+	munmap((void *) snap->map, snap->map_size);
+	snap->map = NULL;
+	snap->map_size = 0;
+
+	return SNAPSHOT_ERROR;
+}
+
+void snapshot_close(snapshot_ctx *snap)
+{
+	if (snap->map)
+		munmap((void *) snap->map, snap->map_size);
+
+	snap->map = NULL;
+	snap->map_size = 0;
+	snap->header = NULL;
+	snap->conferences = NULL;
+	snap->teams = NULL;
+	snap->games = NULL;
+	snap->strings = NULL;
+}
+
+const struct snapshot_conference *snapshot_get_conferences(
+		const snapshot_ctx *snap, int *num_conferences)
+{
+	*num_conferences = snap->header ? (int) snap->header->num_conferences : 0;
+	return snap->conferences;
+}
+
+const struct snapshot_team *snapshot_get_teams(
+		const snapshot_ctx *snap, int *num_teams)
+{
+	*num_teams = snap->header ? (int) snap->header->num_teams : 0;
+	return snap->teams;
+}
+
+const struct snapshot_game *snapshot_get_games(
+		const snapshot_ctx *snap, int *num_games)
+{
+	*num_games = snap->header ? (int) snap->header->num_games : 0;
+	return snap->games;
+}
+
+const char *snapshot_string(const snapshot_ctx *snap, uint32_t offset)
+{
+	return snap->strings + offset;
+}
+
+/* snapshot loading */
+
+static void stats_from_columns(struct stats *s, const int16_t *cols)
+{
+	int i;
+
+	for (i = 0; i < STATS_NUM_COLUMNS; i++)
+		objectdb_stats_set(s, i, cols[i]);
+}
+
+static void team_stats_from_columns(struct team_stats *s, const int32_t *cols)
+{
+	int i;
+
+	for (i = 0; i < STATS_NUM_COLUMNS; i++)
+		objectdb_team_stats_set(s, i, cols[i]);
+}
+
+/*
+ * the objects are indexed under the objectids the snapshot saved. a
+ * conference or team's objectid is the sha1 of its name, so the names
+ * are interned with them too, and nothing is hashed again
+ */
+static int load_objects(snapshot_ctx *snap,
+                        objectdb_ctx *db,
+                        struct conference **confs,
+                        struct team **teams)
+{
+	const struct snapshot_header *h = snap->header;
+	const char *name;
+	size_t len;
+	struct conference *c;
+	struct team *t;
+	struct game *g;
+	uint32_t i;
+
+	for (i = 0; i < h->num_conferences; i++) {
+		const struct snapshot_conference *sc = &snap->conferences[i];
+
+		if ((c = objectdb_create_conference(db)) == NULL)
+			goto objectdb_error;
+
+		/* a longer name couldn't have been saved with this id */
+		name = snapshot_string(snap, sc->name);
+		if ((len = strnlen(name, CONFERENCE_NAME_MAX)) >=
+		    CONFERENCE_NAME_MAX)
+			goto corrupt;
+
+		if (objectdb_intern_sha1(db, name, len, &sc->id,
+		                         &c->name) != OBJECTDB_OK)
+			goto objectdb_error;
+		c->subdivision = sc->subdivision;
+
+		if (objectdb_insert_conference(db, c, &sc->id) != OBJECTDB_OK)
+			goto objectdb_error;
+
+		confs[i] = c;
+	}
+
+	for (i = 0; i < h->num_teams; i++) {
+		const struct snapshot_team *st = &snap->teams[i];
+
+		if ((t = objectdb_create_team(db)) == NULL)
+			goto objectdb_error;
+
+		name = snapshot_string(snap, st->name);
+		if ((len = strnlen(name, TEAM_NAME_MAX)) >= TEAM_NAME_MAX)
+			goto corrupt;
+
+		if (objectdb_intern_sha1(db, name, len, &st->id,
+		                         &t->name) != OBJECTDB_OK)
+			goto objectdb_error;
+		t->conf = confs[st->conf];
+		t->conf_oid = snap->conferences[st->conf].id;
+		team_stats_from_columns(&t->stats, st->stats);
+
+		if (objectdb_insert_team(db, t, &st->id) != OBJECTDB_OK)
+			goto objectdb_error;
+
+		teams[i] = t;
+	}
+
+	for (i = 0; i < h->num_games; i++) {
+		const struct snapshot_game *sg = &snap->games[i];
+
+		if ((g = objectdb_create_game(db)) == NULL)
+			goto objectdb_error;
+
+		g->home = teams[sg->home];
+		g->home_oid = snap->teams[sg->home].id;
+		g->away = teams[sg->away];
+		g->away_oid = snap->teams[sg->away].id;
+		g->neutral = sg->neutral != 0;
+		g->date = (time_t) sg->date;
+		stats_from_columns(&g->home_stats, sg->home_stats);
+		stats_from_columns(&g->away_stats, sg->away_stats);
+
+		if (objectdb_insert_game(db, g, &sg->id) != OBJECTDB_OK)
+			goto objectdb_error;
+	}
+
+	return SNAPSHOT_OK;
+
+objectdb_error:
+	snap->error = SNAPSHOT_EOBJECTDB;
+	return SNAPSHOT_ERROR;
+
+corrupt:
+	snap->error = SNAPSHOT_ECORRUPT;
+	return SNAPSHOT_ERROR;
+}
+
+int snapshot_load(snapshot_ctx *snap, objectdb_ctx *db)
+{
+	const struct snapshot_header *h = snap->header;
+	struct conference **confs;
+	struct team **teams;
+	int err;
+
+	if (!h) {
+		snap->error = SNAPSHOT_EOPEN;
+		return SNAPSHOT_ERROR;
+	}
+
+	/* the saved objectids are sha1s, and are used as they are */
+	if (db->ids != OBJECTID_SHA1) {
+		db->error = OBJECTDB_EIDS;
+		snap->error = SNAPSHOT_EOBJECTDB;
+		return SNAPSHOT_ERROR;
+	}
+
+	err = objectdb_reserve(db, h->num_conferences + h->num_teams +
+	                           h->num_games);
+	if (err != OBJECTDB_OK) {
+		snap->error = SNAPSHOT_ENOMEM;
+		return SNAPSHOT_ERROR;
+	}
+
+	/* snapshot index -> object, for relinking the references */
+	confs = malloc((h->num_conferences + 1) * sizeof(*confs));
+	teams = malloc((h->num_teams + 1) * sizeof(*teams));
+	if (!confs || !teams) {
+		free(confs);
+		free(teams);
+		snap->error = SNAPSHOT_ENOMEM;
+		return SNAPSHOT_ERROR;
+	}
+
+	err = load_objects(snap, db, confs, teams);
+
+	free(confs);
+	free(teams);
+
+	return err;
+}
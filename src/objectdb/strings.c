@@ -0,0 +1,216 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <predcfb/predcfb.h>
+#include <predcfb/objectid.h>
+#include <predcfb/objectdb.h>
+
+#include "objectdb_internal.h"
+
+/*
+ * string pool
+ *
+ * conference and team names come up over and over: once per season in
+ * a multi-season load, and again in every game's objectid. each name is
+ * kept once, with its objectids worked out up front, and objects only
+ * hold a pointer to it and its 32 bit ref. the table is open addressing
+ * with linear probing over refs, keyed by the low bits of the name's
+ * fast hash, which is computed anyway
+ */
+
+#define STRINGS_TABLE_SIZE 256
+
+/* grow once the table is half full */
+#define STRINGS_LOAD_NUM 1
+#define STRINGS_LOAD_DEN 2
+
+static bool over_load_factor(size_t count, size_t size)
+{
+	return (count * STRINGS_LOAD_DEN) > (size * STRINGS_LOAD_NUM);
+}
+
+/* place ref without checking for duplicates, there must be a free slot */
+static void place(struct string_pool *sp, uint32_t ref, uint32_t hash)
+{
+	const size_t mask = sp->size - 1;
+	size_t i;
+
+	for (i = hash & mask; sp->slots[i] != 0; i = (i + 1) & mask)
+		;
+
+	sp->slots[i] = ref;
+}
+
+static int resize(struct string_pool *sp, size_t new_size)
+{
+	uint32_t *slots;
+	int i;
+
+	if ((slots = calloc(new_size, sizeof(*slots))) == NULL)
+		return OBJECTDB_ERROR;
+
+	free(sp->slots);
+	sp->slots = slots;
+	sp->size = new_size;
+
+	for (i = 0; i < sp->num_names; i++)
+		place(sp, i + 1, sp->names[i]->hash);
+
+	return OBJECTDB_OK;
+}
+
+static int grow_names(struct string_pool *sp)
+{
+	struct pooled_name **names;
+	int max;
+
+	max = sp->max_names ? sp->max_names * 2 : OBJECTDB_LIST_SIZE;
+
+	if ((names = realloc(sp->names, max * sizeof(*names))) == NULL)
+		return OBJECTDB_ERROR;
+
+	sp->names = names;
+	sp->max_names = max;
+
+	return OBJECTDB_OK;
+}
+
+static uint32_t find(const struct string_pool *sp,
+                     const char *str,
+                     size_t len,
+                     uint32_t hash)
+{
+	const struct pooled_name *pn;
+	const size_t mask = sp->size - 1;
+	uint32_t ref;
+	size_t i;
+
+	if (sp->num_names == 0)
+		return 0;
+
+	for (i = hash & mask; (ref = sp->slots[i]) != 0; i = (i + 1) & mask) {
+		pn = sp->names[ref - 1];
+
+		if (pn->hash == hash && pn->len == len &&
+		    memcmp(pn->str, str, len) == 0)
+			return ref;
+	}
+
+	return 0;
+}
+
+static struct pooled_name *new_name(struct arena *a,
+                                    const char *str,
+                                    size_t len,
+                                    const struct objectid *fast,
+                                    const struct objectid *sha1)
+{
+	struct pooled_name *pn;
+
+	if ((pn = arena_alloc(a, sizeof(*pn) + len + 1)) == NULL)
+		return NULL;
+
+	memcpy(pn->str, str, len);
+	pn->str[len] = '\0';
+	pn->len = len;
+
+	pn->fast = *fast;
+	memcpy(&pn->hash, fast->md, sizeof(pn->hash));
+	if (sha1)
+		pn->sha1 = *sha1;
+	else
+		hash_sha1_id(str, len, &pn->sha1);
+
+	return pn;
+}
+
+void strings_init(struct string_pool *sp)
+{
+	sp->names = NULL;
+	sp->num_names = 0;
+	sp->max_names = 0;
+
+	sp->slots = NULL;
+	sp->size = 0;
+}
+
+void strings_destroy(struct string_pool *sp)
+{
+	free(sp->names);
+	free(sp->slots);
+	strings_init(sp);
+}
+
+void strings_clear(struct string_pool *sp)
+{
+	if (sp->slots)
+		memset(sp->slots, 0, sp->size * sizeof(*sp->slots));
+
+	sp->num_names = 0;
+}
+
+int strings_intern(struct string_pool *sp,
+                   struct arena *a,
+                   const char *str,
+                   size_t len,
+                   const struct objectid *sha1,
+                   struct name *n)
+{
+	struct pooled_name *pn;
+	struct objectid fast;
+	uint32_t hash;
+	uint32_t ref;
+
+	/* names go into game objectid messages, see objectid.c */
+	if (len >= TEAM_NAME_MAX)
+		return OBJECTDB_ETOOLONG;
+
+	hash_fast_id(str, len, &fast);
+	memcpy(&hash, fast.md, sizeof(hash));
+
+	if ((ref = find(sp, str, len, hash)) != 0) {
+		n->str = sp->names[ref - 1]->str;
+		n->ref = ref;
+		return OBJECTDB_ENONE;
+	}
+
+	if (sp->size == 0 || over_load_factor(sp->num_names + 1, sp->size)) {
+		if (resize(sp, sp->size ? sp->size * 2 : STRINGS_TABLE_SIZE)
+		    != OBJECTDB_OK)
+			return OBJECTDB_ENOMEM;
+	}
+
+	if (sp->num_names >= sp->max_names && grow_names(sp) != OBJECTDB_OK)
+		return OBJECTDB_ENOMEM;
+
+	if ((pn = new_name(a, str, len, &fast, sha1)) == NULL)
+		return OBJECTDB_ENOMEM;
+
+	sp->names[sp->num_names] = pn;
+	sp->num_names++;
+
+	ref = sp->num_names;
+	place(sp, ref, hash);
+
+	n->str = pn->str;
+	n->ref = ref;
+
+	return OBJECTDB_ENONE;
+}
+
+const struct pooled_name *strings_lookup(const struct string_pool *sp,
+                                         uint32_t ref)
+{
+	if (ref == 0 || ref > (uint32_t) sp->num_names)
+		return NULL;
+
+	return sp->names[ref - 1];
+}
+
+const struct pooled_name *strings_pooled(const struct name *n)
+{
+	return (const struct pooled_name *)
+	       (n->str - offsetof(struct pooled_name, str));
+}
@@ -7,27 +7,30 @@
 #include <yaml.h>
 
 #include <predcfb/predcfb.h>
-#include <predcfb/options.h>
+#include <predcfb/date.h>
 #include <predcfb/objectdb.h>
 #include <predcfb/objectid.h>
 
 #include "objectdb_internal.h"
 
+extern const char *progname;
+
 struct save_context {
+	const char *path;
 	FILE *outf;
 	yaml_emitter_t emitter;
 	yaml_event_t event;
 
-	const struct object *objects;
+	struct object * const *objects;
 	int num_objects;
 };
 
 static int open_file(struct save_context *ctx)
 {
-	ctx->outf = fopen(opt_save_file, "w");
+	ctx->outf = fopen(ctx->path, "w");
 	if (!ctx->outf) {
 		fprintf(stderr, "%s: could not open '%s' for writing\n",
-		        progname, opt_save_file);
+		        progname, ctx->path);
 		return OBJECTDB_ERROR;
 	}
 
@@ -258,7 +261,7 @@ static int emit_conference(struct save_context *ctx, const struct object *o)
 	if (emit_scalar_map(ctx, "conference") != OBJECTDB_OK)
 		return OBJECTDB_ERROR;
 
-	if (emit_scalar(ctx, "name", o->data.conf->name) != OBJECTDB_OK)
+	if (emit_scalar(ctx, "name", o->data.conf->name.str) != OBJECTDB_OK)
 		return OBJECTDB_ERROR;
 
 	switch (o->data.conf->subdivision) {
@@ -289,7 +292,7 @@ static int emit_team(struct save_context *ctx, const struct object *o)
 	if (emit_scalar_map(ctx, "team") != OBJECTDB_OK)
 		return OBJECTDB_ERROR;
 
-	if (emit_scalar(ctx, "name", o->data.team->name) != OBJECTDB_OK)
+	if (emit_scalar(ctx, "name", o->data.team->name.str) != OBJECTDB_OK)
 		return OBJECTDB_ERROR;
 
 	if (emit_scalar(ctx, "conf_sha1", buf) != OBJECTDB_OK)
@@ -303,16 +306,13 @@ static int emit_team(struct save_context *ctx, const struct object *o)
 
 static int emit_game(struct save_context *ctx, const struct object *o)
 {
-	const int date_len = 11;
 	char buf[OBJECTID_MD_STR_SIZE];
-	char date[date_len];
-	struct tm tm;
+	char date[DATE_STR_SIZE];
 
 	if (emit_scalar_map(ctx, "game") != OBJECTDB_OK)
 		return OBJECTDB_ERROR;
 
-	gmtime_r(&o->data.game->date, &tm);
-	strftime(date, date_len, "%F", &tm);
+	date_string(o->data.game->date, date);
 
 	if (emit_scalar(ctx, "date", date) != OBJECTDB_OK)
 		return OBJECTDB_ERROR;
@@ -377,7 +377,7 @@ static int emit_objects(struct save_context *ctx)
 		return OBJECTDB_ERROR;
 
 	for (i = 0; i < ctx->num_objects; i++) {
-		if (emit_object(ctx, &ctx->objects[i]) != OBJECTDB_OK)
+		if (emit_object(ctx, ctx->objects[i]) != OBJECTDB_OK)
 			return OBJECTDB_ERROR;
 	}
 
@@ -387,13 +387,16 @@ static int emit_objects(struct save_context *ctx)
 	return OBJECTDB_OK;
 }
 
-int objectdb_write_yaml(const struct object *objects, int num_objects)
+int objectdb_write_yaml(struct object * const *objects,
+                        int num_objects,
+                        const char *path)
 {
 	struct save_context ctx;
 	int err = OBJECTDB_ERROR;
 
 	memset(&ctx, 0, sizeof(ctx));
 
+	ctx.path = path;
 	ctx.objects = objects;
 	ctx.num_objects = num_objects;
 
@@ -410,8 +413,7 @@ int objectdb_write_yaml(const struct object *objects, int num_objects)
 		goto cleanup;
 
 	err = OBJECTDB_OK;
-	printf("%s: wrote %d objects to %s\n", progname, num_objects,
-	                                       opt_save_file);
+	printf("%s: wrote %d objects to %s\n", progname, num_objects, path);
 cleanup:
 	yaml_emitter_delete(&ctx.emitter);
 	fclose(ctx.outf);
@@ -1,5 +1,6 @@
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <getopt.h>
 #include <predcfb/options.h>
 
@@ -8,14 +9,29 @@ const char *progname;
 bool opt_help = false;
 bool opt_version = false;
 bool opt_save = false;
+bool opt_snapshot = false;
+bool opt_fast_ids = false;
 
-const char *opt_archive = NULL;
+const char **opt_archives = NULL;
+int opt_num_archives = 0;
 const char *opt_save_file = "predcfb.yml";
+const char *opt_snapshot_file = "predcfb.snap";
+const char *opt_load_file = NULL;
+const char **opt_append_files = NULL;
+int opt_num_append_files = 0;
+const char *opt_season = NULL;
+int opt_jobs = 0;
 
 enum long_opts {
 	LONG_OPT_HELP,
 	LONG_OPT_VERSION,
-	LONG_OPT_SAVE
+	LONG_OPT_SAVE,
+	LONG_OPT_SNAPSHOT,
+	LONG_OPT_LOAD,
+	LONG_OPT_JOBS,
+	LONG_OPT_FAST_IDS,
+	LONG_OPT_APPEND,
+	LONG_OPT_SEASON
 };
 
 int options_parse(int argc, char **argv)
@@ -27,9 +43,22 @@ int options_parse(int argc, char **argv)
 		{ "help", 0, NULL, LONG_OPT_HELP },
 		{ "version", 0, NULL, LONG_OPT_VERSION },
 		{ "save", 2, NULL, LONG_OPT_SAVE },
+		{ "snapshot", 2, NULL, LONG_OPT_SNAPSHOT },
+		{ "load", 1, NULL, LONG_OPT_LOAD },
+		{ "jobs", 1, NULL, LONG_OPT_JOBS },
+		{ "fast-ids", 0, NULL, LONG_OPT_FAST_IDS },
+		{ "append", 1, NULL, LONG_OPT_APPEND },
+		{ "season", 1, NULL, LONG_OPT_SEASON },
 		{ NULL, 0, NULL, 0 }
 	};
 
+	/* --append can be given any number of times, up to one per arg */
+	opt_append_files = malloc(sizeof(*opt_append_files) * argc);
+	if (!opt_append_files) {
+		fprintf(stderr, "%s: out of memory\n", argv[0]);
+		return -5;
+	}
+
 	while ((c = getopt_long(argc, argv, "", long_options, &index)) != -1) {
 		switch (c) {
 		case LONG_OPT_HELP:
@@ -48,25 +77,56 @@ int options_parse(int argc, char **argv)
 				opt_save_file = optarg;
 			break;
 
+		case LONG_OPT_SNAPSHOT:
+			opt_snapshot = true;
+			if (optarg)
+				opt_snapshot_file = optarg;
+			break;
+
+		case LONG_OPT_LOAD:
+			opt_load_file = optarg;
+			require_file = false;
+			break;
+
+		case LONG_OPT_JOBS:
+			opt_jobs = atoi(optarg);
+			if (opt_jobs < 1) {
+				fprintf(stderr, "%s: invalid number of jobs\n",
+				        argv[0]);
+				return -2;
+			}
+			break;
+
+		case LONG_OPT_FAST_IDS:
+			opt_fast_ids = true;
+			break;
+
+		case LONG_OPT_APPEND:
+			opt_append_files[opt_num_append_files++] = optarg;
+			break;
+
+		case LONG_OPT_SEASON:
+			opt_season = optarg;
+			break;
+
 		case '?':
 			return -1;
 		}
 	}
 
-	/* handle non-options */
-	while (optind < argc) {
-		if (!opt_archive) {
-			opt_archive = argv[optind];
-		} else {
-			fprintf(stderr, "Only one file can be specified\n");
-			return -2;
-		}
-
-		optind++;
+	/* fast ids only mean anything inside this run */
+	if (opt_fast_ids && (opt_save || opt_snapshot || opt_load_file)) {
+		fprintf(stderr, "%s: --fast-ids can't be used with "
+		        "--save, --snapshot or --load\n", argv[0]);
+		return -4;
 	}
 
+	/* handle non-options, getopt_long moves them all to the end */
+	opt_archives = (const char **) &argv[optind];
+	opt_num_archives = argc - optind;
+
 	/* ensure that a filename was provided */
-	if (!opt_archive && require_file) {
+	if (opt_num_archives == 0 && require_file) {
 		fprintf(stderr, "%s: missing file operand\n", argv[0]);
 		return -3;
 	}
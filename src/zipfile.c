@@ -2,20 +2,75 @@
 #include <string.h>
 #include <assert.h>
 #include <errno.h>
+#include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include <zlib.h>
+
 #include <minizip/unzip.h>
 #include <predcfb/zipfile.h>
 
+/*
+ * what a backend needs to find a member's data, kept alongside the
+ * member's zipfile_stat
+ */
+struct zip_member {
+	size_t name_offset;
+	size_t name_len;
+
+	/* mapped backend */
+	uint16_t method;
+	uint32_t local_offset;
+
+	/* minizip backend */
+	unz64_file_pos pos;
+};
+
 /*
  * This structure will keep track of the library handles and all of
  * the other variables used during the reading of a zipfile
  */
 struct zipfile_read_context {
+	enum zipfile_backend backend;
+
+	/* minizip backend */
 	unzFile unzip_handle;
+
+	/* mapped backend */
+	unsigned char *map;
+	size_t map_size;
+
+	/*
+	 * every member of the archive, read from the central directory
+	 * once when the archive is opened, and an index of them by name.
+	 * index holds a member's position + 1, 0 for an empty slot
+	 */
+	struct zipfile_stat *stats;
+	struct zip_member *members;
+	int num_members;
+	char *names;
+	size_t names_used;
+	size_t names_max;
+	int *index;
+	size_t index_size;
+
+	/*
+	 * the whole of the open file, once it has been inflated (always,
+	 * with the mapped backend). owned is false for a stored member,
+	 * which is a view of the mapping
+	 */
+	char *data;
+	size_t size;
+	size_t pos;
+	bool owned;
+
 	bool archive_open;
 	bool file_open;
 	enum zipfile_err error;
@@ -125,27 +180,411 @@ int zipfile_check_format(const char *path)
 	return err;
 }
 
+/* the member directory */
+
+#define ZIP_INDEX_MIN_SIZE   16
+#define ZIP_NAMES_SIZE       1024
+
+static int alloc_directory(zf_readctx *z, size_t num)
+{
+	z->stats = calloc(num ? num : 1, sizeof(*z->stats));
+	z->members = calloc(num ? num : 1, sizeof(*z->members));
+	if (!z->stats || !z->members)
+		return ZIPFILE_ERROR;
+
+	return ZIPFILE_OK;
+}
+
+static void free_directory(zf_readctx *z)
+{
+	free(z->stats);
+	free(z->members);
+	free(z->names);
+	free(z->index);
+
+	z->stats = NULL;
+	z->members = NULL;
+	z->num_members = 0;
+	z->names = NULL;
+	z->names_used = 0;
+	z->names_max = 0;
+	z->index = NULL;
+	z->index_size = 0;
+}
+
+/*
+ * the next member, whose name is copied so it can be nul terminated. a
+ * NULL name only makes room for it
+ */
+static struct zip_member *add_member(zf_readctx *z,
+                                     const char *name,
+                                     size_t len)
+{
+	struct zip_member *m;
+	size_t max;
+	char *names;
+
+	if (z->names_used + len + 1 > z->names_max) {
+		max = z->names_max ? z->names_max : ZIP_NAMES_SIZE;
+		while (z->names_used + len + 1 > max)
+			max *= 2;
+
+		if ((names = realloc(z->names, max)) == NULL)
+			return NULL;
+
+		z->names = names;
+		z->names_max = max;
+	}
+
+	m = &z->members[z->num_members];
+	m->name_offset = z->names_used;
+	m->name_len = len;
+
+	if (name)
+		memcpy(z->names + z->names_used, name, len);
+	z->names[z->names_used + len] = '\0';
+	z->names_used += len + 1;
+
+	z->num_members++;
+
+	return m;
+}
+
+static size_t hash_name(const char *name, size_t len)
+{
+	uint32_t h = 2166136261u;
+	size_t i;
+
+	/* fnv-1a */
+	for (i = 0; i < len; i++) {
+		h ^= (unsigned char) name[i];
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+/*
+ * point the stats at the names, now that they have stopped moving, and
+ * index the members. with duplicate names the first one wins, like
+ * unzLocateFile
+ */
+static int finish_directory(zf_readctx *z)
+{
+	const struct zip_member *m, *other;
+	size_t size = ZIP_INDEX_MIN_SIZE;
+	size_t mask, slot;
+	int i;
+
+	while (size < (size_t) z->num_members * 2)
+		size *= 2;
+
+	if ((z->index = calloc(size, sizeof(*z->index))) == NULL)
+		return ZIPFILE_ERROR;
+
+	z->index_size = size;
+	mask = size - 1;
+
+	for (i = 0; i < z->num_members; i++) {
+		m = &z->members[i];
+		z->stats[i].name = z->names + m->name_offset;
+
+		slot = hash_name(z->stats[i].name, m->name_len) & mask;
+		for (; z->index[slot] != 0; slot = (slot + 1) & mask) {
+			other = &z->members[z->index[slot] - 1];
+			if (other->name_len == m->name_len &&
+			    memcmp(z->names + other->name_offset,
+			           z->stats[i].name, m->name_len) == 0)
+				break;
+		}
+
+		if (z->index[slot] == 0)
+			z->index[slot] = i + 1;
+	}
+
+	return ZIPFILE_OK;
+}
+
+/* the position of the member named file, -1 if there isn't one */
+static int find_member(const zf_readctx *z, const char *file)
+{
+	const struct zip_member *m;
+	size_t len = strlen(file);
+	size_t mask = z->index_size - 1;
+	size_t slot;
+
+	slot = hash_name(file, len) & mask;
+	for (; z->index[slot] != 0; slot = (slot + 1) & mask) {
+		m = &z->members[z->index[slot] - 1];
+		if (m->name_len == len &&
+		    memcmp(z->names + m->name_offset, file, len) == 0)
+			return z->index[slot] - 1;
+	}
+
+	return -1;
+}
+
+/* mapped archives */
+
+#define ZIP_LOCAL_SIG        0x04034b50
+#define ZIP_CENTRAL_SIG      0x02014b50
+#define ZIP_END_SIG          0x06054b50
+
+#define ZIP_LOCAL_SIZE       30
+#define ZIP_CENTRAL_SIZE     46
+#define ZIP_END_SIZE         22
+#define ZIP_COMMENT_MAX      0xffff
+
+#define ZIP_FLAG_ENCRYPTED   0x0001
+#define ZIP_METHOD_STORED    0
+#define ZIP_METHOD_DEFLATED  8
+
+static uint16_t get_le16(const unsigned char *p)
+{
+	return (uint16_t) (p[0] | (p[1] << 8));
+}
+
+static uint32_t get_le32(const unsigned char *p)
+{
+	return (uint32_t) p[0] | ((uint32_t) p[1] << 8) |
+	       ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+/* the end of central directory record, searching back over a comment */
+static const unsigned char *find_end_record(const zf_readctx *z)
+{
+	const unsigned char *p;
+	size_t back;
+
+	if (z->map_size < ZIP_END_SIZE)
+		return NULL;
+
+	for (back = 0; back <= ZIP_COMMENT_MAX; back++) {
+		if (back > z->map_size - ZIP_END_SIZE)
+			break;
+
+		p = z->map + z->map_size - ZIP_END_SIZE - back;
+		if (get_le32(p) == ZIP_END_SIG && get_le16(p + 20) == back)
+			return p;
+	}
+
+	return NULL;
+}
+
+/*
+ * read every central directory entry. anything this backend doesn't
+ * handle (zip64, encryption, methods other than store and deflate)
+ * fails, so the archive can be left to minizip
+ */
+static int read_central_directory(zf_readctx *z)
+{
+	const unsigned char *end, *p;
+	struct zipfile_stat *st;
+	struct zip_member *m;
+	size_t offset, cd_end;
+	uint16_t flags, method;
+	uint32_t local_offset;
+	int num, i;
+
+	if ((end = find_end_record(z)) == NULL)
+		return ZIPFILE_ERROR;
+
+	num = get_le16(end + 10);
+	offset = get_le32(end + 16);
+	cd_end = offset + get_le32(end + 12);
+
+	/* multi-disk and zip64 archives */
+	if (get_le16(end + 4) != 0 || num != get_le16(end + 8) ||
+	    num == 0xffff || offset == 0xffffffff ||
+	    cd_end > (size_t) (end - z->map))
+		return ZIPFILE_ERROR;
+
+	if (alloc_directory(z, num) != ZIPFILE_OK)
+		return ZIPFILE_ERROR;
+
+	for (i = 0; i < num; i++) {
+		if (offset + ZIP_CENTRAL_SIZE > cd_end)
+			return ZIPFILE_ERROR;
+
+		p = z->map + offset;
+		st = &z->stats[i];
+
+		if (get_le32(p) != ZIP_CENTRAL_SIG)
+			return ZIPFILE_ERROR;
+
+		flags = get_le16(p + 8);
+		method = get_le16(p + 10);
+		st->crc = get_le32(p + 16);
+		st->compressed_size = get_le32(p + 20);
+		st->size = get_le32(p + 24);
+		local_offset = get_le32(p + 42);
+
+		if ((flags & ZIP_FLAG_ENCRYPTED) ||
+		    (method != ZIP_METHOD_STORED &&
+		     method != ZIP_METHOD_DEFLATED) ||
+		    st->compressed_size == 0xffffffff ||
+		    st->size == 0xffffffff ||
+		    local_offset == 0xffffffff)
+			return ZIPFILE_ERROR;
+
+		if (offset + ZIP_CENTRAL_SIZE + get_le16(p + 28) > cd_end)
+			return ZIPFILE_ERROR;
+
+		m = add_member(z, (const char *) p + ZIP_CENTRAL_SIZE,
+		               get_le16(p + 28));
+		if (!m)
+			return ZIPFILE_ERROR;
+
+		m->method = method;
+		m->local_offset = local_offset;
+
+		offset += ZIP_CENTRAL_SIZE + m->name_len +
+		          get_le16(p + 30) + get_le16(p + 32);
+		if (offset > cd_end)
+			return ZIPFILE_ERROR;
+	}
+
+	return finish_directory(z);
+}
+
+static void unmap_archive(zf_readctx *z)
+{
+	if (z->map)
+		munmap(z->map, z->map_size);
+
+	free_directory(z);
+
+	z->map = NULL;
+	z->map_size = 0;
+}
+
+/*
+ * the mapping is private and writable, so an open file's data can be
+ * parsed in place even when it is a view of a stored member: only the
+ * pages that are written to get copied
+ */
+static int map_archive(zf_readctx *z, const char *path)
+{
+	struct stat st;
+	void *map;
+	int fd;
+
+	if ((fd = open(path, O_RDONLY)) < 0)
+		return ZIPFILE_ERROR;
+
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return ZIPFILE_ERROR;
+	}
+
+	map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+	           fd, 0);
+	close(fd);
+
+	if (map == MAP_FAILED)
+		return ZIPFILE_ERROR;
+
+	z->map = map;
+	z->map_size = st.st_size;
+
+	if (read_central_directory(z) != ZIPFILE_OK) {
+		unmap_archive(z);
+		return ZIPFILE_ERROR;
+	}
+
+	return ZIPFILE_OK;
+}
+
+/* minizip archives */
+
+/* the same directory, walked through minizip */
+static int read_minizip_directory(zf_readctx *z)
+{
+	unz_global_info64 global;
+	unz_file_info64 info;
+	struct zipfile_stat *st;
+	struct zip_member *m;
+	int err;
+
+	if (unzGetGlobalInfo64(z->unzip_handle, &global) != UNZ_OK ||
+	    global.number_entry > INT_MAX)
+		return ZIPFILE_ERROR;
+
+	if (alloc_directory(z, global.number_entry) != ZIPFILE_OK)
+		return ZIPFILE_ERROR;
+
+	err = unzGoToFirstFile(z->unzip_handle);
+	while (err == UNZ_OK && z->num_members < (int) global.number_entry) {
+		st = &z->stats[z->num_members];
+
+		if (unzGetCurrentFileInfo64(z->unzip_handle, &info,
+		                            NULL, 0, NULL, 0, NULL, 0) != UNZ_OK)
+			return ZIPFILE_ERROR;
+
+		st->crc = info.crc;
+		st->compressed_size = info.compressed_size;
+		st->size = info.uncompressed_size;
+
+		/* the name goes straight into the space made for it */
+		if ((m = add_member(z, NULL, info.size_filename)) == NULL ||
+		    unzGetCurrentFileInfo64(z->unzip_handle, NULL,
+		                            z->names + m->name_offset,
+		                            m->name_len + 1,
+		                            NULL, 0, NULL, 0) != UNZ_OK ||
+		    unzGetFilePos64(z->unzip_handle, &m->pos) != UNZ_OK)
+			return ZIPFILE_ERROR;
+
+		err = unzGoToNextFile(z->unzip_handle);
+	}
+
+	if (err != UNZ_OK && err != UNZ_END_OF_LIST_OF_FILE)
+		return ZIPFILE_ERROR;
+
+	return finish_directory(z);
+}
+
+static int open_minizip(zf_readctx *z, const char *path)
+{
+	z->unzip_handle = unzOpen64(path);
+	if (!z->unzip_handle)
+		return ZIPFILE_ERROR;
+
+	if (read_minizip_directory(z) != ZIPFILE_OK) {
+		free_directory(z);
+		unzClose(z->unzip_handle);
+		z->unzip_handle = NULL;
+		return ZIPFILE_ERROR;
+	}
+
+	z->backend = ZIPFILE_BACKEND_MINIZIP;
+
+	return ZIPFILE_OK;
+}
+
 zf_readctx *zipfile_open_archive(const char *path)
+{
+	return zipfile_open_archive_backend(path, ZIPFILE_BACKEND_MMAP);
+}
+
+zf_readctx *zipfile_open_archive_backend(const char *path,
+                                         enum zipfile_backend backend)
 {
 	zf_readctx *z;
 
-	z = malloc(sizeof(*z));
+	z = calloc(1, sizeof(*z));
 	if (!z)
 		return NULL;
 
-	z->unzip_handle = unzOpen(path);
-	if (!z->unzip_handle) {
+	if (zipfile_check_access(z, path) != ZIPFILE_OK)
+		return z;
 
-		/* if there is no access error, then the unzip library
-		 * is refusing to read the file. this probably means that
-		 * the file is malformed: set z->error to indicate a bad
-		 * file. if there was an access error, then z->error
-		 * was already set
+	if (backend == ZIPFILE_BACKEND_MMAP && map_archive(z, path) == ZIPFILE_OK)
+		z->backend = ZIPFILE_BACKEND_MMAP;
+	else if (open_minizip(z, path) != ZIPFILE_OK) {
+		/* the unzip library is refusing to read the file, so it is
+		 * probably malformed
 		 */
-
-		if (zipfile_check_access(z, path) == ZIPFILE_OK)
-			z->error = ZIPFILE_EFILEBAD;
-
+		z->error = ZIPFILE_EFILEBAD;
 		return z;
 	}
 
@@ -162,30 +601,178 @@ int zipfile_close_archive(zf_readctx *z)
 	if (check_open_states(z, true, false) != ZIPFILE_OK)
 		return ZIPFILE_ERROR;
 
-	if (unzClose(z->unzip_handle) != UNZ_OK) {
+	if (z->backend == ZIPFILE_BACKEND_MMAP) {
+		unmap_archive(z);
+	} else if (unzClose(z->unzip_handle) != UNZ_OK) {
 		z->error = ZIPFILE_EINTERNAL;
 		return ZIPFILE_ERROR;
 	}
 
+	free_directory(z);
+
 	z->archive_open = false;
 	free(z);
 
 	return ZIPFILE_OK;
 }
 
+enum zipfile_backend zipfile_get_backend(const zf_readctx *z)
+{
+	return z->backend;
+}
+
+int zipfile_list(zf_readctx *z, const struct zipfile_stat **stats)
+{
+	if (!z->archive_open) {
+		z->error = ZIPFILE_ENOTOPEN;
+		return ZIPFILE_ERROR;
+	}
+
+	*stats = z->stats;
+
+	return z->num_members;
+}
+
+int zipfile_stat(zf_readctx *z, const char *file, struct zipfile_stat *st)
+{
+	int i;
+
+	if (!z->archive_open) {
+		z->error = ZIPFILE_ENOTOPEN;
+		return ZIPFILE_ERROR;
+	}
+
+	if ((i = find_member(z, file)) < 0) {
+		z->error = ZIPFILE_ENOENT;
+		return ZIPFILE_ERROR;
+	}
+
+	*st = z->stats[i];
+
+	return ZIPFILE_OK;
+}
+
 /* functions for extracting files inside the archive */
 
+/* the whole member in one inflate call, into a buffer of the right size */
+static int inflate_member(zf_readctx *z,
+                          const struct zipfile_stat *st,
+                          const unsigned char *in)
+{
+	z_stream strm;
+	int err;
+
+	/* one spare byte, so an empty member still gets a buffer */
+	if ((z->data = malloc((size_t) st->size + 1)) == NULL) {
+		z->error = ZIPFILE_EINTERNAL;
+		return ZIPFILE_ERROR;
+	}
+
+	z->owned = true;
+
+	memset(&strm, 0, sizeof(strm));
+	if (inflateInit2(&strm, -MAX_WBITS) != Z_OK) {
+		z->error = ZIPFILE_EINTERNAL;
+		return ZIPFILE_ERROR;
+	}
+
+	strm.next_in = (unsigned char *) in;
+	strm.avail_in = st->compressed_size;
+	strm.next_out = (unsigned char *) z->data;
+	strm.avail_out = st->size + 1;
+
+	err = inflate(&strm, Z_FINISH);
+	inflateEnd(&strm);
+
+	if (err != Z_STREAM_END || strm.total_out != st->size) {
+		z->error = ZIPFILE_EFILEBAD;
+		return ZIPFILE_ERROR;
+	}
+
+	return ZIPFILE_OK;
+}
+
+static int open_mapped_file(zf_readctx *z, int i)
+{
+	const struct zip_member *m = &z->members[i];
+	const struct zipfile_stat *st = &z->stats[i];
+	const unsigned char *p;
+	size_t offset;
+
+	/* the member's data follows its local header */
+	offset = m->local_offset;
+	if (offset + ZIP_LOCAL_SIZE > z->map_size ||
+	    get_le32(z->map + offset) != ZIP_LOCAL_SIG) {
+		z->error = ZIPFILE_EFILEBAD;
+		return ZIPFILE_ERROR;
+	}
+
+	p = z->map + offset;
+	offset += ZIP_LOCAL_SIZE + get_le16(p + 26) + get_le16(p + 28);
+	if (offset + st->compressed_size > z->map_size) {
+		z->error = ZIPFILE_EFILEBAD;
+		return ZIPFILE_ERROR;
+	}
+
+	if (m->method == ZIP_METHOD_STORED) {
+		if (st->compressed_size != st->size) {
+			z->error = ZIPFILE_EFILEBAD;
+			return ZIPFILE_ERROR;
+		}
+
+		z->data = (char *) z->map + offset;
+		z->owned = false;
+	} else if (inflate_member(z, st, z->map + offset) != ZIPFILE_OK) {
+		free(z->data);
+		z->data = NULL;
+		return ZIPFILE_ERROR;
+	}
+
+	z->size = st->size;
+
+	if (crc32(0, (const unsigned char *) z->data, z->size) != st->crc) {
+		if (z->owned)
+			free(z->data);
+		z->data = NULL;
+		z->error = ZIPFILE_EFILEBAD;
+		return ZIPFILE_ERROR;
+	}
+
+	return ZIPFILE_OK;
+}
+
 int zipfile_open_file(zf_readctx *z, const char *file)
 {
+	int i;
+
 	/* archive open and file closed */
 	if (check_open_states(z, true, false) != ZIPFILE_OK)
 		return ZIPFILE_ERROR;
 
-	if (unzLocateFile(z->unzip_handle, file, 1) != UNZ_OK) {
+	z->data = NULL;
+	z->size = 0;
+	z->pos = 0;
+	z->owned = false;
+
+	if ((i = find_member(z, file)) < 0) {
 		z->error = ZIPFILE_ENOENT;
 		return ZIPFILE_ERROR;
 	}
 
+	if (z->backend == ZIPFILE_BACKEND_MMAP) {
+		if (open_mapped_file(z, i) != ZIPFILE_OK)
+			return ZIPFILE_ERROR;
+
+		z->file_open = true;
+		return ZIPFILE_OK;
+	}
+
+	/* straight to the member's entry, rather than searching for it */
+	if (unzGoToFilePos64(z->unzip_handle, &z->members[i].pos) != UNZ_OK) {
+		z->error = ZIPFILE_EINTERNAL;
+		return ZIPFILE_ERROR;
+	}
+
 	if (unzOpenCurrentFile(z->unzip_handle) != UNZ_OK) {
 		z->error = ZIPFILE_EINTERNAL;
 		return ZIPFILE_ERROR;
@@ -198,20 +785,77 @@ int zipfile_open_file(zf_readctx *z, const char *file)
 
 int zipfile_close_file(zf_readctx *z)
 {
+	int err = ZIPFILE_OK;
+
 	/* archive open and file open */
 	if (check_open_states(z, true, true) != ZIPFILE_OK)
 		return ZIPFILE_ERROR;
 
-	if (unzCloseCurrentFile(z->unzip_handle) != UNZ_OK)
-		return ZIPFILE_ERROR;
+	if (z->backend == ZIPFILE_BACKEND_MINIZIP &&
+	    unzCloseCurrentFile(z->unzip_handle) != UNZ_OK)
+		err = ZIPFILE_ERROR;
 
+	if (z->owned)
+		free(z->data);
+
+	z->data = NULL;
+	z->owned = false;
 	z->file_open = false;
 
-	return ZIPFILE_OK;
+	return err;
 }
 
 /* functions for reading data from the zipfile */
 
+/* with minizip, the rest of the file is inflated into a buffer first */
+static int read_minizip_data(zf_readctx *z)
+{
+	unz_file_info info;
+	size_t max;
+	int bytes;
+
+	if (unzGetCurrentFileInfo(z->unzip_handle, &info, NULL, 0,
+	                          NULL, 0, NULL, 0) != UNZ_OK) {
+		z->error = ZIPFILE_EINTERNAL;
+		return ZIPFILE_ERROR;
+	}
+
+	max = (size_t) info.uncompressed_size + 1;
+	if ((z->data = malloc(max)) == NULL) {
+		z->error = ZIPFILE_EINTERNAL;
+		return ZIPFILE_ERROR;
+	}
+
+	z->owned = true;
+
+	while ((bytes = unzReadCurrentFile(z->unzip_handle, z->data + z->size,
+	                                   max - z->size)) > 0)
+		z->size += bytes;
+
+	if (bytes < 0 || z->size != info.uncompressed_size) {
+		z->error = ZIPFILE_EINTERNAL;
+		return ZIPFILE_ERROR;
+	}
+
+	return ZIPFILE_OK;
+}
+
+int zipfile_file_data(zf_readctx *z, char **data, size_t *size)
+{
+	/* archive open and file open */
+	if (check_open_states(z, true, true) != ZIPFILE_OK)
+		return ZIPFILE_ERROR;
+
+	if (z->backend == ZIPFILE_BACKEND_MINIZIP && !z->data &&
+	    read_minizip_data(z) != ZIPFILE_OK)
+		return ZIPFILE_ERROR;
+
+	*data = z->data;
+	*size = z->size;
+
+	return ZIPFILE_OK;
+}
+
 ssize_t zipfile_read_file(zf_readctx *z, char *buf, size_t count)
 {
 	int err;
@@ -221,6 +865,17 @@ ssize_t zipfile_read_file(zf_readctx *z, char *buf, size_t count)
 	if (check_open_states(z, true, true) != ZIPFILE_OK)
 		return ZIPFILE_ERROR;
 
+	/* the file is already in memory, hand it out a piece at a time */
+	if (z->backend == ZIPFILE_BACKEND_MMAP || z->data) {
+		if (count > z->size - z->pos)
+			count = z->size - z->pos;
+
+		memcpy(buf, z->data + z->pos, count);
+		z->pos += count;
+
+		return (ssize_t) count;
+	}
+
 	err = unzReadCurrentFile(z->unzip_handle, buf, count);
 
 	if (err > 0) {
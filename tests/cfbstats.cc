@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <predcfb/predcfb.h>
+#include <predcfb/objectdb.h>
+#include <predcfb/cfbstats.h>
+}
+
+/* a small season: 2 conferences, 6 teams, 4 games and their stats */
+#define SEASON "tests/data/cfbseason.zip"
+
+/* CfbstatsTest class */
+
+class CfbstatsTest : public ::testing::Test {
+protected:
+	/* methods */
+	CfbstatsTest() {}
+	virtual ~CfbstatsTest() {}
+	virtual void SetUp();
+	virtual void TearDown();
+
+	void expectSeason();
+
+	/* data */
+	objectdb_ctx *db;
+	cfbstats_ctx *ctx;
+};
+
+void CfbstatsTest::SetUp()
+{
+	db = objectdb_new();
+	ASSERT_TRUE(db != NULL);
+	ctx = cfbstats_new(db);
+	ASSERT_TRUE(ctx != NULL);
+}
+
+void CfbstatsTest::TearDown()
+{
+	cfbstats_free(ctx);
+	objectdb_free(db);
+}
+
+void CfbstatsTest::expectSeason()
+{
+	EXPECT_EQ(2, objectdb_num_conferences(db));
+	EXPECT_EQ(6, objectdb_num_teams(db));
+	EXPECT_EQ(4, objectdb_num_games(db));
+}
+
+namespace {
+
+	TEST_F(CfbstatsTest, ReadSeason) {
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_read_zipfile(ctx, SEASON));
+		expectSeason();
+	}
+
+	TEST_F(CfbstatsTest, ReadSeasonNotPipelined) {
+		cfbstats_set_pipeline(ctx, false);
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_read_zipfile(ctx, SEASON));
+		expectSeason();
+	}
+
+	/* the objects from the first read are reused, nothing is added */
+	TEST_F(CfbstatsTest, ReadSeasonTwice) {
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_read_zipfile(ctx, SEASON));
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_read_zipfile(ctx, SEASON));
+		expectSeason();
+	}
+
+	/* a name or game repeated within one archive is still an error */
+	TEST_F(CfbstatsTest, DuplicateConference) {
+		ASSERT_EQ(CFBSTATS_ERROR, cfbstats_read_zipfile(ctx,
+		          "tests/data/cfbseason-dupconference.zip"));
+		ASSERT_EQ(CFBSTATS_EINVALIDFILE, cfbstats_get_error(ctx));
+	}
+
+	TEST_F(CfbstatsTest, DuplicateTeam) {
+		ASSERT_EQ(CFBSTATS_ERROR, cfbstats_read_zipfile(ctx,
+		          "tests/data/cfbseason-dupteam.zip"));
+		ASSERT_EQ(CFBSTATS_EINVALIDFILE, cfbstats_get_error(ctx));
+	}
+
+	TEST_F(CfbstatsTest, DuplicateGame) {
+		ASSERT_EQ(CFBSTATS_ERROR, cfbstats_read_zipfile(ctx,
+		          "tests/data/cfbseason-dupgame.zip"));
+		ASSERT_EQ(CFBSTATS_EINVALIDFILE, cfbstats_get_error(ctx));
+	}
+}
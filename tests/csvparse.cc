@@ -1,4 +1,6 @@
 
+#include <algorithm>
+#include <climits>
 #include <vector>
 #include <string>
 
@@ -48,7 +50,23 @@ protected:
 	static std::vector<std::string> short_bad_strs;
 };
 
-/* TODO: implement CSVParseTest class and unit tests */
+class CSVParseTest : public ::testing::Test {
+protected:
+	/* methods */
+	CSVParseTest() {}
+	virtual ~CSVParseTest() {}
+	virtual void SetUp();
+	virtual void TearDown();
+
+	int parse(const char *input, bool inplace);
+	static int saveLine(struct csvline *line, void *data);
+
+	/* data */
+	struct csvparse csvp;
+	std::vector<char> buf;
+	std::vector<std::vector<std::string> > lines;
+	std::vector<const char *> slices;
+};
 
 /* StrBufTest implementation */
 
@@ -189,6 +207,299 @@ void CSVLineTest::setupIntegers()
 	int_bad_strs.push_back("127string");
 }
 
+/* CSVParseTest methods */
+
+void CSVParseTest::SetUp()
+{
+	ASSERT_EQ(CSVP_OK, csvp_init(&csvp, saveLine, this));
+}
+
+void CSVParseTest::TearDown()
+{
+	csv_free(&csvp.parser);
+}
+
+int CSVParseTest::saveLine(struct csvline *line, void *data)
+{
+	CSVParseTest *t = static_cast<CSVParseTest *>(data);
+	std::vector<std::string> fields;
+	const char *str;
+	size_t len;
+
+	for (int i = 0; i < line->num_fields; i++) {
+		if (line->fields[i] == NULL) {
+			/* not in the projection */
+			fields.push_back("<skipped>");
+			t->slices.push_back(NULL);
+			continue;
+		}
+
+		if (csvline_slice_at(line, i, &str, &len) != CSVP_OK)
+			return 1;
+		fields.push_back(std::string(str, len));
+		t->slices.push_back(str);
+	}
+
+	t->lines.push_back(fields);
+
+	return 0;
+}
+
+int CSVParseTest::parse(const char *input, bool inplace)
+{
+	int err;
+
+	buf.assign(input, input + strlen(input));
+
+	if (inplace)
+		return csvp_parse_inplace(&csvp, &buf[0], buf.size());
+
+	err = csvp_parse(&csvp, &buf[0], buf.size());
+	if (err != CSVP_OK)
+		return err;
+
+	/* flushes a last line without a newline */
+	err = csvp_destroy(&csvp);
+	if (err != CSVP_OK)
+		return err;
+
+	return csvp_init(&csvp, saveLine, this);
+}
+
+/* CSVParseTest tests */
+
+TEST_F(CSVParseTest, InPlaceSlices)
+{
+	ASSERT_EQ(CSVP_OK, parse("one,two\nthree,four\n", true));
+
+	ASSERT_EQ((size_t)2, lines.size());
+	ASSERT_EQ("two", lines[0][1]);
+	ASSERT_EQ("three", lines[1][0]);
+
+	/* every field points into the buffer and nothing was copied */
+	ASSERT_EQ(&buf[0], slices[0]);
+	ASSERT_EQ(&buf[4], slices[1]);
+	ASSERT_EQ((size_t)0, csvp.bytes_copied);
+}
+
+TEST_F(CSVParseTest, InPlaceQuoted)
+{
+	ASSERT_EQ(CSVP_OK, parse("\"a \"\"b\"\"\" , 2 \r\n\n3,", true));
+
+	ASSERT_EQ((size_t)2, lines.size());
+	ASSERT_EQ((size_t)2, lines[0].size());
+	ASSERT_EQ("a \"b\"", lines[0][0]);
+	ASSERT_EQ("2", lines[0][1]);
+	ASSERT_EQ((size_t)2, lines[1].size());
+	ASSERT_EQ("3", lines[1][0]);
+	ASSERT_EQ("", lines[1][1]);
+
+	/* only the quoted field is copied */
+	ASSERT_EQ((size_t)5, csvp.bytes_copied);
+}
+
+TEST_F(CSVParseTest, InPlaceMatchesLibcsv)
+{
+	const char *input =
+		"\"Team Code\",\"Name\",\"Conference Code\"\n"
+		"5,\"Akron\",875\n"
+		"  8 ,Alabama,\t911\n"
+		"\n"
+		",,\n"
+		"9,\"Multi\nLine\",0";
+	std::vector<std::vector<std::string> > expected;
+
+	ASSERT_EQ(CSVP_OK, parse(input, false));
+	expected = lines;
+	lines.clear();
+
+	ASSERT_EQ(CSVP_OK, parse(input, true));
+	ASSERT_EQ((size_t)5, lines.size());
+	ASSERT_TRUE(expected == lines);
+}
+
+TEST_F(CSVParseTest, InPlaceErrors)
+{
+	ASSERT_EQ(CSVP_ERROR, parse("ab\"c\n", true));
+	ASSERT_EQ(CSVP_EPARSE, csvp_error(&csvp));
+
+	csvp.error = CSVP_ENONE;
+	ASSERT_EQ(CSVP_ERROR, parse("\"ab\"c\n", true));
+	ASSERT_EQ(CSVP_EPARSE, csvp_error(&csvp));
+
+	csvp.error = CSVP_ENONE;
+	ASSERT_EQ(CSVP_ERROR, parse("\"abc\n", true));
+	ASSERT_EQ(CSVP_EPARSE, csvp_error(&csvp));
+}
+
+TEST_F(CSVParseTest, InPlaceAcrossChunks)
+{
+	std::vector<std::vector<std::string> > expected;
+	std::string input;
+
+	/* long enough lines that fields and quotes straddle chunks */
+	for (int i = 0; i < 8 * 40; i++) {
+		if (i % 7 == 3)
+			input += "\"quoted \"\"field\"\" number\"";
+		else
+			input += "unquoted field number";
+		input += (i % 40 == 39) ? "\r\n" : ",";
+	}
+	ASSERT_LT((size_t)CSVSCAN_CHUNK, input.size());
+
+	ASSERT_EQ(CSVP_OK, parse(input.c_str(), false));
+	ASSERT_EQ((size_t)8, lines.size());
+	expected = lines;
+	lines.clear();
+
+	ASSERT_EQ(CSVP_OK, parse(input.c_str(), true));
+	ASSERT_EQ((size_t)8, lines.size());
+	ASSERT_TRUE(expected == lines);
+}
+
+/* each parser scans with its own implementation, they all agree */
+TEST_F(CSVParseTest, InPlaceEachIsa)
+{
+	std::vector<std::vector<std::string> > expected;
+	std::string input;
+	int isa;
+
+	for (int i = 0; i < 8 * 40; i++) {
+		input += (i % 5 == 2) ? "\"a,\"\"b\"\"\"" : "  field ";
+		input += (i % 40 == 39) ? "\n" : ",";
+	}
+
+	ASSERT_EQ(CSVP_ERROR, csvp_set_isa(&csvp, (enum csvscan_isa) 99));
+	ASSERT_EQ(CSVP_EINTERNAL, csvp_error(&csvp));
+	ASSERT_EQ(csvscan_get_isa(), csvp.isa);
+	csvp.error = CSVP_ENONE;
+
+	ASSERT_EQ(CSVP_OK, parse(input.c_str(), false));
+	expected = lines;
+
+	for (isa = CSVSCAN_SCALAR; isa <= CSVSCAN_AVX2; isa++) {
+		if (!csvscan_isa_supported((enum csvscan_isa) isa))
+			continue;
+
+		lines.clear();
+		ASSERT_EQ(CSVP_OK, csvp_set_isa(&csvp, (enum csvscan_isa) isa));
+		ASSERT_EQ(CSVP_OK, parse(input.c_str(), true));
+		ASSERT_TRUE(expected == lines) << csvscan_isa_name(
+			(enum csvscan_isa) isa);
+	}
+}
+
+TEST_F(CSVParseTest, AcrossBuffers)
+{
+	std::vector<std::vector<std::string> > expected;
+	std::string input;
+	static const size_t sizes[] = { 1, 3, 7, 64, 1000 };
+
+	for (int i = 0; i < 4 * 10; i++) {
+		if (i % 7 == 3)
+			input += "\"quoted,\"\"field\"\"\nnumber\"";
+		else
+			input += "unquoted field number";
+		input += (i % 10 == 9) ? "\r\n" : ",";
+	}
+
+	ASSERT_EQ(CSVP_OK, parse(input.c_str(), false));
+	ASSERT_EQ((size_t)4, lines.size());
+	expected = lines;
+
+	/* as a stream read through buffers of each size would hand it over */
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		lines.clear();
+		buf.assign(input.begin(), input.end());
+
+		for (size_t pos = 0; pos < buf.size(); pos += sizes[i]) {
+			size_t len = std::min(sizes[i], buf.size() - pos);
+			ASSERT_EQ(CSVP_OK, csvp_parse(&csvp, &buf[pos], len));
+		}
+
+		ASSERT_EQ(CSVP_OK, csvp_destroy(&csvp));
+		ASSERT_EQ(CSVP_OK, csvp_init(&csvp, saveLine, this));
+		ASSERT_TRUE(expected == lines) << "buffer size " << sizes[i];
+	}
+}
+
+TEST_F(CSVParseTest, Projection)
+{
+	const char *input = "a,\"b \"\"x\"\"\",c,d\n1,2,3,4";
+	const int columns[] = { 0, 2 };
+	const char *str;
+
+	for (int inplace = 0; inplace < 2; inplace++) {
+		lines.clear();
+		ASSERT_EQ(CSVP_OK, csvp_set_projection(&csvp, columns, 2));
+		ASSERT_EQ(CSVP_OK, parse(input, inplace));
+
+		ASSERT_EQ((size_t)2, lines.size());
+		ASSERT_EQ((size_t)4, lines[0].size());
+		ASSERT_EQ("a", lines[0][0]);
+		ASSERT_EQ("<skipped>", lines[0][1]);
+		ASSERT_EQ("c", lines[0][2]);
+		ASSERT_EQ("<skipped>", lines[0][3]);
+		ASSERT_EQ("3", lines[1][2]);
+	}
+
+	/* nothing in a skipped column is copied */
+	ASSERT_EQ((size_t)0, csvp.bytes_copied);
+
+	const int bad[] = { CSVLINE_MAX_FIELDS };
+	ASSERT_EQ(CSVP_ERROR, csvp_set_projection(&csvp, bad, 1));
+
+	csvline_clear(&csvp.csvline);
+	ASSERT_EQ(CSVP_OK, csvline_skip(&csvp.csvline));
+	ASSERT_EQ(CSVP_ERROR, csvline_str_at(&csvp.csvline, 0, &str));
+	ASSERT_EQ(CSVLINE_ENULLSTR, csvp.csvline.error);
+}
+
+/* CSVScanTest tests */
+
+TEST(CSVScanTest, MatchesScalar)
+{
+	const char alphabet[] = "abc ,\"\r\n";
+	std::vector<uint32_t> expected, offsets;
+	std::vector<char> buf;
+	size_t num;
+	int isa;
+
+	srand(1);
+	for (int i = 0; i < 1000; i++)
+		buf.push_back(alphabet[rand() % (sizeof(alphabet) - 1)]);
+
+	expected.resize(buf.size());
+	num = csvscan_with_isa(CSVSCAN_SCALAR, &buf[0], buf.size(),
+	                       &expected[0]);
+	expected.resize(num);
+
+	for (isa = CSVSCAN_SSE42; isa <= CSVSCAN_AVX2; isa++) {
+		if (!csvscan_isa_supported((enum csvscan_isa) isa))
+			continue;
+
+		/* every length, so each tail size is covered */
+		for (size_t len = 0; len <= buf.size(); len += 7) {
+			offsets.assign(len + 1, 0);
+			num = csvscan_with_isa((enum csvscan_isa) isa, &buf[0],
+			                       len, &offsets[0]);
+
+			size_t want = 0;
+			while (want < expected.size() && expected[want] < len)
+				want++;
+
+			ASSERT_EQ(want, num);
+			for (size_t i = 0; i < num; i++)
+				ASSERT_EQ(expected[i], offsets[i]);
+		}
+	}
+
+	/* the default is the best the cpu has */
+	ASSERT_TRUE(csvscan_isa_supported(csvscan_get_isa()));
+	num = csvscan(&buf[0], buf.size(), &offsets[0]);
+	ASSERT_EQ(expected.size(), num);
+}
+
 /* CSVLineTest tests */
 
 TEST_F(CSVLineTest, Clear)
@@ -406,3 +717,52 @@ TEST_F(CSVLineTest, ShortAt)
 		csvl.error = CSVLINE_ENONE;
 	}
 }
+
+TEST_F(CSVLineTest, NumbersMatchStrtol)
+{
+	const char *odd[] = {
+		"", "-", "+5", " 7", "7 ", "12a", "007", "-0", "/1", "9:",
+		"12345678", "-99999999", "123456789", "2147483648", "32768",
+		"-32769", NULL
+	};
+	std::vector<std::string> strs;
+	char buf[32];
+
+	for (int i = -40000; i <= 40000; i += 37) {
+		snprintf(buf, sizeof(buf), "%d", i);
+		strs.push_back(buf);
+	}
+
+	for (int i = 0; odd[i]; i++)
+		strs.push_back(odd[i]);
+
+	for (size_t i = 0; i < strs.size(); i++) {
+		const char *str = strs[i].c_str();
+		char *endptr;
+		long li = strtol(str, &endptr, 10);
+		bool valid = *endptr == '\0';
+		short sval;
+		int ival;
+
+		csvline_clear(&csvl);
+		ASSERT_EQ(CSVP_OK, csvline_add(&csvl, str, strs[i].length()));
+
+		if (valid && li >= SHRT_MIN && li <= SHRT_MAX) {
+			ASSERT_EQ(CSVP_OK, csvline_short_at(&csvl, 0, &sval)) << str;
+			ASSERT_EQ(li, sval) << str;
+		} else {
+			ASSERT_EQ(CSVP_ERROR, csvline_short_at(&csvl, 0, &sval)) << str;
+			ASSERT_EQ(valid ? CSVLINE_ERANGE : CSVLINE_EWRONGTYPE,
+			          csvl.error) << str;
+		}
+
+		csvl.error = CSVLINE_ENONE;
+
+		if (valid && li >= INT_MIN && li <= INT_MAX) {
+			ASSERT_EQ(CSVP_OK, csvline_int_at(&csvl, 0, &ival)) << str;
+			ASSERT_EQ(li, ival) << str;
+		} else {
+			ASSERT_EQ(CSVP_ERROR, csvline_int_at(&csvl, 0, &ival)) << str;
+		}
+	}
+}
@@ -0,0 +1,81 @@
+#include <string.h>
+#include <time.h>
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <predcfb/date.h>
+#include "../src/cfbstats/cfbstats_internal.h"
+}
+
+namespace {
+
+	TEST(DateTest, ParseMDY) {
+		time_t t;
+
+		ASSERT_TRUE(date_parse_mdy("08/30/2005", 10, &t));
+		ASSERT_EQ((time_t) 1125360000, t);
+
+		ASSERT_TRUE(date_parse_mdy("8/3/2005", 8, &t));
+		ASSERT_EQ((time_t) 1123027200, t);
+
+		ASSERT_TRUE(date_parse_mdy("02/29/2004", 10, &t));
+
+		ASSERT_FALSE(date_parse_mdy("02/29/2005", 10, &t));
+		ASSERT_FALSE(date_parse_mdy("13/01/2005", 10, &t));
+		ASSERT_FALSE(date_parse_mdy("00/10/2005", 10, &t));
+		ASSERT_FALSE(date_parse_mdy("01/01/05", 8, &t));
+		ASSERT_FALSE(date_parse_mdy("01-01-2005", 10, &t));
+		ASSERT_FALSE(date_parse_mdy("01/01/2005 ", 11, &t));
+		ASSERT_FALSE(date_parse_mdy("", 0, &t));
+	}
+
+	TEST(DateTest, ParseYMD) {
+		time_t t;
+
+		ASSERT_TRUE(date_parse_ymd("2005-08-30", &t));
+		ASSERT_EQ((time_t) 1125360000, t);
+
+		ASSERT_FALSE(date_parse_ymd("2005-8-30", &t));
+		ASSERT_FALSE(date_parse_ymd("2005-02-30", &t));
+		ASSERT_FALSE(date_parse_ymd("2005-08-30x", &t));
+	}
+
+	TEST(DateTest, StringMatchesGmtime) {
+		char expected[DATE_STR_SIZE];
+		char buf[DATE_STR_SIZE];
+		struct tm tm;
+		time_t t;
+
+		/* every day from 1900 to 2100, at midnight and just before */
+		for (t = -2208988800LL; t < 4102444800LL; t += 24 * 60 * 60) {
+			time_t times[] = { t, t + 24 * 60 * 60 - 1 };
+
+			for (int i = 0; i < 2; i++) {
+				gmtime_r(&times[i], &tm);
+				strftime(expected, sizeof(expected), "%Y-%m-%d", &tm);
+				date_string(times[i], buf);
+				ASSERT_STREQ(expected, buf);
+			}
+
+			ASSERT_TRUE(date_parse_ymd(buf, &times[1]));
+			ASSERT_EQ(t, times[1]);
+		}
+	}
+
+	TEST(DateTest, CacheRejectsEmptyDate) {
+		struct date_cache cache;
+		const struct date_cache_entry *entry;
+
+		date_cache_clear(&cache);
+
+		/* an empty field must not match a slot that was never filled */
+		ASSERT_TRUE(date_cache_lookup(&cache, "", 0) == NULL);
+
+		entry = date_cache_lookup(&cache, "8/3/2005", 8);
+		ASSERT_TRUE(entry != NULL);
+		ASSERT_STREQ("2005-08-03", entry->str);
+
+		ASSERT_TRUE(date_cache_lookup(&cache, "", 0) == NULL);
+	}
+}
@@ -0,0 +1,146 @@
+#include <string.h>
+#include <stdio.h>
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include "../src/cfbstats/cfbstats_internal.h"
+}
+
+namespace {
+
+	game_key packed(const char *code)
+	{
+		game_key key;
+
+		EXPECT_TRUE(pack_game_code(code, &key)) << code;
+
+		return key;
+	}
+
+	TEST(IdMapTest, GameKeyWidth) {
+		ASSERT_EQ((size_t) PREDCFB_GAME_KEY_BITS / 8, sizeof(game_key));
+	}
+
+	TEST(IdMapTest, PackSwappedTeams) {
+		/* visiting and home team codes are separate fields */
+		ASSERT_NE(packed("0074006120050830"), packed("0061007420050830"));
+		ASSERT_NE(packed("0001000220050830"), packed("0002000120050830"));
+	}
+
+	TEST(IdMapTest, PackYears) {
+		/* one season apart, the 32 bit key's year parity bit */
+		ASSERT_NE(packed("0074006120050830"), packed("0074006120040830"));
+		ASSERT_NE(packed("0074006120050830"), packed("0074006120060830"));
+
+#if PREDCFB_GAME_KEY_BITS == 32
+		/* only the parity is kept, keys are unique within a season */
+		ASSERT_EQ(packed("0074006120040830"), packed("0074006120060830"));
+#else
+		ASSERT_NE(packed("0074006120040830"), packed("0074006120060830"));
+#endif
+	}
+
+	TEST(IdMapTest, PackDays) {
+		char code[17];
+		game_key keys[12 * 31];
+		int n = 0;
+
+		/* every month and day of a season packs to its own key */
+		for (int month = 1; month <= 12; month++) {
+			for (int day = 1; day <= 31; day++) {
+				snprintf(code, sizeof(code), "0074006120%02d%02d%02d",
+				         5, month, day);
+				keys[n++] = packed(code);
+			}
+		}
+
+		for (int i = 0; i < n; i++) {
+			for (int j = i + 1; j < n; j++)
+				ASSERT_NE(keys[i], keys[j]) << i << " " << j;
+		}
+	}
+
+	TEST(IdMapTest, PackMalformed) {
+		game_key key;
+
+		ASSERT_FALSE(pack_game_code("", &key));
+		ASSERT_FALSE(pack_game_code("007400612005083", &key));
+		ASSERT_FALSE(pack_game_code("00740061200508300", &key));
+		ASSERT_FALSE(pack_game_code("007400612005083x", &key));
+		ASSERT_FALSE(pack_game_code("x074006120050830", &key));
+		ASSERT_FALSE(pack_game_code("0074-06120050830", &key));
+		ASSERT_FALSE(pack_game_code(" 074006120050830", &key));
+		ASSERT_FALSE(pack_game_code("0074006120050830 ", &key));
+	}
+
+	TEST(IdMapTest, PackOutOfRangeDates) {
+		game_key key;
+
+		ASSERT_FALSE(pack_game_code("0074006120050030", &key));
+		ASSERT_FALSE(pack_game_code("0074006120051330", &key));
+		ASSERT_FALSE(pack_game_code("0074006120051630", &key));
+		ASSERT_FALSE(pack_game_code("0074006120059930", &key));
+		ASSERT_FALSE(pack_game_code("0074006120050800", &key));
+		ASSERT_FALSE(pack_game_code("0074006120050832", &key));
+		ASSERT_FALSE(pack_game_code("0074006120050899", &key));
+
+		ASSERT_TRUE(pack_game_code("0074006120051231", &key));
+		ASSERT_TRUE(pack_game_code("0074006120050101", &key));
+	}
+
+	TEST(IdMapTest, PackTeamCodes) {
+		game_key key;
+
+#if PREDCFB_GAME_KEY_BITS == 32
+		/* team codes get 11 bits each */
+		ASSERT_TRUE(pack_game_code("2047204720050830", &key));
+		ASSERT_FALSE(pack_game_code("2048000120050830", &key));
+		ASSERT_FALSE(pack_game_code("0001204820050830", &key));
+#else
+		ASSERT_TRUE(pack_game_code("9999999920050830", &key));
+		ASSERT_NE(packed("9999000120050830"), packed("0001999920050830"));
+#endif
+	}
+
+	TEST(IdMapTest, GamesByKey) {
+		struct id_map map;
+		struct objectid oid;
+		const struct id_map_entry *e;
+		char code[17];
+
+		id_map_init(&map);
+		memset(&oid, 0, sizeof(oid));
+
+		/* a season's worth of games, enough to grow the table */
+		for (uint32_t i = 0; i < 1000; i++) {
+			snprintf(code, sizeof(code), "%04u%04u200509%02u",
+			         i % 700, (i * 7 + 1) % 700, 1 + i % 30);
+			oid.md[0] = (unsigned char) i;
+			ASSERT_EQ(CFBSTATS_ENONE,
+			          id_map_insert_game(&map, packed(code), &oid, i));
+		}
+
+		for (uint32_t i = 0; i < 1000; i++) {
+			snprintf(code, sizeof(code), "%04u%04u200509%02u",
+			         i % 700, (i * 7 + 1) % 700, 1 + i % 30);
+			e = id_map_lookup_game(&map, packed(code));
+			ASSERT_TRUE(e != NULL) << code;
+			ASSERT_EQ(i, e->idx);
+			ASSERT_EQ((unsigned char) i, e->oid.md[0]);
+		}
+
+		/* the same game a season later isn't mapped */
+		ASSERT_TRUE(id_map_lookup_game(&map,
+		            packed("0000000120060901")) == NULL);
+
+		/* the first game with a key keeps it */
+		oid.md[0] = 0xff;
+		ASSERT_EQ(CFBSTATS_ENONE, id_map_insert_game(&map,
+		          packed("0000000120050901"), &oid, 5000));
+		e = id_map_lookup_game(&map, packed("0000000120050901"));
+		ASSERT_EQ(0u, e->idx);
+
+		id_map_destroy(&map);
+	}
+}
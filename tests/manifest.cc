@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <predcfb/predcfb.h>
+#include <predcfb/objectdb.h>
+#include <predcfb/cfbstats.h>
+#include <predcfb/zipfile.h>
+#include "../src/cfbstats/cfbstats_internal.h"
+}
+
+#define SEASON "tests/data/cfbseason.zip"
+/* the same season with one stats row changed */
+#define SEASON_STATS "tests/data/cfbseason-stats.zip"
+
+namespace {
+
+	class ManifestTest : public ::testing::Test {
+		protected:
+			ManifestTest() {}
+			virtual ~ManifestTest() {}
+			virtual void SetUp();
+			virtual void TearDown();
+			void writeFile(const std::string &text);
+			std::string readFile();
+
+			objectdb_ctx *db;
+			cfbstats_ctx *ctx;
+			char path[32];
+	};
+
+	void ManifestTest::SetUp()
+	{
+		int fd;
+
+		db = objectdb_new();
+		ASSERT_TRUE(db != NULL);
+
+		ctx = cfbstats_new(db);
+		ASSERT_TRUE(ctx != NULL);
+
+		strcpy(path, "/tmp/predcfb_manifestXXXXXX");
+		fd = mkstemp(path);
+		ASSERT_NE(-1, fd);
+		close(fd);
+	}
+
+	void ManifestTest::TearDown()
+	{
+		cfbstats_free(ctx);
+		objectdb_free(db);
+		unlink(path);
+	}
+
+	void ManifestTest::writeFile(const std::string &text)
+	{
+		FILE *outf = fopen(path, "w");
+
+		ASSERT_TRUE(outf != NULL);
+		ASSERT_EQ(text.size(), fwrite(text.data(), 1, text.size(), outf));
+		fclose(outf);
+	}
+
+	std::string ManifestTest::readFile()
+	{
+		std::string text;
+		char buf[4096];
+		size_t len;
+		FILE *inf = fopen(path, "r");
+
+		EXPECT_TRUE(inf != NULL);
+		if (!inf)
+			return text;
+
+		while ((len = fread(buf, 1, sizeof(buf), inf)) > 0)
+			text.append(buf, len);
+
+		fclose(inf);
+
+		return text;
+	}
+
+	/* summed over every team, to see a changed stats row applied */
+	static int rushAttempts(objectdb_ctx *db)
+	{
+		int total = 0;
+
+		for (int i = 0; i < objectdb_num_teams(db); i++)
+			total += objectdb_get_team_at(db, i)->stats.rush_att;
+
+		return total;
+	}
+
+	static std::string header()
+	{
+		char buf[64];
+
+		snprintf(buf, sizeof(buf), "predcfb-manifest 1 %d\n",
+		         PREDCFB_GAME_KEY_BITS);
+
+		return buf;
+	}
+
+	TEST_F(ManifestTest, RoundTrip) {
+		std::string first;
+
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_manifest_new(ctx));
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_read_zipfile(ctx, SEASON));
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_manifest_write(ctx, path));
+
+		/* one record, keyed by file name, with 4 members and 12 ids */
+		first = readFile();
+		ASSERT_EQ(0u, first.find(header()));
+		ASSERT_NE(std::string::npos, first.find("archive cfbseason.zip\n"));
+		ASSERT_NE(std::string::npos, first.find("member game.csv "));
+		ASSERT_EQ(first.size() - 4, first.rfind("end\n"));
+
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_manifest_read(ctx, path));
+		ASSERT_TRUE(manifest_find(ctx->manifest, SEASON) != NULL);
+		ASSERT_TRUE(manifest_find(ctx->manifest, "cfbseason.zip") != NULL);
+		ASSERT_TRUE(manifest_find(ctx->manifest, "other.zip") == NULL);
+
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_manifest_write(ctx, path));
+		ASSERT_EQ(first, readFile());
+	}
+
+	TEST_F(ManifestTest, Unchanged) {
+		const struct manifest_archive *a;
+		struct zipfile_stat st;
+		zf_readctx *zf;
+
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_manifest_new(ctx));
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_read_zipfile(ctx, SEASON));
+		a = manifest_find(ctx->manifest, SEASON);
+		ASSERT_TRUE(a != NULL);
+
+		zf = zipfile_open_archive(SEASON);
+		ASSERT_TRUE(zf != NULL);
+		ASSERT_EQ(ZIPFILE_OK, zipfile_stat(zf, "game.csv", &st));
+		ASSERT_TRUE(manifest_unchanged(a, &st));
+
+		st.crc ^= 1;
+		ASSERT_FALSE(manifest_unchanged(a, &st));
+		st.crc ^= 1;
+
+		st.size++;
+		ASSERT_FALSE(manifest_unchanged(a, &st));
+		st.size--;
+
+		st.name = "stadium.csv";
+		ASSERT_FALSE(manifest_unchanged(a, &st));
+
+		zipfile_close_archive(zf);
+	}
+
+	/* every file is skipped, and the objects and ids are still there */
+	TEST_F(ManifestTest, SkipUnchanged) {
+		game_key key;
+		int rush;
+
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_manifest_new(ctx));
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_read_zipfile(ctx, SEASON));
+		ASSERT_EQ(0, cfbstats_files_skipped(ctx));
+		rush = rushAttempts(db);
+
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_read_zipfile(ctx, SEASON));
+		ASSERT_EQ(4, cfbstats_files_skipped(ctx));
+		ASSERT_EQ(6, objectdb_num_teams(db));
+		ASSERT_EQ(4, objectdb_num_games(db));
+		ASSERT_EQ(rush, rushAttempts(db));
+
+		ASSERT_TRUE(id_map_lookup(&ctx->id_map, ID_CONFERENCE, 800) != NULL);
+		ASSERT_TRUE(id_map_lookup(&ctx->id_map, ID_TEAM, 86) != NULL);
+		ASSERT_TRUE(pack_game_code("0086002620050830", &key));
+		ASSERT_TRUE(id_map_lookup_game(&ctx->id_map, key) != NULL);
+	}
+
+	/*
+	 * the weekly download replaces an archive under the same name: only
+	 * the changed stats file is read, and its change applied
+	 */
+	TEST_F(ManifestTest, SkipPrefix) {
+		char dir[] = "/tmp/predcfb_seasonXXXXXX";
+		std::string copy;
+		int rush;
+
+		ASSERT_TRUE(mkdtemp(dir) != NULL);
+		copy = std::string(dir) + "/cfbseason.zip";
+		ASSERT_EQ(0, link(SEASON_STATS, copy.c_str()));
+
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_manifest_new(ctx));
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_read_zipfile(ctx, SEASON));
+		rush = rushAttempts(db);
+
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_read_zipfile(ctx, copy.c_str()));
+		EXPECT_EQ(3, cfbstats_files_skipped(ctx));
+		EXPECT_EQ(4, objectdb_num_games(db));
+		EXPECT_EQ(rush + 1, rushAttempts(db));
+
+		/* the record now has the new file, so nothing is read again */
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_read_zipfile(ctx, copy.c_str()));
+		EXPECT_EQ(7, cfbstats_files_skipped(ctx));
+		EXPECT_EQ(rush + 1, rushAttempts(db));
+
+		unlink(copy.c_str());
+		rmdir(dir);
+	}
+
+	/* written for another database, the archive is read in full */
+	TEST_F(ManifestTest, MissingObjects) {
+		objectdb_ctx *other_db;
+		cfbstats_ctx *other;
+
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_manifest_new(ctx));
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_read_zipfile(ctx, SEASON));
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_manifest_write(ctx, path));
+
+		other_db = objectdb_new();
+		ASSERT_TRUE(other_db != NULL);
+		other = cfbstats_new(other_db);
+		ASSERT_TRUE(other != NULL);
+
+		EXPECT_EQ(CFBSTATS_OK, cfbstats_manifest_read(other, path));
+		EXPECT_EQ(CFBSTATS_OK, cfbstats_read_zipfile(other, SEASON));
+		EXPECT_EQ(0, cfbstats_files_skipped(other));
+		EXPECT_EQ(2, objectdb_num_conferences(other_db));
+		EXPECT_EQ(6, objectdb_num_teams(other_db));
+		EXPECT_EQ(4, objectdb_num_games(other_db));
+		EXPECT_EQ(rushAttempts(db), rushAttempts(other_db));
+
+		cfbstats_free(other);
+		objectdb_free(other_db);
+	}
+
+	TEST_F(ManifestTest, Reject) {
+		const std::string sha1(40, 'a');
+		std::string members;
+		const char *other_bits = PREDCFB_GAME_KEY_BITS == 32 ? "64" : "32";
+		std::vector<std::string> bad;
+
+		for (int i = 0; i < 9; i++)
+			members += "member file" + std::to_string(i) + ".csv 1 2\n";
+
+		bad.push_back("");
+		bad.push_back(header().substr(0, header().size() - 1));
+		bad.push_back("predcfb-snapshot 1 64\n");
+		bad.push_back("predcfb-manifest 2 " +
+		              std::to_string(PREDCFB_GAME_KEY_BITS) + "\n");
+		bad.push_back(std::string("predcfb-manifest 1 ") + other_bits +
+		              "\n");
+		/* records cut off part of the way through */
+		bad.push_back(header() + "archive a.zip\n");
+		bad.push_back(header() + "archive a.zip\nmember game.csv 1 2");
+		bad.push_back(header() + "archive a.zip\nteam 5 " + sha1 + "\nen");
+		/* lines that don't belong */
+		bad.push_back(header() + "member game.csv 1 2\n");
+		bad.push_back(header() + "archive \nend\n");
+		bad.push_back(header() + "end\n");
+		bad.push_back(header() + "archive a.zip\nmember game.csv 1\nend\n");
+		bad.push_back(header() + "archive a.zip\nteam 5 xyz\nend\n");
+		bad.push_back(header() + "archive a.zip\nteam x " + sha1 +
+		              "\nend\n");
+		bad.push_back(header() + "archive a.zip\nstadium 5 " + sha1 +
+		              "\nend\n");
+		/* more members than a record holds */
+		bad.push_back(header() + "archive a.zip\n" + members + "end\n");
+
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_manifest_new(ctx));
+		ASSERT_EQ(CFBSTATS_OK, cfbstats_read_zipfile(ctx, SEASON));
+
+		for (size_t i = 0; i < bad.size(); i++) {
+			writeFile(bad[i]);
+			EXPECT_EQ(CFBSTATS_ERROR, cfbstats_manifest_read(ctx, path))
+				<< bad[i];
+			EXPECT_EQ(CFBSTATS_EMANIFEST, cfbstats_get_error(ctx));
+
+			/* the manifest the context had is kept */
+			EXPECT_TRUE(manifest_find(ctx->manifest, SEASON) != NULL);
+		}
+
+		/* a full record of members is fine */
+		members = members.substr(members.find('\n') + 1);
+		writeFile(header() + "archive a.zip\n" + members + "team 5 " +
+		          sha1 + "\nend\n");
+		EXPECT_EQ(CFBSTATS_OK, cfbstats_manifest_read(ctx, path));
+		EXPECT_TRUE(manifest_find(ctx->manifest, "a.zip") != NULL);
+		EXPECT_TRUE(manifest_find(ctx->manifest, SEASON) == NULL);
+	}
+}
@@ -1,6 +1,11 @@
 
+#include <limits.h>
 #include <time.h>
+#include <stdio.h>
+#include <unistd.h>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 
@@ -18,16 +23,24 @@ namespace {
 			virtual ~ObjectDBTest() {}
 			virtual void SetUp();
 			virtual void TearDown();
+
+			objectdb_ctx *db;
 	};
 
 	void ObjectDBTest::SetUp()
 	{
-		objectdb_clear();
-		objectdb_errno = OBJECTDB_ENONE;
+		db = objectdb_new();
+		ASSERT_TRUE(db != NULL);
 	}
 
 	void ObjectDBTest::TearDown()
 	{
+		objectdb_free(db);
+	}
+
+	static void setName(objectdb_ctx *db, struct name *n, const char *str)
+	{
+		ASSERT_EQ(OBJECTDB_OK, objectdb_intern(db, str, strlen(str), n));
 	}
 
 	/*************************************************/
@@ -35,24 +48,28 @@ namespace {
 	TEST_F(ObjectDBTest, CreateConference) {
 		struct conference *c;
 
-		c = objectdb_create_conference();
+		c = objectdb_create_conference(db);
 		ASSERT_TRUE(c != NULL);
-		ASSERT_EQ(OBJECTDB_ENONE, objectdb_errno);
+		ASSERT_EQ(OBJECTDB_ENONE, objectdb_get_error(db));
 	}
 
-	TEST_F(ObjectDBTest, CreateTooManyConferences) {
-		struct conference *c;
+	TEST_F(ObjectDBTest, CreateManyConferences) {
+		struct conference *c, *first;
 		int i;
 
-		for (i = 0; i < CONFERENCE_NUM_MAX; i++) {
-			c = objectdb_create_conference();
+		first = objectdb_create_conference(db);
+		ASSERT_TRUE(first != NULL);
+		setName(db, &first->name, "First");
+
+		for (i = 1; i < 1000; i++) {
+			c = objectdb_create_conference(db);
 			ASSERT_TRUE(c != NULL);
-			ASSERT_EQ(OBJECTDB_ENONE, objectdb_errno);
+			ASSERT_TRUE(c != first);
+			ASSERT_EQ(OBJECTDB_ENONE, objectdb_get_error(db));
 		}
 
-		c = objectdb_create_conference();
-		ASSERT_TRUE(c == NULL);
-		ASSERT_EQ(OBJECTDB_EMAXCONFS, objectdb_errno);
+		/* objects never move as the database grows */
+		ASSERT_STREQ("First", first->name.str);
 	}
 
 	TEST_F(ObjectDBTest, AddConferenceAndLookup) {
@@ -60,18 +77,18 @@ namespace {
 		struct objectid id;
 		int err;
 
-		c = objectdb_create_conference();
+		c = objectdb_create_conference(db);
 		ASSERT_TRUE(c != NULL);
 
-		strcpy(c->name, "Southeastern");
+		setName(db, &c->name, "Southeastern");
 		c->subdivision = CONFERENCE_FBS;
 
-		err = objectdb_add_conference(c, &id);
+		err = objectdb_add_conference(db, c, &id);
 		ASSERT_EQ(OBJECTDB_OK, err);
 
-		c2 = objectdb_get_conference(&id);
+		c2 = objectdb_get_conference(db, &id);
 		ASSERT_TRUE(c2 != NULL);
-		ASSERT_STREQ(c->name, c2->name);
+		ASSERT_STREQ(c->name.str, c2->name.str);
 		ASSERT_EQ(c->subdivision, c2->subdivision);
 	}
 
@@ -81,9 +98,9 @@ namespace {
 
 		memset(id.md, 0xaf, sizeof(id.md));
 
-		conf = objectdb_get_conference(&id);
+		conf = objectdb_get_conference(db, &id);
 		ASSERT_TRUE(conf == NULL);
-		ASSERT_EQ(OBJECTDB_ENOTFOUND, objectdb_errno);
+		ASSERT_EQ(OBJECTDB_ENOTFOUND, objectdb_get_error(db));
 	}
 
 	TEST_F(ObjectDBTest, InsertConferenceTwice) {
@@ -91,41 +108,45 @@ namespace {
 		struct objectid id;
 		int err;
 
-		c = objectdb_create_conference();
+		c = objectdb_create_conference(db);
 		ASSERT_TRUE(c != NULL);
 
-		strcpy(c->name, "Southeastern");
+		setName(db, &c->name, "Southeastern");
 		c->subdivision = CONFERENCE_FBS;
 
-		err = objectdb_add_conference(c, &id);
+		err = objectdb_add_conference(db, c, &id);
 		ASSERT_EQ(OBJECTDB_OK, err);
 
-		err = objectdb_add_conference(c, &id);
+		err = objectdb_add_conference(db, c, &id);
 		ASSERT_EQ(OBJECTDB_ERROR, err);
-		ASSERT_EQ(OBJECTDB_EDUPLICATE, objectdb_errno);
+		ASSERT_EQ(OBJECTDB_EDUPLICATE, objectdb_get_error(db));
 	}
 
 	TEST_F(ObjectDBTest, CreateTeam) {
 		struct team *team;
 
-		team = objectdb_create_team();
+		team = objectdb_create_team(db);
 		ASSERT_TRUE(team != NULL);
-		ASSERT_EQ(OBJECTDB_ENONE, objectdb_errno);
+		ASSERT_EQ(OBJECTDB_ENONE, objectdb_get_error(db));
 	}
 
-	TEST_F(ObjectDBTest, CreateTooManyTeams) {
-		struct team *team;
+	TEST_F(ObjectDBTest, CreateManyTeams) {
+		struct team *team, *first;
 		int i;
 
-		for (i = 0; i < TEAM_NUM_MAX; i++) {
-			team = objectdb_create_team();
+		first = objectdb_create_team(db);
+		ASSERT_TRUE(first != NULL);
+		setName(db, &first->name, "First");
+
+		for (i = 1; i < 10000; i++) {
+			team = objectdb_create_team(db);
 			ASSERT_TRUE(team != NULL);
-			ASSERT_EQ(OBJECTDB_ENONE, objectdb_errno);
+			ASSERT_TRUE(team != first);
+			ASSERT_EQ(OBJECTDB_ENONE, objectdb_get_error(db));
 		}
 
-		team = objectdb_create_team();
-		ASSERT_TRUE(team == NULL);
-		ASSERT_EQ(OBJECTDB_EMAXTEAMS, objectdb_errno);
+		/* objects never move as the database grows */
+		ASSERT_STREQ("First", first->name.str);
 	}
 
 	TEST_F(ObjectDBTest, AddTeamAndLookup) {
@@ -133,17 +154,17 @@ namespace {
 		struct objectid id;
 		int err;
 
-		team1 = objectdb_create_team();
+		team1 = objectdb_create_team(db);
 		ASSERT_TRUE(team1 != NULL);
 
-		strcpy(team1->name, "Random name");
+		setName(db, &team1->name, "Random name");
 
-		err = objectdb_add_team(team1, &id);
+		err = objectdb_add_team(db, team1, &id);
 		ASSERT_EQ(OBJECTDB_OK, err);
 
-		team2 = objectdb_get_team(&id);
+		team2 = objectdb_get_team(db, &id);
 		ASSERT_TRUE(team2 != NULL);
-		ASSERT_STREQ(team1->name, team2->name);
+		ASSERT_STREQ(team1->name.str, team2->name.str);
 	}
 
 	TEST_F(ObjectDBTest, LookupBogusTeam) {
@@ -152,9 +173,9 @@ namespace {
 
 		memset(id.md, 0xaf, sizeof(id.md));
 
-		team = objectdb_get_team(&id);
+		team = objectdb_get_team(db, &id);
 		ASSERT_TRUE(team == NULL);
-		ASSERT_EQ(OBJECTDB_ENOTFOUND, objectdb_errno);
+		ASSERT_EQ(OBJECTDB_ENOTFOUND, objectdb_get_error(db));
 	}
 
 	TEST_F(ObjectDBTest, InsertTeamTwice) {
@@ -162,40 +183,143 @@ namespace {
 		struct objectid id;
 		int err;
 
-		team = objectdb_create_team();
+		team = objectdb_create_team(db);
 		ASSERT_TRUE(team != NULL);
 
-		strcpy(team->name, "TeamName");
+		setName(db, &team->name, "TeamName");
 
-		err = objectdb_add_team(team, &id);
+		err = objectdb_add_team(db, team, &id);
 		ASSERT_EQ(OBJECTDB_OK, err);
 
-		err = objectdb_add_team(team, &id);
+		err = objectdb_add_team(db, team, &id);
 		ASSERT_EQ(OBJECTDB_ERROR, err);
-		ASSERT_EQ(OBJECTDB_EDUPLICATE, objectdb_errno);
+		ASSERT_EQ(OBJECTDB_EDUPLICATE, objectdb_get_error(db));
 	}
 
 	TEST_F(ObjectDBTest, CreateGame) {
 		struct game *game;
 
-		game = objectdb_create_game();
+		game = objectdb_create_game(db);
 		ASSERT_TRUE(game != NULL);
-		ASSERT_EQ(OBJECTDB_ENONE, objectdb_errno);
+		ASSERT_EQ(OBJECTDB_ENONE, objectdb_get_error(db));
 	}
 
-	TEST_F(ObjectDBTest, CreateTooManyGames) {
-		struct game *game;
+	TEST_F(ObjectDBTest, CreateManyGames) {
+		struct game *game, *first, **games;
+		struct team team1, team2;
+		struct objectid id;
+		int num_games;
+		int err;
 		int i;
 
-		for (i = 0; i < GAME_NUM_MAX; i++) {
-			game = objectdb_create_game();
+		setName(db, &team1.name, "Team One");
+		setName(db, &team2.name, "Team Two");
+
+		/* more than 20 seasons worth of games */
+		for (i = 0; i < 30000; i++) {
+			game = objectdb_create_game(db);
 			ASSERT_TRUE(game != NULL);
-			ASSERT_EQ(OBJECTDB_ENONE, objectdb_errno);
+			ASSERT_FALSE(game->neutral);
+			ASSERT_EQ(OBJECTDB_ENONE, objectdb_get_error(db));
+
+			game->home = &team1;
+			game->away = &team2;
+			game->date = (time_t) i * 24 * 60 * 60;
+			err = objectdb_add_game(db, game, &id);
+			ASSERT_EQ(OBJECTDB_OK, err);
+
+			if (i == 0) {
+				first = game;
+				first->neutral = true;
+			}
 		}
 
-		game = objectdb_create_game();
-		ASSERT_TRUE(game == NULL);
-		ASSERT_EQ(OBJECTDB_EMAXGAMES, objectdb_errno);
+		games = objectdb_get_games(db, &num_games);
+		ASSERT_EQ(30000, num_games);
+		ASSERT_EQ(first, games[0]);
+		ASSERT_TRUE(first->neutral);
+	}
+
+	TEST_F(ObjectDBTest, ClearAndReuse) {
+		struct game *game;
+		int num_games;
+
+		for (int i = 0; i < 10000; i++) {
+			game = objectdb_create_game(db);
+			ASSERT_TRUE(game != NULL);
+			game->neutral = true;
+		}
+
+		objectdb_clear(db);
+		objectdb_get_games(db, &num_games);
+		ASSERT_EQ(0, num_games);
+
+		/* recycled memory comes back zeroed */
+		for (int i = 0; i < 10000; i++) {
+			game = objectdb_create_game(db);
+			ASSERT_TRUE(game != NULL);
+			ASSERT_FALSE(game->neutral);
+		}
+	}
+
+	TEST_F(ObjectDBTest, InternNames) {
+		struct name n1, n2, n3;
+		struct team team;
+		struct objectid id, expected;
+
+		setName(db, &n1, "Southeastern");
+		setName(db, &n2, "Southeastern");
+		setName(db, &n3, "Big Ten");
+
+		/* one copy and one handle per name */
+		ASSERT_EQ(n1.str, n2.str);
+		ASSERT_EQ(n1.ref, n2.ref);
+		ASSERT_NE(n1.ref, n3.ref);
+		ASSERT_NE(0u, n1.ref);
+		ASSERT_EQ(2, objectdb_num_names(db));
+
+		ASSERT_STREQ("Southeastern", objectdb_name(db, n1.ref));
+		ASSERT_STREQ("Big Ten", objectdb_name(db, n3.ref));
+		ASSERT_TRUE(objectdb_name(db, 0) == NULL);
+		ASSERT_TRUE(objectdb_name(db, 3) == NULL);
+
+		/* only len bytes are kept */
+		ASSERT_EQ(OBJECTDB_OK, objectdb_intern(db, "Big Ten Conference",
+		                                       7, &n2));
+		ASSERT_EQ(n3.ref, n2.ref);
+
+		/* the saved objectid is the one the name hashes to */
+		memset(&team, 0, sizeof(team));
+		team.name.str = "Big Ten";
+		objectid_from_team(&team, &expected);
+		team.name = n3;
+		objectid_from_team(&team, &id);
+		ASSERT_TRUE(objectid_compare(&expected, &id));
+
+		team.name.str = "Big Ten";
+		team.name.ref = 0;
+		objectid_fast_from_team(&team, &expected);
+		team.name = n3;
+		objectid_fast_from_team(&team, &id);
+		ASSERT_TRUE(objectid_compare(&expected, &id));
+
+		objectdb_clear(db);
+		ASSERT_EQ(0, objectdb_num_names(db));
+		ASSERT_TRUE(objectdb_name(db, n1.ref) == NULL);
+	}
+
+	TEST_F(ObjectDBTest, InternRejectsLongNames) {
+		std::string name(TEAM_NAME_MAX, 'x');
+		struct name n;
+
+		ASSERT_EQ(OBJECTDB_ERROR, objectdb_intern(db, name.c_str(),
+		                                          name.size(), &n));
+		ASSERT_EQ(OBJECTDB_ETOOLONG, objectdb_get_error(db));
+		ASSERT_EQ(0, objectdb_num_names(db));
+
+		ASSERT_EQ(OBJECTDB_OK, objectdb_intern(db, name.c_str(),
+		                                       name.size() - 1, &n));
+		ASSERT_EQ(1, objectdb_num_names(db));
 	}
 
 	TEST_F(ObjectDBTest, AddGameAndLookup) {
@@ -204,23 +328,23 @@ namespace {
 		struct objectid id;
 		int err;
 
-		game1 = objectdb_create_game();
+		game1 = objectdb_create_game(db);
 		ASSERT_TRUE(game1 != NULL);
 
-		strcpy(team1.name, "Team One");
-		strcpy(team2.name, "Team Two");
+		setName(db, &team1.name, "Team One");
+		setName(db, &team2.name, "Team Two");
 		game1->home = &team1;
 		game1->away = &team2;
 		game1->date = time(NULL);
 
-		err = objectdb_add_game(game1, &id);
+		err = objectdb_add_game(db, game1, &id);
 		ASSERT_EQ(OBJECTDB_OK, err);
 
-		game2 = objectdb_get_game(&id);
+		game2 = objectdb_get_game(db, &id);
 		ASSERT_TRUE(game2 != NULL);
 
-		ASSERT_STREQ(game1->home->name, game2->home->name);
-		ASSERT_STREQ(game1->away->name, game2->away->name);
+		ASSERT_STREQ(game1->home->name.str, game2->home->name.str);
+		ASSERT_STREQ(game1->away->name.str, game2->away->name.str);
 	}
 
 	TEST_F(ObjectDBTest, LookupBogusGame) {
@@ -229,9 +353,9 @@ namespace {
 
 		memset(id.md, 0xaf, sizeof(id.md));
 
-		game = objectdb_get_game(&id);
+		game = objectdb_get_game(db, &id);
 		ASSERT_TRUE(game == NULL);
-		ASSERT_EQ(OBJECTDB_ENOTFOUND, objectdb_errno);
+		ASSERT_EQ(OBJECTDB_ENOTFOUND, objectdb_get_error(db));
 	}
 
 	TEST_F(ObjectDBTest, InsertGameTwice) {
@@ -240,20 +364,655 @@ namespace {
 		struct objectid id;
 		int err;
 
-		game = objectdb_create_game();
+		game = objectdb_create_game(db);
 		ASSERT_TRUE(game != NULL);
 
-		strcpy(team1.name, "Team One");
-		strcpy(team2.name, "Team Two");
+		setName(db, &team1.name, "Team One");
+		setName(db, &team2.name, "Team Two");
 		game->home = &team1;
 		game->away = &team2;
 		game->date = time(NULL);
 
-		err = objectdb_add_game(game, &id);
+		err = objectdb_add_game(db, game, &id);
 		ASSERT_EQ(OBJECTDB_OK, err);
 
-		err = objectdb_add_game(game, &id);
+		err = objectdb_add_game(db, game, &id);
+		ASSERT_EQ(OBJECTDB_ERROR, err);
+		ASSERT_EQ(OBJECTDB_EDUPLICATE, objectdb_get_error(db));
+	}
+
+	TEST_F(ObjectDBTest, LookupManyTeams) {
+		static const int num_teams = 20000;
+		std::vector<struct objectid> ids(num_teams);
+		struct team *team;
+		char name[TEAM_NAME_MAX];
+		int err;
+
+		/* enough to resize the index several times */
+		for (int i = 0; i < num_teams; i++) {
+			team = objectdb_create_team(db);
+			ASSERT_TRUE(team != NULL);
+			snprintf(name, sizeof(name), "Team %d", i);
+			setName(db, &team->name, name);
+
+			err = objectdb_add_team(db, team, &ids[i]);
+			ASSERT_EQ(OBJECTDB_OK, err);
+		}
+
+		for (int i = 0; i < num_teams; i++) {
+			team = objectdb_get_team(db, &ids[i]);
+			ASSERT_TRUE(team != NULL);
+			snprintf(name, sizeof(name), "Team %d", i);
+			ASSERT_STREQ(name, team->name.str);
+		}
+	}
+
+	TEST_F(ObjectDBTest, LookupTeamsByIndex) {
+		struct team *team;
+		struct objectid id;
+		char name[TEAM_NAME_MAX];
+		int err;
+
+		for (int i = 0; i < 1000; i++) {
+			team = objectdb_create_team(db);
+			ASSERT_TRUE(team != NULL);
+			snprintf(name, sizeof(name), "Team %d", i);
+			setName(db, &team->name, name);
+
+			err = objectdb_add_team(db, team, &id);
+			ASSERT_EQ(OBJECTDB_OK, err);
+			ASSERT_EQ((uint32_t) i, team->idx);
+		}
+
+		/* a duplicate doesn't use up an index */
+		err = objectdb_add_team(db, team, &id);
 		ASSERT_EQ(OBJECTDB_ERROR, err);
-		ASSERT_EQ(OBJECTDB_EDUPLICATE, objectdb_errno);
+		ASSERT_EQ(1000, objectdb_num_teams(db));
+
+		for (int i = 0; i < 1000; i++) {
+			team = objectdb_get_team_at(db, i);
+			ASSERT_TRUE(team != NULL);
+			snprintf(name, sizeof(name), "Team %d", i);
+			ASSERT_STREQ(name, team->name.str);
+		}
+
+		team = objectdb_get_team_at(db, 1000);
+		ASSERT_TRUE(team == NULL);
+		ASSERT_EQ(OBJECTDB_ENOTFOUND, objectdb_get_error(db));
+	}
+
+	TEST_F(ObjectDBTest, StatsColumns) {
+		static const int num_games = 1000;
+		struct game *game;
+		struct team team1, team2;
+		struct stats stats;
+		struct objectid id;
+		const short *points;
+		int num_rows;
+		int total = 0;
+		int err;
+
+		setName(db, &team1.name, "Team One");
+		setName(db, &team2.name, "Team Two");
+		memset(&stats, 0, sizeof(stats));
+
+		for (int i = 0; i < num_games; i++) {
+			game = objectdb_create_game(db);
+			ASSERT_TRUE(game != NULL);
+			game->home = &team1;
+			game->away = &team2;
+			game->date = (time_t) i * 24 * 60 * 60;
+
+			err = objectdb_add_game(db, game, &id);
+			ASSERT_EQ(OBJECTDB_OK, err);
+
+			stats.points = i % 50;
+			stats.pass_yds = 300;
+			objectdb_set_game_stats(db, game, GAME_AWAY, &stats);
+			ASSERT_EQ(i % 50, game->away_stats.points);
+		}
+
+		points = objectdb_get_stats_column(db, STATS_POINTS, &num_rows);
+		ASSERT_EQ(num_games * 2, num_rows);
+		ASSERT_EQ(0u, (uintptr_t) points % 32);
+
+		/* the padding past the last row reads as zero */
+		for (int i = 0; i < num_rows + (-num_rows & 15); i++)
+			total += points[i];
+
+		ASSERT_EQ(num_games / 50 * (49 * 50 / 2), total);
+		ASSERT_EQ(0, points[OBJECTDB_STATS_ROW(7, GAME_HOME)]);
+		ASSERT_EQ(7, points[OBJECTDB_STATS_ROW(7, GAME_AWAY)]);
+
+		objectdb_clear(db);
+		objectdb_get_stats_column(db, STATS_POINTS, &num_rows);
+		ASSERT_EQ(0, num_rows);
+	}
+
+	TEST_F(ObjectDBTest, ReserveAndLookup) {
+		struct conference *c, *c2;
+		struct objectid id;
+		int err;
+
+		err = objectdb_reserve(db, 5000);
+		ASSERT_EQ(OBJECTDB_OK, err);
+
+		c = objectdb_create_conference(db);
+		ASSERT_TRUE(c != NULL);
+		setName(db, &c->name, "Southeastern");
+
+		err = objectdb_add_conference(db, c, &id);
+		ASSERT_EQ(OBJECTDB_OK, err);
+
+		c2 = objectdb_get_conference(db, &id);
+		ASSERT_EQ(c, c2);
+
+		/* clearing the database empties the index too */
+		objectdb_clear(db);
+		c2 = objectdb_get_conference(db, &id);
+		ASSERT_TRUE(c2 == NULL);
+		ASSERT_EQ(OBJECTDB_ENOTFOUND, objectdb_get_error(db));
+	}
+
+	static struct team *addTeam(objectdb_ctx *db, struct conference *conf,
+	                            const char *name, short points)
+	{
+		struct team *team;
+		struct objectid id;
+
+		team = objectdb_create_team(db);
+		if (!team)
+			return NULL;
+
+		setName(db, &team->name, name);
+		objectid_from_conference(conf, &team->conf_oid);
+		team->conf = conf;
+		team->stats.points = points;
+
+		if (objectdb_add_team(db, team, &id) != OBJECTDB_OK)
+			return NULL;
+
+		return team;
+	}
+
+	TEST_F(ObjectDBTest, MergeDatabases) {
+		objectdb_ctx *src;
+		struct conference *c;
+		struct team *home, *away, *merged;
+		struct game *game, *merged_game;
+		struct objectid id, game_id;
+		int num_games;
+		int err;
+
+		/* dst already knows about the conference and one team */
+		c = objectdb_create_conference(db);
+		ASSERT_TRUE(c != NULL);
+		setName(db, &c->name, "Southeastern");
+		err = objectdb_add_conference(db, c, &id);
+		ASSERT_EQ(OBJECTDB_OK, err);
+		ASSERT_TRUE(addTeam(db, c, "Team One", 10) != NULL);
+
+		src = objectdb_new();
+		ASSERT_TRUE(src != NULL);
+
+		c = objectdb_create_conference(src);
+		ASSERT_TRUE(c != NULL);
+		setName(src, &c->name, "Southeastern");
+		err = objectdb_add_conference(src, c, &id);
+		ASSERT_EQ(OBJECTDB_OK, err);
+
+		home = addTeam(src, c, "Team One", 7);
+		away = addTeam(src, c, "Team Two", 3);
+		ASSERT_TRUE(home != NULL);
+		ASSERT_TRUE(away != NULL);
+
+		game = objectdb_create_game(src);
+		ASSERT_TRUE(game != NULL);
+		objectid_from_team(home, &game->home_oid);
+		objectid_from_team(away, &game->away_oid);
+		game->home = home;
+		game->away = away;
+		game->date = time(NULL);
+		err = objectdb_add_game(src, game, &game_id);
+		ASSERT_EQ(OBJECTDB_OK, err);
+
+		objectid_from_team(home, &id);
+
+		err = objectdb_merge(db, src);
+		objectdb_free(src);
+		ASSERT_EQ(OBJECTDB_OK, err);
+
+		/* existing team is reused and its stats are accumulated */
+		merged = objectdb_get_team(db, &id);
+		ASSERT_TRUE(merged != NULL);
+		ASSERT_EQ(17, merged->stats.points);
+
+		/* the game points at the teams in dst, not src */
+		merged_game = objectdb_get_game(db, &game_id);
+		ASSERT_TRUE(merged_game != NULL);
+		ASSERT_EQ(merged, merged_game->home);
+		ASSERT_STREQ("Team Two", merged_game->away->name.str);
+
+		objectdb_get_games(db, &num_games);
+		ASSERT_EQ(1, num_games);
+
+		/* only the new team's name was added to dst's pool */
+		ASSERT_EQ(3, objectdb_num_names(db));
+	}
+
+	TEST_F(ObjectDBTest, MergeSeasonTotals) {
+		struct conference *c;
+		struct team *team;
+		struct objectid id;
+		int season;
+
+		/* eight seasons of a passing team go well past a short */
+		for (season = 0; season < 8; season++) {
+			objectdb_ctx *src = objectdb_new();
+			ASSERT_TRUE(src != NULL);
+
+			c = objectdb_create_conference(src);
+			ASSERT_TRUE(c != NULL);
+			setName(src, &c->name, "Big 12");
+			ASSERT_EQ(OBJECTDB_OK, objectdb_add_conference(src, c, &id));
+
+			team = addTeam(src, c, "Texas Tech", 450);
+			ASSERT_TRUE(team != NULL);
+			team->stats.pass_yds = 5000;
+			objectid_from_team(team, &id);
+
+			ASSERT_EQ(OBJECTDB_OK, objectdb_merge(db, src));
+			objectdb_free(src);
+		}
+
+		team = objectdb_get_team(db, &id);
+		ASSERT_TRUE(team != NULL);
+		ASSERT_GT(team->stats.pass_yds, SHRT_MAX);
+		ASSERT_EQ(40000, team->stats.pass_yds);
+		ASSERT_EQ(3600, objectdb_team_stats_get(&team->stats, STATS_POINTS));
+	}
+
+	TEST_F(ObjectDBTest, MergeDuplicateGame) {
+		objectdb_ctx *src;
+		struct conference *c;
+		struct team *home, *away;
+		struct game *game;
+		struct objectid id;
+		int err;
+
+		src = objectdb_new();
+		ASSERT_TRUE(src != NULL);
+
+		c = objectdb_create_conference(src);
+		ASSERT_TRUE(c != NULL);
+		setName(src, &c->name, "Southeastern");
+		err = objectdb_add_conference(src, c, &id);
+		ASSERT_EQ(OBJECTDB_OK, err);
+
+		home = addTeam(src, c, "Team One", 0);
+		away = addTeam(src, c, "Team Two", 0);
+		ASSERT_TRUE(home != NULL);
+		ASSERT_TRUE(away != NULL);
+
+		game = objectdb_create_game(src);
+		ASSERT_TRUE(game != NULL);
+		objectid_from_team(home, &game->home_oid);
+		objectid_from_team(away, &game->away_oid);
+		game->home = home;
+		game->away = away;
+		game->date = 0;
+		err = objectdb_add_game(src, game, &id);
+		ASSERT_EQ(OBJECTDB_OK, err);
+
+		/* the second merge repeats every game */
+		err = objectdb_merge(db, src);
+		ASSERT_EQ(OBJECTDB_OK, err);
+		err = objectdb_merge(db, src);
+		ASSERT_EQ(OBJECTDB_ERROR, err);
+		ASSERT_EQ(OBJECTDB_EDUPLICATE, objectdb_get_error(db));
+
+		objectdb_free(src);
+	}
+
+	TEST_F(ObjectDBTest, WriteAndRead) {
+		objectdb_ctx *loaded;
+		struct conference *c;
+		struct team *home, *away;
+		struct game *game;
+		struct objectid id, game_id;
+		char path[] = "/tmp/predcfb_yamlXXXXXX";
+		int fd;
+		int err;
+
+		c = objectdb_create_conference(db);
+		ASSERT_TRUE(c != NULL);
+		setName(db, &c->name, "Southeastern");
+		c->subdivision = CONFERENCE_FCS;
+		ASSERT_EQ(OBJECTDB_OK, objectdb_add_conference(db, c, &id));
+
+		home = addTeam(db, c, "Team One", 0);
+		away = addTeam(db, c, "Team Two", 0);
+		ASSERT_TRUE(home != NULL);
+		ASSERT_TRUE(away != NULL);
+
+		game = objectdb_create_game(db);
+		ASSERT_TRUE(game != NULL);
+		objectid_from_team(home, &game->home_oid);
+		objectid_from_team(away, &game->away_oid);
+		game->home = home;
+		game->away = away;
+		game->date = time(NULL);
+		ASSERT_EQ(OBJECTDB_OK, objectdb_add_game(db, game, &game_id));
+
+		fd = mkstemp(path);
+		ASSERT_NE(-1, fd);
+		close(fd);
+
+		err = objectdb_write(db, path, OBJECTDB_FORMAT_YAML);
+		ASSERT_EQ(OBJECTDB_OK, err);
+
+		loaded = objectdb_new();
+		ASSERT_TRUE(loaded != NULL);
+		err = objectdb_read(loaded, path);
+		unlink(path);
+		ASSERT_EQ(OBJECTDB_OK, err);
+
+		/* references are relinked within the loaded database */
+		game = objectdb_get_game(loaded, &game_id);
+		ASSERT_TRUE(game != NULL);
+		ASSERT_STREQ("Team One", game->home->name.str);
+		ASSERT_STREQ("Southeastern", game->away->conf->name.str);
+		ASSERT_EQ(CONFERENCE_FCS, game->away->conf->subdivision);
+		ASSERT_EQ(objectdb_get_team(loaded, &game->home_oid), game->home);
+
+		objectdb_free(loaded);
+	}
+
+	TEST_F(ObjectDBTest, ReadMismatchedObject) {
+		char path[] = "/tmp/predcfb_yamlXXXXXX";
+		FILE *f;
+		int fd;
+		int err;
+
+		fd = mkstemp(path);
+		ASSERT_NE(-1, fd);
+		f = fdopen(fd, "w");
+		ASSERT_TRUE(f != NULL);
+
+		/* the name doesn't hash to the saved sha1 */
+		fputs("---\n"
+		      "- type: CONF\n"
+		      "  sha1: a1838e086f0df8671b35ac5892b8c9105bcc6a05\n"
+		      "  conference:\n"
+		      "    name: Not The Right Name\n"
+		      "    subdivision: FBS\n", f);
+		fclose(f);
+
+		err = objectdb_read(db, path);
+		unlink(path);
+		ASSERT_EQ(OBJECTDB_ERROR, err);
+		ASSERT_EQ(OBJECTDB_EMISMATCH, objectdb_get_error(db));
+
+		err = objectdb_read(db, "/nonexistent/predcfb.yml");
+		ASSERT_EQ(OBJECTDB_ERROR, err);
+		ASSERT_EQ(OBJECTDB_EREAD, objectdb_get_error(db));
+	}
+
+	TEST_F(ObjectDBTest, AddGamesBatch) {
+		static const int num_games = 20;
+		struct conference *c;
+		struct team *home, *away;
+		struct game *games[num_games];
+		struct objectid ids[num_games];
+		struct objectid id;
+		int i;
+
+		c = objectdb_create_conference(db);
+		ASSERT_TRUE(c != NULL);
+		setName(db, &c->name, "Southeastern");
+		ASSERT_EQ(OBJECTDB_OK, objectdb_add_conference(db, c, &id));
+
+		home = addTeam(db, c, "Team One", 0);
+		away = addTeam(db, c, "Team Two", 0);
+		ASSERT_TRUE(home != NULL);
+		ASSERT_TRUE(away != NULL);
+
+		for (i = 0; i < num_games; i++) {
+			games[i] = objectdb_create_game(db);
+			ASSERT_TRUE(games[i] != NULL);
+			games[i]->home = home;
+			games[i]->away = away;
+			games[i]->date = 1000000000 + i * 86400;
+		}
+
+		ASSERT_EQ(OBJECTDB_OK,
+		          objectdb_add_games(db, games, num_games, ids));
+		ASSERT_EQ(num_games, objectdb_num_games(db));
+
+		for (i = 0; i < num_games; i++) {
+			objectid_from_game(games[i], &id);
+			ASSERT_TRUE(objectid_compare(&id, &ids[i]));
+			ASSERT_EQ(games[i], objectdb_get_game(db, &ids[i]));
+			ASSERT_EQ((uint32_t) i, games[i]->idx);
+		}
+
+		/* a duplicate stops the batch, the games before it are kept */
+		games[0] = objectdb_create_game(db);
+		games[1] = objectdb_create_game(db);
+		ASSERT_TRUE(games[0] != NULL);
+		ASSERT_TRUE(games[1] != NULL);
+		*games[0] = *games[2];
+		games[0]->date = 0;
+		games[0]->date_str[0] = '\0';
+		*games[1] = *games[2];
+
+		ASSERT_EQ(OBJECTDB_ERROR, objectdb_add_games(db, games, 2, ids));
+		ASSERT_EQ(OBJECTDB_EDUPLICATE, objectdb_get_error(db));
+		ASSERT_EQ(num_games + 1, objectdb_num_games(db));
+	}
+
+	TEST_F(ObjectDBTest, AddOrGetGames) {
+		struct conference *c;
+		struct team *home, *away;
+		struct game *games[3], *first;
+		struct objectid ids[3];
+		struct objectid id;
+		int i;
+
+		c = objectdb_create_conference(db);
+		ASSERT_TRUE(c != NULL);
+		setName(db, &c->name, "Southeastern");
+		ASSERT_EQ(OBJECTDB_OK, objectdb_add_conference(db, c, &id));
+
+		home = addTeam(db, c, "Team One", 0);
+		away = addTeam(db, c, "Team Two", 0);
+		ASSERT_TRUE(home != NULL);
+		ASSERT_TRUE(away != NULL);
+
+		first = objectdb_create_game(db);
+		ASSERT_TRUE(first != NULL);
+		first->home = home;
+		first->away = away;
+		first->date = 1000000000;
+		ASSERT_EQ(OBJECTDB_OK, objectdb_add_game(db, first, &id));
+
+		/* the same game again, between two new ones */
+		for (i = 0; i < 3; i++) {
+			games[i] = objectdb_create_game(db);
+			ASSERT_TRUE(games[i] != NULL);
+			games[i]->home = home;
+			games[i]->away = away;
+			games[i]->date = 1000000000 + (i - 1) * 86400;
+		}
+
+		ASSERT_EQ(OBJECTDB_OK,
+		          objectdb_add_or_get_games(db, games, 3, ids));
+		ASSERT_EQ(3, objectdb_num_games(db));
+
+		ASSERT_EQ(first, games[1]);
+		ASSERT_TRUE(objectid_compare(&id, &ids[1]));
+		ASSERT_EQ(games[0], objectdb_get_game(db, &ids[0]));
+		ASSERT_EQ(games[2], objectdb_get_game(db, &ids[2]));
+		ASSERT_EQ(2U, games[2]->idx);
+	}
+
+	TEST_F(ObjectDBTest, DirtyTeams) {
+		struct conference *c;
+		struct team *teams[3];
+		struct team **dirty;
+		struct game *game;
+		struct stats stats;
+		struct objectid id;
+		int num_dirty;
+
+		c = objectdb_create_conference(db);
+		ASSERT_TRUE(c != NULL);
+		setName(db, &c->name, "Southeastern");
+		ASSERT_EQ(OBJECTDB_OK, objectdb_add_conference(db, c, &id));
+
+		teams[0] = addTeam(db, c, "Team One", 0);
+		teams[1] = addTeam(db, c, "Team Two", 0);
+		teams[2] = addTeam(db, c, "Team Three", 0);
+		ASSERT_TRUE(teams[2] != NULL);
+
+		/* teams without games have nothing to work out */
+		objectdb_get_dirty_teams(db, &num_dirty);
+		ASSERT_EQ(0, num_dirty);
+
+		game = objectdb_create_game(db);
+		ASSERT_TRUE(game != NULL);
+		game->home = teams[2];
+		game->away = teams[0];
+		game->date = 1000000000;
+		ASSERT_EQ(OBJECTDB_OK, objectdb_add_game(db, game, &id));
+
+		dirty = objectdb_get_dirty_teams(db, &num_dirty);
+		ASSERT_EQ(2, num_dirty);
+		ASSERT_EQ(teams[2], dirty[0]);
+		ASSERT_EQ(teams[0], dirty[1]);
+		ASSERT_FALSE(objectdb_team_is_dirty(db, teams[1]));
+
+		objectdb_clear_dirty(db);
+		objectdb_get_dirty_teams(db, &num_dirty);
+		ASSERT_EQ(0, num_dirty);
+		ASSERT_FALSE(objectdb_team_is_dirty(db, teams[2]));
+
+		/* setting a side's stats marks both teams again, once */
+		memset(&stats, 0, sizeof(stats));
+		stats.points = 21;
+		objectdb_set_game_stats(db, game, GAME_HOME, &stats);
+		objectdb_set_game_stats(db, game, GAME_AWAY, &stats);
+
+		objectdb_get_dirty_teams(db, &num_dirty);
+		ASSERT_EQ(2, num_dirty);
+		ASSERT_TRUE(objectdb_team_is_dirty(db, teams[0]));
+		ASSERT_TRUE(objectdb_team_is_dirty(db, teams[2]));
+		ASSERT_FALSE(objectdb_team_is_dirty(db, teams[1]));
+	}
+
+	TEST_F(ObjectDBTest, FastIds) {
+		objectdb_ctx *fast;
+		struct conference *c;
+		struct team *home, *away;
+		struct game *game;
+		struct objectid id, game_id;
+		char path[] = "/tmp/predcfb_yamlXXXXXX";
+		int fd;
+
+		fast = objectdb_new_ids(OBJECTID_FAST);
+		ASSERT_TRUE(fast != NULL);
+		ASSERT_EQ(OBJECTID_FAST, objectdb_get_ids(fast));
+		ASSERT_EQ(OBJECTID_SHA1, objectdb_get_ids(db));
+
+		c = objectdb_create_conference(fast);
+		ASSERT_TRUE(c != NULL);
+		setName(fast, &c->name, "Southeastern");
+		ASSERT_EQ(OBJECTDB_OK, objectdb_add_conference(fast, c, &id));
+		ASSERT_EQ(c, objectdb_get_conference(fast, &id));
+
+		home = addTeam(fast, c, "Team One", 0);
+		away = addTeam(fast, c, "Team Two", 0);
+		ASSERT_TRUE(home != NULL);
+		ASSERT_TRUE(away != NULL);
+
+		game = objectdb_create_game(fast);
+		ASSERT_TRUE(game != NULL);
+		objectid_fast_from_team(home, &game->home_oid);
+		objectid_fast_from_team(away, &game->away_oid);
+		game->home = home;
+		game->away = away;
+		game->date = time(NULL);
+		ASSERT_EQ(OBJECTDB_OK, objectdb_add_game(fast, game, &game_id));
+		ASSERT_EQ(game, objectdb_get_game(fast, &game_id));
+		ASSERT_EQ(home, objectdb_get_team(fast, &game->home_oid));
+
+		/* none of it means anything outside of this database */
+		fd = mkstemp(path);
+		ASSERT_NE(-1, fd);
+		close(fd);
+
+		ASSERT_EQ(OBJECTDB_ERROR,
+		          objectdb_write(fast, path, OBJECTDB_FORMAT_YAML));
+		ASSERT_EQ(OBJECTDB_EIDS, objectdb_get_error(fast));
+		ASSERT_EQ(OBJECTDB_ERROR, objectdb_read(fast, path));
+		ASSERT_EQ(OBJECTDB_EIDS, objectdb_get_error(fast));
+		unlink(path);
+
+		ASSERT_EQ(OBJECTDB_ERROR, objectdb_merge(db, fast));
+		ASSERT_EQ(OBJECTDB_EIDS, objectdb_get_error(db));
+		ASSERT_EQ(0, objectdb_num_conferences(db));
+
+		objectdb_free(fast);
+	}
+
+	/* build one database per thread, each with the same team names */
+	static void buildTeams(objectdb_ctx *db, int num_teams, int *failures)
+	{
+		struct team *team;
+		struct objectid id;
+		char name[TEAM_NAME_MAX];
+		int i;
+
+		for (i = 0; i < num_teams; i++) {
+			snprintf(name, sizeof(name), "Team %d", i);
+
+			team = objectdb_create_team(db);
+			if (!team) {
+				(*failures)++;
+				continue;
+			}
+
+			if (objectdb_intern(db, name, strlen(name),
+			                    &team->name) != OBJECTDB_OK)
+				(*failures)++;
+			else if (objectdb_add_team(db, team, &id) != OBJECTDB_OK)
+				(*failures)++;
+			else if (objectdb_get_team(db, &id) != team)
+				(*failures)++;
+		}
+	}
+
+	TEST(ObjectDBTestNoFixture, ConcurrentDatabases) {
+		static const int num_threads = 4;
+		std::vector<std::thread> threads;
+		objectdb_ctx *dbs[num_threads];
+		int failures[num_threads];
+
+		for (int i = 0; i < num_threads; i++) {
+			dbs[i] = objectdb_new();
+			ASSERT_TRUE(dbs[i] != NULL);
+			failures[i] = 0;
+		}
+
+		for (int i = 0; i < num_threads; i++) {
+			threads.push_back(std::thread(buildTeams, dbs[i],
+			                              256, &failures[i]));
+		}
+
+		for (int i = 0; i < num_threads; i++) {
+			threads[i].join();
+			EXPECT_EQ(0, failures[i]);
+			objectdb_free(dbs[i]);
+		}
 	}
 }
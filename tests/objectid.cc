@@ -1,12 +1,18 @@
 
 #include <time.h>
+#include <atomic>
 #include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <gtest/gtest.h>
 
 extern "C" {
+#include <polarssl/sha1.h>
 #include <predcfb/predcfb.h>
 #include <predcfb/objectid.h>
+#include "../src/objectdb/hash_impl.h"
 }
 
 namespace {
@@ -66,6 +72,21 @@ namespace {
 		ASSERT_EQ('\0', buf[OBJECTID_MD_STR_SIZE - 1]);
 	}
 
+	TEST_F(ObjectIDTest, FromString)
+	{
+		char buf[OBJECTID_MD_STR_SIZE];
+		struct objectid id;
+
+		objectid_string(&oid2, buf);
+		ASSERT_TRUE(objectid_from_string(buf, &id));
+		ASSERT_TRUE(objectid_compare(&oid2, &id));
+
+		ASSERT_FALSE(objectid_from_string("afaf", &id));
+
+		buf[5] = 'x';
+		ASSERT_FALSE(objectid_from_string(buf, &id));
+	}
+
 	TEST_F(ObjectIDTest, Conference)
 	{
 		static const char *conf_name = "Southeastern Conference";
@@ -76,7 +97,8 @@ namespace {
 		char buf[OBJECTID_MD_STR_SIZE];
 		int diff;
 
-		strncpy(conf.name, conf_name, CONFERENCE_NAME_MAX);
+		memset(&conf, 0, sizeof(conf));
+		conf.name.str = conf_name;
 		conf.subdivision = CONFERENCE_FBS;
 
 		objectid_from_conference(&conf, &oid);
@@ -96,7 +118,8 @@ namespace {
 		char buf[OBJECTID_MD_STR_SIZE];
 		int diff;
 
-		strncpy(team.name, team_name, TEAM_NAME_MAX);
+		memset(&team, 0, sizeof(team));
+		team.name.str = team_name;
 
 		objectid_from_team(&team, &oid);
 		objectid_string(&oid, buf);
@@ -120,9 +143,13 @@ namespace {
 		struct tm tm;
 		int diff;
 
-		strncpy(team1.name, team1_name, TEAM_NAME_MAX);
-		strncpy(team2.name, team2_name, TEAM_NAME_MAX);
+		memset(&team1, 0, sizeof(team1));
+		memset(&team2, 0, sizeof(team2));
+		team1.name.str = team1_name;
+		team2.name.str = team2_name;
 
+		memset(&game, 0, sizeof(game));
+		memset(&tm, 0, sizeof(tm));
 		game.home = &team1;
 		game.away = &team2;
 
@@ -135,5 +162,281 @@ namespace {
 
 		diff = strcmp(buf, game_sha1);
 		ASSERT_EQ(0, diff);
+
+		/* the string kept by the parser hashes the same */
+		strcpy(game.date_str, "2013-12-01");
+		objectid_from_game(&game, &oid);
+		objectid_string(&oid, buf);
+		ASSERT_STREQ(game_sha1, buf);
+	}
+
+	/* every implementation gives polarssl's answer, across block ends */
+	TEST_F(ObjectIDTest, Sha1ImplsMatch)
+	{
+		enum objectid_sha1_impl best = objectid_get_sha1_impl();
+		enum objectid_sha1_impl impl;
+		unsigned char expected[OBJECTID_MD_SIZE];
+		char both[TEAM_NAME_MAX * 2 + DATE_STR_SIZE];
+		char home_name[TEAM_NAME_MAX], away_name[TEAM_NAME_MAX];
+		struct team home, away;
+		struct game game;
+		struct objectid oid;
+
+		memset(&home, 0, sizeof(home));
+		memset(&away, 0, sizeof(away));
+		home.name.str = home_name;
+		away.name.str = away_name;
+
+		memset(&game, 0, sizeof(game));
+		game.home = &home;
+		game.away = &away;
+		strcpy(game.date_str, "2013-12-01");
+
+		for (impl = OBJECTID_SHA1_POLARSSL; impl <= OBJECTID_SHA1_SHANI;
+		     impl = (enum objectid_sha1_impl) (impl + 1)) {
+			if (!objectid_set_sha1_impl(impl))
+				continue;
+
+			for (int len = 0; len < TEAM_NAME_MAX; len++) {
+				for (int i = 0; i < len; i++) {
+					home_name[i] = 'a' + (i * 7 + len) % 26;
+					away_name[i] = 'A' + (i * 3 + len) % 26;
+				}
+				home_name[len] = '\0';
+				away_name[len] = '\0';
+
+				objectid_from_team(&home, &oid);
+				sha1((const unsigned char *) home_name, len, expected);
+				ASSERT_EQ(0, memcmp(expected, oid.md, OBJECTID_MD_SIZE))
+					<< objectid_sha1_impl_name(impl) << " " << len;
+
+				snprintf(both, sizeof(both), "%s%s%s",
+				         home_name, away_name, game.date_str);
+				objectid_from_game(&game, &oid);
+				sha1((const unsigned char *) both, strlen(both),
+				     expected);
+				ASSERT_EQ(0, memcmp(expected, oid.md, OBJECTID_MD_SIZE))
+					<< objectid_sha1_impl_name(impl) << " " << len;
+			}
+		}
+
+		ASSERT_TRUE(objectid_set_sha1_impl(best));
+	}
+
+	/*
+	 * hashes and batches under way on other threads aren't disturbed by
+	 * a switch of either implementation
+	 */
+	TEST_F(ObjectIDTest, SwitchWhileHashing)
+	{
+		static const int num_games = 64;
+		enum objectid_sha1_impl best = objectid_get_sha1_impl();
+		enum objectid_batch_impl best_batch = objectid_get_batch_impl();
+		char names[num_games][TEAM_NAME_MAX];
+		struct team teams[num_games];
+		struct game games[num_games];
+		const struct game *list[num_games];
+		struct objectid expected[num_games];
+		std::atomic<bool> done(false);
+		std::atomic<int> wrong(0);
+		std::atomic<int> rounds(0);
+		std::vector<std::thread> threads;
+
+		memset(teams, 0, sizeof(teams));
+		memset(games, 0, sizeof(games));
+
+		for (int i = 0; i < num_games; i++) {
+			snprintf(names[i], TEAM_NAME_MAX, "Team %d %.*s", i, i % 50,
+			         "abcdefghijklmnopqrstuvwxyzabcdefghijklmnopqrstuvwx");
+			teams[i].name.str = names[i];
+		}
+
+		for (int i = 0; i < num_games; i++) {
+			games[i].home = &teams[i];
+			games[i].away = &teams[(i * 7 + 3) % num_games];
+			strcpy(games[i].date_str, "2013-09-07");
+			objectid_from_game(&games[i], &expected[i]);
+			list[i] = &games[i];
+		}
+
+		for (int t = 0; t < 4; t++) {
+			threads.push_back(std::thread([&]() {
+				struct objectid ids[num_games];
+
+				while (!done) {
+					for (int i = 0; i < num_games; i++) {
+						objectid_from_game(&games[i], &ids[i]);
+						if (!objectid_compare(&ids[i], &expected[i]))
+							wrong++;
+					}
+
+					objectid_from_games(list, num_games, ids);
+					for (int i = 0; i < num_games; i++) {
+						if (!objectid_compare(&ids[i], &expected[i]))
+							wrong++;
+					}
+
+					rounds++;
+				}
+			}));
+		}
+
+		/* keep switching until every thread has been through a few */
+		for (int n = 0; n < 2000 || rounds < 100; n++) {
+			objectid_set_sha1_impl((enum objectid_sha1_impl)
+			                       (n % (OBJECTID_SHA1_SHANI + 1)));
+			objectid_set_batch_impl((enum objectid_batch_impl)
+			                        (n % (OBJECTID_BATCH_MB_AVX2 + 1)));
+		}
+
+		done = true;
+		for (size_t t = 0; t < threads.size(); t++)
+			threads[t].join();
+
+		ASSERT_EQ(0, wrong);
+		ASSERT_TRUE(objectid_set_sha1_impl(best));
+		ASSERT_TRUE(objectid_set_batch_impl(best_batch));
+	}
+
+	/* games of one to three blocks, mixed within each batch of lanes */
+	TEST_F(ObjectIDTest, BatchMatchesSerial)
+	{
+		static const int num_games = 100;
+		enum objectid_batch_impl best = objectid_get_batch_impl();
+		enum objectid_batch_impl impl;
+		char names[TEAM_NAME_MAX][TEAM_NAME_MAX];
+		struct team teams[TEAM_NAME_MAX];
+		struct game games[num_games];
+		const struct game *list[num_games];
+		struct objectid ids[num_games];
+		struct objectid oid;
+
+		memset(names, 0, sizeof(names));
+		memset(teams, 0, sizeof(teams));
+		memset(games, 0, sizeof(games));
+
+		for (int i = 0; i < TEAM_NAME_MAX; i++) {
+			for (int j = 0; j < i; j++)
+				names[i][j] = 'a' + (i + j) % 26;
+			teams[i].name.str = names[i];
+		}
+
+		for (int i = 0; i < num_games; i++) {
+			games[i].home = &teams[(i * 7) % TEAM_NAME_MAX];
+			games[i].away = &teams[(i * 13 + 5) % TEAM_NAME_MAX];
+			snprintf(games[i].date_str, DATE_STR_SIZE, "2013-%02d-%02d",
+			         1 + i % 12, 1 + i % 28);
+			list[i] = &games[i];
+		}
+
+		for (impl = OBJECTID_BATCH_SERIAL; impl <= OBJECTID_BATCH_MB_AVX2;
+		     impl = (enum objectid_batch_impl) (impl + 1)) {
+			if (!objectid_set_batch_impl(impl))
+				continue;
+
+			/* odd sizes leave lanes of the last batch empty */
+			for (int num = 1; num <= num_games; num += 33) {
+				memset(ids, 0, sizeof(ids));
+				objectid_from_games(list, num, ids);
+
+				for (int i = 0; i < num; i++) {
+					objectid_from_game(&games[i], &oid);
+					ASSERT_TRUE(objectid_compare(&oid, &ids[i]))
+						<< objectid_batch_impl_name(impl)
+						<< " game " << i << " of " << num;
+				}
+			}
+		}
+
+		ASSERT_TRUE(objectid_set_batch_impl(best));
+	}
+
+	/* names too long for a game message are hashed a piece at a time */
+	TEST_F(ObjectIDTest, LongNamesInGames)
+	{
+		static const int num_games = 10;
+		std::string long_name(TEAM_NAME_MAX * 4, 'x');
+		struct team short_team, long_team;
+		struct game games[num_games];
+		const struct game *list[num_games];
+		struct objectid ids[num_games];
+		struct objectid oid;
+
+		memset(&short_team, 0, sizeof(short_team));
+		memset(&long_team, 0, sizeof(long_team));
+		memset(games, 0, sizeof(games));
+		short_team.name.str = "Alabama";
+		long_team.name.str = long_name.c_str();
+
+		for (int i = 0; i < num_games; i++) {
+			games[i].home = i % 3 ? &short_team : &long_team;
+			games[i].away = i % 2 ? &long_team : &short_team;
+			snprintf(games[i].date_str, DATE_STR_SIZE, "2013-09-%02d",
+			         1 + i);
+			list[i] = &games[i];
+		}
+
+		objectid_from_games(list, num_games, ids);
+
+		for (int i = 0; i < num_games; i++) {
+			objectid_from_game(&games[i], &oid);
+			ASSERT_TRUE(objectid_compare(&oid, &ids[i])) << "game " << i;
+		}
+
+		/* the fast id of a game that doesn't fit is its sha1 id */
+		objectid_fast_from_game(&games[0], &oid);
+		ASSERT_TRUE(objectid_compare(&oid, &ids[0]));
+	}
+
+	TEST_F(ObjectIDTest, FastIds)
+	{
+		struct conference conf;
+		struct team team1, team2;
+		struct game game;
+		struct objectid oid, oid2, sha1_oid;
+
+		memset(&conf, 0, sizeof(conf));
+		memset(&team1, 0, sizeof(team1));
+		memset(&team2, 0, sizeof(team2));
+		conf.name.str = "Southeastern Conference";
+		team1.name.str = "Alabama";
+		team2.name.str = "LSU";
+
+		objectid_fast_from_team(&team1, &oid);
+		objectid_fast_from_team(&team1, &oid2);
+		ASSERT_TRUE(objectid_compare(&oid, &oid2));
+
+		/* the tail the index fingerprints is part of the hash */
+		ASSERT_EQ(0, memcmp(oid.md, oid.md + 16, OBJECTID_MD_SIZE - 16));
+
+		objectid_fast_from_team(&team2, &oid2);
+		ASSERT_FALSE(objectid_compare(&oid, &oid2));
+
+		objectid_from_team(&team1, &sha1_oid);
+		ASSERT_FALSE(objectid_compare(&oid, &sha1_oid));
+
+		/* a conference and a team with the same name are the same bytes */
+		team2.name = conf.name;
+		objectid_fast_from_conference(&conf, &oid);
+		objectid_fast_from_team(&team2, &oid2);
+		ASSERT_TRUE(objectid_compare(&oid, &oid2));
+
+		memset(&game, 0, sizeof(game));
+		game.home = &team1;
+		game.away = &team2;
+		strcpy(game.date_str, "2013-12-01");
+		objectid_fast_from_game(&game, &oid);
+
+		/* home and away matter, and so does the day */
+		game.home = &team2;
+		game.away = &team1;
+		objectid_fast_from_game(&game, &oid2);
+		ASSERT_FALSE(objectid_compare(&oid, &oid2));
+
+		game.home = &team1;
+		game.away = &team2;
+		strcpy(game.date_str, "2013-12-02");
+		objectid_fast_from_game(&game, &oid2);
+		ASSERT_FALSE(objectid_compare(&oid, &oid2));
 	}
 }
@@ -0,0 +1,278 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gtest/gtest.h>
+
+extern "C" {
+#include <predcfb/predcfb.h>
+#include <predcfb/objectid.h>
+#include <predcfb/objectdb.h>
+#include <predcfb/snapshot.h>
+}
+
+namespace {
+
+	class SnapshotTest : public ::testing::Test {
+		protected:
+			SnapshotTest() {}
+			virtual ~SnapshotTest() {}
+			virtual void SetUp();
+			virtual void TearDown();
+			void fillDatabase();
+
+			objectdb_ctx *db;
+			snapshot_ctx *snap;
+			char path[32];
+			struct objectid game_id;
+	};
+
+	void SnapshotTest::SetUp()
+	{
+		int fd;
+
+		db = objectdb_new();
+		ASSERT_TRUE(db != NULL);
+
+		snap = snapshot_new();
+		ASSERT_TRUE(snap != NULL);
+
+		strcpy(path, "/tmp/predcfb_snapXXXXXX");
+		fd = mkstemp(path);
+		ASSERT_NE(-1, fd);
+		close(fd);
+	}
+
+	void SnapshotTest::TearDown()
+	{
+		snapshot_free(snap);
+		objectdb_free(db);
+		unlink(path);
+	}
+
+	static void setName(objectdb_ctx *db, struct name *n, const char *str)
+	{
+		ASSERT_EQ(OBJECTDB_OK, objectdb_intern(db, str, strlen(str), n));
+	}
+
+	void SnapshotTest::fillDatabase()
+	{
+		struct conference *c;
+		struct team *home, *away;
+		struct game *g;
+		struct objectid id;
+
+		c = objectdb_create_conference(db);
+		ASSERT_TRUE(c != NULL);
+		setName(db, &c->name, "Southeastern");
+		c->subdivision = CONFERENCE_FBS;
+		ASSERT_EQ(OBJECTDB_OK, objectdb_add_conference(db, c, &id));
+
+		home = objectdb_create_team(db);
+		ASSERT_TRUE(home != NULL);
+		setName(db, &home->name, "Team One");
+		home->conf = c;
+		home->conf_oid = id;
+		home->stats.points = 31;
+		ASSERT_EQ(OBJECTDB_OK, objectdb_add_team(db, home, &id));
+
+		away = objectdb_create_team(db);
+		ASSERT_TRUE(away != NULL);
+		setName(db, &away->name, "Team Two");
+		away->conf = c;
+		away->conf_oid = home->conf_oid;
+		away->stats.points = 17;
+		ASSERT_EQ(OBJECTDB_OK, objectdb_add_team(db, away, &id));
+
+		g = objectdb_create_game(db);
+		ASSERT_TRUE(g != NULL);
+		g->home = home;
+		objectid_from_team(home, &g->home_oid);
+		g->away = away;
+		objectid_from_team(away, &g->away_oid);
+		g->date = 1000000000;
+		g->neutral = true;
+		g->home_stats.points = 31;
+		g->away_stats.points = 17;
+		g->away_stats.pass_yds = 250;
+		ASSERT_EQ(OBJECTDB_OK, objectdb_add_game(db, g, &game_id));
+	}
+
+	/*************************************************/
+
+	TEST_F(SnapshotTest, WriteAndMap) {
+		const struct snapshot_team *teams;
+		const struct snapshot_game *games;
+		int num_teams, num_games;
+		int err;
+
+		fillDatabase();
+
+		err = objectdb_write(db, path, OBJECTDB_FORMAT_SNAPSHOT);
+		ASSERT_EQ(OBJECTDB_OK, err);
+
+		err = snapshot_open(snap, path);
+		ASSERT_EQ(SNAPSHOT_OK, err);
+
+		teams = snapshot_get_teams(snap, &num_teams);
+		ASSERT_EQ(2, num_teams);
+		ASSERT_STREQ("Team Two", snapshot_string(snap, teams[1].name));
+		ASSERT_EQ(0u, teams[1].conf);
+		ASSERT_EQ(17, teams[1].stats[STATS_POINTS]);
+
+		games = snapshot_get_games(snap, &num_games);
+		ASSERT_EQ(1, num_games);
+		ASSERT_TRUE(objectid_compare(&game_id, &games[0].id));
+		ASSERT_EQ(0u, games[0].home);
+		ASSERT_EQ(1u, games[0].away);
+		ASSERT_EQ(250, games[0].away_stats[STATS_PASS_YDS]);
+	}
+
+	TEST_F(SnapshotTest, LoadIntoDatabase) {
+		objectdb_ctx *loaded;
+		struct game *g;
+		const short *points;
+		int num_rows;
+		int err;
+
+		fillDatabase();
+		ASSERT_EQ(OBJECTDB_OK,
+		          objectdb_write(db, path, OBJECTDB_FORMAT_SNAPSHOT));
+		ASSERT_EQ(SNAPSHOT_OK, snapshot_open(snap, path));
+
+		loaded = objectdb_new();
+		ASSERT_TRUE(loaded != NULL);
+
+		err = snapshot_load(snap, loaded);
+		ASSERT_EQ(SNAPSHOT_OK, err);
+
+		g = objectdb_get_game(loaded, &game_id);
+		ASSERT_TRUE(g != NULL);
+		ASSERT_STREQ("Team One", g->home->name.str);
+		ASSERT_STREQ("Southeastern", g->away->conf->name.str);
+		ASSERT_EQ(31, g->home->stats.points);
+		ASSERT_TRUE(g->neutral);
+
+		points = objectdb_get_stats_column(loaded, STATS_POINTS, &num_rows);
+		ASSERT_EQ(2, num_rows);
+		ASSERT_EQ(17, points[OBJECTDB_STATS_ROW(g->idx, GAME_AWAY)]);
+
+		objectdb_free(loaded);
+	}
+
+	/* the stored objectids are used as they are, and match the names */
+	TEST_F(SnapshotTest, LoadKeepsIds) {
+		const struct snapshot_team *teams;
+		objectdb_ctx *loaded;
+		struct objectid id;
+		struct team *t;
+		int num_teams;
+
+		fillDatabase();
+		ASSERT_EQ(OBJECTDB_OK,
+		          objectdb_write(db, path, OBJECTDB_FORMAT_SNAPSHOT));
+		ASSERT_EQ(SNAPSHOT_OK, snapshot_open(snap, path));
+
+		loaded = objectdb_new();
+		ASSERT_TRUE(loaded != NULL);
+		ASSERT_EQ(SNAPSHOT_OK, snapshot_load(snap, loaded));
+
+		teams = snapshot_get_teams(snap, &num_teams);
+		for (int i = 0; i < num_teams; i++) {
+			t = objectdb_get_team(loaded, &teams[i].id);
+			ASSERT_TRUE(t != NULL);
+			objectid_from_team(t, &id);
+			ASSERT_TRUE(objectid_compare(&teams[i].id, &id));
+		}
+
+		objectid_from_game(objectdb_get_game_at(loaded, 0), &id);
+		ASSERT_TRUE(objectid_compare(&game_id, &id));
+
+		objectdb_free(loaded);
+	}
+
+	TEST_F(SnapshotTest, LoadDuplicateId) {
+		struct snapshot_header h;
+		struct snapshot_team teams[2];
+		objectdb_ctx *loaded;
+		FILE *f;
+
+		fillDatabase();
+		ASSERT_EQ(OBJECTDB_OK,
+		          objectdb_write(db, path, OBJECTDB_FORMAT_SNAPSHOT));
+
+		f = fopen(path, "r+b");
+		ASSERT_TRUE(f != NULL);
+		ASSERT_EQ(1u, fread(&h, sizeof(h), 1, f));
+		fseek(f, h.teams_offset, SEEK_SET);
+		ASSERT_EQ(2u, fread(teams, sizeof(teams[0]), 2, f));
+		teams[1].id = teams[0].id;
+		fseek(f, h.teams_offset, SEEK_SET);
+		ASSERT_EQ(2u, fwrite(teams, sizeof(teams[0]), 2, f));
+		fclose(f);
+
+		ASSERT_EQ(SNAPSHOT_OK, snapshot_open(snap, path));
+
+		loaded = objectdb_new();
+		ASSERT_TRUE(loaded != NULL);
+		ASSERT_EQ(SNAPSHOT_ERROR, snapshot_load(snap, loaded));
+		ASSERT_EQ(SNAPSHOT_EOBJECTDB, snapshot_get_error(snap));
+		ASSERT_EQ(OBJECTDB_EDUPLICATE, objectdb_get_error(loaded));
+
+		objectdb_free(loaded);
+	}
+
+	TEST_F(SnapshotTest, OpenYamlFile) {
+		int err;
+
+		fillDatabase();
+		ASSERT_EQ(OBJECTDB_OK,
+		          objectdb_write(db, path, OBJECTDB_FORMAT_YAML));
+
+		err = snapshot_open(snap, path);
+		ASSERT_EQ(SNAPSHOT_ERROR, err);
+		ASSERT_EQ(SNAPSHOT_EFORMAT, snapshot_get_error(snap));
+	}
+
+	TEST_F(SnapshotTest, OpenTruncatedFile) {
+		struct snapshot_header h;
+		int err;
+
+		fillDatabase();
+		ASSERT_EQ(OBJECTDB_OK,
+		          objectdb_write(db, path, OBJECTDB_FORMAT_SNAPSHOT));
+
+		/* keep the header, lose the tables it points at */
+		ASSERT_EQ(0, truncate(path, sizeof(h) + 8));
+
+		err = snapshot_open(snap, path);
+		ASSERT_EQ(SNAPSHOT_ERROR, err);
+		ASSERT_EQ(SNAPSHOT_ECORRUPT, snapshot_get_error(snap));
+	}
+
+	TEST_F(SnapshotTest, BadTeamReference) {
+		struct snapshot_header h;
+		struct snapshot_game game;
+		FILE *f;
+		int err;
+
+		fillDatabase();
+		ASSERT_EQ(OBJECTDB_OK,
+		          objectdb_write(db, path, OBJECTDB_FORMAT_SNAPSHOT));
+
+		f = fopen(path, "r+b");
+		ASSERT_TRUE(f != NULL);
+		ASSERT_EQ(1u, fread(&h, sizeof(h), 1, f));
+		fseek(f, h.games_offset, SEEK_SET);
+		ASSERT_EQ(1u, fread(&game, sizeof(game), 1, f));
+		game.away = 7;
+		fseek(f, h.games_offset, SEEK_SET);
+		ASSERT_EQ(1u, fwrite(&game, sizeof(game), 1, f));
+		fclose(f);
+
+		err = snapshot_open(snap, path);
+		ASSERT_EQ(SNAPSHOT_ERROR, err);
+		ASSERT_EQ(SNAPSHOT_ECORRUPT, snapshot_get_error(snap));
+	}
+}
@@ -1,6 +1,8 @@
 
 #include <gtest/gtest.h>
 
+#include <string>
+
 extern "C" {
 #include <predcfb/zipfile.h>
 }
@@ -127,4 +129,156 @@ namespace {
 		err = zipfile_open_file(zf, "filetwo.txt");
 		ASSERT_EQ(ZIPFILE_OK, err);
 	}
+
+	TEST_F(ZipFileTest, MappedBackend) {
+		ASSERT_EQ(ZIPFILE_BACKEND_MMAP, zipfile_get_backend(zf));
+	}
+
+	TEST_F(ZipFileTest, FileData) {
+		char *data;
+		size_t size;
+		int err;
+
+		err = zipfile_file_data(zf, &data, &size);
+		ASSERT_EQ(ZIPFILE_ERROR, err);
+		ASSERT_EQ(ZIPFILE_ENOTOPEN, zipfile_get_error(zf));
+
+		err = zipfile_open_file(zf, "filetwo.txt");
+		ASSERT_EQ(ZIPFILE_OK, err);
+
+		err = zipfile_file_data(zf, &data, &size);
+		ASSERT_EQ(ZIPFILE_OK, err);
+		ASSERT_EQ(8U, size);
+		ASSERT_EQ("test456\n", std::string(data, size));
+	}
+
+	/* the whole of a member, read through each backend */
+	static std::string memberData(const char *path, const char *file,
+	                              enum zipfile_backend backend)
+	{
+		zf_readctx *zf;
+		std::string str;
+		char *data;
+		size_t size;
+
+		zf = zipfile_open_archive_backend(path, backend);
+		EXPECT_NE((zf_readctx*) NULL, zf);
+		EXPECT_EQ(ZIPFILE_ENONE, zipfile_get_error(zf));
+		EXPECT_EQ(backend, zipfile_get_backend(zf));
+
+		EXPECT_EQ(ZIPFILE_OK, zipfile_open_file(zf, file));
+		if (zipfile_file_data(zf, &data, &size) == ZIPFILE_OK)
+			str.assign(data, size);
+
+		EXPECT_EQ(ZIPFILE_OK, zipfile_close_file(zf));
+		EXPECT_EQ(ZIPFILE_OK, zipfile_close_archive(zf));
+
+		return str;
+	}
+
+	/* and a piece at a time */
+	static std::string memberReads(const char *path, const char *file,
+	                               enum zipfile_backend backend)
+	{
+		zf_readctx *zf;
+		std::string str;
+		char buf[100];
+		ssize_t bytes;
+
+		zf = zipfile_open_archive_backend(path, backend);
+		EXPECT_NE((zf_readctx*) NULL, zf);
+		EXPECT_EQ(ZIPFILE_OK, zipfile_open_file(zf, file));
+
+		while ((bytes = zipfile_read_file(zf, buf, sizeof(buf))) > 0)
+			str.append(buf, bytes);
+
+		EXPECT_EQ(0, bytes);
+		EXPECT_EQ(ZIPFILE_OK, zipfile_close_file(zf));
+		EXPECT_EQ(ZIPFILE_OK, zipfile_close_archive(zf));
+
+		return str;
+	}
+
+	TEST(ZipFileTestNoFixture, BackendsAgree) {
+		static const char *path = "tests/data/deflated.zip";
+		std::string data;
+
+		data = memberData(path, "lines.txt", ZIPFILE_BACKEND_MMAP);
+		ASSERT_EQ(20890U, data.size());
+		ASSERT_EQ("line 0,of,some,csv\n", data.substr(0, 19));
+
+		ASSERT_EQ(data, memberData(path, "lines.txt",
+		                           ZIPFILE_BACKEND_MINIZIP));
+		ASSERT_EQ(data, memberReads(path, "lines.txt",
+		                            ZIPFILE_BACKEND_MMAP));
+		ASSERT_EQ(data, memberReads(path, "lines.txt",
+		                            ZIPFILE_BACKEND_MINIZIP));
+	}
+
+	TEST(ZipFileTestNoFixture, OpenBadArchiveMinizip) {
+		zf_readctx *zf;
+
+		zf = zipfile_open_archive_backend("tests/data/notazipfile.zip",
+		                                  ZIPFILE_BACKEND_MINIZIP);
+		EXPECT_NE((zf_readctx*) NULL, zf);
+		ASSERT_EQ(ZIPFILE_EFILEBAD, zipfile_get_error(zf));
+		free(zf);
+	}
+
+	TEST_F(ZipFileTest, List) {
+		const struct zipfile_stat *stats;
+
+		ASSERT_EQ(2, zipfile_list(zf, &stats));
+		ASSERT_STREQ("fileone.txt", stats[0].name);
+		ASSERT_EQ(8U, stats[0].size);
+		ASSERT_EQ(8U, stats[0].compressed_size);
+		ASSERT_EQ(0x6e943835U, stats[0].crc);
+		ASSERT_STREQ("filetwo.txt", stats[1].name);
+		ASSERT_EQ(0x21722ac7U, stats[1].crc);
+	}
+
+	TEST_F(ZipFileTest, Stat) {
+		struct zipfile_stat st;
+		int err;
+
+		err = zipfile_stat(zf, "filetwo.txt", &st);
+		ASSERT_EQ(ZIPFILE_OK, err);
+		ASSERT_STREQ("filetwo.txt", st.name);
+		ASSERT_EQ(8U, st.size);
+		ASSERT_EQ(0x21722ac7U, st.crc);
+
+		/* lookups are case sensitive, as they always were */
+		err = zipfile_stat(zf, "FILETWO.TXT", &st);
+		ASSERT_EQ(ZIPFILE_ERROR, err);
+		ASSERT_EQ(ZIPFILE_ENOENT, zipfile_get_error(zf));
+
+		/* an open file doesn't get in the way */
+		ASSERT_EQ(ZIPFILE_OK, zipfile_open_file(zf, "fileone.txt"));
+		err = zipfile_stat(zf, "fileone.txt", &st);
+		ASSERT_EQ(ZIPFILE_OK, err);
+		ASSERT_EQ(0x6e943835U, st.crc);
+	}
+
+	TEST(ZipFileTestNoFixture, ListMinizip) {
+		const struct zipfile_stat *stats;
+		struct zipfile_stat st;
+		zf_readctx *zf;
+
+		zf = zipfile_open_archive_backend("tests/data/deflated.zip",
+		                                  ZIPFILE_BACKEND_MINIZIP);
+		ASSERT_NE((zf_readctx*) NULL, zf);
+		ASSERT_EQ(ZIPFILE_ENONE, zipfile_get_error(zf));
+
+		ASSERT_EQ(1, zipfile_list(zf, &stats));
+		ASSERT_STREQ("lines.txt", stats[0].name);
+		ASSERT_EQ(20890U, stats[0].size);
+		ASSERT_EQ(2349U, stats[0].compressed_size);
+		ASSERT_EQ(0xcd450a2aU, stats[0].crc);
+
+		ASSERT_EQ(ZIPFILE_OK, zipfile_stat(zf, "lines.txt", &st));
+		ASSERT_EQ(20890U, st.size);
+		ASSERT_EQ(ZIPFILE_ERROR, zipfile_stat(zf, "lines", &st));
+
+		ASSERT_EQ(ZIPFILE_OK, zipfile_close_archive(zf));
+	}
 }